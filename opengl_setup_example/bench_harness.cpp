@@ -0,0 +1,181 @@
+//
+//  bench_harness.cpp
+//  opengl_setup_example
+//
+
+#include "bench_harness.h"
+
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+#include "frame_state.h"
+#include "gl_backend.h"
+#include "profiler.h"
+#include "trace.h"
+
+// untimed frames on each path first, so the ring buffers and queues have grown.
+constexpr int kWarmupFrames = 10;
+// alternating runs with the profiler off and on.
+constexpr int kProfilerRuns = 3;
+
+static int CountDrawCalls(const GLNullBackend& backend)
+{
+    return backend.CountCommands(kCmdDrawArrays) + backend.CountCommands(kCmdDrawElements) +
+        backend.CountCommands(kCmdDrawArraysInstanced) + backend.CountCommands(kCmdDrawElementsInstanced) +
+        backend.CountCommands(kCmdDrawElementsInstancedBaseVertex);
+}
+
+// Average cost of entering and leaving one profiler scope, with its timestamp queries when gpu is set.
+// Each includes a profiler frame as well, so this is an upper bound.
+static double TimeProfilerScope(bool gpu)
+{
+    const int kScopes = 100000;
+    GLNullBackend backend;
+    FrameProfiler profiler(backend);
+    int scope = profiler.AddScope("bench", gpu);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < kScopes; i++) {
+        // one scope a frame, so a GPU scope records its queries every time.
+        profiler.BeginFrame();
+        {
+            ProfileScope timed(&profiler, scope);
+        }
+        profiler.EndFrame();
+        backend.Discard();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / kScopes;
+}
+
+// Average cost of a TRACE_ZONE with tracing compiled in but not enabled.
+static double TimeDisabledTraceZone(void)
+{
+    const int kZones = 1000000;
+    auto start = std::chrono::high_resolution_clock::now();
+    for(int i = 0; i < kZones; i++) {
+        TRACE_ZONE("bench", "disabled zone");
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / kZones;
+}
+
+static HeadlessBenchStats RunFrames(DemoScene& scene, GLNullBackend& backend, int frames, bool replay)
+{
+    GLNullBackend replayTarget;
+    double totalNanos = 0;
+    double replayNanos = 0;
+    double commands = 0;
+    double bytes = 0;
+    double drawCalls = 0;
+
+    for(int i = -kWarmupFrames; i < frames; i++) {
+        TRACE_ZONE("frame", "bench frame");
+        auto start = std::chrono::high_resolution_clock::now();
+        scene.BeginFrame();
+        scene.Cull();
+        scene.Submit();
+        scene.EndFrame();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        if(i >= 0) {
+            totalNanos += std::chrono::duration<double, std::nano>(end - start).count();
+            commands += backend.CommandCount();
+            bytes += backend.ByteSize();
+            drawCalls += CountDrawCalls(backend);
+        }
+        if(replay) {
+            auto replayStart = std::chrono::high_resolution_clock::now();
+            backend.Replay(replayTarget);
+            auto replayEnd = std::chrono::high_resolution_clock::now();
+            if(i >= 0) {
+                replayNanos += std::chrono::duration<double, std::nano>(replayEnd - replayStart).count();
+            }
+            replayTarget.Discard();
+        }
+        backend.Discard();
+    }
+
+    HeadlessBenchStats stats;
+    stats.frames = frames;
+    stats.nsPerFrame = totalNanos / frames;
+    stats.commandsPerFrame = commands / frames;
+    stats.bytesPerFrame = bytes / frames;
+    stats.drawCallsPerFrame = drawCalls / frames;
+    stats.replayNsPerFrame = replayNanos / frames;
+    return stats;
+}
+
+bool RunHeadlessBench(const DemoSceneOptions& options, int frames, bool replay)
+{
+    FrameState frameState = FrameState();
+    GLNullBackend backend;
+    DemoScene scene(backend, frameState);
+    scene.printStats = false;
+
+    if(!scene.Init(options)) {
+        return false;
+    }
+    std::cout << "Headless setup: " << backend.CommandCount() << " commands, " << backend.ByteSize() / 1024 << " KB recorded" << std::endl;
+    backend.Discard();
+
+    const struct { const char* name; bool instancing; bool arena; } paths[] = {
+        { "one draw per object", false, false },
+        { "instanced", true, false },
+        { "geometry arena", true, true },
+    };
+    for(const auto& path : paths) {
+        scene.SetInstancing(path.instancing);
+        scene.SetArena(path.arena);
+        HeadlessBenchStats stats = RunFrames(scene, backend, frames, replay);
+
+        std::cout << "Headless bench (" << path.name << "): " << stats.frames << " frames, "
+            << stats.nsPerFrame << " ns/frame, " << stats.commandsPerFrame << " commands/frame, "
+            << stats.bytesPerFrame << " bytes/frame, " << stats.drawCallsPerFrame << " draw calls/frame";
+        if(replay) {
+            std::cout << ", replay " << stats.replayNsPerFrame << " ns/frame";
+        }
+        std::cout << std::endl;
+    }
+
+    // Same frames again with the profiler timing every pass, to check what it costs. The culling
+    // threads make single runs noisy next to the profiler's cost, so on and off take turns
+    // and the best of each counts.
+    double profilerOffNanos = 0;
+    double profilerOnNanos = 0;
+    for(int run = 0; run < kProfilerRuns; run++) {
+        for(bool profiling : { false, true }) {
+            scene.SetProfiling(profiling);
+            double nanos = RunFrames(scene, backend, frames, false).nsPerFrame;
+            double& best = profiling ? profilerOnNanos : profilerOffNanos;
+            best = run == 0 ? nanos : std::min(best, nanos);
+        }
+    }
+    // the demo's scopes, see DemoScene::SetProfiling, each entered about once a frame.
+    scene.SetProfiling(true);
+    const FrameProfiler* profiler = scene.Profiler();
+    int cpuScopes = 0;
+    int gpuScopes = 0;
+    for(int scope = 0; scope < profiler->ScopeCount(); scope++) {
+        (profiler->ScopeHasGPU(scope) ? gpuScopes : cpuScopes)++;
+    }
+    scene.SetProfiling(false);
+    backend.Discard();
+    double overhead = 100.0 * (profilerOnNanos - profilerOffNanos) / profilerOffNanos;
+    std::cout << "Headless bench (profiler): " << profilerOffNanos << " ns/frame off, "
+        << profilerOnNanos << " ns/frame on, " << overhead << "% overhead" << std::endl;
+
+    // That difference is within the noise, so also time the scopes on their own.
+    double cpuScopeNanos = TimeProfilerScope(false);
+    double gpuScopeNanos = TimeProfilerScope(true);
+    double scopeNanos = cpuScopes * cpuScopeNanos + gpuScopes * gpuScopeNanos;
+    std::cout << "Headless bench (profiler scopes): " << cpuScopeNanos << " ns per CPU scope, " << gpuScopeNanos
+        << " ns per GPU scope, about " << scopeNanos << " ns/frame, "
+        << 100.0 * scopeNanos / profilerOffNanos << "% of the frame" << std::endl;
+
+    if(!Tracer::Enabled()) {
+        std::cout << "Headless bench (tracing off): " << TimeDisabledTraceZone() << " ns per zone" << std::endl;
+    }
+    return true;
+}
@@ -0,0 +1,33 @@
+//
+//  bench_harness.h
+//  opengl_setup_example
+//
+
+#ifndef bench_harness_hpp
+#define bench_harness_hpp
+
+#include "demo_scene.h"
+
+struct HeadlessBenchStats {
+    int frames;
+    // CPU time of BeginFrame, Cull, Submit and EndFrame, recording the commands included.
+    double nsPerFrame;
+    double commandsPerFrame;
+    double bytesPerFrame;
+    double drawCallsPerFrame;
+    // replaying the recorded frame onto a second null backend, 0 when not replaying.
+    double replayNsPerFrame;
+
+    HeadlessBenchStats() : frames(0), nsPerFrame(0), commandsPerFrame(0), bytesPerFrame(0),
+                           drawCallsPerFrame(0), replayNsPerFrame(0) {}
+};
+
+// Sets up the demo scene on a GLNullBackend and runs frames frames of the normal update
+// and submit loop on each submit path, per object, instanced and geometry arena, printing
+// a line of stats for each. No window or GL context is needed.
+// Each frame's commands are discarded, or replayed first when replay is set.
+// Then the last path runs again with the frame profiler on and off, to print its overhead.
+// Returns false if the scene could not be set up.
+bool RunHeadlessBench(const DemoSceneOptions& options, int frames, bool replay);
+
+#endif /* bench_harness_hpp */
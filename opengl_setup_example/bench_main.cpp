@@ -0,0 +1,986 @@
+//
+//  bench_main.cpp
+//  opengl_setup_example
+//
+//  Microbenchmarks for the core kernels, built as the microbench target.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <memory>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <functional>
+
+#include "microbench.h"
+#include "smf.h"
+#include "trianglemesh.h"
+#include "bbox.h"
+#include "noise.h"
+#include "matrix.h"
+#include "textures.h"
+#include "proc_textures.h"
+#include "proc_graph.h"
+#include "texture_cache.h"
+#include "virtual_texture.h"
+#include "cube.h"
+#include "sphere.h"
+#include "pyramid.h"
+#include "thread_pool.h"
+
+// Returns the integer following flag on the command line, or defaultValue if flag is not there.
+static int IntArg(int argc, const char** argv, const char* flag, int defaultValue)
+{
+    for(int i = 1; i < argc - 1; i++) {
+        if(strcmp(argv[i], flag) == 0) {
+            return atoi(argv[i+1]);
+        }
+    }
+    return defaultValue;
+}
+
+// Returns the string following flag on the command line, or defaultValue if flag is not there.
+static const char* StringArg(int argc, const char** argv, const char* flag, const char* defaultValue)
+{
+    for(int i = 1; i < argc - 1; i++) {
+        if(strcmp(argv[i], flag) == 0) {
+            return argv[i+1];
+        }
+    }
+    return defaultValue;
+}
+
+static bool ReadFile(const std::string& path, std::string& outText)
+{
+    std::ifstream in(path);
+    if(!in) {
+        return false;
+    }
+    std::stringstream text;
+    text << in.rdbuf();
+    outText = text.str();
+    return true;
+}
+
+// Parsing only, each file is read into memory once up front.
+static void BenchReadSMF(MicroBench& bench, const std::string& meshDir)
+{
+    std::vector<std::filesystem::path> paths;
+    std::error_code error;
+    for(const auto& entry : std::filesystem::directory_iterator(meshDir, error)) {
+        if(entry.path().extension() == ".smf") {
+            paths.push_back(entry.path());
+        }
+    }
+    if(error || paths.empty()) {
+        std::cerr << "No SMF files in " << meshDir << ", skipping ReadSMF" << std::endl;
+        return;
+    }
+    std::sort(paths.begin(), paths.end());
+
+    for(const auto& path : paths) {
+        std::string name = "ReadSMF/" + path.filename().string();
+        if(!bench.Selected(name)) {
+            continue;
+        }
+        std::string text;
+        if(!ReadFile(path.string(), text)) {
+            std::cerr << "Unable to read " << path << std::endl;
+            continue;
+        }
+        std::vector<Vector3> verts;
+        std::vector<Triangle> triangles;
+        bench.Run(name, 1, [&] {
+            std::istringstream in(text);
+            ReadSMF(in, verts, triangles);
+            DoNotOptimize(triangles.size());
+        });
+    }
+}
+
+static Vector3 RandomPoint(std::mt19937& rng, double range)
+{
+    std::uniform_real_distribution<double> dist(-range, range);
+    return Vector3(dist(rng), dist(rng), dist(rng));
+}
+
+// Rays from around the origin towards triangles and boxes near it, so a fair share hit.
+static std::vector<Ray> RandomRays(std::mt19937& rng, int count)
+{
+    std::vector<Ray> rays(count);
+    for(Ray& ray : rays) {
+        ray.o = Vector3(0, 0, 5) + RandomPoint(rng, 0.5);
+        Vector3 target = RandomPoint(rng, 1.0);
+        ray.d = target - ray.o;
+    }
+    return rays;
+}
+
+static void BenchIntersect(MicroBench& bench)
+{
+    const int kRays = 10000;
+    std::mt19937 rng(1234);
+    std::vector<Ray> rays = RandomRays(rng, kRays);
+
+    std::vector<Vector3> triangleVerts;
+    for(int i = 0; i < kRays * 3; i++) {
+        triangleVerts.push_back(RandomPoint(rng, 1.0));
+    }
+    bench.Run("TriangleMesh::IntersectTriangle", kRays, [&] {
+        int hits = 0;
+        double t, beta, gamma;
+        for(int i = 0; i < kRays; i++) {
+            const Vector3* v = &triangleVerts[i * 3];
+            hits += TriangleMesh::IntersectTriangle(rays[i], t, beta, gamma, v[0], v[1], v[2]) ? 1 : 0;
+        }
+        DoNotOptimize(hits);
+    });
+
+    std::vector<BBox> boxes;
+    for(int i = 0; i < kRays; i++) {
+        Vector3 a = RandomPoint(rng, 1.0);
+        Vector3 b = RandomPoint(rng, 1.0);
+        boxes.push_back(BBox(Vector3(std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)),
+                             Vector3(std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z))));
+    }
+    bench.Run("BBox::Intersect", kRays, [&] {
+        int hits = 0;
+        double tNear, tFar;
+        for(int i = 0; i < kRays; i++) {
+            hits += boxes[i].Intersect(rays[i], tNear, tFar) ? 1 : 0;
+        }
+        DoNotOptimize(hits);
+    });
+}
+
+static const BenchResult* FindResult(const MicroBench& bench, const std::string& name)
+{
+    for(const BenchResult& result : bench.Results()) {
+        if(result.name == name) {
+            return &result;
+        }
+    }
+    return nullptr;
+}
+
+static void BenchNoise(MicroBench& bench)
+{
+    const int kPoints = 100000;
+    std::mt19937 rng(5678);
+    std::vector<Vector3> points;
+    for(int i = 0; i < kPoints; i++) {
+        points.push_back(RandomPoint(rng, 16.0));
+    }
+    bench.Run("ImpPerlinNoise", kPoints, [&] {
+        double sum = 0;
+        for(const Vector3& p : points) {
+            sum += ImpPerlinNoise(p);
+        }
+        DoNotOptimize(sum);
+    });
+
+    // The same points as separate x, y and z arrays for the batch versions.
+    std::vector<double> xs, ys, zs, nd(kPoints);
+    for(const Vector3& p : points) {
+        xs.push_back(p.x);
+        ys.push_back(p.y);
+        zs.push_back(p.z);
+    }
+    std::vector<float> xf(xs.begin(), xs.end()), yf(ys.begin(), ys.end()), zf(zs.begin(), zs.end()), nf(kPoints);
+    bench.Run("ImpPerlinNoiseBatch/float", kPoints, [&] {
+        ImpPerlinNoiseBatch(xf.data(), yf.data(), zf.data(), nf.data(), kPoints);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("ImpPerlinNoiseBatch/double", kPoints, [&] {
+        ImpPerlinNoiseBatch(xs.data(), ys.data(), zs.data(), nd.data(), kPoints);
+        DoNotOptimize(nd.data());
+    });
+
+    // Settings of the demo's FBM texture, less octaves so a repetition stays short.
+    const int kFBMPoints = 10000;
+    bench.Run("FBM/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kFBMPoints; i++) {
+            sum += FBM(points[i], 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("Turbulence/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kFBMPoints; i++) {
+            sum += Turbulence(points[i], 3.0, 8);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("FBMBatch/float/8 octaves", kFBMPoints, [&] {
+        FBMBatch(xf.data(), yf.data(), zf.data(), nf.data(), kFBMPoints, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("FBMBatch/double/8 octaves", kFBMPoints, [&] {
+        FBMBatch(xs.data(), ys.data(), zs.data(), nd.data(), kFBMPoints, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+        DoNotOptimize(nd.data());
+    });
+
+    // Simplex noise on the same points. 3D simplex features are about 1.25 times the size
+    // of Perlin's at the same frequency, going by zero crossings along random lines, so
+    // its FBM starts that much higher to compare at the same visual frequency.
+    const double kSimplexFreq3D = 3.0 * 1.25;
+    const NoiseGenerator& noise = NoiseGenerator::Default();
+    bench.Run("SimplexNoise", kPoints, [&] {
+        double sum = 0;
+        for(const Vector3& p : points) {
+            sum += noise.SimplexNoise(p);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("SimplexNoiseBatch/float", kPoints, [&] {
+        noise.SimplexNoiseBatch(xf.data(), yf.data(), zf.data(), nf.data(), kPoints);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("SimplexNoiseBatch/double", kPoints, [&] {
+        noise.SimplexNoiseBatch(xs.data(), ys.data(), zs.data(), nd.data(), kPoints);
+        DoNotOptimize(nd.data());
+    });
+    bench.Run("FBM/simplex/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kFBMPoints; i++) {
+            sum += noise.FBM(points[i], 0.8, 1.8, kSimplexFreq3D, -0.5, 0.5, 8, false, kNoiseSimplex);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("FBMBatch/simplex/float/8 octaves", kFBMPoints, [&] {
+        noise.FBMBatch(xf.data(), yf.data(), zf.data(), nf.data(), kFBMPoints, 0.8, 1.8, kSimplexFreq3D, -0.5, 0.5, 8, false,
+                       kNoiseSimplex);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("FBMBatch/simplex/double/8 octaves", kFBMPoints, [&] {
+        noise.FBMBatch(xs.data(), ys.data(), zs.data(), nd.data(), kFBMPoints, 0.8, 1.8, kSimplexFreq3D, -0.5, 0.5, 8, false,
+                       kNoiseSimplex);
+        DoNotOptimize(nd.data());
+    });
+
+    // The same x and y in the 2D and tileable versions.
+    const int kPeriod = 16;
+    bench.Run("ImpPerlinNoise2D", kPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kPoints; i++) {
+            sum += noise.ImpPerlinNoise2D(xs[i], ys[i]);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("TileableNoise2D", kPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kPoints; i++) {
+            sum += noise.TileableNoise2D(xs[i], ys[i], kPeriod, kPeriod);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("ImpPerlinNoiseBatch2D/float", kPoints, [&] {
+        noise.ImpPerlinNoiseBatch2D(xf.data(), yf.data(), nf.data(), kPoints);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("ImpPerlinNoiseBatch2D/double", kPoints, [&] {
+        noise.ImpPerlinNoiseBatch2D(xs.data(), ys.data(), nd.data(), kPoints);
+        DoNotOptimize(nd.data());
+    });
+    bench.Run("TileableNoiseBatch2D/float", kPoints, [&] {
+        noise.TileableNoiseBatch2D(xf.data(), yf.data(), nf.data(), kPoints, kPeriod, kPeriod);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("FBM2D/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kFBMPoints; i++) {
+            sum += noise.FBM2D(xs[i], ys[i], 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("FBMBatch2D/double/8 octaves", kFBMPoints, [&] {
+        noise.FBMBatch2D(xs.data(), ys.data(), nd.data(), kFBMPoints, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+        DoNotOptimize(nd.data());
+    });
+    bench.Run("SimplexNoise2D", kPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kPoints; i++) {
+            sum += noise.SimplexNoise2D(xs[i], ys[i]);
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("SimplexNoiseBatch2D/float", kPoints, [&] {
+        noise.SimplexNoiseBatch2D(xf.data(), yf.data(), nf.data(), kPoints);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("FBMBatch2D/simplex/double/8 octaves", kFBMPoints, [&] {
+        noise.FBMBatch2D(xs.data(), ys.data(), nd.data(), kFBMPoints, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false, kNoiseSimplex);
+        DoNotOptimize(nd.data());
+    });
+    // 4D has no Perlin version, with w as time it is what an animated 3D texture costs.
+    std::vector<float> wf(kPoints);
+    for(int i = 0; i < kPoints; i++) {
+        wf[i] = i * 0.001f;
+    }
+    bench.Run("SimplexNoiseBatch4D/float", kPoints, [&] {
+        noise.SimplexNoiseBatch4D(xf.data(), yf.data(), zf.data(), wf.data(), nf.data(), kPoints);
+        DoNotOptimize(nf.data());
+    });
+    bench.Run("TileableFBMBatch2D/double/8 octaves", kFBMPoints, [&] {
+        noise.TileableFBMBatch2D(xs.data(), ys.data(), nd.data(), kFBMPoints, kPeriod, kPeriod, 0.5, 2, -0.5, 0.5, 8, false);
+        DoNotOptimize(nd.data());
+    });
+
+    // Value and gradient from the analytic derivatives, against the value and forward
+    // differences, the fewest extra evaluations a gradient can take.
+    const double kStep = 1e-4;
+    bench.Run("FBMDeriv/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        Vector3 gradient;
+        for(int i = 0; i < kFBMPoints; i++) {
+            sum += noise.FBMDeriv(points[i], 0.8, 1.8, 3.0, -0.5, 0.5, 8, false, gradient);
+            sum += gradient.x + gradient.y + gradient.z;
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("FBM/forward differences/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kFBMPoints; i++) {
+            double value = noise.FBM(points[i], 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+            sum += value;
+            for(const Vector3& axis : { Vector3(kStep, 0, 0), Vector3(0, kStep, 0), Vector3(0, 0, kStep) }) {
+                sum += (noise.FBM(points[i] + axis, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false) - value) / kStep;
+            }
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("TileableFBMDeriv2D/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kFBMPoints; i++) {
+            double dx, dy;
+            sum += noise.TileableFBMDeriv2D(xs[i], ys[i], kPeriod, kPeriod, 0.5, 2, -0.5, 0.5, 8, false, dx, dy);
+            sum += dx + dy;
+        }
+        DoNotOptimize(sum);
+    });
+    bench.Run("TileableFBM2D/forward differences/8 octaves", kFBMPoints, [&] {
+        double sum = 0;
+        for(int i = 0; i < kFBMPoints; i++) {
+            double value = noise.TileableFBM2D(xs[i], ys[i], kPeriod, kPeriod, 0.5, 2, -0.5, 0.5, 8, false);
+            sum += value;
+            sum += (noise.TileableFBM2D(xs[i] + kStep, ys[i], kPeriod, kPeriod, 0.5, 2, -0.5, 0.5, 8, false) - value) / kStep;
+            sum += (noise.TileableFBM2D(xs[i], ys[i] + kStep, kPeriod, kPeriod, 0.5, 2, -0.5, 0.5, 8, false) - value) / kStep;
+        }
+        DoNotOptimize(sum);
+    });
+
+    const char* kComparisons[][2] = {
+        { "ImpPerlinNoise", "ImpPerlinNoise2D" },
+        { "ImpPerlinNoise", "TileableNoise2D" },
+        { "ImpPerlinNoiseBatch/float", "ImpPerlinNoiseBatch2D/float" },
+        { "ImpPerlinNoiseBatch/double", "ImpPerlinNoiseBatch2D/double" },
+        { "ImpPerlinNoiseBatch/float", "TileableNoiseBatch2D/float" },
+        { "FBM/8 octaves", "FBM2D/8 octaves" },
+        { "FBMBatch/double/8 octaves", "FBMBatch2D/double/8 octaves" },
+        { "FBMBatch/double/8 octaves", "TileableFBMBatch2D/double/8 octaves" },
+    };
+    bool printedHeader = false;
+    char line[160];
+    for(const auto& comparison : kComparisons) {
+        const BenchResult* result3D = FindResult(bench, comparison[0]);
+        const BenchResult* result2D = FindResult(bench, comparison[1]);
+        if(!result3D || !result2D) {
+            continue;
+        }
+        if(!printedHeader) {
+            std::cout << "\n2D against 3D, median ns/op:\n";
+            printedHeader = true;
+        }
+        snprintf(line, sizeof(line), "%-36s %8.1f  %-28s %8.1f  %5.2fx", comparison[1], result2D->medianNanos,
+                 comparison[0], result3D->medianNanos, result3D->medianNanos / result2D->medianNanos);
+        std::cout << line << "\n";
+    }
+    if(printedHeader) {
+        std::cout << std::endl;
+    }
+
+    // Octaves a second for FBM on each basis, at the same visual frequency.
+    const char* kBasisComparisons[][2] = {
+        { "FBM/8 octaves", "FBM/simplex/8 octaves" },
+        { "FBMBatch/float/8 octaves", "FBMBatch/simplex/float/8 octaves" },
+        { "FBMBatch/double/8 octaves", "FBMBatch/simplex/double/8 octaves" },
+        { "FBMBatch2D/double/8 octaves", "FBMBatch2D/simplex/double/8 octaves" },
+    };
+    printedHeader = false;
+    for(const auto& comparison : kBasisComparisons) {
+        const BenchResult* perlin = FindResult(bench, comparison[0]);
+        const BenchResult* simplex = FindResult(bench, comparison[1]);
+        if(!perlin || !simplex) {
+            continue;
+        }
+        if(!printedHeader) {
+            std::cout << "Simplex against Perlin, million octaves/s:\n";
+            printedHeader = true;
+        }
+        const double kOctaves = 8;
+        snprintf(line, sizeof(line), "%-36s %8.2f  %-28s %8.2f  %5.2fx", comparison[1], 1e3 * kOctaves / simplex->medianNanos,
+                 comparison[0], 1e3 * kOctaves / perlin->medianNanos, perlin->medianNanos / simplex->medianNanos);
+        std::cout << line << "\n";
+    }
+    if(printedHeader) {
+        std::cout << std::endl;
+    }
+
+    const char* kGradientComparisons[][2] = {
+        { "FBM/forward differences/8 octaves", "FBMDeriv/8 octaves" },
+        { "TileableFBM2D/forward differences/8 octaves", "TileableFBMDeriv2D/8 octaves" },
+    };
+    printedHeader = false;
+    for(const auto& comparison : kGradientComparisons) {
+        const BenchResult* differences = FindResult(bench, comparison[0]);
+        const BenchResult* analytic = FindResult(bench, comparison[1]);
+        if(!differences || !analytic) {
+            continue;
+        }
+        if(!printedHeader) {
+            std::cout << "Analytic gradient against finite differences, median ns/op:\n";
+            printedHeader = true;
+        }
+        snprintf(line, sizeof(line), "%-36s %8.1f  %-28s %8.1f  %5.2fx", comparison[1], analytic->medianNanos,
+                 comparison[0], differences->medianNanos, differences->medianNanos / analytic->medianNanos);
+        std::cout << line << "\n";
+    }
+    if(printedHeader) {
+        std::cout << std::endl;
+    }
+}
+
+static void BenchMatrix(MicroBench& bench)
+{
+    const int kMultiplies = 10000;
+    std::mt19937 rng(91011);
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    Matrix a(4, 4), b(4, 4), r(4, 4);
+    for(unsigned row = 0; row < 4; row++) {
+        for(unsigned col = 0; col < 4; col++) {
+            a.Set(row, col, dist(rng));
+            b.Set(row, col, dist(rng));
+        }
+    }
+    bench.Run("Matrix::Multiply/4x4", kMultiplies, [&] {
+        for(int i = 0; i < kMultiplies; i++) {
+            Matrix::Multiply(r, a, b);
+            DoNotOptimize(r[0][0]);
+        }
+    });
+}
+
+static void BenchMesh(MicroBench& bench, const std::string& meshDir)
+{
+    TriangleMesh mesh;
+    std::string path = meshDir + "/teapot.smf";
+    if(!mesh.LoadFromSMF(path.c_str())) {
+        std::cerr << "Unable to load " << path << ", skipping mesh benchmarks" << std::endl;
+        return;
+    }
+    bench.Run("TriangleMesh::CalcNormals/teapot", 1, [&] {
+        mesh.CalcNormals();
+        DoNotOptimize(mesh.GetVertexNormals().size());
+    });
+
+    std::vector<float> texCoords;
+    bench.Run("AutoMapUV/teapot", 1, [&] {
+        texCoords.clear();
+        AutoMapUV(mesh, texCoords);
+        DoNotOptimize(texCoords.size());
+    });
+}
+
+static void BenchGenerators(MicroBench& bench)
+{
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor green = {0, 255, 0};
+    const RGBColor white = {255, 255, 255};
+    const RGBColor orange = {232, 99, 10};
+
+    // Sizes as in the demo, the FBM octaves cut down as above.
+    bench.Run("GenerateCheckers/1024", 1, [&] {
+        std::unique_ptr<RGBImageBuffer> image(GenerateCheckers(1024, 32, blue, green));
+        DoNotOptimize(image->Pixels());
+    });
+    bench.Run("GenerateMarble/512", 1, [&] {
+        std::unique_ptr<RGBImageBuffer> image(GenerateMarble(512, blue, white));
+        DoNotOptimize(image->Pixels());
+    });
+    bench.Run("GenerateFractalBrownianMotion/256", 1, [&] {
+        std::unique_ptr<RGBImageBuffer> image(GenerateFractalBrownianMotion(256, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false));
+        DoNotOptimize(image->Pixels());
+    });
+    bench.Run("GenerateMarble/simplex/512", 1, [&] {
+        std::unique_ptr<RGBImageBuffer> image(GenerateMarble(512, blue, white, nullptr, kNoiseSimplex));
+        DoNotOptimize(image->Pixels());
+    });
+    bench.Run("GenerateFractalBrownianMotion/simplex/256", 1, [&] {
+        std::unique_ptr<RGBImageBuffer> image(GenerateFractalBrownianMotion(256, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false,
+                                                                            nullptr, kNoiseSimplex));
+        DoNotOptimize(image->Pixels());
+    });
+    bench.Run("GenerateTileableFractalBrownianMotion/256", 1, [&] {
+        std::unique_ptr<RGBImageBuffer> image(GenerateTileableFractalBrownianMotion(256, orange, 8, 0.5, 2, -0.5, 0.5, 8, false));
+        DoNotOptimize(image->Pixels());
+    });
+    bench.Run("GenerateTileableHeightAndNormalMaps/256", 1, [&] {
+        RGBImageBuffer* height;
+        RGBImageBuffer* normal;
+        GenerateTileableHeightAndNormalMaps(256, 8, 0.5, 2, -0.5, 0.5, 8, false, 0.02, height, normal);
+        std::unique_ptr<RGBImageBuffer> heightMap(height), normalMap(normal);
+        DoNotOptimize(normalMap->Pixels());
+    });
+    // The same two maps the way they were made before, the height texture then the
+    // normals from forward differences of the FBM.
+    bench.Run("GenerateTileableHeightAndNormalMaps/finite differences/256", 1, [&] {
+        std::unique_ptr<RGBImageBuffer> heightMap(GenerateTileableFractalBrownianMotion(256, white, 8, 0.5, 2, -0.5, 0.5, 8, false));
+        const NoiseGenerator& noise = NoiseGenerator::Default();
+        const double cellsPerPixel = 8.0 / 256;
+        const double kStep = 1e-4;
+        const double slopeScale = 0.02 * 8;
+        auto normalColor = [&](u_int32_t x, u_int32_t y) {
+            double u = x * cellsPerPixel, v = y * cellsPerPixel;
+            double h = noise.TileableFBM2D(u, v, 8, 8, 0.5, 2, -0.5, 0.5, 8, false);
+            double dhdu = (noise.TileableFBM2D(u + kStep, v, 8, 8, 0.5, 2, -0.5, 0.5, 8, false) - h) / kStep;
+            double dhdv = (noise.TileableFBM2D(u, v + kStep, 8, 8, 0.5, 2, -0.5, 0.5, 8, false) - h) / kStep;
+            Vector3 n(-dhdu * slopeScale, -dhdv * slopeScale, 1.0);
+            n = n / n.Magnitude();
+            return ColorF(n.x * 0.5 + 0.5, n.y * 0.5 + 0.5, n.z * 0.5 + 0.5);
+        };
+        std::unique_ptr<RGBImageBuffer> normalMap(GenerateProceduralTexture(256, normalColor));
+        DoNotOptimize(normalMap->Pixels());
+    });
+
+    std::vector<float> vertices, normals, texCoords;
+    std::vector<int> indices;
+    // the cube and pyramid are too quick to time one at a time.
+    const int kSmallShapes = 1000;
+    bench.Run("GenerateCube", kSmallShapes, [&] {
+        for(int i = 0; i < kSmallShapes; i++) {
+            vertices.clear();
+            texCoords.clear();
+            GenerateCube(vertices, texCoords);
+            DoNotOptimize(vertices.size());
+        }
+    });
+    bench.Run("GeneratePyramid", kSmallShapes, [&] {
+        for(int i = 0; i < kSmallShapes; i++) {
+            vertices.clear();
+            texCoords.clear();
+            GeneratePyramid(vertices, texCoords);
+            DoNotOptimize(vertices.size());
+        }
+    });
+    bench.Run("GenerateSphere/64x64", 1, [&] {
+        vertices.clear();
+        normals.clear();
+        texCoords.clear();
+        indices.clear();
+        GenerateSphere(1.0f, 64, 64, vertices, normals, texCoords, indices);
+        DoNotOptimize(vertices.size());
+    });
+}
+
+// The batch color functions, shading a batch of ray hits in one call against a call per
+// hit, and packing a 512 square texture's float colors to bytes against To24Color.
+static void BenchColorBatch(MicroBench& bench)
+{
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor white = {255, 255, 255};
+    const RGBColor orange = {232, 99, 10};
+    const int kHits = 1024;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> coord(0.0, 512.0);
+    std::vector<double> xs(kHits), ys(kHits), zs(kHits);
+    for(int i = 0; i < kHits; i++) {
+        xs[i] = coord(rng);
+        ys[i] = coord(rng);
+        zs[i] = coord(rng) / 32;
+    }
+    std::vector<float> r(kHits), g(kHits), b(kHits);
+    const ColorSpan span = { r.data(), g.data(), b.data() };
+
+    const std::pair<const char*, std::shared_ptr<const ProcColorBatch>> functions[] = {
+        { "MarbleColors", MarbleColors(blue, white) },
+        { "FractalBrownianMotionColors", FractalBrownianMotionColors(orange, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false) },
+    };
+    for(const auto& function : functions) {
+        bench.Run(std::string(function.first) + "/ColorsAtPoints/batch", kHits, [&] {
+            function.second->ColorsAtPoints(xs.data(), ys.data(), zs.data(), kHits, span);
+            DoNotOptimize(r.data());
+        });
+        bench.Run(std::string(function.first) + "/ColorsAtPoints/one a call", kHits, [&] {
+            for(int i = 0; i < kHits; i++) {
+                function.second->ColorsAtPoints(&xs[i], &ys[i], &zs[i], 1, { &r[i], &g[i], &b[i] });
+            }
+            DoNotOptimize(r.data());
+        });
+    }
+
+    // a little over 1 in places, like the marble's two layers added together.
+    const u_int32_t kSize = 512;
+    std::uniform_real_distribution<float> channel(0.0f, 1.2f);
+    std::vector<float> rs(kSize * kSize), gs(kSize * kSize), bs(kSize * kSize);
+    std::vector<ColorF> colors(kSize * kSize);
+    for(size_t i = 0; i < colors.size(); i++) {
+        rs[i] = channel(rng);
+        gs[i] = channel(rng);
+        bs[i] = channel(rng);
+        colors[i] = ColorF(rs[i], gs[i], bs[i]);
+        colors[i].TrimToRange();
+    }
+    std::vector<uint8_t> pixels(kSize * kSize * 3);
+    bench.Run("PackColors24/512", kSize * kSize, [&] {
+        for(u_int32_t y = 0; y < kSize; y++) {
+            const size_t first = y * kSize;
+            PackColors24({ &rs[first], &gs[first], &bs[first] }, kSize, &pixels[first * 3]);
+        }
+        DoNotOptimize(pixels.data());
+    });
+    bench.Run("To24Color/512", kSize * kSize, [&] {
+        uint8_t* pp = pixels.data();
+        for(const ColorF& color : colors) {
+            RGBColor mc;
+            To24Color(color, mc.r, mc.g, mc.b);
+            *pp++ = mc.r;
+            *pp++ = mc.g;
+            *pp++ = mc.b;
+        }
+        DoNotOptimize(pixels.data());
+    });
+
+    const char* kBatchComparisons[][2] = {
+        { "MarbleColors/ColorsAtPoints/one a call", "MarbleColors/ColorsAtPoints/batch" },
+        { "FractalBrownianMotionColors/ColorsAtPoints/one a call", "FractalBrownianMotionColors/ColorsAtPoints/batch" },
+        { "To24Color/512", "PackColors24/512" },
+    };
+    char line[256];
+    bool printedHeader = false;
+    for(const auto& comparison : kBatchComparisons) {
+        const BenchResult* single = FindResult(bench, comparison[0]);
+        const BenchResult* batch = FindResult(bench, comparison[1]);
+        if(!single || !batch) {
+            continue;
+        }
+        if(!printedHeader) {
+            std::cout << "Batch against one at a time, median ns/op:\n";
+            printedHeader = true;
+        }
+        snprintf(line, sizeof(line), "%-48s %8.1f  %-52s %8.1f  %5.2fx", comparison[1], batch->medianNanos,
+                 comparison[0], single->medianNanos, single->medianNanos / batch->medianNanos);
+        std::cout << line << "\n";
+    }
+    if(printedHeader) {
+        std::cout << std::endl;
+    }
+}
+
+// Texture graphs compiled to plans, a texel per op so ns/op is ms per megapixel. The demo's
+// marble, whose layers share no noise, and two FBM layers an octave apart made with their
+// overlapping octaves shared and with each making its own.
+static void BenchTextureGraph(MicroBench& bench)
+{
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor white = {255, 255, 255};
+    const u_int32_t kSize = 512;
+
+    ProcTextureGraph layered;
+    ProcTextureGraph::Node texels = layered.TexelPoints(0, 0.0f);
+    layered.AddColorLayer(layered.FBM(texels, 0.5, 2.0, 0.02, -0.6, 0.6, 6, false), ColorF(0.6f, 0.3f, 0.1f));
+    layered.AddColorLayer(layered.FBM(texels, 0.5, 2.0, 0.04, -0.6, 0.6, 6, false), ColorF(0.2f, 0.3f, 0.5f));
+
+    const std::pair<const char*, std::shared_ptr<const ProcColorBatch>> plans[] = {
+        { "TextureGraph/marble/512", MarbleColors(blue, white) },
+        { "TextureGraph/layered FBM/shared octaves/512", layered.Compile() },
+        { "TextureGraph/layered FBM/separate octaves/512", layered.Compile(false) },
+    };
+    std::vector<float> r(kSize), g(kSize), b(kSize);
+    std::vector<uint8_t> pixels(kSize * kSize * 3);
+    for(const auto& plan : plans) {
+        bench.Run(plan.first, kSize * kSize, [&] {
+            for(u_int32_t y = 0; y < kSize; y++) {
+                plan.second->ColorsOfTexels(0, 0, y, kSize, { r.data(), g.data(), b.data() });
+                PackColors24({ r.data(), g.data(), b.data() }, kSize, &pixels[y * kSize * 3]);
+            }
+            DoNotOptimize(pixels.data());
+        });
+    }
+
+    bool printedHeader = false;
+    for(const auto& plan : plans) {
+        const BenchResult* result = FindResult(bench, plan.first);
+        if(!result) {
+            continue;
+        }
+        if(!printedHeader) {
+            std::cout << "Texture graphs, median ms per megapixel:\n";
+            printedHeader = true;
+        }
+        char line[256];
+        snprintf(line, sizeof(line), "%-48s %8.1f", plan.first, result->medianNanos);
+        std::cout << line << "\n";
+    }
+    if(printedHeader) {
+        std::cout << std::endl;
+    }
+}
+
+// The demo's marble through a TextureCache, made and written on a miss and mapped on a hit.
+static void BenchTextureCache(MicroBench& bench)
+{
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor white = {255, 255, 255};
+    const std::filesystem::path directory = std::filesystem::temp_directory_path() / "microbench_texture_cache";
+    std::filesystem::remove_all(directory);
+
+    TextureCache cache(directory.string());
+    auto generate = [&] { return GenerateMarble(512, blue, white); };
+    // a new key every time, so every Get misses.
+    int missCount = 0;
+    bench.Run("TextureCache::Get/miss/marble 512", 1, [&] {
+        std::unique_ptr<TextureLevels> levels = cache.Get(ProcTextureKey("GenerateMarble", 512, blue, white, missCount++), true, generate);
+        DoNotOptimize(levels->GetLevel(0).pixels);
+    });
+    const std::string key = ProcTextureKey("GenerateMarble", 512, blue, white);
+    cache.Get(key, true, generate);
+    // a hit maps the file without reading it, so this touches every page as an upload would.
+    bench.Run("TextureCache::Get/hit/marble 512", 1, [&] {
+        std::unique_ptr<TextureLevels> levels = cache.Get(key, true, generate);
+        int sum = 0;
+        for(int level = 0; level < levels->LevelCount(); level++) {
+            const TextureLevels::Level& entry = levels->GetLevel(level);
+            for(size_t offset = 0; offset < (size_t)entry.rowBytes * entry.height; offset += 4096) {
+                sum += entry.pixels[offset];
+            }
+        }
+        DoNotOptimize(sum);
+    });
+    std::filesystem::remove_all(directory);
+}
+
+// A 16k square marble as a virtual texture with a 4 MB budget. A cold region makes all
+// its pages, a warm one copies them out, and samples are of pages already made.
+static void BenchVirtualTexture(MicroBench& bench)
+{
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor white = {255, 255, 255};
+    const u_int32_t kSize = 16384;
+    const size_t kBudget = 4 << 20;
+    const u_int32_t kRegion = 512;
+    std::vector<uint8_t> pixels(kRegion * kRegion * 3);
+
+    // somewhere new every time, so each region misses on every page.
+    VirtualTexture coldTexture(kSize, MarbleRegion(blue, white), kBudget);
+    u_int32_t coldX = 0;
+    bench.Run("VirtualTexture::ReadRegion/cold/marble 16k/512x512", 1, [&] {
+        coldTexture.ReadRegion(0, coldX, coldX, kRegion, kRegion, pixels.data(), kRegion * 3);
+        coldX = (coldX + kRegion) % kSize;
+        DoNotOptimize(pixels.data());
+    });
+
+    VirtualTexture warmTexture(kSize, MarbleRegion(blue, white), kBudget);
+    warmTexture.ReadRegion(0, 4096, 4096, kRegion, kRegion, pixels.data(), kRegion * 3);
+    bench.Run("VirtualTexture::ReadRegion/warm/marble 16k/512x512", 1, [&] {
+        warmTexture.ReadRegion(0, 4096, 4096, kRegion, kRegion, pixels.data(), kRegion * 3);
+        DoNotOptimize(pixels.data());
+    });
+
+    const int kSamples = 100000;
+    std::mt19937 rng(2468);
+    std::uniform_real_distribution<double> dist(4096.0 / kSize, (4096.0 + kRegion) / kSize);
+    std::vector<double> us(kSamples), vs(kSamples);
+    for(int i = 0; i < kSamples; i++) {
+        us[i] = dist(rng);
+        vs[i] = dist(rng);
+    }
+    bench.Run("VirtualTexture::Sample/warm/marble 16k", kSamples, [&] {
+        float sum = 0;
+        for(int i = 0; i < kSamples; i++) {
+            sum += warmTexture.Sample(us[i], vs[i], 0).r;
+        }
+        DoNotOptimize(sum);
+    });
+
+    // Four threads sampling a 3x3 page texture with room for four pages, so most samples
+    // miss and make a page while others are being evicted. Checked against the generator.
+    const std::string kThrashName = "VirtualTexture::Sample/thrashing/marble 300/4 threads";
+    if(bench.Selected(kThrashName)) {
+        const u_int32_t kSmallSize = 300;
+        const size_t kSmallBudget = 4 * TextureLevels::LevelBytes(VirtualTexture::kPageSize, VirtualTexture::kPageSize,
+                                                                   VirtualTexture::kChannels);
+        std::unique_ptr<RGBImageBuffer> reference(GenerateMarble(kSmallSize, blue, white));
+        VirtualTexture thrashed(kSmallSize, MarbleRegion(blue, white), kSmallBudget);
+        const int kThreads = 4;
+        const int kThrashSamples = 500;
+        std::vector<int> wrong(kThreads, 0);
+        bench.Run(kThrashName, kThreads * kThrashSamples, [&] {
+            std::vector<std::thread> threads;
+            for(int t = 0; t < kThreads; t++) {
+                threads.emplace_back([&, t] {
+                    std::mt19937 threadRng(t);
+                    std::uniform_real_distribution<double> unit(0.0, 1.0);
+                    for(int i = 0; i < kThrashSamples; i++) {
+                        double u = unit(threadRng), v = unit(threadRng);
+                        ColorF sampled = thrashed.Sample(u, v, 0);
+                        const uint8_t* expected = reference->Pixels() + (u_int32_t)(v * kSmallSize) * reference->RowBytes() +
+                            (u_int32_t)(u * kSmallSize) * 3;
+                        ColorF exact = From24Color(expected[0], expected[1], expected[2]);
+                        if(sampled.r != exact.r || sampled.g != exact.g || sampled.b != exact.b) {
+                            wrong[t]++;
+                        }
+                    }
+                });
+            }
+            for(auto& thread : threads) {
+                thread.join();
+            }
+        });
+        for(int count : wrong) {
+            if(count > 0) {
+                std::cerr << "VirtualTexture::Sample/thrashing: " << count << " samples differ from the generator" << std::endl;
+            }
+        }
+        if(thrashed.ResidentBytes() > kSmallBudget) {
+            std::cerr << "VirtualTexture::Sample/thrashing: " << thrashed.ResidentBytes() << " bytes resident, over budget" << std::endl;
+        }
+    }
+
+    if(bench.Selected("VirtualTexture")) {
+        std::cout << "Virtual texture: " << coldTexture.ResidentPages() << " pages, " << (coldTexture.ResidentBytes() >> 20)
+            << " MB resident of a " << (kBudget >> 20) << " MB budget, for " << ((size_t)kSize * kSize * 3 >> 20)
+            << " MB of texels, " << coldTexture.Evictions() << " evictions\n" << std::endl;
+    }
+}
+
+static std::string ScalingName(const char* texture, int threads)
+{
+    return std::string(texture) + "/" + std::to_string(threads) + (threads == 1 ? " thread" : " threads");
+}
+
+// The procedural textures on 1 thread, then on pools of 2, 4 and so on up to the
+// hardware's thread count, followed by a table of how each scaled.
+static void BenchTextureScaling(MicroBench& bench)
+{
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor green = {0, 255, 0};
+    const RGBColor white = {255, 255, 255};
+    const RGBColor orange = {232, 99, 10};
+
+    const int hwThreads = std::max(1, (int)std::thread::hardware_concurrency());
+    // 2 threads even on one core, to see what the pool costs.
+    std::vector<int> threadCounts = { 1 };
+    for(int threads = 2; threads < std::max(hwThreads, 3); threads *= 2) {
+        threadCounts.push_back(threads);
+    }
+    if(hwThreads > threadCounts.back()) {
+        threadCounts.push_back(hwThreads);
+    }
+
+    const struct {
+        const char* name;
+        std::function<RGBImageBuffer*(ThreadPool*)> generate;
+    } textures[] = {
+        { "GenerateCheckers/1024", [&](ThreadPool* pool) { return GenerateCheckers(1024, 32, blue, green, pool); } },
+        { "GenerateMarble/512", [&](ThreadPool* pool) { return GenerateMarble(512, blue, white, pool); } },
+        { "GenerateFractalBrownianMotion/256", [&](ThreadPool* pool) {
+            return GenerateFractalBrownianMotion(256, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false, pool);
+        } },
+    };
+
+    for(const auto& texture : textures) {
+        for(int threads : threadCounts) {
+            std::string name = ScalingName(texture.name, threads);
+            if(!bench.Selected(name)) {
+                continue;
+            }
+            std::unique_ptr<ThreadPool> pool(threads > 1 ? new ThreadPool(threads - 1) : nullptr);
+            bench.Run(name, 1, [&] {
+                std::unique_ptr<RGBImageBuffer> image(texture.generate(pool.get()));
+                DoNotOptimize(image->Pixels());
+            });
+        }
+    }
+
+    bool printedHeader = false;
+    char line[160];
+    for(const auto& texture : textures) {
+        const BenchResult* serial = FindResult(bench, ScalingName(texture.name, 1));
+        if(!serial) {
+            continue;
+        }
+        if(!printedHeader) {
+            std::cout << "\nTexture scaling, " << hwThreads << " hardware threads:\n";
+            snprintf(line, sizeof(line), "%-36s %8s %12s %9s %11s", "", "threads", "ms", "speedup", "efficiency");
+            std::cout << line << "\n";
+            printedHeader = true;
+        }
+        for(int threads : threadCounts) {
+            const BenchResult* result = FindResult(bench, ScalingName(texture.name, threads));
+            if(!result) {
+                continue;
+            }
+            double speedup = serial->medianNanos / result->medianNanos;
+            snprintf(line, sizeof(line), "%-36s %8d %12.2f %8.2fx %10.0f%%", texture.name, threads,
+                     result->medianNanos / 1e6, speedup, 100.0 * speedup / threads);
+            std::cout << line << "\n";
+        }
+    }
+    std::cout << std::flush;
+}
+
+// usage: microbench [--reps N] [--warmup N] [--filter text] [--mesh-dir dir]
+//                   [--json out.json] [--baseline baseline.json] [--threshold percent]
+// Exits with 2 when anything is more than threshold percent slower than the baseline.
+int main(int argc, const char** argv)
+{
+    if(!MicroBench::Test()) {
+        std::cerr << "Microbench tests failed" << std::endl;
+        return 1;
+    }
+
+    MicroBench bench(IntArg(argc, argv, "--warmup", 3), IntArg(argc, argv, "--reps", 15), StringArg(argc, argv, "--filter", ""));
+    const std::string meshDir = StringArg(argc, argv, "--mesh-dir", "mesh");
+
+    BenchReadSMF(bench, meshDir);
+    BenchIntersect(bench);
+    BenchNoise(bench);
+    BenchMatrix(bench);
+    BenchMesh(bench, meshDir);
+    BenchGenerators(bench);
+    BenchColorBatch(bench);
+    BenchTextureGraph(bench);
+    BenchTextureCache(bench);
+    BenchVirtualTexture(bench);
+    BenchTextureScaling(bench);
+
+    const char* jsonPath = StringArg(argc, argv, "--json", nullptr);
+    if(jsonPath && !bench.WriteJSON(jsonPath)) {
+        return 1;
+    }
+
+    const char* baselinePath = StringArg(argc, argv, "--baseline", nullptr);
+    if(baselinePath) {
+        std::map<std::string, double> baseline;
+        if(!MicroBench::ReadBaseline(baselinePath, baseline)) {
+            return 1;
+        }
+        double threshold = IntArg(argc, argv, "--threshold", 10) / 100.0;
+        std::cout << "\nAgainst " << baselinePath << ":\n";
+        int regressions = bench.CompareToBaseline(baseline, threshold, std::cout);
+        std::cout << regressions << " regressions over " << threshold * 100.0 << "%" << std::endl;
+        if(regressions > 0) {
+            return 2;
+        }
+    }
+    return 0;
+}
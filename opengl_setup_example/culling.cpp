@@ -0,0 +1,271 @@
+//
+//  culling.cpp
+//  opengl_setup_example
+//
+
+#include "culling.h"
+
+#include <cfloat>
+#include <chrono>
+#include <list>
+#include <memory>
+
+#include <glm/ext.hpp>
+
+#include "model_object.h"
+#include "simd.h"
+#include "mathutil.h"
+#include "dbgutils.h"
+
+enum SphereResult : uint8_t {
+    kSphereInside = 0,
+    kSphereOutside,
+    kSphereIntersects,
+};
+
+LocalBounds ComputeLocalBounds(const std::vector<float>& vertices)
+{
+    LocalBounds bounds;
+    if(vertices.size() < 3) {
+        return bounds;
+    }
+
+    glm::vec3 bMin(FLT_MAX), bMax(-FLT_MAX);
+    for(size_t i = 0; i + 2 < vertices.size(); i += 3) {
+        glm::vec3 v(vertices[i], vertices[i+1], vertices[i+2]);
+        bMin = glm::min(bMin, v);
+        bMax = glm::max(bMax, v);
+    }
+    bounds.aabbMin = bMin;
+    bounds.aabbMax = bMax;
+    bounds.sphereCenter = (bMin + bMax) * 0.5f;
+
+    float maxDist2 = 0.0f;
+    for(size_t i = 0; i + 2 < vertices.size(); i += 3) {
+        glm::vec3 d = glm::vec3(vertices[i], vertices[i+1], vertices[i+2]) - bounds.sphereCenter;
+        maxDist2 = TMax(maxDist2, glm::dot(d, d));
+    }
+    bounds.sphereRadius = sqrtf(maxDist2);
+    return bounds;
+}
+
+
+void Frustum::ExtractPlanes(const glm::mat4& m)
+{
+    // glm is column major so row i is m[0][i], m[1][i], m[2][i], m[3][i].
+    auto row = [&](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+    glm::vec4 r0 = row(0), r1 = row(1), r2 = row(2), r3 = row(3);
+
+    const glm::vec4 eqs[kNumPlanes] = {
+        r3 + r0, // left
+        r3 - r0, // right
+        r3 + r1, // bottom
+        r3 - r1, // top
+        r3 + r2, // near
+        r3 - r2, // far
+    };
+
+    for(int i = 0; i < kNumPlanes; i++) {
+        glm::vec3 n(eqs[i].x, eqs[i].y, eqs[i].z);
+        float invLen = 1.0f / glm::length(n);
+        planes[i].normal = n * invLen;
+        planes[i].d = eqs[i].w * invLen;
+    }
+}
+
+bool Frustum::SphereOutside(const glm::vec3& center, float radius) const
+{
+    for(int i = 0; i < kNumPlanes; i++) {
+        if(glm::dot(planes[i].normal, center) + planes[i].d < -radius) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Frustum::AABBOutside(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& modelMatrix) const
+{
+    const glm::vec3 center = (localMin + localMax) * 0.5f;
+    const glm::vec3 extent = (localMax - localMin) * 0.5f;
+
+    for(int i = 0; i < kNumPlanes; i++) {
+        // Plane in object space is the world plane times the model matrix.
+        glm::vec4 p = glm::transpose(modelMatrix) * glm::vec4(planes[i].normal, planes[i].d);
+        glm::vec3 n(p.x, p.y, p.z);
+        float r = glm::dot(glm::abs(n), extent);
+        if(glm::dot(n, center) + p.w + r < 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void FrustumCuller::Cull(const Frustum& frustum, const std::vector<ModelObject*>& objects, CullStats& outStats)
+{
+    auto startTime = std::chrono::high_resolution_clock::now();
+
+    const size_t count = objects.size();
+    const size_t padded = (count + 3) & ~size_t(3);
+    mCenterX.resize(padded);
+    mCenterY.resize(padded);
+    mCenterZ.resize(padded);
+    mRadius.resize(padded);
+    mSphereResult.resize(padded);
+
+    // Gather world space spheres. Scale the radius by the largest axis scale so it stays conservative.
+    for(size_t i = 0; i < count; i++) {
+        const ModelObject* obj = objects[i];
+        if(!obj->geometry) {
+            mCenterX[i] = mCenterY[i] = mCenterZ[i] = mRadius[i] = 0.0f;
+            continue;
+        }
+        const glm::mat4& m = obj->modelMatrixStack.top();
+        const LocalBounds& b = obj->geometry->localBounds;
+        glm::vec4 c = m * glm::vec4(b.sphereCenter, 1.0f);
+        float sx = glm::dot(glm::vec3(m[0]), glm::vec3(m[0]));
+        float sy = glm::dot(glm::vec3(m[1]), glm::vec3(m[1]));
+        float sz = glm::dot(glm::vec3(m[2]), glm::vec3(m[2]));
+        mCenterX[i] = c.x;
+        mCenterY[i] = c.y;
+        mCenterZ[i] = c.z;
+        mRadius[i] = b.sphereRadius * sqrtf(TMax3(sx, sy, sz));
+    }
+    // results for the padding lanes are ignored.
+    for(size_t i = count; i < padded; i++) {
+        mCenterX[i] = mCenterY[i] = mCenterZ[i] = 0.0f;
+        mRadius[i] = 0.0f;
+    }
+
+    Float4 planeX[Frustum::kNumPlanes], planeY[Frustum::kNumPlanes], planeZ[Frustum::kNumPlanes], planeD[Frustum::kNumPlanes];
+    for(int p = 0; p < Frustum::kNumPlanes; p++) {
+        planeX[p] = Set4(frustum.planes[p].normal.x);
+        planeY[p] = Set4(frustum.planes[p].normal.y);
+        planeZ[p] = Set4(frustum.planes[p].normal.z);
+        planeD[p] = Set4(frustum.planes[p].d);
+    }
+    const Float4 zero = Set4(0.0f);
+
+    // Sphere pass, 4 objects per iteration.
+    for(size_t i = 0; i < padded; i += 4) {
+        Float4 cx = Load4(&mCenterX[i]);
+        Float4 cy = Load4(&mCenterY[i]);
+        Float4 cz = Load4(&mCenterZ[i]);
+        Float4 r = Load4(&mRadius[i]);
+        Float4 negR = zero - r;
+
+        Float4 outside = CmpLt4(zero, zero); // all false
+        Float4 straddle = outside;
+        for(int p = 0; p < Frustum::kNumPlanes; p++) {
+            Float4 dist = cx * planeX[p] + cy * planeY[p] + cz * planeZ[p] + planeD[p];
+            outside = Or4(outside, CmpLt4(dist, negR));
+            straddle = Or4(straddle, CmpLt4(dist, r));
+        }
+        int outsideBits = MoveMask4(outside);
+        int straddleBits = MoveMask4(straddle);
+        for(int lane = 0; lane < 4; lane++) {
+            uint8_t result = kSphereInside;
+            if(outsideBits & (1 << lane)) {
+                result = kSphereOutside;
+            } else if(straddleBits & (1 << lane)) {
+                result = kSphereIntersects;
+            }
+            mSphereResult[i + lane] = result;
+        }
+    }
+
+    CullStats stats;
+    for(size_t i = 0; i < count; i++) {
+        ModelObject* obj = objects[i];
+        if(!obj->Visible() || !obj->geometry) {
+            obj->isCulled = false;
+            continue;
+        }
+        bool culled = mSphereResult[i] == kSphereOutside;
+        if(mSphereResult[i] == kSphereIntersects) {
+            stats.boxTests++;
+            const LocalBounds& b = obj->geometry->localBounds;
+            culled = frustum.AABBOutside(b.aabbMin, b.aabbMax, obj->modelMatrixStack.top());
+        }
+        obj->isCulled = culled;
+        if(culled) {
+            stats.culled++;
+        } else {
+            stats.visible++;
+        }
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    stats.cullMillis = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+    outStats = stats;
+}
+
+
+bool Frustum::Test(void)
+{
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    Frustum frustum(proj * view);
+
+    // Near plane faces down -z from just in front of the eye.
+    DbgAssertAlmostEqual(frustum.planes[kNear].normal.z, -1.0, 1e-5);
+    DbgAssertAlmostEqual(frustum.planes[kNear].d, 2.9, 1e-4);
+
+    DbgAssert(!frustum.SphereOutside({0, 0, 0}, 0.5f));
+    DbgAssert(frustum.SphereOutside({0, 0, 10}, 1.0f)); // behind the eye
+    DbgAssert(frustum.SphereOutside({0, 0, -200}, 1.0f)); // past far plane
+    DbgAssert(frustum.SphereOutside({50, 0, 0}, 1.0f));
+    DbgAssert(!frustum.SphereOutside({50, 0, 0}, 60.0f));
+
+    glm::mat4 model = glm::translate(glm::identity<glm::mat4>(), glm::vec3(30, 0, -5));
+    DbgAssert(frustum.AABBOutside({-1, -1, -1}, {1, 1, 1}, model));
+    model = glm::scale(model, glm::vec3(40, 1, 1));
+    DbgAssert(!frustum.AABBOutside({-1, -1, -1}, {1, 1, 1}, model));
+
+    std::vector<float> verts = { -1, -2, -3,  3, 2, 1,  0, 0, 0 };
+    LocalBounds bounds = ComputeLocalBounds(verts);
+    DbgAssertAlmostEqual(bounds.aabbMin.x, -1);
+    DbgAssertAlmostEqual(bounds.aabbMax.z, 1);
+    DbgAssertAlmostEqual(bounds.sphereCenter.x, 1);
+    DbgAssertAlmostEqual(bounds.sphereRadius, sqrt(12.0), 1e-5);
+
+    // Batch culler must agree with the scalar tests, including a count that is not a multiple of 4.
+    auto geom = std::make_shared<MeshGeometry>();
+    geom->vertexData = verts;
+    geom->Finish();
+    std::list<std::unique_ptr<ModelObject>> owned;
+    std::vector<ModelObject*> objects;
+    for(int i = 0; i < 7; i++) {
+        owned.push_back(std::make_unique<ModelObject>());
+        ModelObject* obj = owned.back().get();
+        obj->geometry = geom;
+        obj->Show();
+        obj->PushModelMatrix(glm::translate(glm::identity<glm::mat4>(), glm::vec3(i * 8.0f - 24.0f, 0, -5)));
+        objects.push_back(obj);
+    }
+    objects[3]->Hide();
+
+    FrustumCuller culler;
+    CullStats stats;
+    culler.Cull(frustum, objects, stats);
+    int expectedCulled = 0;
+    for(auto obj : objects) {
+        if(!obj->Visible()) {
+            DbgAssert(!obj->isCulled);
+            continue;
+        }
+        bool expected = frustum.AABBOutside(geom->localBounds.aabbMin, geom->localBounds.aabbMax, obj->ModelMatrix());
+        DbgAssert(obj->isCulled == expected);
+        if(expected) {
+            expectedCulled++;
+        }
+    }
+    DbgAssert(stats.culled == expectedCulled);
+    DbgAssert(stats.culled + stats.visible == 6);
+    DbgAssert(stats.culled > 0 && stats.visible > 0);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,80 @@
+//
+//  culling.h
+//  opengl_setup_example
+//
+
+#ifndef culling_hpp
+#define culling_hpp
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+class ModelObject;
+
+// Object space bounds of a model, computed once from its vertex data.
+struct LocalBounds {
+    glm::vec3 aabbMin;
+    glm::vec3 aabbMax;
+    glm::vec3 sphereCenter;
+    float sphereRadius;
+
+    LocalBounds() : aabbMin(0.0f), aabbMax(0.0f), sphereCenter(0.0f), sphereRadius(0.0f) {}
+};
+
+// vertices are xyz triples. Sphere is centered on the box so it is never larger than needed by much.
+LocalBounds ComputeLocalBounds(const std::vector<float>& vertices);
+
+
+// plane is dot(normal, p) + d, positive on the inside of the frustum.
+struct Plane {
+    glm::vec3 normal;
+    float d;
+};
+
+class Frustum {
+public:
+    enum { kLeft = 0, kRight, kBottom, kTop, kNear, kFar, kNumPlanes };
+
+    Plane planes[kNumPlanes];
+
+    Frustum() = default;
+    explicit Frustum(const glm::mat4& viewProj) { ExtractPlanes(viewProj); }
+
+    // Gribb/Hartmann plane extraction from a projection * view matrix.
+    void ExtractPlanes(const glm::mat4& viewProj);
+
+    bool SphereOutside(const glm::vec3& center, float radius) const;
+
+    // Box given in object space with the matrix that takes it to world space.
+    bool AABBOutside(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& modelMatrix) const;
+
+    static bool Test(void);
+};
+
+
+struct CullStats {
+    int visible;
+    int culled;
+    // objects whose sphere crossed a plane and needed the box test.
+    int boxTests;
+    double cullMillis;
+
+    CullStats() : visible(0), culled(0), boxTests(0), cullMillis(0) {}
+};
+
+// Culls objects against the frustum 4 at a time using world space bounding spheres,
+// then refines the ones straddling a plane with their oriented local box.
+class FrustumCuller {
+private:
+    // world space spheres in structure of arrays layout, padded to a multiple of 4.
+    std::vector<float> mCenterX, mCenterY, mCenterZ, mRadius;
+    // per object result of the sphere pass.
+    std::vector<uint8_t> mSphereResult;
+
+public:
+    // Sets isCulled on each object. Hidden objects and ones without geometry are skipped and not counted.
+    void Cull(const Frustum& frustum, const std::vector<ModelObject*>& objects, CullStats& outStats);
+};
+
+#endif /* culling_hpp */
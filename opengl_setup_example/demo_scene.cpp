@@ -0,0 +1,519 @@
+//
+//  demo_scene.cpp
+//  opengl_setup_example
+//
+
+#include "demo_scene.h"
+
+#include <iostream>
+#include <chrono>
+#include <cassert>
+
+#include <glm/ext.hpp>
+
+#include "frame_state.h"
+#include "textures.h"
+#include "proc_textures.h"
+#include "mathutil.h"
+#include "gl_backend.h"
+#include "trace.h"
+
+const char* kVertexShaderPath = "phong_vertex_shader.glsl";
+const char* kFragmentShaderPath = "phong_fragment_shader.glsl";
+const char* kInstancedVertexShaderPath = "phong_instanced_vertex_shader.glsl";
+const char* kArenaVertexShaderPath = "phong_arena_vertex_shader.glsl";
+
+const RGBColor red = {255, 0, 0};
+const RGBColor blue = {0, 0, 255};
+const RGBColor green = {0, 255, 0};
+const RGBColor white = {255, 255, 255};
+const RGBColor black = { 0, 0, 0};
+const RGBColor orange = {232, 99, 10};
+
+const float kZNear = 0.001f;
+const float kZFar = 100.0f;
+
+const float kTriRotSpeed = 0.02;
+const float kCubeRotSpeed = 0.03;
+const float kSphereRotSpeed = 0.01;
+const float kPyramidRotSpeed = 0.025;
+const float kMeshRotSpeed = 0.025;
+
+DemoScene::DemoScene(GLBackend& backend, FrameState& frameState)
+    : rotating(true), printStats(true), mBackend(backend), mFrameState(frameState), mState(&backend),
+      mCullingEnabled(true), mOcclusionEnabled(true), mInstancingEnabled(true), mArenaEnabled(false),
+      mProgram(0), mGeometryCache(&backend),
+      mTriangle(nullptr), mCube(nullptr), mCubeTwo(nullptr), mSphere(nullptr), mPyramid(nullptr),
+      mMesh(nullptr), mMeshTwo(nullptr),
+      mTriAngle(0), mCubeAngle(0), mSphereAngle(0), mPyramidAngle(0), mMeshAngle(0),
+      mOcclusionCuller(&mThreadPool), mScopes(), mDrawCalls(0), mSubmitMillis(0), mFrameCount(0)
+{
+    mUniforms = std::make_unique<UniformBuffers>();
+    mFrameState.uniforms = mUniforms.get();
+    mFrameState.glState = &mState;
+}
+
+DemoScene::~DemoScene()
+{
+    mProfiler.reset();
+    // Geometry buffers are deleted with the last object using them, so this has to happen before the context goes.
+    mExtraCubeBatch.reset();
+    mGeometryArena.reset();
+    mExtraCubeGeometry.reset();
+    mObjects.clear();
+    mUniforms.reset();
+
+    GLuint programs[] = { mProgram, mInstancedShader.program, mArenaShader.program };
+    for(GLuint program : programs) {
+        if(program != 0) {
+            mBackend.DeleteProgram(program);
+        }
+    }
+    for(auto textureID: mTextureIDs) {
+        mBackend.DeleteTexture(textureID);
+    }
+}
+
+GLuint DemoScene::AddTexture(RGBImageBuffer* image)
+{
+    assert(image);
+    GLuint textureID = CreateTextureFromImage(mBackend, image);
+    mTextureIDs.push_back(textureID);
+    // kept for automatic cleanup.
+    mImageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(image));
+    return textureID;
+}
+
+GLuint DemoScene::AddTexture(TextureCache& cache, const std::string& key, const TextureCache::GenerateFunc& generate)
+{
+    std::unique_ptr<TextureLevels> levels = cache.Get(key, true, generate);
+    assert(levels);
+    GLuint textureID = CreateTextureFromLevels(mBackend, *levels);
+    mTextureIDs.push_back(textureID);
+    return textureID;
+}
+
+ModelObject* DemoScene::AddObject(std::shared_ptr<const MeshGeometry> geometry, GLuint textureID, const Material& material)
+{
+    mObjects.push_back(std::make_unique<ModelObject>());
+    ModelObject* obj = mObjects.back().get();
+    obj->geometry = geometry;
+    obj->textureID = textureID;
+    obj->material = material;
+    return obj;
+}
+
+bool DemoScene::Init(const DemoSceneOptions& options)
+{
+    TRACE_ZONE("scene", "DemoScene::Init");
+    mBackend.CullFace( GL_BACK );
+    mBackend.FrontFace( GL_CCW );
+    mBackend.Enable( GL_CULL_FACE );
+
+    mBackend.Enable(GL_DEPTH_TEST);
+    mBackend.DepthFunc(GL_LESS);
+
+    mBackend.ClearColor((GLfloat)0.2f, (GLfloat)0.2f, (GLfloat)0.2f, (GLfloat)1.0f);
+
+    if(!mBackend.CreateProgram(mProgram, kVertexShaderPath, kFragmentShaderPath)) {
+        std::cerr << "Could not initialize shaders" << std::endl;
+        return false;
+    }
+    if(!mInstancedShader.Init(mBackend, kInstancedVertexShaderPath, kFragmentShaderPath)) {
+        std::cerr << "Could not initialize instanced shaders" << std::endl;
+        return false;
+    }
+    if(!mArenaShader.Init(mBackend, kArenaVertexShaderPath, kFragmentShaderPath)) {
+        std::cerr << "Could not initialize arena shaders" << std::endl;
+        return false;
+    }
+
+    const float fovyInDegrees = 45.0f;
+    const float aspectRatio = (float)options.width / (float)options.height;
+    mFrameState.projMatrix = glm::perspective(glm::radians(fovyInDegrees), aspectRatio, kZNear, kZFar);
+
+    mFrameState.eyePosition = glm::vec3(0.0f, 0.0f, 3.0f);
+    mFrameState.viewMatrix = glm::lookAt(
+                                         mFrameState.eyePosition, // position
+                                         glm::vec3(0.0f, 0.0f, 0.0f), // target
+                                         glm::vec3(0.0f, 1.0f, 0.0f) //  up vector
+                                         );
+
+    // Uniform data lives in buffers shared by all the programs.
+    UniformBuffers::BindBlocks(mBackend, mProgram);
+    mUniforms->Init(&mState);
+
+    //  Textures, the procedural ones from the cache when an earlier run left them there, otherwise
+    //  spread over the culling threads, which are idle until the first frame.
+    TextureCache textureCache(options.textureCacheDirectory);
+    GLuint blueGreenCheckersTextureID = AddTexture(textureCache, ProcTextureKey("GenerateCheckers", 1024, 32, blue, green), [&] {
+        std::cout  << "Generating checkers" << std::endl;
+        return GenerateCheckers(1024, 32, blue, green, &mThreadPool);
+    });
+    GLuint redBlackCheckersTextureID = AddTexture(textureCache, ProcTextureKey("GenerateCheckers", 1024, 64, red, black), [&] {
+        return GenerateCheckers(1024, 64, red, black, &mThreadPool);
+    });
+
+    GLuint marbleTextureID = AddTexture(textureCache, ProcTextureKey("GenerateMarble", 512, blue, white, kNoisePerlin), [&] {
+        std::cout  << "Generating marble" << std::endl;
+        return GenerateMarble(512, blue, white, &mThreadPool);
+    });
+
+    std::cout << "Loading image textures" << std::endl;
+    GLuint rockyTextureImageID = AddTexture(LoadImageBufferFromPNG("textures/rocky.png"));
+    GLuint marsTextureImageID = AddTexture(LoadImageBufferFromPNG("textures/mars.png"));
+    GLuint fuzzyTextureID = AddTexture(LoadImageBufferFromPNG("textures/fuzzy.png"));
+
+    GLuint fbmTextureID = AddTexture(textureCache, ProcTextureKey("GenerateFractalBrownianMotion", 256, orange, 0.8, 1.8, 3.0,
+                                                                  -0.5, 0.5, 64, false, kNoisePerlin), [&] {
+        std::cout  << "Generating fractal browning motion" << std::endl;
+        return GenerateFractalBrownianMotion(256 /*512*/, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 64, false, &mThreadPool);
+    });
+    textureCache.PrintStats();
+
+    // Lighting
+    mFrameState.globalAmbient = glm::vec3(1,1,1);
+    mFrameState.lightDiffuse = glm::vec3(1,1,1);
+    mFrameState.lightSpecular = glm::vec3(1,1,1);
+    mFrameState.lightPosition = glm::vec3 {-5, 5, 0};
+
+    // TODO: setup materials for each shape
+    Material plainWhiteMaterial = Material(glm::vec3(0.1, 0.1, 0.1), glm::vec3(1,1,1), glm::vec3(1,1,1), 15);
+
+    // Shapes
+    mTriangle = AddObject(mGeometryCache.Triangle(), marbleTextureID, plainWhiteMaterial);
+    mCube = AddObject(mGeometryCache.Cube(), fbmTextureID, plainWhiteMaterial);
+    mCubeTwo = AddObject(mGeometryCache.Cube(), rockyTextureImageID, plainWhiteMaterial);
+    mSphere = AddObject(mGeometryCache.Sphere(1.5, 20, 25), marsTextureImageID, plainWhiteMaterial);
+    mPyramid = AddObject(mGeometryCache.Pyramid(), blueGreenCheckersTextureID, plainWhiteMaterial);
+    // todo: use better textures for the meshes.
+    mMesh = AddObject(mGeometryCache.LoadSMF("mesh/bound-bunny_200.smf"), redBlackCheckersTextureID, plainWhiteMaterial);
+    mMeshTwo = AddObject(mGeometryCache.LoadSMF("mesh/teddy.smf"), fuzzyTextureID, plainWhiteMaterial);
+
+    // Extra cubes scattered around the scene for testing with many objects.
+    // They all share one cube's buffers and are drawn as instances of it.
+    mExtraCubeGeometry = std::make_unique<ModelObject>();
+    {
+        mExtraCubeGeometry->geometry = mGeometryCache.Cube();
+
+        mExtraCubeGeometry->textureID = rockyTextureImageID;
+        mExtraCubeGeometry->material = plainWhiteMaterial;
+        mExtraCubeGeometry->Show();
+    }
+    mExtraCubeBatch = std::make_unique<InstancedBatch>(mBackend, *mExtraCubeGeometry);
+    for(int i = 0; i < options.extraObjectCount; i++) {
+        mObjects.push_back(std::make_unique<ModelObject>());
+        ModelObject* extraObjPtr = mObjects.back().get();
+        mExtraCubeBatch->AddInstance(extraObjPtr);
+        mExtraObjects.push_back(extraObjPtr);
+    }
+
+    std::cout << "Geometry cache: " << mGeometryCache.LiveCount() << " meshes for " << mObjects.size() + 1 << " objects, "
+        << mGeometryCache.LiveCPUBytes() / 1024 << " KB CPU, " << mGeometryCache.LiveGPUBytes() / 1024 << " KB GPU, "
+        << mGeometryCache.Hits() << " hits" << std::endl;
+
+    for(auto& modelObj : mObjects) {
+        mDrawList.push_back(modelObj.get());
+    }
+
+    for(auto modelObj : mDrawList) {
+        modelObj->materialSlot = mUniforms->AddMaterial(modelObj->material);
+    }
+    mExtraCubeGeometry->materialSlot = mUniforms->AddMaterial(mExtraCubeGeometry->material);
+    mUniforms->UploadMaterials();
+
+    // Every mesh in the scene copied into one vertex and one index buffer for the arena path.
+    mGeometryArena = std::make_unique<GeometryArena>(&mBackend);
+    for(auto modelObj : mDrawList) {
+        if(modelObj->geometry) {
+            mGeometryArena->Add(modelObj->geometry);
+        }
+    }
+    mGeometryArena->Build();
+    std::cout << "Geometry arena: " << mGeometryArena->MeshCount() << " meshes, "
+        << mGeometryArena->GPUBytes() / 1024 << " KB" << std::endl;
+
+    // The big solid shapes near the middle hide things behind them.
+    mSphere->isOccluder = true;
+    mMeshTwo->isOccluder = true;
+
+    mRenderQueue = std::make_unique<RenderQueue>(kZNear, kZFar);
+
+    // Setup made GL calls of its own, start the per frame state tracking from scratch.
+    mState.Invalidate();
+    mState.UseProgram(mProgram);
+
+    // setup basic model transforms
+
+    mTriangle->PushModelMatrix(glm::scale(mTriangle->ModelMatrix(), glm::vec3(0.6f, 0.5f, 0.5f)));
+
+    mCube->PushModelMatrix(glm::translate(mCube->ModelMatrix(), glm::vec3(-2.5, 0, -4)));
+    mCube->PushModelMatrix(glm::scale(mCube->ModelMatrix(), glm::vec3(0.6f, 0.5f, 0.5f)));
+
+    mCubeTwo->PushModelMatrix( glm::translate(mCubeTwo->ModelMatrix(), glm::vec3(2.5, 0, -4)) );
+    mCubeTwo->PushModelMatrix( glm::scale(mCubeTwo->ModelMatrix(), glm::vec3(0.6f, 0.5f, 0.5f)) );
+
+    mSphere->PushModelMatrix( glm::translate(mSphere->ModelMatrix(), glm::vec3(0, 1.0, -4)) );
+    mSphere->PushModelMatrix( glm::scale(mSphere->ModelMatrix(), glm::vec3(0.5f, 0.5f, 0.5f)) );
+    mSphere->PushModelMatrix( glm::rotate(mSphere->ModelMatrix(), (float)(PI / 2), glm::vec3(1.0, 0, 0)) );
+
+    mPyramid->PushModelMatrix( glm::translate(mPyramid->ModelMatrix(), glm::vec3(0, -2, -4)) );
+    mPyramid->PushModelMatrix(  glm::rotate(mPyramid->ModelMatrix(), (float)(PI / 8.0f), glm::vec3(1, 0, 0)) );
+
+    mMesh->PushModelMatrix( glm::translate(mMesh->ModelMatrix(), glm::vec3(-2, -2, -5)) );
+    mMesh->PushModelMatrix(  glm::scale(mMesh->ModelMatrix(), glm::vec3(1.5, 1.5, 1.8)) );
+
+    mMeshTwo->PushModelMatrix( glm::translate(mMeshTwo->ModelMatrix(), glm::vec3(2, -2, -5)) );
+    mMeshTwo->PushModelMatrix(  glm::scale(mMeshTwo->ModelMatrix(), glm::vec3(0.05, 0.05, 0.05)) );
+
+    // extra cubes go in a wide slab in front of and around the camera, many of them off screen.
+    for(auto extraObjPtr : mExtraObjects) {
+        glm::vec3 pos(RandFloat() * 80 - 40, RandFloat() * 60 - 30, RandFloat() * -60 - 5);
+        extraObjPtr->PushModelMatrix( glm::translate(extraObjPtr->ModelMatrix(), pos) );
+        extraObjPtr->PushModelMatrix( glm::scale(extraObjPtr->ModelMatrix(), glm::vec3(0.2f, 0.2f, 0.2f)) );
+    }
+
+    for(auto& modelObj : mObjects) {
+        modelObj->Show();
+    }
+    return true;
+}
+
+void DemoScene::BeginFrame(void)
+{
+    TRACE_ZONE("frame", "DemoScene::BeginFrame");
+    FrameProfiler* profiler = mProfiler.get();
+    if(profiler) {
+        profiler->BeginFrame();
+    }
+    {
+        ProfileScope scope(profiler, mScopes.clear);
+        mBackend.Clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    {
+        ProfileScope scope(profiler, mScopes.update);
+        mState.ResetStats();
+        mUniforms->UpdateFrame(mFrameState);
+    }
+
+    ProfileScope pushScope(profiler, mScopes.matrixPush);
+    mTriangle->PushModelMatrix(glm::rotate(mTriangle->ModelMatrix(), mTriAngle, glm::vec3(0, 0.2, 1)));
+
+    mCube->PushModelMatrix(glm::rotate(mCube->ModelMatrix(), mCubeAngle, glm::vec3(0.5, 0.0, 0.5)));
+    mCubeTwo->PushModelMatrix(glm::rotate(mCubeTwo->ModelMatrix(), mCubeAngle, glm::vec3(0.5, 0.0, 0.5)));
+
+    mSphere->PushModelMatrix(glm::rotate(mSphere->ModelMatrix(), mSphereAngle, glm::vec3(0.0, 0.1, 1.0)));
+
+    mPyramid->PushModelMatrix(glm::rotate(mPyramid->ModelMatrix(), mPyramidAngle, glm::vec3(0, 1, 0)));
+
+    mMesh->PushModelMatrix(glm::rotate(mMesh->ModelMatrix(), mMeshAngle, glm::vec3(0, 1, 0)) );
+    mMeshTwo->PushModelMatrix(glm::rotate(mMeshTwo->ModelMatrix(), mMeshAngle, glm::vec3(1, 0, 0)));
+
+    for(auto extraObjPtr : mExtraObjects) {
+        extraObjPtr->PushModelMatrix(glm::rotate(extraObjPtr->ModelMatrix(), mCubeAngle, glm::vec3(0.5, 0.0, 0.5)));
+    }
+
+    if(rotating) {
+        mTriAngle += kTriRotSpeed;
+        mCubeAngle += kCubeRotSpeed;
+        mSphereAngle += kSphereRotSpeed;
+        mPyramidAngle += kPyramidRotSpeed;
+        mMeshAngle += kMeshRotSpeed;
+    }
+}
+
+void DemoScene::Cull(void)
+{
+    TRACE_ZONE("frame", "DemoScene::Cull");
+    FrameProfiler* profiler = mProfiler.get();
+    ProfileScope scope(profiler, mScopes.cull);
+
+    // Reject objects outside the view before any GL calls are made for them.
+    if(mCullingEnabled) {
+        ProfileScope frustumScope(profiler, mScopes.frustum);
+        mFrustum.ExtractPlanes(mFrameState.projMatrix * mFrameState.viewMatrix);
+        mCuller.Cull(mFrustum, mDrawList, mCullStats);
+    } else if(mOcclusionEnabled) {
+        // occlusion only ever sets isCulled, so clear last frame's results.
+        ClearCulled();
+    }
+
+    // Then the ones hidden behind occluders, using a small software depth buffer.
+    if(mOcclusionEnabled) {
+        ProfileScope occlusionScope(profiler, mScopes.occlusion);
+        mOcclusionCuller.BeginFrame(mFrameState.projMatrix * mFrameState.viewMatrix);
+        for(auto modelObj : mDrawList) {
+            if(modelObj->isOccluder && modelObj->Visible() && !modelObj->isCulled) {
+                mOcclusionCuller.AddOccluder(*modelObj);
+            }
+        }
+        mOcclusionCuller.Rasterize();
+        mOcclusionCuller.CullObjects(mDrawList, mOcclusionStats);
+    }
+}
+
+int DemoScene::Submit(void)
+{
+    TRACE_ZONE("frame", "DemoScene::Submit");
+    FrameState* frameState = &mFrameState;
+    FrameProfiler* profiler = mProfiler.get();
+    ProfileScope scope(profiler, mScopes.submit);
+    int drawCalls = 0;
+    auto submitStart = std::chrono::high_resolution_clock::now();
+    if(mArenaEnabled) {
+        // One draw per mesh, texture and material, instances included.
+        ProfileScope drawScope(profiler, mScopes.draw);
+        drawCalls += mGeometryArena->Submit(frameState, mArenaShader, mDrawList, frameState->viewMatrix);
+    } else {
+        {
+            // All transforms for the frame in one upload, instances only need them when drawn one by one.
+            ProfileScope transformsScope(profiler, mScopes.transforms);
+            mUniforms->WriteObjectTransforms(mDrawList, frameState->viewMatrix, !mInstancingEnabled);
+        }
+        {
+            // Everything with a transform slot is drawn this frame, sorted to cut down on state changes.
+            ProfileScope queueScope(profiler, mScopes.queue);
+            mRenderQueue->Clear();
+            for(auto modelObj : mDrawList) {
+                if(modelObj->transformSlot >= 0) {
+                    mRenderQueue->Add(*modelObj, mProgram, frameState->viewMatrix);
+                }
+            }
+            mRenderQueue->Sort();
+        }
+        ProfileScope drawScope(profiler, mScopes.draw);
+        drawCalls += mRenderQueue->Submit(frameState);
+        if(mInstancingEnabled) {
+            drawCalls += mExtraCubeBatch->Draw(frameState, mInstancedShader, frameState->viewMatrix);
+        }
+    }
+    auto submitEnd = std::chrono::high_resolution_clock::now();
+    mSubmitMillis += std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
+    mDrawCalls += drawCalls;
+    return drawCalls;
+}
+
+void DemoScene::EndFrame(void)
+{
+    TRACE_ZONE("frame", "DemoScene::EndFrame");
+    mUniforms->EndFrame();
+
+    {
+        ProfileScope scope(mProfiler.get(), mScopes.matrixPop);
+        for(auto& modelObj : mObjects) {
+            if(modelObj->modelMatrixStack.size() > 1) {
+                modelObj->PopModelMatrix() ;
+            }
+        }
+    }
+    if(mProfiler) {
+        mProfiler->EndFrame();
+    }
+
+    mFrameCount++;
+    if(mFrameCount % kStatsFrameInterval == 0) {
+        if(printStats) {
+            PrintStats();
+        }
+        ResetSubmitStats();
+    }
+}
+
+void DemoScene::PrintStats(void) const
+{
+    if(mCullingEnabled) {
+        std::cout << "Frustum culling: " << mCullStats.visible << " visible, " << mCullStats.culled << " culled, "
+            << mCullStats.boxTests << " box tests, " << mCullStats.cullMillis << " ms" << std::endl;
+    }
+    if(mOcclusionEnabled) {
+        double cullRate = mOcclusionStats.tested > 0 ? 100.0 * mOcclusionStats.occluded / mOcclusionStats.tested : 0.0;
+        std::cout << "Occlusion culling: " << mOcclusionStats.occluded << " of " << mOcclusionStats.tested
+            << " occluded (" << cullRate << "%), " << mOcclusionStats.occluderTris << " occluder tris, setup "
+            << mOcclusionStats.setupMillis << " ms, raster " << mOcclusionStats.rasterMillis << " ms, test "
+            << mOcclusionStats.testMillis << " ms, " << mThreadPool.NumThreads() << " threads" << std::endl;
+    }
+    const char* submitPath = mArenaEnabled ? " (geometry arena): " : mInstancingEnabled ? " (instanced): " : " (one draw per object): ";
+    std::cout << "Draw submit" << submitPath
+        << (double)mDrawCalls / kStatsFrameInterval << " draw calls, "
+        << mSubmitMillis / kStatsFrameInterval << " ms CPU per frame, "
+        << (mDrawCalls > 0 ? mSubmitMillis * 10000.0 / mDrawCalls : 0.0) << " ms per 10k draws, "
+        << mUniforms->Stats().uploads << " uniform uploads, "
+        << mUniforms->Stats().rangeBinds << " uniform range binds, "
+        << mState.Stats().issued << " state calls issued, " << mState.Stats().elided << " elided" << std::endl;
+    if(mArenaEnabled) {
+        const ArenaStats& arenaStats = mGeometryArena->Stats();
+        std::cout << "Geometry arena: " << arenaStats.objects << " objects in " << arenaStats.draws
+            << " draws, pack " << arenaStats.packMillis << " ms" << std::endl;
+    } else {
+        const RenderQueueStats& queueStats = mRenderQueue->Stats();
+        std::cout << "Render queue: " << queueStats.packets << " packets, " << queueStats.stateChangesUnsorted
+            << " state changes unsorted, " << queueStats.stateChangesSorted << " sorted ("
+            << queueStats.programBinds << " program, " << queueStats.vertexArrayBinds << " vertex array, "
+            << queueStats.textureBinds << " texture, " << queueStats.materialBinds << " material), sort "
+            << queueStats.sortMillis << " ms" << std::endl;
+    }
+    if(mProfiler) {
+        mProfiler->PrintTable(std::cout);
+    }
+}
+
+void DemoScene::ResetSubmitStats(void)
+{
+    mDrawCalls = 0;
+    mSubmitMillis = 0;
+}
+
+void DemoScene::ClearCulled(void)
+{
+    for(auto modelObj : mDrawList) {
+        modelObj->isCulled = false;
+    }
+}
+
+void DemoScene::SetCulling(bool enabled)
+{
+    mCullingEnabled = enabled;
+    ClearCulled();
+}
+
+void DemoScene::SetOcclusion(bool enabled)
+{
+    mOcclusionEnabled = enabled;
+    ClearCulled();
+}
+
+void DemoScene::SetInstancing(bool enabled)
+{
+    mInstancingEnabled = enabled;
+    ResetSubmitStats();
+}
+
+void DemoScene::SetArena(bool enabled)
+{
+    mArenaEnabled = enabled;
+    ResetSubmitStats();
+}
+
+void DemoScene::SetProfiling(bool enabled)
+{
+    if(enabled == ProfilingEnabled()) {
+        return;
+    }
+    if(!enabled) {
+        mProfiler.reset();
+        return;
+    }
+    mProfiler = std::make_unique<FrameProfiler>(mBackend);
+    mScopes.clear = mProfiler->AddScope("clear", true);
+    mScopes.update = mProfiler->AddScope("update", false);
+    mScopes.matrixPush = mProfiler->AddScope("matrix push", false);
+    mScopes.cull = mProfiler->AddScope("cull", false);
+    mScopes.frustum = mProfiler->AddScope("  frustum", false);
+    mScopes.occlusion = mProfiler->AddScope("  occlusion", false);
+    mScopes.submit = mProfiler->AddScope("submit", true);
+    mScopes.transforms = mProfiler->AddScope("  transforms", true);
+    mScopes.queue = mProfiler->AddScope("  queue build/sort", false);
+    mScopes.draw = mProfiler->AddScope("  draw", true);
+    mScopes.matrixPop = mProfiler->AddScope("matrix pop", false);
+}
@@ -0,0 +1,177 @@
+//
+//  demo_scene.h
+//  opengl_setup_example
+//
+
+#ifndef demo_scene_hpp
+#define demo_scene_hpp
+
+#include <vector>
+#include <list>
+#include <memory>
+#include <string>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+
+#include "model_object.h"
+#include "image_buffer.h"
+#include "culling.h"
+#include "occlusion.h"
+#include "thread_pool.h"
+#include "instancing.h"
+#include "geometry_cache.h"
+#include "uniform_buffers.h"
+#include "render_queue.h"
+#include "geometry_arena.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include "texture_cache.h"
+
+struct FrameState;
+class GLBackend;
+
+struct DemoSceneOptions {
+    // cubes scattered around the scene on top of the fixed shapes.
+    int extraObjectCount;
+    // framebuffer size, for the projection.
+    int width;
+    int height;
+    // where the procedural textures are kept between runs, empty to make them every time.
+    std::string textureCacheDirectory;
+
+    DemoSceneOptions() : extraObjectCount(0), width(1024), height(768), textureCacheDirectory(kDefaultTextureCacheDirectory) {}
+
+    static constexpr const char* kDefaultTextureCacheDirectory = "texture_cache";
+};
+
+// The demo's shapes, textures and per frame update and submit, with every GL call
+// going through one backend. The window, input and buffer swap stay with the caller,
+// so the same frames run on the driver or headless on a GLNullBackend.
+//
+// A frame is BeginFrame, Cull, Submit then EndFrame. Picking goes between BeginFrame
+// and EndFrame, while the frame's model matrices are pushed.
+class DemoScene {
+public:
+    // print per frame stats this often.
+    static constexpr int kStatsFrameInterval = 300;
+
+    // objects turn while this is set.
+    bool rotating;
+    // EndFrame prints stats every kStatsFrameInterval frames while this is set.
+    bool printStats;
+
+private:
+    GLBackend& mBackend;
+    FrameState& mFrameState;
+    GLStateCache mState;
+    std::unique_ptr<UniformBuffers> mUniforms;
+
+    bool mCullingEnabled;
+    bool mOcclusionEnabled;
+    bool mInstancingEnabled;
+    bool mArenaEnabled;
+
+    GLuint mProgram;
+    InstancedShader mInstancedShader;
+    ArenaShader mArenaShader;
+
+    std::list<std::unique_ptr<RGBImageBuffer>> mImageBuffers;
+    std::vector<GLuint> mTextureIDs;
+
+    // Geometry is shared between objects built from the same generator or file.
+    GeometryCache mGeometryCache;
+    std::list<std::unique_ptr<ModelObject>> mObjects;
+    // Flat list of objects for per frame passes like culling.
+    std::vector<ModelObject*> mDrawList;
+    ModelObject* mTriangle;
+    ModelObject* mCube;
+    ModelObject* mCubeTwo;
+    ModelObject* mSphere;
+    ModelObject* mPyramid;
+    ModelObject* mMesh;
+    ModelObject* mMeshTwo;
+    std::vector<ModelObject*> mExtraObjects;
+    std::unique_ptr<ModelObject> mExtraCubeGeometry;
+    std::unique_ptr<InstancedBatch> mExtraCubeBatch;
+    std::unique_ptr<GeometryArena> mGeometryArena;
+
+    // Rotation angles
+    float mTriAngle;
+    float mCubeAngle;
+    float mSphereAngle;
+    float mPyramidAngle;
+    float mMeshAngle;
+
+    Frustum mFrustum;
+    FrustumCuller mCuller;
+    CullStats mCullStats;
+    ThreadPool mThreadPool;
+    OcclusionCuller mOcclusionCuller;
+    OcclusionStats mOcclusionStats;
+    std::unique_ptr<RenderQueue> mRenderQueue;
+
+    // null while profiling is off.
+    std::unique_ptr<FrameProfiler> mProfiler;
+    struct {
+        int clear, update, matrixPush, cull, frustum, occlusion, submit, transforms, queue, draw, matrixPop;
+    } mScopes;
+
+    // summed since the stats were last printed.
+    int mDrawCalls;
+    double mSubmitMillis;
+    int mFrameCount;
+
+    GLuint AddTexture(RGBImageBuffer* image);
+    // Uploads key's texture from cache, with its mips. Nothing is kept on the CPU.
+    GLuint AddTexture(TextureCache& cache, const std::string& key, const TextureCache::GenerateFunc& generate);
+    ModelObject* AddObject(std::shared_ptr<const MeshGeometry> geometry, GLuint textureID, const Material& material);
+    void ClearCulled(void);
+
+public:
+    // Fills in frameState's uniform and state pointers, both live as long as the scene.
+    DemoScene(GLBackend& backend, FrameState& frameState);
+    // Deletes every GL object the scene made, the context must still be current.
+    ~DemoScene();
+
+    DemoScene(const DemoScene&) = delete;
+    DemoScene& operator = (const DemoScene&) = delete;
+
+    // Compiles the shaders, makes the textures and objects and uploads them. False if a shader fails.
+    bool Init(const DemoSceneOptions& options);
+
+    // Clears, uploads the frame block and pushes this frame's rotations.
+    void BeginFrame(void);
+    // Frustum then occlusion culling, whichever are on.
+    void Cull(void);
+    // Draws everything not culled on the current path. Returns the draw calls made.
+    int Submit(void);
+    // Pops the rotations and fences the frame's uniforms.
+    void EndFrame(void);
+    void PrintStats(void) const;
+    // Starts the summed submit stats over.
+    void ResetSubmitStats(void);
+
+    bool CullingEnabled(void) const { return mCullingEnabled; }
+    bool OcclusionEnabled(void) const { return mOcclusionEnabled; }
+    bool InstancingEnabled(void) const { return mInstancingEnabled; }
+    bool ArenaEnabled(void) const { return mArenaEnabled; }
+    void SetCulling(bool enabled);
+    void SetOcclusion(bool enabled);
+    void SetInstancing(bool enabled);
+    void SetArena(bool enabled);
+
+    // Times each pass of the frame, its table is printed with the other stats.
+    bool ProfilingEnabled(void) const { return mProfiler != nullptr; }
+    void SetProfiling(bool enabled);
+    // null while profiling is off.
+    const FrameProfiler* Profiler(void) const { return mProfiler.get(); }
+
+    const std::list<std::unique_ptr<ModelObject>>& Objects(void) const { return mObjects; }
+    GLStateCache& StateCache(void) { return mState; }
+    const UniformBuffers& Uniforms(void) const { return *mUniforms; }
+};
+
+#endif /* demo_scene_hpp */
@@ -16,27 +16,17 @@
 #include <glm/glm.hpp>
 #include <glm/ext.hpp>
 
+class UniformBuffers;
+class GLStateCache;
+
 struct FrameState {
     GLFWwindow *window;
     
-    GLint aPositionLocation;
-    GLint mUniformLocation;
-    GLint vUniformLocation;
-    GLint normMatUniformLocation;
-    GLint projUniformLocation;
-    GLint lightPositionID;
-    
-    GLint materialAmbientID;
-    GLint materialDiffuseID;
-    GLint materialSpecularID;
-    GLint materialSpecExpID;
-
-    GLint globalAmbientID;
-    GLint lightDiffuseID;
-    GLint lightSpecularID;
+    // frame, material and object uniform blocks.
+    UniformBuffers* uniforms;
+    // all per frame binds go through this so redundant ones are dropped.
+    GLStateCache* glState;
     
-    GLuint VertexArrayID;
-   
     glm::vec3 lightPosition;
     
     glm::vec3 globalAmbient;
@@ -0,0 +1,173 @@
+//
+//  frame_timer.cpp
+//  opengl_setup_example
+//
+
+#include "frame_timer.h"
+
+#include <algorithm>
+#include <sstream>
+
+#include "gl_backend.h"
+#include "dbgutils.h"
+
+FrameTimer::FrameTimer(GLBackend& backend)
+    : mBackend(backend), mStalls(0)
+{
+    for(int i = 0; i < kQueryLatency; i++) {
+        mQueries[i] = backend.GenQuery();
+        mQueryFrames[i] = -1;
+    }
+}
+
+FrameTimer::~FrameTimer()
+{
+    for(int i = 0; i < kQueryLatency; i++) {
+        mBackend.DeleteQuery(mQueries[i]);
+    }
+}
+
+void FrameTimer::Collect(int slot)
+{
+    int frame = mQueryFrames[slot];
+    if(frame < 0) {
+        return;
+    }
+    if(!mBackend.QueryResultAvailable(mQueries[slot])) {
+        mStalls++;
+    }
+    GLuint64 nanos = mBackend.QueryResult(mQueries[slot]);
+    mTimings[frame].gpuMillis = nanos / 1.0e6;
+    mQueryFrames[slot] = -1;
+}
+
+void FrameTimer::BeginFrame(void)
+{
+    int frame = (int)mTimings.size();
+    int slot = frame % kQueryLatency;
+    Collect(slot);
+
+    mTimings.push_back(FrameTiming());
+    mQueryFrames[slot] = frame;
+    mBackend.BeginQuery(GL_TIME_ELAPSED, mQueries[slot]);
+    mFrameStart = std::chrono::high_resolution_clock::now();
+}
+
+void FrameTimer::EndFrame(void)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    mBackend.EndQuery(GL_TIME_ELAPSED);
+    mTimings.back().cpuMillis = std::chrono::duration<double, std::milli>(end - mFrameStart).count();
+}
+
+void FrameTimer::Finish(void)
+{
+    // oldest first, so the stall count only includes frames that really were not done.
+    int next = (int)mTimings.size() % kQueryLatency;
+    for(int i = 0; i < kQueryLatency; i++) {
+        Collect((next + i) % kQueryLatency);
+    }
+}
+
+void FrameTimer::WriteCSV(std::ostream& out) const
+{
+    out << "frame,cpu_ms,gpu_ms\n";
+    for(size_t i = 0; i < mTimings.size(); i++) {
+        out << i << "," << mTimings[i].cpuMillis << "," << mTimings[i].gpuMillis << "\n";
+    }
+}
+
+static void PrintSummaryLine(std::ostream& out, const char* label, const TimingSummary& summary)
+{
+    out << label << " ms: mean " << summary.mean << ", median " << summary.median << ", p95 " << summary.p95
+        << ", min " << summary.min << ", max " << summary.max << "\n";
+}
+
+void FrameTimer::PrintSummary(std::ostream& out) const
+{
+    std::vector<double> cpu;
+    std::vector<double> gpu;
+    for(const FrameTiming& timing : mTimings) {
+        cpu.push_back(timing.cpuMillis);
+        if(timing.gpuMillis >= 0) {
+            gpu.push_back(timing.gpuMillis);
+        }
+    }
+    out << mTimings.size() << " frames, " << mStalls << " GPU query stalls\n";
+    PrintSummaryLine(out, "CPU", Summarize(cpu));
+    PrintSummaryLine(out, "GPU", Summarize(gpu));
+}
+
+TimingSummary FrameTimer::Summarize(std::vector<double>& values)
+{
+    TimingSummary summary;
+    if(values.empty()) {
+        return summary;
+    }
+    std::sort(values.begin(), values.end());
+    summary.count = (int)values.size();
+    double total = 0;
+    for(double value : values) {
+        total += value;
+    }
+    summary.mean = total / values.size();
+    size_t mid = values.size() / 2;
+    summary.median = values.size() % 2 == 0 ? (values[mid - 1] + values[mid]) * 0.5 : values[mid];
+    // nearest rank.
+    size_t rank = (size_t)((values.size() * 95 + 99) / 100);
+    summary.p95 = values[std::max<size_t>(rank, 1) - 1];
+    summary.min = values.front();
+    summary.max = values.back();
+    return summary;
+}
+
+bool FrameTimer::Test(void)
+{
+    std::vector<double> values;
+    for(int i = 20; i >= 1; i--) {
+        values.push_back(i);
+    }
+    TimingSummary summary = Summarize(values);
+    DbgAssert(summary.count == 20);
+    DbgAssertAlmostEqual(summary.mean, 10.5);
+    DbgAssertAlmostEqual(summary.median, 10.5);
+    DbgAssertAlmostEqual(summary.p95, 19.0);
+    DbgAssertAlmostEqual(summary.min, 1.0);
+    DbgAssertAlmostEqual(summary.max, 20.0);
+
+    std::vector<double> empty;
+    DbgAssert(Summarize(empty).count == 0);
+
+    // Each query is read back only when its slot comes round again, then the rest on Finish.
+    GLNullBackend backend;
+    {
+        FrameTimer timer(backend);
+        const int frames = kQueryLatency + 2;
+        for(int i = 0; i < frames; i++) {
+            timer.BeginFrame();
+            timer.EndFrame();
+            int readBack = std::max(0, i + 1 - kQueryLatency);
+            DbgAssert(backend.CountCommands(kCmdQueryResult) == readBack);
+        }
+        DbgAssert(timer.Timings()[frames - 1].gpuMillis < 0);
+        timer.Finish();
+        DbgAssert(backend.CountCommands(kCmdQueryResult) == frames);
+        DbgAssert(backend.CountCommands(kCmdBeginQuery) == frames);
+        for(const FrameTiming& timing : timer.Timings()) {
+            DbgAssert(timing.gpuMillis == 0);
+            DbgAssert(timing.cpuMillis >= 0);
+        }
+        DbgAssert(timer.Stalls() == 0);
+
+        std::ostringstream csv;
+        timer.WriteCSV(csv);
+        std::string text = csv.str();
+        DbgAssert(std::count(text.begin(), text.end(), '\n') == frames + 1);
+    }
+    DbgAssert(backend.CountCommands(kCmdDeleteQuery) == kQueryLatency);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+//
+//  frame_timer.h
+//  opengl_setup_example
+//
+
+#ifndef frame_timer_hpp
+#define frame_timer_hpp
+
+#include <vector>
+#include <chrono>
+#include <ostream>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+
+class GLBackend;
+
+struct FrameTiming {
+    double cpuMillis;
+    // GL_TIME_ELAPSED for the frame's commands, negative until the query is read back.
+    double gpuMillis;
+
+    FrameTiming() : cpuMillis(0), gpuMillis(-1) {}
+};
+
+struct TimingSummary {
+    int count;
+    double mean;
+    double median;
+    double p95;
+    double min;
+    double max;
+
+    TimingSummary() : count(0), mean(0), median(0), p95(0), min(0), max(0) {}
+};
+
+// CPU wall time and GPU elapsed time for each frame between BeginFrame and EndFrame.
+//
+// The GPU time comes from a ring of GL_TIME_ELAPSED queries. A query is read back
+// kQueryLatency frames after it was issued, by which point it has normally finished,
+// so timing does not make the CPU wait on the GPU. Finish reads back whatever is left.
+class FrameTimer {
+public:
+    static constexpr int kQueryLatency = 4;
+
+private:
+    GLBackend& mBackend;
+    GLuint mQueries[kQueryLatency];
+    // frame each query is timing, -1 when it is free.
+    int mQueryFrames[kQueryLatency];
+    std::vector<FrameTiming> mTimings;
+    std::chrono::high_resolution_clock::time_point mFrameStart;
+    // read backs that had to wait for the GPU.
+    int mStalls;
+
+    void Collect(int slot);
+
+public:
+    explicit FrameTimer(GLBackend& backend);
+    // Deletes the queries, the context must still be current.
+    ~FrameTimer();
+
+    FrameTimer(const FrameTimer&) = delete;
+    FrameTimer& operator = (const FrameTimer&) = delete;
+
+    void BeginFrame(void);
+    void EndFrame(void);
+    // Reads back every query still in flight, waiting on the GPU if needed.
+    void Finish(void);
+
+    const std::vector<FrameTiming>& Timings(void) const { return mTimings; }
+    int Stalls(void) const { return mStalls; }
+
+    // One line per frame, frame,cpu_ms,gpu_ms.
+    void WriteCSV(std::ostream& out) const;
+    // Summary of the CPU and GPU columns.
+    void PrintSummary(std::ostream& out) const;
+
+    // values is sorted in place.
+    static TimingSummary Summarize(std::vector<double>& values);
+
+    static bool Test(void);
+};
+
+#endif /* frame_timer_hpp */
@@ -0,0 +1,280 @@
+//
+//  geometry_arena.cpp
+//  opengl_setup_example
+//
+
+#include "geometry_arena.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+
+#include "model_object.h"
+#include "frame_state.h"
+#include "uniform_buffers.h"
+#include "gl_state.h"
+#include "gl_backend.h"
+#include "dbgutils.h"
+#include "trace.h"
+
+// texture unit the draw data buffer is bound to, unit 0 is the object texture.
+constexpr GLint kDrawDataTextureUnit = 1;
+
+bool ArenaShader::Init(GLBackend& backend, const char* vertexShaderPath, const char* fragmentShaderPath)
+{
+    if(!backend.CreateProgram(program, vertexShaderPath, fragmentShaderPath)) {
+        return false;
+    }
+    UniformBuffers::BindBlocks(backend, program);
+
+    drawBaseLocation = backend.GetUniformLocation(program, "drawBase");
+    if(drawBaseLocation == -1) {
+        std::cerr << "Could not bind drawBase location in arena shader" << std::endl;
+    }
+    backend.UseProgram(program);
+    backend.Uniform1i(backend.GetUniformLocation(program, "drawData"), kDrawDataTextureUnit);
+    return true;
+}
+
+
+GeometryArena::GeometryArena(GLBackend* backend)
+    : mBackend(backend), mVertexCount(0), mVertexArray(0), mVertexBuffer(0), mIndexBuffer(0),
+      mDrawDataBuffer(0), mDrawDataTexture(0)
+{
+}
+
+GeometryArena::~GeometryArena()
+{
+    if(mVertexArray == 0) {
+        return;
+    }
+    mBackend->DeleteVertexArray(mVertexArray);
+    mBackend->DeleteTexture(mDrawDataTexture);
+    GLuint buffers[] = { mVertexBuffer, mIndexBuffer, mDrawDataBuffer };
+    for(GLuint buffer : buffers) {
+        mBackend->DeleteBuffer(buffer);
+    }
+}
+
+int GeometryArena::Add(const std::shared_ptr<const MeshGeometry>& geom)
+{
+    int existing = Find(geom.get());
+    if(existing >= 0) {
+        return existing;
+    }
+
+    GLint vertexCount = (GLint)(geom->vertexData.size() / 3);
+    ArenaRange range;
+    range.baseVertex = mVertexCount;
+    range.firstIndex = (GLuint)mIndexes.size();
+    if(geom->isIndexed) {
+        mIndexes.insert(mIndexes.end(), geom->vertexIndexes.begin(), geom->vertexIndexes.end());
+    } else {
+        for(GLint i = 0; i < vertexCount; i++) {
+            mIndexes.push_back(i);
+        }
+    }
+    range.indexCount = (GLsizei)(mIndexes.size() - range.firstIndex);
+    mVertexCount += vertexCount;
+
+    mMeshes.push_back(geom);
+    mRanges.push_back(range);
+    mRangeIndexes[geom.get()] = (int)mRanges.size() - 1;
+    return (int)mRanges.size() - 1;
+}
+
+int GeometryArena::Find(const MeshGeometry* geom) const
+{
+    auto found = mRangeIndexes.find(geom);
+    return found != mRangeIndexes.end() ? found->second : -1;
+}
+
+void GeometryArena::Build(void)
+{
+    TRACE_ZONE("gl", "GeometryArena::Build");
+    if(mRanges.empty() || !mBackend) {
+        return;
+    }
+    GLBackend& backend = *mBackend;
+    if(mVertexArray == 0) {
+        mVertexArray = backend.GenVertexArray();
+        mVertexBuffer = backend.GenBuffer();
+        mIndexBuffer = backend.GenBuffer();
+        mDrawDataBuffer = backend.GenBuffer();
+        mDrawDataTexture = backend.GenTexture();
+    }
+
+    const GLsizeiptr vertexBytes = kVertexStride * sizeof(float);
+    backend.BindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    backend.BufferData(GL_ARRAY_BUFFER, mVertexCount * vertexBytes, nullptr, GL_STATIC_DRAW);
+
+    // The interleaved data is only on the GPU by now, so copy buffer to buffer.
+    backend.BindBuffer(GL_COPY_WRITE_BUFFER, mVertexBuffer);
+    for(size_t i = 0; i < mMeshes.size(); i++) {
+        const MeshGeometry& geom = *mMeshes[i];
+        if(geom.vertexBuffer == 0) {
+            std::cerr << "Arena mesh " << i << " was never uploaded" << std::endl;
+            continue;
+        }
+        GLsizeiptr bytes = (geom.vertexData.size() / 3) * vertexBytes;
+        backend.BindBuffer(GL_COPY_READ_BUFFER, geom.vertexBuffer);
+        backend.CopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, mRanges[i].baseVertex * vertexBytes, bytes);
+    }
+
+    backend.BindVertexArray(mVertexArray);
+    backend.BindBuffer(GL_ARRAY_BUFFER, mVertexBuffer);
+    SetVertexAttributes(backend);
+    backend.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, mIndexBuffer);
+    backend.BufferData(GL_ELEMENT_ARRAY_BUFFER, mIndexes.size() * sizeof(GLuint), mIndexes.data(), GL_STATIC_DRAW);
+    backend.BindVertexArray(0);
+
+    backend.BindBuffer(GL_TEXTURE_BUFFER, mDrawDataBuffer);
+    backend.BindTexture(GL_TEXTURE_BUFFER, mDrawDataTexture);
+    backend.TexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, mDrawDataBuffer);
+    backend.BindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+size_t GeometryArena::GPUBytes(void) const
+{
+    return mVertexCount * kVertexStride * sizeof(float) + mIndexes.size() * sizeof(GLuint);
+}
+
+void GeometryArena::PackDraws(const std::vector<ModelObject*>& objects, const glm::mat4& viewMatrix)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // mesh, then texture, then material, so each group is one draw.
+    mSortedObjects.clear();
+    for(const ModelObject* obj : objects) {
+        if(!obj->Visible() || obj->isCulled || !obj->geometry) {
+            continue;
+        }
+        int rangeIndex = Find(obj->geometry.get());
+        if(rangeIndex < 0) {
+            continue;
+        }
+        uint64_t key = ((uint64_t)rangeIndex << 40) | ((uint64_t)(obj->textureID & 0xFFFFFF) << 16) | (uint64_t)(obj->materialSlot & 0xFFFF);
+        mSortedObjects.push_back(std::make_pair(key, obj));
+    }
+    std::stable_sort(mSortedObjects.begin(), mSortedObjects.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    mDraws.clear();
+    mDrawData.resize(mSortedObjects.size() * kFloatsPerDraw);
+    for(size_t i = 0; i < mSortedObjects.size(); i++) {
+        const ModelObject* obj = mSortedObjects[i].second;
+        // same layout as the object uniform block.
+        PackObjectBlock(obj->modelMatrixStack.top(), viewMatrix, &mDrawData[i * kFloatsPerDraw]);
+
+        if(i == 0 || mSortedObjects[i].first != mSortedObjects[i - 1].first) {
+            ArenaDraw draw;
+            draw.rangeIndex = (int)(mSortedObjects[i].first >> 40);
+            draw.textureID = obj->textureID;
+            draw.materialSlot = obj->materialSlot;
+            draw.drawBase = (GLint)i;
+            draw.instanceCount = 0;
+            mDraws.push_back(draw);
+        }
+        mDraws.back().instanceCount++;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    mStats.objects = (int)mSortedObjects.size();
+    mStats.draws = (int)mDraws.size();
+    mStats.packMillis = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int GeometryArena::Submit(FrameState* frameState, const ArenaShader& shader,
+                          const std::vector<ModelObject*>& objects, const glm::mat4& viewMatrix)
+{
+    PackDraws(objects, viewMatrix);
+    if(mDraws.empty() || mVertexArray == 0) {
+        return 0;
+    }
+
+    GLStateCache* state = frameState->glState;
+    state->BindBuffer(GL_TEXTURE_BUFFER, mDrawDataBuffer);
+    mBackend->BufferData(GL_TEXTURE_BUFFER, mDrawData.size() * sizeof(float), mDrawData.data(), GL_STREAM_DRAW);
+
+    state->UseProgram(shader.program);
+    state->BindVertexArray(mVertexArray);
+    state->ActiveTexture(GL_TEXTURE0 + kDrawDataTextureUnit);
+    state->BindTexture(GL_TEXTURE_BUFFER, mDrawDataTexture);
+    state->ActiveTexture(GL_TEXTURE0);
+
+    for(const ArenaDraw& draw : mDraws) {
+        state->BindTexture(GL_TEXTURE_2D, draw.textureID);
+        frameState->uniforms->BindMaterial(draw.materialSlot);
+        const ArenaRange& range = mRanges[draw.rangeIndex];
+        mBackend->Uniform1i(shader.drawBaseLocation, draw.drawBase);
+        mBackend->DrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, GL_UNSIGNED_INT,
+                                                  range.firstIndex * sizeof(GLuint),
+                                                  draw.instanceCount, range.baseVertex);
+    }
+    return (int)mDraws.size();
+}
+
+
+bool GeometryArena::Test(void)
+{
+    GeometryCache cache(nullptr);
+    auto cube = cache.Cube();
+    auto sphere = cache.Sphere(1.0f, 8, 6);
+    auto pyramid = cache.Pyramid();
+
+    GeometryArena arena(nullptr);
+    DbgAssert(arena.Add(cube) == 0);
+    DbgAssert(arena.Add(sphere) == 1);
+    DbgAssert(arena.Add(cube) == 0);
+    DbgAssert(arena.MeshCount() == 2);
+    DbgAssert(arena.Find(pyramid.get()) == -1);
+
+    // Meshes are packed one after the other, the non-indexed cube gets its own indexes.
+    const ArenaRange& cubeRange = arena.Range(0);
+    const ArenaRange& sphereRange = arena.Range(1);
+    DbgAssert(cubeRange.baseVertex == 0 && cubeRange.firstIndex == 0 && cubeRange.indexCount == 36);
+    DbgAssert(sphereRange.baseVertex == 36 && sphereRange.firstIndex == 36);
+    DbgAssert(sphereRange.indexCount == sphere->drawCount);
+    DbgAssert(arena.mIndexes[35] == 35);
+    DbgAssert(arena.mIndexes[36] == (GLuint)sphere->vertexIndexes[0]);
+
+    std::vector<std::unique_ptr<ModelObject>> owned;
+    std::vector<ModelObject*> objects;
+    auto addObject = [&](std::shared_ptr<const MeshGeometry> geom, GLuint texture, float x) {
+        owned.push_back(std::make_unique<ModelObject>());
+        ModelObject* obj = owned.back().get();
+        obj->geometry = geom;
+        obj->textureID = texture;
+        obj->PushModelMatrix(glm::translate(obj->ModelMatrix(), glm::vec3(x, 0, -5)));
+        obj->Show();
+        objects.push_back(obj);
+        return obj;
+    };
+    addObject(sphere, 5, 0);
+    addObject(cube, 5, 1);
+    addObject(cube, 7, 2);
+    addObject(cube, 5, 3);
+    addObject(cube, 5, 4)->Hide();
+    addObject(pyramid, 5, 5);
+
+    arena.PackDraws(objects, glm::identity<glm::mat4>());
+    const std::vector<ArenaDraw>& draws = arena.Draws();
+    DbgAssert(draws.size() == 3);
+    DbgAssert(arena.Stats().objects == 4);
+    DbgAssert(arena.DrawData().size() == 4 * kFloatsPerDraw);
+
+    // cubes with texture 5 first, in the order they were given.
+    DbgAssert(draws[0].rangeIndex == 0 && draws[0].textureID == 5);
+    DbgAssert(draws[0].drawBase == 0 && draws[0].instanceCount == 2);
+    DbgAssertAlmostEqual(arena.DrawData()[12], 1.0);
+    DbgAssertAlmostEqual(arena.DrawData()[kFloatsPerDraw + 12], 3.0);
+    DbgAssert(draws[1].textureID == 7 && draws[1].drawBase == 2 && draws[1].instanceCount == 1);
+    DbgAssert(draws[2].rangeIndex == 1 && draws[2].drawBase == 3);
+    DbgAssertAlmostEqual(arena.DrawData()[3 * kFloatsPerDraw + 12], 0.0);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
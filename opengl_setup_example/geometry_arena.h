@@ -0,0 +1,130 @@
+//
+//  geometry_arena.h
+//  opengl_setup_example
+//
+
+#ifndef geometry_arena_hpp
+#define geometry_arena_hpp
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <cstdint>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct MeshGeometry;
+class ModelObject;
+struct FrameState;
+class GLBackend;
+
+// Where one mesh lives inside the arena buffers.
+struct ArenaRange {
+    GLint baseVertex;
+    GLuint firstIndex;
+    GLsizei indexCount;
+};
+
+// One draw of the arena path: every object sharing a mesh, texture and material.
+struct ArenaDraw {
+    int rangeIndex;
+    GLuint textureID;
+    int materialSlot;
+    // first object of the draw in the draw data, the shader adds gl_InstanceID.
+    GLint drawBase;
+    GLsizei instanceCount;
+};
+
+struct ArenaStats {
+    int objects;
+    int draws;
+    double packMillis;
+
+    ArenaStats() : objects(0), draws(0), packMillis(0) {}
+};
+
+// Program for phong_arena_vertex_shader.glsl, which reads model and normal
+// matrices from a texture buffer indexed by draw base plus instance ID.
+struct ArenaShader {
+    GLuint program;
+    GLint drawBaseLocation;
+
+    ArenaShader() : program(0), drawBaseLocation(-1) {}
+
+    // Also binds the uniform blocks and points drawData at its texture unit.
+    bool Init(GLBackend& backend, const char* vertexShaderPath, const char* fragmentShaderPath);
+};
+
+// All static meshes sub-allocated in one vertex buffer and one index buffer behind a
+// single vertex array, so the whole scene draws without rebinding geometry.
+//
+// GL 4.1 on macOS has neither glMultiDrawElementsIndirect nor gl_DrawID, so objects are
+// grouped by mesh, texture and material and each group is one
+// glDrawElementsInstancedBaseVertex. Per object data sits in a texture buffer and the
+// shader finds its entry with a per draw base uniform plus gl_InstanceID.
+class GeometryArena {
+public:
+    // model matrix then normal matrix, as 8 RGBA32F texels.
+    static constexpr int kFloatsPerDraw = 32;
+
+private:
+    GLBackend* mBackend;
+    // kept alive so the ranges stay valid.
+    std::vector<std::shared_ptr<const MeshGeometry>> mMeshes;
+    std::vector<ArenaRange> mRanges;
+    std::map<const MeshGeometry*, int> mRangeIndexes;
+    // indexes for the whole arena, non-indexed meshes get 0..n-1.
+    std::vector<GLuint> mIndexes;
+    GLint mVertexCount;
+
+    GLuint mVertexArray;
+    GLuint mVertexBuffer;
+    GLuint mIndexBuffer;
+    GLuint mDrawDataBuffer;
+    GLuint mDrawDataTexture;
+
+    // per frame, reused to avoid allocating.
+    std::vector<std::pair<uint64_t, const ModelObject*>> mSortedObjects;
+    std::vector<float> mDrawData;
+    std::vector<ArenaDraw> mDraws;
+    ArenaStats mStats;
+
+public:
+    // backend may be null for an arena that is only packed, never built.
+    explicit GeometryArena(GLBackend* backend);
+    ~GeometryArena();
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator = (const GeometryArena&) = delete;
+
+    // Reserves space for geom if it is not in the arena yet. Returns its range index.
+    int Add(const std::shared_ptr<const MeshGeometry>& geom);
+    // Range index of geom, -1 if it was never added.
+    int Find(const MeshGeometry* geom) const;
+    const ArenaRange& Range(int rangeIndex) const { return mRanges[rangeIndex]; }
+
+    // Copies every added mesh into the arena buffers. The meshes must already be uploaded.
+    void Build(void);
+
+    // Groups the visible, unculled objects in the arena and packs their per object data.
+    // Objects whose mesh is not in the arena are left out.
+    void PackDraws(const std::vector<ModelObject*>& objects, const glm::mat4& viewMatrix);
+    const std::vector<ArenaDraw>& Draws(void) const { return mDraws; }
+    const std::vector<float>& DrawData(void) const { return mDrawData; }
+
+    // PackDraws then uploads the draw data and issues the draws. Returns the number of draw calls.
+    int Submit(FrameState* frameState, const ArenaShader& shader,
+               const std::vector<ModelObject*>& objects, const glm::mat4& viewMatrix);
+
+    int MeshCount(void) const { return (int)mRanges.size(); }
+    size_t GPUBytes(void) const;
+    const ArenaStats& Stats(void) const { return mStats; }
+
+    static bool Test(void);
+};
+
+#endif /* geometry_arena_hpp */
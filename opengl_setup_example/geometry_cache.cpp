@@ -0,0 +1,221 @@
+//
+//  geometry_cache.cpp
+//  opengl_setup_example
+//
+
+#include "geometry_cache.h"
+
+#include <iostream>
+#include <sstream>
+
+#include "model_object.h"
+#include "gl_backend.h"
+#include "cube.h"
+#include "sphere.h"
+#include "pyramid.h"
+#include "trianglemesh.h"
+#include "dbgutils.h"
+
+MeshGeometry::MeshGeometry()
+    : isIndexed(false), hasTexCoords(false), hasNormals(false), drawCount(0),
+      vertexArray(0), vertexBuffer(0), indexBuffer(0), gpuBytes(0), backend(nullptr)
+{
+}
+
+MeshGeometry::~MeshGeometry()
+{
+    // Geometry that was never uploaded may not have a GL context around at all.
+    if(!backend) {
+        return;
+    }
+    if(vertexArray != 0) {
+        backend->DeleteVertexArray(vertexArray);
+    }
+    GLuint buffers[] = { vertexBuffer, indexBuffer };
+    for(GLuint buffer : buffers) {
+        if(buffer != 0) {
+            backend->DeleteBuffer(buffer);
+        }
+    }
+}
+
+void MeshGeometry::Finish(void)
+{
+    isIndexed = !vertexIndexes.empty();
+    hasTexCoords = !texCoords.empty();
+    hasNormals = !normals.empty();
+    drawCount = (GLsizei)(isIndexed ? vertexIndexes.size() : vertexData.size() / 3);
+    bvh.Build(vertexData, vertexIndexes);
+    localBounds = ComputeLocalBounds(vertexData);
+}
+
+size_t MeshGeometry::CPUBytes(void) const
+{
+    return (vertexData.size() + texCoords.size() + normals.size()) * sizeof(float) + vertexIndexes.size() * sizeof(int);
+}
+
+
+std::shared_ptr<const MeshGeometry> GeometryCache::Get(const std::string& key, const BuildFunc& build)
+{
+    auto found = mEntries.find(key);
+    if(found != mEntries.end()) {
+        std::shared_ptr<const MeshGeometry> existing = found->second.lock();
+        if(existing) {
+            mHits++;
+            return existing;
+        }
+    }
+
+    mMisses++;
+    std::shared_ptr<MeshGeometry> geom = std::make_shared<MeshGeometry>();
+    if(!build(*geom)) {
+        return nullptr;
+    }
+    if(mBackend) {
+        BindObjectBuffers(*mBackend, *geom);
+    } else {
+        geom->Finish();
+    }
+    mEntries[key] = geom;
+    return geom;
+}
+
+std::shared_ptr<const MeshGeometry> GeometryCache::Triangle(void)
+{
+    return Get("triangle", [](MeshGeometry& geom) {
+        MakeTriangle(geom);
+        return true;
+    });
+}
+
+std::shared_ptr<const MeshGeometry> GeometryCache::Cube(void)
+{
+    return Get("cube", [](MeshGeometry& geom) {
+        GenerateCube(geom.vertexData, geom.texCoords);
+        GenerateNormals(geom.vertexData, geom.normals);
+        return true;
+    });
+}
+
+std::shared_ptr<const MeshGeometry> GeometryCache::Pyramid(void)
+{
+    return Get("pyramid", [](MeshGeometry& geom) {
+        GeneratePyramid(geom.vertexData, geom.texCoords);
+        GenerateNormals(geom.vertexData, geom.normals);
+        return true;
+    });
+}
+
+std::shared_ptr<const MeshGeometry> GeometryCache::Sphere(float radius, int sectorCount, int stackCount)
+{
+    std::ostringstream key;
+    key << "sphere:" << radius << ":" << sectorCount << ":" << stackCount;
+    return Get(key.str(), [=](MeshGeometry& geom) {
+        GenerateSphere(radius, sectorCount, stackCount, geom.vertexData, geom.normals, geom.texCoords, geom.vertexIndexes);
+        return true;
+    });
+}
+
+std::shared_ptr<const MeshGeometry> GeometryCache::LoadSMF(const std::string& path)
+{
+    return Get("smf:" + path, [&](MeshGeometry& geom) {
+        TriangleMesh mesh;
+        if(!mesh.LoadFromSMF(path.c_str())) {
+            std::cerr << "Error loading mesh from " << path << std::endl;
+            return false;
+        }
+        mesh.CalcNormals();
+        MakeMeshObject(mesh, geom);
+        return true;
+    });
+}
+
+int GeometryCache::LiveCount(void) const
+{
+    int count = 0;
+    for(const auto& entry : mEntries) {
+        if(!entry.second.expired()) {
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t GeometryCache::LiveCPUBytes(void) const
+{
+    size_t bytes = 0;
+    for(const auto& entry : mEntries) {
+        if(auto geom = entry.second.lock()) {
+            bytes += geom->CPUBytes();
+        }
+    }
+    return bytes;
+}
+
+size_t GeometryCache::LiveGPUBytes(void) const
+{
+    size_t bytes = 0;
+    for(const auto& entry : mEntries) {
+        if(auto geom = entry.second.lock()) {
+            bytes += geom->gpuBytes;
+        }
+    }
+    return bytes;
+}
+
+
+bool GeometryCache::Test(void)
+{
+    GeometryCache cache(nullptr);
+
+    auto cubeA = cache.Cube();
+    auto cubeB = cache.Cube();
+    DbgAssert(cubeA && cubeA == cubeB);
+    DbgAssert(cache.Misses() == 1 && cache.Hits() == 1);
+    DbgAssert(!cubeA->isIndexed);
+    DbgAssert(cubeA->drawCount == 36);
+    DbgAssert(cubeA->hasNormals && cubeA->hasTexCoords);
+    DbgAssert(cubeA->bvh.NumTriangles() == 12);
+    DbgAssertAlmostEqual(cubeA->localBounds.aabbMax.x, 1.0);
+
+    // Different generator parameters are different geometry.
+    auto sphereA = cache.Sphere(1.5f, 20, 25);
+    auto sphereB = cache.Sphere(1.5f, 20, 25);
+    auto sphereC = cache.Sphere(0.5f, 20, 25);
+    DbgAssert(sphereA == sphereB);
+    DbgAssert(sphereA != sphereC);
+    DbgAssert(sphereA->isIndexed);
+    DbgAssert(sphereA->drawCount == (GLsizei)sphereA->vertexIndexes.size());
+    DbgAssertAlmostEqual(sphereC->localBounds.sphereRadius, 0.5, 1e-4);
+    DbgAssert(cache.LiveCount() == 3);
+
+    // Entries go away with their last user and get rebuilt on the next request.
+    size_t bytesWithSmallSphere = cache.LiveCPUBytes();
+    sphereC.reset();
+    DbgAssert(cache.LiveCount() == 2);
+    DbgAssert(cache.LiveCPUBytes() < bytesWithSmallSphere);
+    int missesBefore = cache.Misses();
+    sphereC = cache.Sphere(0.5f, 20, 25);
+    DbgAssert(cache.Misses() == missesBefore + 1);
+
+    // Upload layout, position then normal then uv per vertex.
+    std::vector<float> interleaved;
+    InterleaveVertexData({ 1, 2, 3,  4, 5, 6 }, { 0, 0, 1,  0, 1, 0 }, { 0.25f, 0.5f,  0.75f, 1 }, interleaved);
+    DbgAssert(interleaved.size() == 2 * kVertexStride);
+    DbgAssert(interleaved[kVertexStride] == 4);
+    DbgAssert(interleaved[kVertexStride + kVertexNormalOffset + 1] == 1);
+    DbgAssert(interleaved[kVertexUVOffset] == 0.25f);
+    DbgAssert(interleaved[kVertexStride + kVertexUVOffset + 1] == 1);
+    InterleaveVertexData({ 1, 2, 3 }, {}, {}, interleaved);
+    DbgAssert(interleaved.size() == kVertexStride && interleaved[kVertexUVOffset] == 0);
+
+    // Failed builds are not cached.
+    auto failed = cache.Get("broken", [](MeshGeometry&) { return false; });
+    DbgAssert(!failed);
+    DbgAssert(cache.LiveCount() == 3);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,106 @@
+//
+//  geometry_cache.h
+//  opengl_setup_example
+//
+
+#ifndef geometry_cache_hpp
+#define geometry_cache_hpp
+
+#include <vector>
+#include <map>
+#include <string>
+#include <memory>
+#include <functional>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+
+#include "picking.h"
+#include "culling.h"
+
+class GLBackend;
+
+// Vertex data and GL buffers for one mesh. Objects share it through a
+// std::shared_ptr<const MeshGeometry> so it is never changed once uploaded.
+struct MeshGeometry {
+    // positions and indexes stay on the CPU for picking and occlusion culling.
+    std::vector<float> vertexData;
+    std::vector<int> vertexIndexes;
+    // uv and normal arrays are dropped once they are uploaded.
+    std::vector<float> texCoords;
+    std::vector<float> normals;
+
+    bool isIndexed;
+    bool hasTexCoords;
+    bool hasNormals;
+    // index count when indexed, otherwise vertex count.
+    GLsizei drawCount;
+    // 0 until uploaded. The vertex array holds the attribute layout over the
+    // interleaved buffer and the index buffer, so drawing only has to bind it.
+    GLuint vertexArray;
+    GLuint vertexBuffer, indexBuffer;
+    size_t gpuBytes;
+    // what the buffers were created with, null until uploaded.
+    GLBackend* backend;
+
+    // object space triangle hierarchy for picking.
+    MeshBVH bvh;
+    // object space bounds for culling.
+    LocalBounds localBounds;
+
+    MeshGeometry();
+    // Deletes the GL buffers, so the last reference must go away while the context is current.
+    ~MeshGeometry();
+
+    MeshGeometry(const MeshGeometry&) = delete;
+    MeshGeometry& operator = (const MeshGeometry&) = delete;
+
+    // Sets the draw count, bounds and BVH from the CPU arrays. BindObjectBuffers calls this,
+    // call it directly for geometry that never goes to the GPU.
+    void Finish(void);
+
+    size_t CPUBytes(void) const;
+};
+
+// Hands out shared geometry keyed by file path or generator parameters so objects
+// using the same mesh share one copy of the vertex data and buffers.
+// Entries are weak, geometry is freed when the last object using it goes away.
+class GeometryCache {
+public:
+    // fills in the CPU arrays of a new geometry, returns false on failure.
+    typedef std::function<bool(MeshGeometry&)> BuildFunc;
+
+private:
+    std::map<std::string, std::weak_ptr<const MeshGeometry>> mEntries;
+    GLBackend* mBackend;
+    int mHits;
+    int mMisses;
+
+public:
+    // Uploads new geometry through backend. Null keeps everything on the CPU, for tests without a GL context.
+    explicit GeometryCache(GLBackend* backend) : mBackend(backend), mHits(0), mMisses(0) {}
+
+    // Returns the geometry for key, calling build only if nothing alive has it. Null if build fails.
+    std::shared_ptr<const MeshGeometry> Get(const std::string& key, const BuildFunc& build);
+
+    std::shared_ptr<const MeshGeometry> Triangle(void);
+    std::shared_ptr<const MeshGeometry> Cube(void);
+    std::shared_ptr<const MeshGeometry> Pyramid(void);
+    std::shared_ptr<const MeshGeometry> Sphere(float radius, int sectorCount, int stackCount);
+    // SMF mesh with smooth normals and automatic uv mapping.
+    std::shared_ptr<const MeshGeometry> LoadSMF(const std::string& path);
+
+    int Hits(void) const { return mHits; }
+    int Misses(void) const { return mMisses; }
+
+    // geometries still referenced by something and the memory they use.
+    int LiveCount(void) const;
+    size_t LiveCPUBytes(void) const;
+    size_t LiveGPUBytes(void) const;
+
+    static bool Test(void);
+};
+
+#endif /* geometry_cache_hpp */
@@ -0,0 +1,927 @@
+//
+//  gl_backend.cpp
+//  opengl_setup_example
+//
+
+#include "gl_backend.h"
+
+#include <map>
+#include <string>
+#include <cstring>
+
+#include "shaders.h"
+#include "mathutil.h"
+#include "dbgutils.h"
+
+bool GLDirectBackend::CreateProgram(GLuint& program, const char* vertexShaderPath, const char* fragmentShaderPath)
+{
+    return InitShader(program, vertexShaderPath, fragmentShaderPath);
+}
+
+void GLDirectBackend::DeleteProgram(GLuint program) { glDeleteProgram(program); }
+void GLDirectBackend::UseProgram(GLuint program) { glUseProgram(program); }
+GLint GLDirectBackend::GetUniformLocation(GLuint program, const char* name) { return glGetUniformLocation(program, name); }
+GLuint GLDirectBackend::GetUniformBlockIndex(GLuint program, const char* name) { return glGetUniformBlockIndex(program, name); }
+
+void GLDirectBackend::UniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding)
+{
+    glUniformBlockBinding(program, blockIndex, binding);
+}
+
+void GLDirectBackend::GetActiveUniformBlockiv(GLuint program, GLuint blockIndex, GLenum pname, GLint* value)
+{
+    glGetActiveUniformBlockiv(program, blockIndex, pname, value);
+}
+
+void GLDirectBackend::Uniform1i(GLint location, GLint value) { glUniform1i(location, value); }
+void GLDirectBackend::GetIntegerv(GLenum pname, GLint* value) { glGetIntegerv(pname, value); }
+
+GLuint GLDirectBackend::GenBuffer(void)
+{
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    return buffer;
+}
+
+void GLDirectBackend::DeleteBuffer(GLuint buffer) { glDeleteBuffers(1, &buffer); }
+void GLDirectBackend::BindBuffer(GLenum target, GLuint buffer) { glBindBuffer(target, buffer); }
+void GLDirectBackend::BindBufferBase(GLenum target, GLuint index, GLuint buffer) { glBindBufferBase(target, index, buffer); }
+
+void GLDirectBackend::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    glBindBufferRange(target, index, buffer, offset, size);
+}
+
+void GLDirectBackend::BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage)
+{
+    glBufferData(target, size, data, usage);
+}
+
+void GLDirectBackend::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data)
+{
+    glBufferSubData(target, offset, size, data);
+}
+
+void* GLDirectBackend::MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+    return glMapBufferRange(target, offset, length, access);
+}
+
+void GLDirectBackend::UnmapBuffer(GLenum target) { glUnmapBuffer(target); }
+
+void GLDirectBackend::CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+{
+    glCopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, size);
+}
+
+GLuint GLDirectBackend::GenVertexArray(void)
+{
+    GLuint vertexArray = 0;
+    glGenVertexArrays(1, &vertexArray);
+    return vertexArray;
+}
+
+void GLDirectBackend::DeleteVertexArray(GLuint vertexArray) { glDeleteVertexArrays(1, &vertexArray); }
+void GLDirectBackend::BindVertexArray(GLuint vertexArray) { glBindVertexArray(vertexArray); }
+void GLDirectBackend::EnableVertexAttribArray(GLuint index) { glEnableVertexAttribArray(index); }
+void GLDirectBackend::DisableVertexAttribArray(GLuint index) { glDisableVertexAttribArray(index); }
+
+void GLDirectBackend::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, uintptr_t offset)
+{
+    glVertexAttribPointer(index, size, type, normalized, stride, (const void*)offset);
+}
+
+void GLDirectBackend::VertexAttribDivisor(GLuint index, GLuint divisor) { glVertexAttribDivisor(index, divisor); }
+
+GLuint GLDirectBackend::GenTexture(void)
+{
+    GLuint texture = 0;
+    glGenTextures(1, &texture);
+    return texture;
+}
+
+void GLDirectBackend::DeleteTexture(GLuint texture) { glDeleteTextures(1, &texture); }
+void GLDirectBackend::ActiveTexture(GLenum unit) { glActiveTexture(unit); }
+void GLDirectBackend::BindTexture(GLenum target, GLuint texture) { glBindTexture(target, texture); }
+
+void GLDirectBackend::TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                                 GLenum format, GLenum type, const void* pixels)
+{
+    glTexImage2D(target, level, internalFormat, width, height, 0, format, type, pixels);
+}
+
+void GLDirectBackend::TexParameteri(GLenum target, GLenum pname, GLint value) { glTexParameteri(target, pname, value); }
+void GLDirectBackend::GenerateMipmap(GLenum target) { glGenerateMipmap(target); }
+void GLDirectBackend::TexBuffer(GLenum target, GLenum internalFormat, GLuint buffer) { glTexBuffer(target, internalFormat, buffer); }
+
+void GLDirectBackend::Enable(GLenum cap) { glEnable(cap); }
+void GLDirectBackend::Disable(GLenum cap) { glDisable(cap); }
+void GLDirectBackend::DepthMask(GLboolean flag) { glDepthMask(flag); }
+void GLDirectBackend::BlendFunc(GLenum sfactor, GLenum dfactor) { glBlendFunc(sfactor, dfactor); }
+void GLDirectBackend::DepthFunc(GLenum func) { glDepthFunc(func); }
+void GLDirectBackend::CullFace(GLenum mode) { glCullFace(mode); }
+void GLDirectBackend::FrontFace(GLenum mode) { glFrontFace(mode); }
+void GLDirectBackend::ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { glClearColor(red, green, blue, alpha); }
+void GLDirectBackend::Clear(GLbitfield mask) { glClear(mask); }
+
+void GLDirectBackend::DrawArrays(GLenum mode, GLint first, GLsizei count) { glDrawArrays(mode, first, count); }
+
+void GLDirectBackend::DrawElements(GLenum mode, GLsizei count, GLenum type, uintptr_t offset)
+{
+    glDrawElements(mode, count, type, (const void*)offset);
+}
+
+void GLDirectBackend::DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount)
+{
+    glDrawArraysInstanced(mode, first, count, instanceCount);
+}
+
+void GLDirectBackend::DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, uintptr_t offset, GLsizei instanceCount)
+{
+    glDrawElementsInstanced(mode, count, type, (const void*)offset, instanceCount);
+}
+
+void GLDirectBackend::DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, uintptr_t offset,
+                                                      GLsizei instanceCount, GLint baseVertex)
+{
+    glDrawElementsInstancedBaseVertex(mode, count, type, (void*)offset, instanceCount, baseVertex);
+}
+
+GLuint GLDirectBackend::GenFramebuffer(void)
+{
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    return framebuffer;
+}
+
+void GLDirectBackend::DeleteFramebuffer(GLuint framebuffer) { glDeleteFramebuffers(1, &framebuffer); }
+void GLDirectBackend::BindFramebuffer(GLenum target, GLuint framebuffer) { glBindFramebuffer(target, framebuffer); }
+GLenum GLDirectBackend::CheckFramebufferStatus(GLenum target) { return glCheckFramebufferStatus(target); }
+
+GLuint GLDirectBackend::GenRenderbuffer(void)
+{
+    GLuint renderbuffer = 0;
+    glGenRenderbuffers(1, &renderbuffer);
+    return renderbuffer;
+}
+
+void GLDirectBackend::DeleteRenderbuffer(GLuint renderbuffer) { glDeleteRenderbuffers(1, &renderbuffer); }
+void GLDirectBackend::BindRenderbuffer(GLenum target, GLuint renderbuffer) { glBindRenderbuffer(target, renderbuffer); }
+
+void GLDirectBackend::RenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+    glRenderbufferStorage(target, internalFormat, width, height);
+}
+
+void GLDirectBackend::FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer)
+{
+    glFramebufferRenderbuffer(target, attachment, renderbufferTarget, renderbuffer);
+}
+
+void GLDirectBackend::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { glViewport(x, y, width, height); }
+
+void GLDirectBackend::ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels)
+{
+    glReadPixels(x, y, width, height, format, type, pixels);
+}
+
+void GLDirectBackend::Flush(void) { glFlush(); }
+void GLDirectBackend::Finish(void) { glFinish(); }
+
+GLuint GLDirectBackend::GenQuery(void)
+{
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    return query;
+}
+
+void GLDirectBackend::DeleteQuery(GLuint query) { glDeleteQueries(1, &query); }
+void GLDirectBackend::BeginQuery(GLenum target, GLuint query) { glBeginQuery(target, query); }
+void GLDirectBackend::EndQuery(GLenum target) { glEndQuery(target); }
+void GLDirectBackend::QueryCounter(GLuint query, GLenum target) { glQueryCounter(query, target); }
+
+bool GLDirectBackend::QueryResultAvailable(GLuint query)
+{
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    return available != 0;
+}
+
+GLuint64 GLDirectBackend::QueryResult(GLuint query)
+{
+    GLuint64 result = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &result);
+    return result;
+}
+
+GLsync GLDirectBackend::FenceSync(void) { return glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0); }
+GLenum GLDirectBackend::ClientWaitSync(GLsync sync, GLuint64 timeout) { return glClientWaitSync(sync, GL_SYNC_FLUSH_COMMANDS_BIT, timeout); }
+void GLDirectBackend::DeleteSync(GLsync sync) { glDeleteSync(sync); }
+
+
+// Reads back what Record wrote, in the same order.
+class CommandReader {
+private:
+    const uint8_t* mAt;
+
+public:
+    explicit CommandReader(const uint8_t* at) : mAt(at) {}
+
+    template<typename T> T Next(void)
+    {
+        T value;
+        memcpy(&value, mAt, sizeof(T));
+        mAt += sizeof(T);
+        return value;
+    }
+
+    std::string Text(void)
+    {
+        uint16_t length = Next<uint16_t>();
+        std::string text((const char*)mAt, length);
+        mAt += length;
+        return text;
+    }
+};
+
+template<typename... Args> void GLNullBackend::Record(GLCommand command, Args... args)
+{
+    constexpr size_t argBytes = (sizeof(Args) + ... + 0);
+    static_assert(argBytes <= 0xFFFF, "command arguments do not fit the size field");
+
+    size_t at = mCommands.size();
+    mCommands.resize(at + kHeaderBytes + argBytes);
+    uint8_t* write = &mCommands[at];
+    write[0] = command;
+    uint16_t size = (uint16_t)argBytes;
+    memcpy(write + 1, &size, sizeof(size));
+    write += kHeaderBytes;
+    ((memcpy(write, &args, sizeof(args)), write += sizeof(args)), ...);
+    mCommandCount++;
+    mLastCommand = at;
+}
+
+void GLNullBackend::RecordText(const char* text)
+{
+    uint16_t length = (uint16_t)TMin<size_t>(strlen(text), 0xFFFF - sizeof(uint16_t));
+    const uint8_t* lengthBytes = (const uint8_t*)&length;
+    mCommands.insert(mCommands.end(), lengthBytes, lengthBytes + sizeof(length));
+    mCommands.insert(mCommands.end(), (const uint8_t*)text, (const uint8_t*)text + length);
+
+    uint16_t size;
+    memcpy(&size, &mCommands[mLastCommand + 1], sizeof(size));
+    size += sizeof(length) + length;
+    memcpy(&mCommands[mLastCommand + 1], &size, sizeof(size));
+}
+
+int GLNullBackend::CountCommands(GLCommand command) const
+{
+    int count = 0;
+    size_t at = 0;
+    while(at < mCommands.size()) {
+        uint16_t size;
+        memcpy(&size, &mCommands[at + 1], sizeof(size));
+        count += (mCommands[at] == command);
+        at += kHeaderBytes + size;
+    }
+    return count;
+}
+
+void GLNullBackend::Discard(void)
+{
+    mCommands.clear();
+    mCommandCount = 0;
+}
+
+void GLNullBackend::Replay(GLBackend& target) const
+{
+    // what the recording handed out, to what the target returned for the same call.
+    std::map<GLuint, GLuint> names;
+    std::map<uintptr_t, GLsync> syncs;
+    auto name = [&](GLuint recorded) {
+        auto found = names.find(recorded);
+        return found != names.end() ? found->second : recorded;
+    };
+    auto sync = [&](uintptr_t recorded) {
+        auto found = syncs.find(recorded);
+        return found != syncs.end() ? found->second : (GLsync)recorded;
+    };
+
+    size_t at = 0;
+    while(at < mCommands.size()) {
+        GLCommand command = (GLCommand)mCommands[at];
+        uint16_t size;
+        memcpy(&size, &mCommands[at + 1], sizeof(size));
+        CommandReader in(&mCommands[at + kHeaderBytes]);
+        at += kHeaderBytes + size;
+
+        switch(command) {
+            case kCmdCreateProgram: {
+                GLuint recorded = in.Next<GLuint>();
+                std::string vertexShaderPath = in.Text();
+                std::string fragmentShaderPath = in.Text();
+                GLuint program = 0;
+                target.CreateProgram(program, vertexShaderPath.c_str(), fragmentShaderPath.c_str());
+                names[recorded] = program;
+                break;
+            }
+            case kCmdDeleteProgram: target.DeleteProgram(name(in.Next<GLuint>())); break;
+            case kCmdUseProgram: target.UseProgram(name(in.Next<GLuint>())); break;
+            case kCmdGetUniformLocation: {
+                GLuint program = in.Next<GLuint>();
+                GLint recorded = in.Next<GLint>();
+                names[(GLuint)recorded] = (GLuint)target.GetUniformLocation(name(program), in.Text().c_str());
+                break;
+            }
+            case kCmdGetUniformBlockIndex: {
+                GLuint program = in.Next<GLuint>();
+                GLuint recorded = in.Next<GLuint>();
+                names[recorded] = target.GetUniformBlockIndex(name(program), in.Text().c_str());
+                break;
+            }
+            case kCmdUniformBlockBinding: {
+                GLuint program = in.Next<GLuint>();
+                GLuint blockIndex = in.Next<GLuint>();
+                target.UniformBlockBinding(name(program), name(blockIndex), in.Next<GLuint>());
+                break;
+            }
+            case kCmdGetActiveUniformBlockiv: {
+                GLuint program = in.Next<GLuint>();
+                GLuint blockIndex = in.Next<GLuint>();
+                GLint value = 0;
+                target.GetActiveUniformBlockiv(name(program), name(blockIndex), in.Next<GLenum>(), &value);
+                break;
+            }
+            case kCmdUniform1i: {
+                GLint location = (GLint)name((GLuint)in.Next<GLint>());
+                target.Uniform1i(location, in.Next<GLint>());
+                break;
+            }
+            case kCmdGetIntegerv: {
+                GLint value = 0;
+                target.GetIntegerv(in.Next<GLenum>(), &value);
+                break;
+            }
+            case kCmdGenBuffer: {
+                GLuint recorded = in.Next<GLuint>();
+                names[recorded] = target.GenBuffer();
+                break;
+            }
+            case kCmdDeleteBuffer: target.DeleteBuffer(name(in.Next<GLuint>())); break;
+            case kCmdBindBuffer: {
+                GLenum bufferTarget = in.Next<GLenum>();
+                target.BindBuffer(bufferTarget, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdBindBufferBase: {
+                GLenum bufferTarget = in.Next<GLenum>();
+                GLuint index = in.Next<GLuint>();
+                target.BindBufferBase(bufferTarget, index, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdBindBufferRange: {
+                GLenum bufferTarget = in.Next<GLenum>();
+                GLuint index = in.Next<GLuint>();
+                GLuint buffer = name(in.Next<GLuint>());
+                GLintptr offset = in.Next<GLintptr>();
+                target.BindBufferRange(bufferTarget, index, buffer, offset, in.Next<GLsizeiptr>());
+                break;
+            }
+            case kCmdBufferData: {
+                GLenum bufferTarget = in.Next<GLenum>();
+                GLsizeiptr bytes = in.Next<GLsizeiptr>();
+                target.BufferData(bufferTarget, bytes, nullptr, in.Next<GLenum>());
+                break;
+            }
+            case kCmdBufferSubData: {
+                // without the data there is nothing to write.
+                break;
+            }
+            case kCmdMapBufferRange: {
+                GLenum bufferTarget = in.Next<GLenum>();
+                GLintptr offset = in.Next<GLintptr>();
+                GLsizeiptr length = in.Next<GLsizeiptr>();
+                target.MapBufferRange(bufferTarget, offset, length, in.Next<GLbitfield>());
+                break;
+            }
+            case kCmdUnmapBuffer: target.UnmapBuffer(in.Next<GLenum>()); break;
+            case kCmdCopyBufferSubData: {
+                GLenum readTarget = in.Next<GLenum>();
+                GLenum writeTarget = in.Next<GLenum>();
+                GLintptr readOffset = in.Next<GLintptr>();
+                GLintptr writeOffset = in.Next<GLintptr>();
+                target.CopyBufferSubData(readTarget, writeTarget, readOffset, writeOffset, in.Next<GLsizeiptr>());
+                break;
+            }
+            case kCmdGenVertexArray: {
+                GLuint recorded = in.Next<GLuint>();
+                names[recorded] = target.GenVertexArray();
+                break;
+            }
+            case kCmdDeleteVertexArray: target.DeleteVertexArray(name(in.Next<GLuint>())); break;
+            case kCmdBindVertexArray: target.BindVertexArray(name(in.Next<GLuint>())); break;
+            case kCmdEnableVertexAttribArray: target.EnableVertexAttribArray(in.Next<GLuint>()); break;
+            case kCmdDisableVertexAttribArray: target.DisableVertexAttribArray(in.Next<GLuint>()); break;
+            case kCmdVertexAttribPointer: {
+                GLuint index = in.Next<GLuint>();
+                GLint components = in.Next<GLint>();
+                GLenum type = in.Next<GLenum>();
+                GLboolean normalized = in.Next<GLboolean>();
+                GLsizei stride = in.Next<GLsizei>();
+                target.VertexAttribPointer(index, components, type, normalized, stride, in.Next<uintptr_t>());
+                break;
+            }
+            case kCmdVertexAttribDivisor: {
+                GLuint index = in.Next<GLuint>();
+                target.VertexAttribDivisor(index, in.Next<GLuint>());
+                break;
+            }
+            case kCmdGenTexture: {
+                GLuint recorded = in.Next<GLuint>();
+                names[recorded] = target.GenTexture();
+                break;
+            }
+            case kCmdDeleteTexture: target.DeleteTexture(name(in.Next<GLuint>())); break;
+            case kCmdActiveTexture: target.ActiveTexture(in.Next<GLenum>()); break;
+            case kCmdBindTexture: {
+                GLenum textureTarget = in.Next<GLenum>();
+                target.BindTexture(textureTarget, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdTexImage2D: {
+                GLenum textureTarget = in.Next<GLenum>();
+                GLint level = in.Next<GLint>();
+                GLint internalFormat = in.Next<GLint>();
+                GLsizei width = in.Next<GLsizei>();
+                GLsizei height = in.Next<GLsizei>();
+                GLenum format = in.Next<GLenum>();
+                target.TexImage2D(textureTarget, level, internalFormat, width, height, format, in.Next<GLenum>(), nullptr);
+                break;
+            }
+            case kCmdTexParameteri: {
+                GLenum textureTarget = in.Next<GLenum>();
+                GLenum pname = in.Next<GLenum>();
+                target.TexParameteri(textureTarget, pname, in.Next<GLint>());
+                break;
+            }
+            case kCmdGenerateMipmap: target.GenerateMipmap(in.Next<GLenum>()); break;
+            case kCmdTexBuffer: {
+                GLenum textureTarget = in.Next<GLenum>();
+                GLenum internalFormat = in.Next<GLenum>();
+                target.TexBuffer(textureTarget, internalFormat, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdEnable: target.Enable(in.Next<GLenum>()); break;
+            case kCmdDisable: target.Disable(in.Next<GLenum>()); break;
+            case kCmdDepthMask: target.DepthMask(in.Next<GLboolean>()); break;
+            case kCmdBlendFunc: {
+                GLenum sfactor = in.Next<GLenum>();
+                target.BlendFunc(sfactor, in.Next<GLenum>());
+                break;
+            }
+            case kCmdDepthFunc: target.DepthFunc(in.Next<GLenum>()); break;
+            case kCmdCullFace: target.CullFace(in.Next<GLenum>()); break;
+            case kCmdFrontFace: target.FrontFace(in.Next<GLenum>()); break;
+            case kCmdClearColor: {
+                GLfloat red = in.Next<GLfloat>();
+                GLfloat green = in.Next<GLfloat>();
+                GLfloat blue = in.Next<GLfloat>();
+                target.ClearColor(red, green, blue, in.Next<GLfloat>());
+                break;
+            }
+            case kCmdClear: target.Clear(in.Next<GLbitfield>()); break;
+            case kCmdDrawArrays: {
+                GLenum mode = in.Next<GLenum>();
+                GLint first = in.Next<GLint>();
+                target.DrawArrays(mode, first, in.Next<GLsizei>());
+                break;
+            }
+            case kCmdDrawElements: {
+                GLenum mode = in.Next<GLenum>();
+                GLsizei count = in.Next<GLsizei>();
+                GLenum type = in.Next<GLenum>();
+                target.DrawElements(mode, count, type, in.Next<uintptr_t>());
+                break;
+            }
+            case kCmdDrawArraysInstanced: {
+                GLenum mode = in.Next<GLenum>();
+                GLint first = in.Next<GLint>();
+                GLsizei count = in.Next<GLsizei>();
+                target.DrawArraysInstanced(mode, first, count, in.Next<GLsizei>());
+                break;
+            }
+            case kCmdDrawElementsInstanced: {
+                GLenum mode = in.Next<GLenum>();
+                GLsizei count = in.Next<GLsizei>();
+                GLenum type = in.Next<GLenum>();
+                uintptr_t offset = in.Next<uintptr_t>();
+                target.DrawElementsInstanced(mode, count, type, offset, in.Next<GLsizei>());
+                break;
+            }
+            case kCmdDrawElementsInstancedBaseVertex: {
+                GLenum mode = in.Next<GLenum>();
+                GLsizei count = in.Next<GLsizei>();
+                GLenum type = in.Next<GLenum>();
+                uintptr_t offset = in.Next<uintptr_t>();
+                GLsizei instanceCount = in.Next<GLsizei>();
+                target.DrawElementsInstancedBaseVertex(mode, count, type, offset, instanceCount, in.Next<GLint>());
+                break;
+            }
+            case kCmdGenFramebuffer: {
+                GLuint recorded = in.Next<GLuint>();
+                names[recorded] = target.GenFramebuffer();
+                break;
+            }
+            case kCmdDeleteFramebuffer: target.DeleteFramebuffer(name(in.Next<GLuint>())); break;
+            case kCmdBindFramebuffer: {
+                GLenum framebufferTarget = in.Next<GLenum>();
+                target.BindFramebuffer(framebufferTarget, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdCheckFramebufferStatus: target.CheckFramebufferStatus(in.Next<GLenum>()); break;
+            case kCmdGenRenderbuffer: {
+                GLuint recorded = in.Next<GLuint>();
+                names[recorded] = target.GenRenderbuffer();
+                break;
+            }
+            case kCmdDeleteRenderbuffer: target.DeleteRenderbuffer(name(in.Next<GLuint>())); break;
+            case kCmdBindRenderbuffer: {
+                GLenum renderbufferTarget = in.Next<GLenum>();
+                target.BindRenderbuffer(renderbufferTarget, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdRenderbufferStorage: {
+                GLenum renderbufferTarget = in.Next<GLenum>();
+                GLenum internalFormat = in.Next<GLenum>();
+                GLsizei width = in.Next<GLsizei>();
+                target.RenderbufferStorage(renderbufferTarget, internalFormat, width, in.Next<GLsizei>());
+                break;
+            }
+            case kCmdFramebufferRenderbuffer: {
+                GLenum framebufferTarget = in.Next<GLenum>();
+                GLenum attachment = in.Next<GLenum>();
+                GLenum renderbufferTarget = in.Next<GLenum>();
+                target.FramebufferRenderbuffer(framebufferTarget, attachment, renderbufferTarget, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdViewport: {
+                GLint x = in.Next<GLint>();
+                GLint y = in.Next<GLint>();
+                GLsizei width = in.Next<GLsizei>();
+                target.Viewport(x, y, width, in.Next<GLsizei>());
+                break;
+            }
+            case kCmdReadPixels: {
+                // nowhere to put the pixels.
+                break;
+            }
+            case kCmdFlush: target.Flush(); break;
+            case kCmdFinish: target.Finish(); break;
+            case kCmdGenQuery: {
+                GLuint recorded = in.Next<GLuint>();
+                names[recorded] = target.GenQuery();
+                break;
+            }
+            case kCmdDeleteQuery: target.DeleteQuery(name(in.Next<GLuint>())); break;
+            case kCmdBeginQuery: {
+                GLenum queryTarget = in.Next<GLenum>();
+                target.BeginQuery(queryTarget, name(in.Next<GLuint>()));
+                break;
+            }
+            case kCmdEndQuery: target.EndQuery(in.Next<GLenum>()); break;
+            case kCmdQueryCounter: {
+                GLuint query = name(in.Next<GLuint>());
+                target.QueryCounter(query, in.Next<GLenum>());
+                break;
+            }
+            case kCmdQueryResultAvailable: target.QueryResultAvailable(name(in.Next<GLuint>())); break;
+            case kCmdQueryResult: target.QueryResult(name(in.Next<GLuint>())); break;
+            case kCmdFenceSync: {
+                uintptr_t recorded = in.Next<uintptr_t>();
+                syncs[recorded] = target.FenceSync();
+                break;
+            }
+            case kCmdClientWaitSync: {
+                GLsync waitOn = sync(in.Next<uintptr_t>());
+                target.ClientWaitSync(waitOn, in.Next<GLuint64>());
+                break;
+            }
+            case kCmdDeleteSync: {
+                uintptr_t recorded = in.Next<uintptr_t>();
+                target.DeleteSync(sync(recorded));
+                syncs.erase(recorded);
+                break;
+            }
+            case kNumGLCommands:
+                break;
+        }
+    }
+}
+
+bool GLNullBackend::CreateProgram(GLuint& program, const char* vertexShaderPath, const char* fragmentShaderPath)
+{
+    program = mNextName++;
+    Record(kCmdCreateProgram, program);
+    RecordText(vertexShaderPath);
+    RecordText(fragmentShaderPath);
+    return true;
+}
+
+void GLNullBackend::DeleteProgram(GLuint program) { Record(kCmdDeleteProgram, program); }
+void GLNullBackend::UseProgram(GLuint program) { Record(kCmdUseProgram, program); }
+
+GLint GLNullBackend::GetUniformLocation(GLuint program, const char* name)
+{
+    GLint location = (GLint)mNextName++;
+    Record(kCmdGetUniformLocation, program, location);
+    RecordText(name);
+    return location;
+}
+
+GLuint GLNullBackend::GetUniformBlockIndex(GLuint program, const char* name)
+{
+    GLuint blockIndex = mNextName++;
+    Record(kCmdGetUniformBlockIndex, program, blockIndex);
+    RecordText(name);
+    return blockIndex;
+}
+
+void GLNullBackend::UniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding)
+{
+    Record(kCmdUniformBlockBinding, program, blockIndex, binding);
+}
+
+void GLNullBackend::GetActiveUniformBlockiv(GLuint program, GLuint blockIndex, GLenum pname, GLint* value)
+{
+    Record(kCmdGetActiveUniformBlockiv, program, blockIndex, pname);
+    *value = 0;
+}
+
+void GLNullBackend::Uniform1i(GLint location, GLint value) { Record(kCmdUniform1i, location, value); }
+
+void GLNullBackend::GetIntegerv(GLenum pname, GLint* value)
+{
+    Record(kCmdGetIntegerv, pname);
+    // the largest alignment drivers report, so uniform buffer layouts are the worst case.
+    *value = (pname == GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT) ? 256 : 0;
+}
+
+GLuint GLNullBackend::GenBuffer(void)
+{
+    GLuint buffer = mNextName++;
+    Record(kCmdGenBuffer, buffer);
+    return buffer;
+}
+
+void GLNullBackend::DeleteBuffer(GLuint buffer) { Record(kCmdDeleteBuffer, buffer); }
+void GLNullBackend::BindBuffer(GLenum target, GLuint buffer) { Record(kCmdBindBuffer, target, buffer); }
+void GLNullBackend::BindBufferBase(GLenum target, GLuint index, GLuint buffer) { Record(kCmdBindBufferBase, target, index, buffer); }
+
+void GLNullBackend::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    Record(kCmdBindBufferRange, target, index, buffer, offset, size);
+}
+
+void GLNullBackend::BufferData(GLenum target, GLsizeiptr size, const void* /*data*/, GLenum usage)
+{
+    Record(kCmdBufferData, target, size, usage);
+}
+
+void GLNullBackend::BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* /*data*/)
+{
+    Record(kCmdBufferSubData, target, offset, size);
+}
+
+void* GLNullBackend::MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access)
+{
+    Record(kCmdMapBufferRange, target, offset, length, access);
+    if(mMapScratch.size() < (size_t)length) {
+        mMapScratch.resize(length);
+    }
+    return mMapScratch.data();
+}
+
+void GLNullBackend::UnmapBuffer(GLenum target) { Record(kCmdUnmapBuffer, target); }
+
+void GLNullBackend::CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size)
+{
+    Record(kCmdCopyBufferSubData, readTarget, writeTarget, readOffset, writeOffset, size);
+}
+
+GLuint GLNullBackend::GenVertexArray(void)
+{
+    GLuint vertexArray = mNextName++;
+    Record(kCmdGenVertexArray, vertexArray);
+    return vertexArray;
+}
+
+void GLNullBackend::DeleteVertexArray(GLuint vertexArray) { Record(kCmdDeleteVertexArray, vertexArray); }
+void GLNullBackend::BindVertexArray(GLuint vertexArray) { Record(kCmdBindVertexArray, vertexArray); }
+void GLNullBackend::EnableVertexAttribArray(GLuint index) { Record(kCmdEnableVertexAttribArray, index); }
+void GLNullBackend::DisableVertexAttribArray(GLuint index) { Record(kCmdDisableVertexAttribArray, index); }
+
+void GLNullBackend::VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, uintptr_t offset)
+{
+    Record(kCmdVertexAttribPointer, index, size, type, normalized, stride, offset);
+}
+
+void GLNullBackend::VertexAttribDivisor(GLuint index, GLuint divisor) { Record(kCmdVertexAttribDivisor, index, divisor); }
+
+GLuint GLNullBackend::GenTexture(void)
+{
+    GLuint texture = mNextName++;
+    Record(kCmdGenTexture, texture);
+    return texture;
+}
+
+void GLNullBackend::DeleteTexture(GLuint texture) { Record(kCmdDeleteTexture, texture); }
+void GLNullBackend::ActiveTexture(GLenum unit) { Record(kCmdActiveTexture, unit); }
+void GLNullBackend::BindTexture(GLenum target, GLuint texture) { Record(kCmdBindTexture, target, texture); }
+
+void GLNullBackend::TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                               GLenum format, GLenum type, const void* /*pixels*/)
+{
+    Record(kCmdTexImage2D, target, level, internalFormat, width, height, format, type);
+}
+
+void GLNullBackend::TexParameteri(GLenum target, GLenum pname, GLint value) { Record(kCmdTexParameteri, target, pname, value); }
+void GLNullBackend::GenerateMipmap(GLenum target) { Record(kCmdGenerateMipmap, target); }
+void GLNullBackend::TexBuffer(GLenum target, GLenum internalFormat, GLuint buffer) { Record(kCmdTexBuffer, target, internalFormat, buffer); }
+
+void GLNullBackend::Enable(GLenum cap) { Record(kCmdEnable, cap); }
+void GLNullBackend::Disable(GLenum cap) { Record(kCmdDisable, cap); }
+void GLNullBackend::DepthMask(GLboolean flag) { Record(kCmdDepthMask, flag); }
+void GLNullBackend::BlendFunc(GLenum sfactor, GLenum dfactor) { Record(kCmdBlendFunc, sfactor, dfactor); }
+void GLNullBackend::DepthFunc(GLenum func) { Record(kCmdDepthFunc, func); }
+void GLNullBackend::CullFace(GLenum mode) { Record(kCmdCullFace, mode); }
+void GLNullBackend::FrontFace(GLenum mode) { Record(kCmdFrontFace, mode); }
+void GLNullBackend::ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) { Record(kCmdClearColor, red, green, blue, alpha); }
+void GLNullBackend::Clear(GLbitfield mask) { Record(kCmdClear, mask); }
+
+void GLNullBackend::DrawArrays(GLenum mode, GLint first, GLsizei count) { Record(kCmdDrawArrays, mode, first, count); }
+
+void GLNullBackend::DrawElements(GLenum mode, GLsizei count, GLenum type, uintptr_t offset)
+{
+    Record(kCmdDrawElements, mode, count, type, offset);
+}
+
+void GLNullBackend::DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount)
+{
+    Record(kCmdDrawArraysInstanced, mode, first, count, instanceCount);
+}
+
+void GLNullBackend::DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, uintptr_t offset, GLsizei instanceCount)
+{
+    Record(kCmdDrawElementsInstanced, mode, count, type, offset, instanceCount);
+}
+
+void GLNullBackend::DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, uintptr_t offset,
+                                                    GLsizei instanceCount, GLint baseVertex)
+{
+    Record(kCmdDrawElementsInstancedBaseVertex, mode, count, type, offset, instanceCount, baseVertex);
+}
+
+GLuint GLNullBackend::GenFramebuffer(void)
+{
+    GLuint framebuffer = mNextName++;
+    Record(kCmdGenFramebuffer, framebuffer);
+    return framebuffer;
+}
+
+void GLNullBackend::DeleteFramebuffer(GLuint framebuffer) { Record(kCmdDeleteFramebuffer, framebuffer); }
+void GLNullBackend::BindFramebuffer(GLenum target, GLuint framebuffer) { Record(kCmdBindFramebuffer, target, framebuffer); }
+
+GLenum GLNullBackend::CheckFramebufferStatus(GLenum target)
+{
+    Record(kCmdCheckFramebufferStatus, target);
+    return GL_FRAMEBUFFER_COMPLETE;
+}
+
+GLuint GLNullBackend::GenRenderbuffer(void)
+{
+    GLuint renderbuffer = mNextName++;
+    Record(kCmdGenRenderbuffer, renderbuffer);
+    return renderbuffer;
+}
+
+void GLNullBackend::DeleteRenderbuffer(GLuint renderbuffer) { Record(kCmdDeleteRenderbuffer, renderbuffer); }
+void GLNullBackend::BindRenderbuffer(GLenum target, GLuint renderbuffer) { Record(kCmdBindRenderbuffer, target, renderbuffer); }
+
+void GLNullBackend::RenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height)
+{
+    Record(kCmdRenderbufferStorage, target, internalFormat, width, height);
+}
+
+void GLNullBackend::FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer)
+{
+    Record(kCmdFramebufferRenderbuffer, target, attachment, renderbufferTarget, renderbuffer);
+}
+
+void GLNullBackend::Viewport(GLint x, GLint y, GLsizei width, GLsizei height) { Record(kCmdViewport, x, y, width, height); }
+
+void GLNullBackend::ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* /*pixels*/)
+{
+    Record(kCmdReadPixels, x, y, width, height, format, type);
+}
+
+void GLNullBackend::Flush(void) { Record(kCmdFlush); }
+void GLNullBackend::Finish(void) { Record(kCmdFinish); }
+
+GLuint GLNullBackend::GenQuery(void)
+{
+    GLuint query = mNextName++;
+    Record(kCmdGenQuery, query);
+    return query;
+}
+
+void GLNullBackend::DeleteQuery(GLuint query) { Record(kCmdDeleteQuery, query); }
+void GLNullBackend::BeginQuery(GLenum target, GLuint query) { Record(kCmdBeginQuery, target, query); }
+void GLNullBackend::EndQuery(GLenum target) { Record(kCmdEndQuery, target); }
+void GLNullBackend::QueryCounter(GLuint query, GLenum target) { Record(kCmdQueryCounter, query, target); }
+
+bool GLNullBackend::QueryResultAvailable(GLuint query)
+{
+    Record(kCmdQueryResultAvailable, query);
+    return true;
+}
+
+GLuint64 GLNullBackend::QueryResult(GLuint query)
+{
+    Record(kCmdQueryResult, query);
+    return 0;
+}
+
+GLsync GLNullBackend::FenceSync(void)
+{
+    uintptr_t sync = mNextName++;
+    Record(kCmdFenceSync, sync);
+    return (GLsync)sync;
+}
+
+GLenum GLNullBackend::ClientWaitSync(GLsync sync, GLuint64 timeout)
+{
+    Record(kCmdClientWaitSync, (uintptr_t)sync, timeout);
+    return GL_ALREADY_SIGNALED;
+}
+
+void GLNullBackend::DeleteSync(GLsync sync) { Record(kCmdDeleteSync, (uintptr_t)sync); }
+
+
+bool GLNullBackend::Test(void)
+{
+    GLNullBackend recorded;
+
+    // Names are unique across kinds and never 0.
+    GLuint program = 0;
+    DbgAssert(recorded.CreateProgram(program, "a_vertex_shader.glsl", "a_fragment_shader.glsl"));
+    GLuint buffer = recorded.GenBuffer();
+    GLuint vertexArray = recorded.GenVertexArray();
+    DbgAssert(program != 0 && buffer != program && vertexArray != buffer);
+
+    recorded.UseProgram(program);
+    recorded.BindVertexArray(vertexArray);
+    recorded.BindBuffer(GL_ARRAY_BUFFER, buffer);
+    recorded.BufferData(GL_ARRAY_BUFFER, 1024, nullptr, GL_STATIC_DRAW);
+    recorded.DrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    recorded.DrawElements(GL_TRIANGLES, 12, GL_UNSIGNED_INT, 48);
+    GLsync fence = recorded.FenceSync();
+    DbgAssert(recorded.ClientWaitSync(fence, 0) == GL_ALREADY_SIGNALED);
+    recorded.DeleteSync(fence);
+
+    GLint alignment = 0;
+    recorded.GetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    DbgAssert(alignment == 256);
+
+    // Mapped ranges are writable.
+    float* mapped = (float*)recorded.MapBufferRange(GL_UNIFORM_BUFFER, 0, 64 * sizeof(float), GL_MAP_WRITE_BIT);
+    mapped[63] = 1.0f;
+    recorded.UnmapBuffer(GL_UNIFORM_BUFFER);
+
+    DbgAssert(recorded.CommandCount() == 15);
+    DbgAssert(recorded.CountCommands(kCmdDrawElements) == 2);
+    DbgAssert(recorded.CountCommands(kCmdCreateProgram) == 1);
+    DbgAssert(recorded.CountCommands(kCmdClear) == 0);
+
+    // Replaying onto a backend that has already used some names remaps them,
+    // replaying that onto a fresh one maps them back.
+    GLNullBackend offset;
+    offset.GenTexture();
+    offset.Discard();
+    DbgAssert(offset.CommandCount() == 0 && offset.ByteSize() == 0);
+    recorded.Replay(offset);
+    DbgAssert(offset.CommandCount() == recorded.CommandCount());
+    DbgAssert(offset.ByteSize() == recorded.ByteSize());
+    DbgAssert(offset.mCommands != recorded.mCommands);
+
+    GLNullBackend fresh;
+    offset.Replay(fresh);
+    DbgAssert(fresh.mCommands == recorded.mCommands);
+
+    recorded.Discard();
+    DbgAssert(recorded.CommandCount() == 0 && recorded.CountCommands(kCmdDrawElements) == 0);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,395 @@
+//
+//  gl_backend.h
+//  opengl_setup_example
+//
+
+#ifndef gl_backend_hpp
+#define gl_backend_hpp
+
+#include <vector>
+#include <cstdint>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+
+// Every GL call the scene setup and frame loop make, behind an interface so they
+// can go to the driver or to a stand-in that runs without a GPU.
+// Names follow GL without the gl prefix. Object creation returns one name at a time.
+class GLBackend {
+public:
+    virtual ~GLBackend() {}
+
+    // Compiles and links the two shader files. False if either fails.
+    virtual bool CreateProgram(GLuint& program, const char* vertexShaderPath, const char* fragmentShaderPath) = 0;
+    virtual void DeleteProgram(GLuint program) = 0;
+    virtual void UseProgram(GLuint program) = 0;
+    virtual GLint GetUniformLocation(GLuint program, const char* name) = 0;
+    virtual GLuint GetUniformBlockIndex(GLuint program, const char* name) = 0;
+    virtual void UniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding) = 0;
+    virtual void GetActiveUniformBlockiv(GLuint program, GLuint blockIndex, GLenum pname, GLint* value) = 0;
+    virtual void Uniform1i(GLint location, GLint value) = 0;
+    virtual void GetIntegerv(GLenum pname, GLint* value) = 0;
+
+    virtual GLuint GenBuffer(void) = 0;
+    virtual void DeleteBuffer(GLuint buffer) = 0;
+    virtual void BindBuffer(GLenum target, GLuint buffer) = 0;
+    virtual void BindBufferBase(GLenum target, GLuint index, GLuint buffer) = 0;
+    virtual void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) = 0;
+    virtual void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) = 0;
+    virtual void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) = 0;
+    virtual void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) = 0;
+    virtual void UnmapBuffer(GLenum target) = 0;
+    virtual void CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) = 0;
+
+    virtual GLuint GenVertexArray(void) = 0;
+    virtual void DeleteVertexArray(GLuint vertexArray) = 0;
+    virtual void BindVertexArray(GLuint vertexArray) = 0;
+    virtual void EnableVertexAttribArray(GLuint index) = 0;
+    virtual void DisableVertexAttribArray(GLuint index) = 0;
+    // offset is the byte offset into the bound GL_ARRAY_BUFFER.
+    virtual void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, uintptr_t offset) = 0;
+    virtual void VertexAttribDivisor(GLuint index, GLuint divisor) = 0;
+
+    virtual GLuint GenTexture(void) = 0;
+    virtual void DeleteTexture(GLuint texture) = 0;
+    virtual void ActiveTexture(GLenum unit) = 0;
+    virtual void BindTexture(GLenum target, GLuint texture) = 0;
+    virtual void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                            GLenum format, GLenum type, const void* pixels) = 0;
+    virtual void TexParameteri(GLenum target, GLenum pname, GLint value) = 0;
+    virtual void GenerateMipmap(GLenum target) = 0;
+    virtual void TexBuffer(GLenum target, GLenum internalFormat, GLuint buffer) = 0;
+
+    virtual void Enable(GLenum cap) = 0;
+    virtual void Disable(GLenum cap) = 0;
+    virtual void DepthMask(GLboolean flag) = 0;
+    virtual void BlendFunc(GLenum sfactor, GLenum dfactor) = 0;
+    virtual void DepthFunc(GLenum func) = 0;
+    virtual void CullFace(GLenum mode) = 0;
+    virtual void FrontFace(GLenum mode) = 0;
+    virtual void ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) = 0;
+    virtual void Clear(GLbitfield mask) = 0;
+
+    // offset is the byte offset into the bound GL_ELEMENT_ARRAY_BUFFER.
+    virtual void DrawArrays(GLenum mode, GLint first, GLsizei count) = 0;
+    virtual void DrawElements(GLenum mode, GLsizei count, GLenum type, uintptr_t offset) = 0;
+    virtual void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) = 0;
+    virtual void DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, uintptr_t offset, GLsizei instanceCount) = 0;
+    virtual void DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, uintptr_t offset,
+                                                 GLsizei instanceCount, GLint baseVertex) = 0;
+
+    virtual GLuint GenFramebuffer(void) = 0;
+    virtual void DeleteFramebuffer(GLuint framebuffer) = 0;
+    virtual void BindFramebuffer(GLenum target, GLuint framebuffer) = 0;
+    virtual GLenum CheckFramebufferStatus(GLenum target) = 0;
+    virtual GLuint GenRenderbuffer(void) = 0;
+    virtual void DeleteRenderbuffer(GLuint renderbuffer) = 0;
+    virtual void BindRenderbuffer(GLenum target, GLuint renderbuffer) = 0;
+    virtual void RenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height) = 0;
+    virtual void FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer) = 0;
+    virtual void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) = 0;
+    virtual void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) = 0;
+    virtual void Flush(void) = 0;
+    virtual void Finish(void) = 0;
+
+    virtual GLuint GenQuery(void) = 0;
+    virtual void DeleteQuery(GLuint query) = 0;
+    virtual void BeginQuery(GLenum target, GLuint query) = 0;
+    virtual void EndQuery(GLenum target) = 0;
+    virtual void QueryCounter(GLuint query, GLenum target) = 0;
+    // GL_QUERY_RESULT_AVAILABLE without waiting.
+    virtual bool QueryResultAvailable(GLuint query) = 0;
+    // GL_QUERY_RESULT, waits for the GPU if it is not available yet.
+    virtual GLuint64 QueryResult(GLuint query) = 0;
+
+    virtual GLsync FenceSync(void) = 0;
+    virtual GLenum ClientWaitSync(GLsync sync, GLuint64 timeout) = 0;
+    virtual void DeleteSync(GLsync sync) = 0;
+};
+
+// Straight through to GL.
+class GLDirectBackend : public GLBackend {
+public:
+    bool CreateProgram(GLuint& program, const char* vertexShaderPath, const char* fragmentShaderPath) override;
+    void DeleteProgram(GLuint program) override;
+    void UseProgram(GLuint program) override;
+    GLint GetUniformLocation(GLuint program, const char* name) override;
+    GLuint GetUniformBlockIndex(GLuint program, const char* name) override;
+    void UniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding) override;
+    void GetActiveUniformBlockiv(GLuint program, GLuint blockIndex, GLenum pname, GLint* value) override;
+    void Uniform1i(GLint location, GLint value) override;
+    void GetIntegerv(GLenum pname, GLint* value) override;
+
+    GLuint GenBuffer(void) override;
+    void DeleteBuffer(GLuint buffer) override;
+    void BindBuffer(GLenum target, GLuint buffer) override;
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer) override;
+    void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+    void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+    void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+    void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+    void UnmapBuffer(GLenum target) override;
+    void CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) override;
+
+    GLuint GenVertexArray(void) override;
+    void DeleteVertexArray(GLuint vertexArray) override;
+    void BindVertexArray(GLuint vertexArray) override;
+    void EnableVertexAttribArray(GLuint index) override;
+    void DisableVertexAttribArray(GLuint index) override;
+    void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, uintptr_t offset) override;
+    void VertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+    GLuint GenTexture(void) override;
+    void DeleteTexture(GLuint texture) override;
+    void ActiveTexture(GLenum unit) override;
+    void BindTexture(GLenum target, GLuint texture) override;
+    void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                    GLenum format, GLenum type, const void* pixels) override;
+    void TexParameteri(GLenum target, GLenum pname, GLint value) override;
+    void GenerateMipmap(GLenum target) override;
+    void TexBuffer(GLenum target, GLenum internalFormat, GLuint buffer) override;
+
+    void Enable(GLenum cap) override;
+    void Disable(GLenum cap) override;
+    void DepthMask(GLboolean flag) override;
+    void BlendFunc(GLenum sfactor, GLenum dfactor) override;
+    void DepthFunc(GLenum func) override;
+    void CullFace(GLenum mode) override;
+    void FrontFace(GLenum mode) override;
+    void ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) override;
+    void Clear(GLbitfield mask) override;
+
+    void DrawArrays(GLenum mode, GLint first, GLsizei count) override;
+    void DrawElements(GLenum mode, GLsizei count, GLenum type, uintptr_t offset) override;
+    void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) override;
+    void DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, uintptr_t offset, GLsizei instanceCount) override;
+    void DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, uintptr_t offset,
+                                         GLsizei instanceCount, GLint baseVertex) override;
+
+    GLuint GenFramebuffer(void) override;
+    void DeleteFramebuffer(GLuint framebuffer) override;
+    void BindFramebuffer(GLenum target, GLuint framebuffer) override;
+    GLenum CheckFramebufferStatus(GLenum target) override;
+    GLuint GenRenderbuffer(void) override;
+    void DeleteRenderbuffer(GLuint renderbuffer) override;
+    void BindRenderbuffer(GLenum target, GLuint renderbuffer) override;
+    void RenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height) override;
+    void FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer) override;
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+    void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) override;
+    void Flush(void) override;
+    void Finish(void) override;
+
+    GLuint GenQuery(void) override;
+    void DeleteQuery(GLuint query) override;
+    void BeginQuery(GLenum target, GLuint query) override;
+    void EndQuery(GLenum target) override;
+    void QueryCounter(GLuint query, GLenum target) override;
+    bool QueryResultAvailable(GLuint query) override;
+    GLuint64 QueryResult(GLuint query) override;
+
+    GLsync FenceSync(void) override;
+    GLenum ClientWaitSync(GLsync sync, GLuint64 timeout) override;
+    void DeleteSync(GLsync sync) override;
+};
+
+// One opcode per backend call.
+enum GLCommand : uint8_t {
+    kCmdCreateProgram,
+    kCmdDeleteProgram,
+    kCmdUseProgram,
+    kCmdGetUniformLocation,
+    kCmdGetUniformBlockIndex,
+    kCmdUniformBlockBinding,
+    kCmdGetActiveUniformBlockiv,
+    kCmdUniform1i,
+    kCmdGetIntegerv,
+    kCmdGenBuffer,
+    kCmdDeleteBuffer,
+    kCmdBindBuffer,
+    kCmdBindBufferBase,
+    kCmdBindBufferRange,
+    kCmdBufferData,
+    kCmdBufferSubData,
+    kCmdMapBufferRange,
+    kCmdUnmapBuffer,
+    kCmdCopyBufferSubData,
+    kCmdGenVertexArray,
+    kCmdDeleteVertexArray,
+    kCmdBindVertexArray,
+    kCmdEnableVertexAttribArray,
+    kCmdDisableVertexAttribArray,
+    kCmdVertexAttribPointer,
+    kCmdVertexAttribDivisor,
+    kCmdGenTexture,
+    kCmdDeleteTexture,
+    kCmdActiveTexture,
+    kCmdBindTexture,
+    kCmdTexImage2D,
+    kCmdTexParameteri,
+    kCmdGenerateMipmap,
+    kCmdTexBuffer,
+    kCmdEnable,
+    kCmdDisable,
+    kCmdDepthMask,
+    kCmdBlendFunc,
+    kCmdDepthFunc,
+    kCmdCullFace,
+    kCmdFrontFace,
+    kCmdClearColor,
+    kCmdClear,
+    kCmdDrawArrays,
+    kCmdDrawElements,
+    kCmdDrawArraysInstanced,
+    kCmdDrawElementsInstanced,
+    kCmdDrawElementsInstancedBaseVertex,
+    kCmdGenFramebuffer,
+    kCmdDeleteFramebuffer,
+    kCmdBindFramebuffer,
+    kCmdCheckFramebufferStatus,
+    kCmdGenRenderbuffer,
+    kCmdDeleteRenderbuffer,
+    kCmdBindRenderbuffer,
+    kCmdRenderbufferStorage,
+    kCmdFramebufferRenderbuffer,
+    kCmdViewport,
+    kCmdReadPixels,
+    kCmdFlush,
+    kCmdFinish,
+    kCmdGenQuery,
+    kCmdDeleteQuery,
+    kCmdBeginQuery,
+    kCmdEndQuery,
+    kCmdQueryCounter,
+    kCmdQueryResultAvailable,
+    kCmdQueryResult,
+    kCmdFenceSync,
+    kCmdClientWaitSync,
+    kCmdDeleteSync,
+    kNumGLCommands
+};
+
+// Makes no GL calls. Each call is appended to a byte buffer as an opcode, the
+// argument byte count and the arguments packed back to back, shader paths and
+// uniform names included. Buffer and texture contents are not kept, so replayed
+// uploads pass null data, sub-range uploads and pixel reads are dropped and mapped
+// ranges are left as the driver hands them out. Framebuffers are always complete,
+// uniform blocks have a size of 0 and queries are always available with a result of 0.
+//
+// Names, syncs and uniform locations come from a counter so setup runs headless.
+// Replay maps the ones created in the recording to what the target returns.
+class GLNullBackend : public GLBackend {
+private:
+    static constexpr size_t kHeaderBytes = 3;
+
+    std::vector<uint8_t> mCommands;
+    size_t mCommandCount;
+    size_t mLastCommand;
+    GLuint mNextName;
+    // mapped ranges point here so the caller's writes land somewhere.
+    std::vector<uint8_t> mMapScratch;
+
+    template<typename... Args> void Record(GLCommand command, Args... args);
+    // appends a string to the last recorded command.
+    void RecordText(const char* text);
+
+public:
+    GLNullBackend() : mCommandCount(0), mLastCommand(0), mNextName(1) {}
+
+    size_t CommandCount(void) const { return mCommandCount; }
+    size_t ByteSize(void) const { return mCommands.size(); }
+    int CountCommands(GLCommand command) const;
+
+    // Issues the recorded calls on target, in order.
+    void Replay(GLBackend& target) const;
+    // Drops the recorded calls, keeps the buffer's memory for the next frame.
+    void Discard(void);
+
+    bool CreateProgram(GLuint& program, const char* vertexShaderPath, const char* fragmentShaderPath) override;
+    void DeleteProgram(GLuint program) override;
+    void UseProgram(GLuint program) override;
+    GLint GetUniformLocation(GLuint program, const char* name) override;
+    GLuint GetUniformBlockIndex(GLuint program, const char* name) override;
+    void UniformBlockBinding(GLuint program, GLuint blockIndex, GLuint binding) override;
+    void GetActiveUniformBlockiv(GLuint program, GLuint blockIndex, GLenum pname, GLint* value) override;
+    void Uniform1i(GLint location, GLint value) override;
+    void GetIntegerv(GLenum pname, GLint* value) override;
+
+    GLuint GenBuffer(void) override;
+    void DeleteBuffer(GLuint buffer) override;
+    void BindBuffer(GLenum target, GLuint buffer) override;
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer) override;
+    void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) override;
+    void BufferData(GLenum target, GLsizeiptr size, const void* data, GLenum usage) override;
+    void BufferSubData(GLenum target, GLintptr offset, GLsizeiptr size, const void* data) override;
+    void* MapBufferRange(GLenum target, GLintptr offset, GLsizeiptr length, GLbitfield access) override;
+    void UnmapBuffer(GLenum target) override;
+    void CopyBufferSubData(GLenum readTarget, GLenum writeTarget, GLintptr readOffset, GLintptr writeOffset, GLsizeiptr size) override;
+
+    GLuint GenVertexArray(void) override;
+    void DeleteVertexArray(GLuint vertexArray) override;
+    void BindVertexArray(GLuint vertexArray) override;
+    void EnableVertexAttribArray(GLuint index) override;
+    void DisableVertexAttribArray(GLuint index) override;
+    void VertexAttribPointer(GLuint index, GLint size, GLenum type, GLboolean normalized, GLsizei stride, uintptr_t offset) override;
+    void VertexAttribDivisor(GLuint index, GLuint divisor) override;
+
+    GLuint GenTexture(void) override;
+    void DeleteTexture(GLuint texture) override;
+    void ActiveTexture(GLenum unit) override;
+    void BindTexture(GLenum target, GLuint texture) override;
+    void TexImage2D(GLenum target, GLint level, GLint internalFormat, GLsizei width, GLsizei height,
+                    GLenum format, GLenum type, const void* pixels) override;
+    void TexParameteri(GLenum target, GLenum pname, GLint value) override;
+    void GenerateMipmap(GLenum target) override;
+    void TexBuffer(GLenum target, GLenum internalFormat, GLuint buffer) override;
+
+    void Enable(GLenum cap) override;
+    void Disable(GLenum cap) override;
+    void DepthMask(GLboolean flag) override;
+    void BlendFunc(GLenum sfactor, GLenum dfactor) override;
+    void DepthFunc(GLenum func) override;
+    void CullFace(GLenum mode) override;
+    void FrontFace(GLenum mode) override;
+    void ClearColor(GLfloat red, GLfloat green, GLfloat blue, GLfloat alpha) override;
+    void Clear(GLbitfield mask) override;
+
+    void DrawArrays(GLenum mode, GLint first, GLsizei count) override;
+    void DrawElements(GLenum mode, GLsizei count, GLenum type, uintptr_t offset) override;
+    void DrawArraysInstanced(GLenum mode, GLint first, GLsizei count, GLsizei instanceCount) override;
+    void DrawElementsInstanced(GLenum mode, GLsizei count, GLenum type, uintptr_t offset, GLsizei instanceCount) override;
+    void DrawElementsInstancedBaseVertex(GLenum mode, GLsizei count, GLenum type, uintptr_t offset,
+                                         GLsizei instanceCount, GLint baseVertex) override;
+
+    GLuint GenFramebuffer(void) override;
+    void DeleteFramebuffer(GLuint framebuffer) override;
+    void BindFramebuffer(GLenum target, GLuint framebuffer) override;
+    GLenum CheckFramebufferStatus(GLenum target) override;
+    GLuint GenRenderbuffer(void) override;
+    void DeleteRenderbuffer(GLuint renderbuffer) override;
+    void BindRenderbuffer(GLenum target, GLuint renderbuffer) override;
+    void RenderbufferStorage(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height) override;
+    void FramebufferRenderbuffer(GLenum target, GLenum attachment, GLenum renderbufferTarget, GLuint renderbuffer) override;
+    void Viewport(GLint x, GLint y, GLsizei width, GLsizei height) override;
+    void ReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* pixels) override;
+    void Flush(void) override;
+    void Finish(void) override;
+
+    GLuint GenQuery(void) override;
+    void DeleteQuery(GLuint query) override;
+    void BeginQuery(GLenum target, GLuint query) override;
+    void EndQuery(GLenum target) override;
+    void QueryCounter(GLuint query, GLenum target) override;
+    bool QueryResultAvailable(GLuint query) override;
+    GLuint64 QueryResult(GLuint query) override;
+
+    GLsync FenceSync(void) override;
+    GLenum ClientWaitSync(GLsync sync, GLuint64 timeout) override;
+    void DeleteSync(GLsync sync) override;
+
+    static bool Test(void);
+};
+
+#endif /* gl_backend_hpp */
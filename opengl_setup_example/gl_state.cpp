@@ -0,0 +1,318 @@
+//
+//  gl_state.cpp
+//  opengl_setup_example
+//
+
+#include "gl_state.h"
+
+#include "gl_backend.h"
+#include "dbgutils.h"
+
+// No GL object has this name, so it stands for a binding we know nothing about.
+constexpr GLuint kUnknownName = 0xFFFFFFFFu;
+constexpr int kUnknownValue = -1;
+
+static int BufferSlot(GLenum target)
+{
+    switch(target) {
+        case GL_ARRAY_BUFFER: return 0;
+        case GL_ELEMENT_ARRAY_BUFFER: return 1;
+        case GL_UNIFORM_BUFFER: return 2;
+        case GL_TEXTURE_BUFFER: return 3;
+        case GL_COPY_READ_BUFFER: return 4;
+        case GL_COPY_WRITE_BUFFER: return 5;
+        default: return -1;
+    }
+}
+
+static int TextureSlot(GLenum target)
+{
+    switch(target) {
+        case GL_TEXTURE_2D: return 0;
+        case GL_TEXTURE_BUFFER: return 1;
+        default: return -1;
+    }
+}
+
+static int CapSlot(GLenum cap)
+{
+    switch(cap) {
+        case GL_BLEND: return 0;
+        case GL_DEPTH_TEST: return 1;
+        case GL_CULL_FACE: return 2;
+        default: return -1;
+    }
+}
+
+GLStateCache::GLStateCache(GLBackend* backend) : mBackend(backend)
+{
+    Invalidate();
+}
+
+void GLStateCache::Invalidate(void)
+{
+    mProgram = kUnknownName;
+    mVertexArray = kUnknownName;
+    for(int i = 0; i < kNumBufferSlots; i++) {
+        mBuffers[i] = kUnknownName;
+    }
+    mActiveUnit = kUnknownValue;
+    for(int unit = 0; unit < kMaxTextureUnits; unit++) {
+        for(int i = 0; i < kNumTextureSlots; i++) {
+            mTextures[unit][i] = kUnknownName;
+        }
+    }
+    for(int i = 0; i < kMaxIndexedBindings; i++) {
+        mUniformBindings[i].buffer = kUnknownName;
+    }
+    for(int i = 0; i < kNumCaps; i++) {
+        mCaps[i] = kUnknownValue;
+    }
+    mDepthMask = kUnknownValue;
+    mAttribArrays.clear();
+}
+
+void GLStateCache::UseProgram(GLuint program)
+{
+    if(program == mProgram) {
+        Elide();
+        return;
+    }
+    Issue();
+    mBackend->UseProgram(program);
+    mProgram = program;
+}
+
+void GLStateCache::BindVertexArray(GLuint vertexArray)
+{
+    if(vertexArray == mVertexArray) {
+        Elide();
+        return;
+    }
+    Issue();
+    mBackend->BindVertexArray(vertexArray);
+    mVertexArray = vertexArray;
+    // the element buffer binding belongs to the vertex array.
+    mBuffers[kElementBufferSlot] = kUnknownName;
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+    int slot = BufferSlot(target);
+    if(slot >= 0 && mBuffers[slot] == buffer) {
+        Elide();
+        return;
+    }
+    Issue();
+    mBackend->BindBuffer(target, buffer);
+    if(slot >= 0) {
+        mBuffers[slot] = buffer;
+    }
+}
+
+void GLStateCache::BindBufferBase(GLenum target, GLuint index, GLuint buffer)
+{
+    // a whole buffer binding is recorded as size -1, which no range binding can have.
+    bool tracked = target == GL_UNIFORM_BUFFER && index < kMaxIndexedBindings;
+    if(tracked) {
+        const IndexedBinding& binding = mUniformBindings[index];
+        if(binding.buffer == buffer && binding.offset == 0 && binding.size == -1) {
+            Elide();
+            return;
+        }
+    }
+    Issue();
+    mBackend->BindBufferBase(target, index, buffer);
+    if(tracked) {
+        mUniformBindings[index] = { buffer, 0, -1 };
+    }
+    // also binds the generic target.
+    int slot = BufferSlot(target);
+    if(slot >= 0) {
+        mBuffers[slot] = buffer;
+    }
+}
+
+void GLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+    bool tracked = target == GL_UNIFORM_BUFFER && index < kMaxIndexedBindings;
+    if(tracked) {
+        const IndexedBinding& binding = mUniformBindings[index];
+        if(binding.buffer == buffer && binding.offset == offset && binding.size == size) {
+            Elide();
+            return;
+        }
+    }
+    Issue();
+    mBackend->BindBufferRange(target, index, buffer, offset, size);
+    if(tracked) {
+        mUniformBindings[index] = { buffer, offset, size };
+    }
+    int slot = BufferSlot(target);
+    if(slot >= 0) {
+        mBuffers[slot] = buffer;
+    }
+}
+
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+    int unitIndex = (int)(unit - GL_TEXTURE0);
+    bool tracked = unitIndex >= 0 && unitIndex < kMaxTextureUnits;
+    if(tracked && unitIndex == mActiveUnit) {
+        Elide();
+        return;
+    }
+    Issue();
+    mBackend->ActiveTexture(unit);
+    mActiveUnit = tracked ? unitIndex : kUnknownValue;
+}
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+    int slot = TextureSlot(target);
+    bool tracked = slot >= 0 && mActiveUnit != kUnknownValue;
+    if(tracked && mTextures[mActiveUnit][slot] == texture) {
+        Elide();
+        return;
+    }
+    Issue();
+    mBackend->BindTexture(target, texture);
+    if(tracked) {
+        mTextures[mActiveUnit][slot] = texture;
+    }
+}
+
+void GLStateCache::SetCap(GLenum cap, bool enable)
+{
+    int slot = CapSlot(cap);
+    if(slot >= 0 && mCaps[slot] == (int)enable) {
+        Elide();
+        return;
+    }
+    Issue();
+    if(enable) {
+        mBackend->Enable(cap);
+    } else {
+        mBackend->Disable(cap);
+    }
+    if(slot >= 0) {
+        mCaps[slot] = enable;
+    }
+}
+
+void GLStateCache::DepthMask(GLboolean flag)
+{
+    if(mDepthMask == (int)(flag != GL_FALSE)) {
+        Elide();
+        return;
+    }
+    Issue();
+    mBackend->DepthMask(flag);
+    mDepthMask = flag != GL_FALSE;
+}
+
+void GLStateCache::SetAttribArray(GLuint index, bool enable)
+{
+    bool tracked = mVertexArray != kUnknownName && index < 32;
+    if(tracked) {
+        auto found = mAttribArrays.find(mVertexArray);
+        if(found != mAttribArrays.end()) {
+            uint32_t bit = 1u << index;
+            const AttribArrays& arrays = found->second;
+            if((arrays.known & bit) && ((arrays.enabled & bit) != 0) == enable) {
+                Elide();
+                return;
+            }
+        }
+    }
+    Issue();
+    if(enable) {
+        mBackend->EnableVertexAttribArray(index);
+    } else {
+        mBackend->DisableVertexAttribArray(index);
+    }
+    if(tracked) {
+        uint32_t bit = 1u << index;
+        AttribArrays& arrays = mAttribArrays.insert(std::make_pair(mVertexArray, AttribArrays{ 0, 0 })).first->second;
+        arrays.known |= bit;
+        arrays.enabled = enable ? (arrays.enabled | bit) : (arrays.enabled & ~bit);
+    }
+}
+
+
+bool GLStateCache::Test(void)
+{
+    GLNullBackend recorder;
+    GLStateCache state(&recorder);
+
+    // Unknown state always goes through the first time.
+    state.UseProgram(3);
+    state.UseProgram(3);
+    DbgAssert(recorder.CountCommands(kCmdUseProgram) == 1);
+    DbgAssert(state.Stats().issued == 1 && state.Stats().elided == 1);
+
+    // The element buffer binding follows the vertex array.
+    state.BindVertexArray(5);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 9);
+    state.BindVertexArray(6);
+    state.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 9);
+    state.BindBuffer(GL_ARRAY_BUFFER, 9);
+    state.BindBuffer(GL_ARRAY_BUFFER, 9);
+    DbgAssert(recorder.CountCommands(kCmdBindBuffer) == 3);
+
+    // Textures are per unit and per target.
+    state.ActiveTexture(GL_TEXTURE0);
+    state.BindTexture(GL_TEXTURE_2D, 10);
+    state.BindTexture(GL_TEXTURE_2D, 10);
+    state.ActiveTexture(GL_TEXTURE0 + 1);
+    state.BindTexture(GL_TEXTURE_2D, 10);
+    state.BindTexture(GL_TEXTURE_BUFFER, 10);
+    state.ActiveTexture(GL_TEXTURE0);
+    state.BindTexture(GL_TEXTURE_2D, 10);
+    DbgAssert(recorder.CountCommands(kCmdActiveTexture) == 3);
+    DbgAssert(recorder.CountCommands(kCmdBindTexture) == 3);
+
+    // Range bindings compare buffer, offset and size, and set the generic binding too.
+    state.BindBufferRange(GL_UNIFORM_BUFFER, 1, 20, 0, 64);
+    state.BindBufferRange(GL_UNIFORM_BUFFER, 1, 20, 0, 64);
+    state.BindBufferRange(GL_UNIFORM_BUFFER, 1, 20, 256, 64);
+    state.BindBufferRange(GL_UNIFORM_BUFFER, 2, 20, 256, 64);
+    state.BindBuffer(GL_UNIFORM_BUFFER, 20);
+    state.BindBufferBase(GL_UNIFORM_BUFFER, 1, 20);
+    state.BindBufferBase(GL_UNIFORM_BUFFER, 1, 20);
+    DbgAssert(recorder.CountCommands(kCmdBindBufferRange) == 3);
+    DbgAssert(recorder.CountCommands(kCmdBindBufferBase) == 1);
+    DbgAssert(recorder.CountCommands(kCmdBindBuffer) == 3);
+
+    state.Enable(GL_BLEND);
+    state.Enable(GL_BLEND);
+    state.Disable(GL_BLEND);
+    state.DepthMask(GL_FALSE);
+    state.DepthMask(GL_FALSE);
+    DbgAssert(recorder.CountCommands(kCmdEnable) == 1 && recorder.CountCommands(kCmdDisable) == 1);
+    DbgAssert(recorder.CountCommands(kCmdDepthMask) == 1);
+
+    // Enabled arrays are remembered per vertex array.
+    state.BindVertexArray(5);
+    state.EnableVertexAttribArray(0);
+    state.EnableVertexAttribArray(0);
+    state.BindVertexArray(6);
+    state.EnableVertexAttribArray(0);
+    state.BindVertexArray(5);
+    state.EnableVertexAttribArray(0);
+    state.DisableVertexAttribArray(0);
+    DbgAssert(recorder.CountCommands(kCmdEnableVertexAttribArray) == 2);
+    DbgAssert(recorder.CountCommands(kCmdDisableVertexAttribArray) == 1);
+
+    // Every issued call reached the backend, nothing else did.
+    DbgAssert(state.Stats().issued == (int)recorder.CommandCount());
+
+    state.Invalidate();
+    state.UseProgram(3);
+    DbgAssert(recorder.CountCommands(kCmdUseProgram) == 2);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,108 @@
+//
+//  gl_state.h
+//  opengl_setup_example
+//
+
+#ifndef gl_state_hpp
+#define gl_state_hpp
+
+#include <map>
+#include <cstdint>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+
+class GLBackend;
+
+struct GLStateStats {
+    // calls passed on to the backend.
+    int issued;
+    // calls dropped because the state was already set.
+    int elided;
+
+    GLStateStats() : issued(0), elided(0) {}
+};
+
+// Shadows the program, vertex array, buffer and texture bindings, uniform buffer
+// binding points, a few capabilities and the enabled attribute arrays, and only
+// passes calls that change something on to the backend.
+//
+// Everything starts unknown, so the first call of each kind always goes through.
+// GL calls made around the cache, including creating or deleting bound objects,
+// leave the shadow stale, call Invalidate after them.
+class GLStateCache {
+public:
+    static constexpr int kMaxTextureUnits = 16;
+    static constexpr int kMaxIndexedBindings = 16;
+
+private:
+    enum { kArrayBufferSlot, kElementBufferSlot, kUniformBufferSlot, kTextureBufferSlot,
+           kCopyReadBufferSlot, kCopyWriteBufferSlot, kNumBufferSlots };
+    enum { kTexture2DSlot, kTextureBufferTargetSlot, kNumTextureSlots };
+    enum { kBlendCap, kDepthTestCap, kCullFaceCap, kNumCaps };
+
+    struct IndexedBinding {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr size;
+    };
+
+    // enabled attribute arrays are vertex array state, so they are kept per vertex array.
+    struct AttribArrays {
+        uint32_t known;
+        uint32_t enabled;
+    };
+
+    GLBackend* mBackend;
+
+    GLuint mProgram;
+    GLuint mVertexArray;
+    GLuint mBuffers[kNumBufferSlots];
+    int mActiveUnit;
+    GLuint mTextures[kMaxTextureUnits][kNumTextureSlots];
+    IndexedBinding mUniformBindings[kMaxIndexedBindings];
+    int mCaps[kNumCaps];
+    int mDepthMask;
+    std::map<GLuint, AttribArrays> mAttribArrays;
+
+    GLStateStats mStats;
+
+    bool Issue(void) { mStats.issued++; return true; }
+    bool Elide(void) { mStats.elided++; return false; }
+    void SetCap(GLenum cap, bool enable);
+    void SetAttribArray(GLuint index, bool enable);
+
+public:
+    explicit GLStateCache(GLBackend* backend);
+
+    GLStateCache(const GLStateCache&) = delete;
+    GLStateCache& operator = (const GLStateCache&) = delete;
+
+    // Forgets all shadowed state.
+    void Invalidate(void);
+
+    void UseProgram(GLuint program);
+    void BindVertexArray(GLuint vertexArray);
+    void BindBuffer(GLenum target, GLuint buffer);
+    void BindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void ActiveTexture(GLenum unit);
+    void BindTexture(GLenum target, GLuint texture);
+    void Enable(GLenum cap) { SetCap(cap, true); }
+    void Disable(GLenum cap) { SetCap(cap, false); }
+    void DepthMask(GLboolean flag);
+    void EnableVertexAttribArray(GLuint index) { SetAttribArray(index, true); }
+    void DisableVertexAttribArray(GLuint index) { SetAttribArray(index, false); }
+
+    // for the calls the cache does not shadow.
+    GLBackend& Backend(void) const { return *mBackend; }
+
+    const GLStateStats& Stats(void) const { return mStats; }
+    void ResetStats(void) { mStats = GLStateStats(); }
+
+    static bool Test(void);
+};
+
+#endif /* gl_state_hpp */
@@ -0,0 +1,158 @@
+//
+//  headless.cpp
+//  opengl_setup_example
+//
+
+#include "headless.h"
+
+#include <iostream>
+#include <fstream>
+#include <memory>
+
+#include <GLFW/glfw3.h>
+
+#include "frame_state.h"
+#include "gl_backend.h"
+#include "offscreen_target.h"
+#include "frame_timer.h"
+#include "image_buffer.h"
+#include "trace.h"
+
+static bool SetContextAPI(const std::string& contextAPI)
+{
+    int api;
+    if(contextAPI == "native") {
+        api = GLFW_NATIVE_CONTEXT_API;
+    } else if(contextAPI == "egl") {
+        api = GLFW_EGL_CONTEXT_API;
+    } else if(contextAPI == "osmesa") {
+        api = GLFW_OSMESA_CONTEXT_API;
+    } else {
+        std::cerr << "Unknown context API " << contextAPI << ", expected native, egl or osmesa" << std::endl;
+        return false;
+    }
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, api);
+    return true;
+}
+
+static bool WriteTimings(const FrameTimer& timer, const std::string& path)
+{
+    if(path.empty()) {
+        timer.WriteCSV(std::cout);
+        return true;
+    }
+    std::ofstream out(path);
+    if(!out) {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    timer.WriteCSV(out);
+    return true;
+}
+
+// Everything that needs the context, so it is all gone before glfwTerminate.
+static bool RenderFrames(const HeadlessOptions& options, FrameState& frameState)
+{
+    GLDirectBackend backend;
+    OffscreenTarget target(backend);
+    if(!target.Init(options.scene.width, options.scene.height)) {
+        return false;
+    }
+
+    DemoScene scene(backend, frameState);
+    scene.printStats = false;
+    if(!scene.Init(options.scene)) {
+        return false;
+    }
+
+    scene.SetProfiling(options.profile);
+
+    target.Bind();
+    FrameTimer timer(backend);
+    for(int i = 0; i < options.frames; i++) {
+        TRACE_ZONE("frame", "headless frame");
+        timer.BeginFrame();
+        scene.BeginFrame();
+        scene.Cull();
+        scene.Submit();
+        scene.EndFrame();
+        timer.EndFrame();
+        // No swap to push the frame to the GPU.
+        backend.Flush();
+    }
+    timer.Finish();
+
+    target.Unbind();
+    bool good = WriteTimings(timer, options.timingsPath);
+    timer.PrintSummary(std::cerr);
+    if(scene.Profiler()) {
+        scene.Profiler()->PrintTable(std::cerr);
+    }
+
+    if(!options.pngPath.empty()) {
+        RGBImageBuffer image;
+        target.ReadPixels(image);
+        good = SaveImageBufferToPNG(image, options.pngPath.c_str(), true) && good;
+    }
+    return good;
+}
+
+bool RunHeadless(const HeadlessOptions& options)
+{
+#ifdef GLFW_PLATFORM_NULL
+    // GLFW 3.4 and later, no display connection. EGL then needs EGL_MESA_platform_surfaceless.
+    if(options.contextAPI != "native") {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+    }
+#endif
+    if (!glfwInit()) {
+        std::cerr << "Failed initializing GLFW" << std::endl;
+        return false;
+    }
+
+    glfwWindowHint( GLFW_CONTEXT_VERSION_MAJOR, 3 );
+    glfwWindowHint( GLFW_CONTEXT_VERSION_MINOR, 3 );
+    glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
+    // Required to work on Mac.
+    glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+    // The window is only there to own the context, drawing goes to the framebuffer object.
+    glfwWindowHint( GLFW_VISIBLE, GLFW_FALSE);
+    if(!SetContextAPI(options.contextAPI)) {
+        glfwTerminate();
+        return false;
+    }
+
+    std::unique_ptr<FrameState> frameState(new FrameState());
+    frameState->window = glfwCreateWindow(options.scene.width, options.scene.height, "OpenGL Setup Example", nullptr, nullptr);
+    if( frameState->window == nullptr ) {
+        std::cerr << "Failed creating offscreen context with GLFW" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+    glfwMakeContextCurrent(frameState->window);
+
+    glewExperimental = true; // Needed for core profile
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // Linux GLEW built for GLX reports this on an EGL or OSMesa context, the functions still load.
+    if (glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) {
+        glewStatus = GLEW_OK;
+    }
+#endif
+    if (glewStatus != GLEW_OK) {
+        std::cerr << "Failed to initialize GLEW" << std::endl;
+        glfwTerminate();
+        return false;
+    }
+
+    const GLubyte* renderer = glGetString(GL_RENDERER);
+    // stdout is left for the timings.
+    std::cerr << "Headless: " << options.frames << " frames at " << options.scene.width << "x" << options.scene.height
+        << " on " << (renderer ? (const char*)renderer : "unknown renderer") << std::endl;
+
+    bool good = RenderFrames(options, *frameState);
+
+    glfwDestroyWindow(frameState->window);
+    glfwTerminate();
+    return good;
+}
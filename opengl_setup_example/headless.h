@@ -0,0 +1,36 @@
+//
+//  headless.h
+//  opengl_setup_example
+//
+
+#ifndef headless_hpp
+#define headless_hpp
+
+#include <string>
+
+#include "demo_scene.h"
+
+struct HeadlessOptions {
+    DemoSceneOptions scene;
+    int frames;
+    // "native", "egl" or "osmesa", see GLFW_CONTEXT_CREATION_API.
+    std::string contextAPI;
+    // per frame timings as CSV, to stdout when empty.
+    std::string timingsPath;
+    // the last frame is written here when set.
+    std::string pngPath;
+    // print the frame profiler's table at the end.
+    bool profile;
+
+    HeadlessOptions() : frames(0), contextAPI("native"), profile(false) {}
+};
+
+// Renders frames frames of the demo into an offscreen framebuffer on a real GL context,
+// with no visible window, timing each frame on the CPU and GPU.
+//
+// With the egl or osmesa context API, and a GLFW built with the null platform, no display
+// is needed at all, so this runs on Mesa's software rasterizer on a machine without a GPU.
+// Returns false if the context, scene or framebuffer could not be set up.
+bool RunHeadless(const HeadlessOptions& options);
+
+#endif /* headless_hpp */
@@ -7,6 +7,7 @@
 
 #include "image_buffer.h"
 #include "pngreader.h"
+#include "pngwriter.h"
 
 #include <cassert>
 #include <iostream>
@@ -91,3 +92,12 @@ RGBImageBuffer* LoadImageBufferFromPNG(const char* path)
     
     return new RGBImageBuffer(pixels, width, height, width*3, 3);
 }
+
+bool SaveImageBufferToPNG(const RGBImageBuffer& image, const char* path, bool flipRows)
+{
+    if(!WritePNGImage(path, image.Pixels(), image.Width(), image.Height(), image.RowBytes(), image.Channels(), flipRows)) {
+        std::cerr << "Error saving image to " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -41,6 +41,8 @@ public:
 };
 
 RGBImageBuffer* LoadImageBufferFromPNG(const char* path);
+// flipRows writes the last row first, for images read back from GL.
+bool SaveImageBufferToPNG(const RGBImageBuffer& image, const char* path, bool flipRows=false);
 
 
 #endif /* img_loader_hpp */
@@ -0,0 +1,176 @@
+//
+//  instancing.cpp
+//  opengl_setup_example
+//
+
+#include "instancing.h"
+
+#include <iostream>
+#include <cstring>
+#include <list>
+#include <memory>
+
+#include <glm/ext.hpp>
+
+#include "model_object.h"
+#include "frame_state.h"
+#include "uniform_buffers.h"
+#include "gl_state.h"
+#include "gl_backend.h"
+#include "dbgutils.h"
+
+// first attribute location of each per instance mat4, see phong_instanced_vertex_shader.glsl.
+constexpr GLuint kInstanceModelMatrixLocation = 3;
+constexpr GLuint kInstanceNormMatrixLocation = 7;
+
+bool InstancedShader::Init(GLBackend& backend, const char* vertexShaderPath, const char* fragmentShaderPath)
+{
+    if(!backend.CreateProgram(program, vertexShaderPath, fragmentShaderPath)) {
+        return false;
+    }
+
+    UniformBuffers::BindBlocks(backend, program);
+    return true;
+}
+
+
+InstancedBatch::InstancedBatch(GLBackend& backend, ModelObject& geometry)
+    : mBackend(backend), mGeometry(geometry), mInstanceBuffer(0), mVertexArray(0)
+{
+    mInstanceBuffer = backend.GenBuffer();
+    if(!geometry.geometry) {
+        return;
+    }
+    const MeshGeometry& geom = *geometry.geometry;
+
+    // Same layout as the geometry's own vertex array with the instance matrices added.
+    mVertexArray = backend.GenVertexArray();
+    backend.BindVertexArray(mVertexArray);
+
+    backend.BindBuffer(GL_ARRAY_BUFFER, geom.vertexBuffer);
+    SetVertexAttributes(backend);
+
+    backend.BindBuffer(GL_ARRAY_BUFFER, mInstanceBuffer);
+    const GLsizei instanceStride = kFloatsPerInstance * sizeof(float);
+    for(GLuint col = 0; col < 4; col++) {
+        backend.EnableVertexAttribArray(kInstanceModelMatrixLocation + col);
+        backend.VertexAttribPointer(kInstanceModelMatrixLocation + col, 4, GL_FLOAT, GL_FALSE, instanceStride, col * 4 * sizeof(float));
+        backend.VertexAttribDivisor(kInstanceModelMatrixLocation + col, 1);
+
+        backend.EnableVertexAttribArray(kInstanceNormMatrixLocation + col);
+        backend.VertexAttribPointer(kInstanceNormMatrixLocation + col, 4, GL_FLOAT, GL_FALSE, instanceStride, (16 + col * 4) * sizeof(float));
+        backend.VertexAttribDivisor(kInstanceNormMatrixLocation + col, 1);
+    }
+
+    if(geom.indexBuffer != 0) {
+        backend.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, geom.indexBuffer);
+    }
+    backend.BindVertexArray(0);
+}
+
+InstancedBatch::~InstancedBatch()
+{
+    if(mVertexArray != 0) {
+        mBackend.DeleteVertexArray(mVertexArray);
+    }
+    mBackend.DeleteBuffer(mInstanceBuffer);
+}
+
+void InstancedBatch::AddInstance(ModelObject* inst)
+{
+    inst->isInstance = true;
+    inst->geometry = mGeometry.geometry;
+    inst->textureID = mGeometry.textureID;
+    inst->material = mGeometry.material;
+    inst->materialSlot = mGeometry.materialSlot;
+    mInstances.push_back(inst);
+}
+
+int InstancedBatch::PackInstances(const std::vector<ModelObject*>& instances, const glm::mat4& viewMat, std::vector<float>& outData)
+{
+    outData.resize(instances.size() * kFloatsPerInstance);
+    float* dest = outData.data();
+    int count = 0;
+    for(const ModelObject* inst : instances) {
+        if(!inst->Visible() || inst->isCulled) {
+            continue;
+        }
+        const glm::mat4& modelMat = inst->modelMatrixStack.top();
+        glm::mat4 normMat = glm::transpose(glm::inverse(viewMat * modelMat));
+        memcpy(dest, glm::value_ptr(modelMat), 16 * sizeof(float));
+        memcpy(dest + 16, glm::value_ptr(normMat), 16 * sizeof(float));
+        dest += kFloatsPerInstance;
+        count++;
+    }
+    outData.resize(count * kFloatsPerInstance);
+    return count;
+}
+
+int InstancedBatch::Draw(FrameState* frameState, const InstancedShader& shader, const glm::mat4& viewMat)
+{
+    int count = PackInstances(mInstances, viewMat, mInstanceData);
+    if(count == 0 || mVertexArray == 0) {
+        return 0;
+    }
+    const ModelObject& obj = mGeometry;
+    const MeshGeometry& geom = *obj.geometry;
+
+    GLStateCache* state = frameState->glState;
+    state->UseProgram(shader.program);
+    frameState->uniforms->BindMaterial(obj.materialSlot);
+
+    state->ActiveTexture(GL_TEXTURE0);
+    state->BindTexture(GL_TEXTURE_2D, obj.textureID);
+
+    // Per instance matrices, re-specified every frame. The attribute layout is already in the vertex array.
+    state->BindBuffer(GL_ARRAY_BUFFER, mInstanceBuffer);
+    mBackend.BufferData(GL_ARRAY_BUFFER, mInstanceData.size() * sizeof(float), mInstanceData.data(), GL_STREAM_DRAW);
+
+    state->BindVertexArray(mVertexArray);
+    if(geom.isIndexed) {
+        mBackend.DrawElementsInstanced(GL_TRIANGLES, geom.drawCount, GL_UNSIGNED_INT, 0, count);
+    } else {
+        mBackend.DrawArraysInstanced(GL_TRIANGLES, 0, geom.drawCount, count);
+    }
+    return 1;
+}
+
+bool InstancedBatch::Test(void)
+{
+    const glm::mat4 identity = glm::identity<glm::mat4>();
+    const glm::mat4 viewMat = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+
+    std::list<std::unique_ptr<ModelObject>> owned;
+    std::vector<ModelObject*> instances;
+    for(int i = 0; i < 4; i++) {
+        owned.push_back(std::make_unique<ModelObject>());
+        ModelObject* inst = owned.back().get();
+        inst->Show();
+        inst->PushModelMatrix(glm::scale(glm::translate(identity, glm::vec3(i, 0, -5)), glm::vec3(2.0f)));
+        instances.push_back(inst);
+    }
+    instances[1]->Hide();
+    instances[2]->isCulled = true;
+
+    std::vector<float> data;
+    int count = PackInstances(instances, viewMat, data);
+    DbgAssert(count == 2);
+    DbgAssert(data.size() == 2 * kFloatsPerInstance);
+
+    // second packed instance is the fourth object, translation is column 3 of its model matrix.
+    const float* second = data.data() + kFloatsPerInstance;
+    DbgAssertAlmostEqual(second[12], 3.0);
+    DbgAssertAlmostEqual(second[14], -5.0);
+    DbgAssertAlmostEqual(second[0], 2.0);
+
+    // normal matrix undoes the scale, the view here has no rotation or scale of its own.
+    glm::mat4 normMat = glm::make_mat4(second + 16);
+    glm::vec4 n = normMat * glm::vec4(0, 0, 1, 0);
+    DbgAssertAlmostEqual(n.z, 0.5, 1e-5);
+    DbgAssertAlmostEqual(n.x, 0.0, 1e-5);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,75 @@
+//
+//  instancing.h
+//  opengl_setup_example
+//
+
+#ifndef instancing_hpp
+#define instancing_hpp
+
+#include <vector>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class ModelObject;
+struct FrameState;
+class GLBackend;
+
+// Program for phong_instanced_vertex_shader.glsl.
+// Model and normal matrices come from per instance attributes instead of the object block,
+// frame and material data come from the same uniform buffers as everything else.
+struct InstancedShader {
+    GLuint program;
+
+    InstancedShader() : program(0) {}
+
+    // Also points the program's uniform blocks at their binding points.
+
+    bool Init(GLBackend& backend, const char* vertexShaderPath, const char* fragmentShaderPath);
+};
+
+// Many copies of one mesh drawn with a single instanced draw call.
+// The geometry object supplies the buffers, texture and material for every instance.
+// Instances are ordinary ModelObjects with their own transform and visibility so
+// culling and picking treat them like anything else, but DrawObject skips them.
+// With instancing off they go through the render queue one draw each instead.
+class InstancedBatch {
+private:
+    GLBackend& mBackend;
+    ModelObject& mGeometry;
+    std::vector<ModelObject*> mInstances;
+    GLuint mInstanceBuffer;
+    // geometry attributes plus the per instance matrices.
+    GLuint mVertexArray;
+    // model matrix then normal matrix for each instance drawn this frame.
+    std::vector<float> mInstanceData;
+
+public:
+    static constexpr int kFloatsPerInstance = 32;
+
+    // geometry must already have its uploaded MeshGeometry.
+    InstancedBatch(GLBackend& backend, ModelObject& geometry);
+    ~InstancedBatch();
+
+    InstancedBatch(const InstancedBatch&) = delete;
+    InstancedBatch& operator = (const InstancedBatch&) = delete;
+
+    // Marks inst as an instance and gives it the shared geometry, texture and material.
+    void AddInstance(ModelObject* inst);
+
+    const std::vector<ModelObject*>& Instances(void) const { return mInstances; }
+
+    // Writes model and normal matrices of the visible, unculled instances to outData. Returns how many.
+    static int PackInstances(const std::vector<ModelObject*>& instances, const glm::mat4& viewMat, std::vector<float>& outData);
+
+    // Draws every visible instance in one call. Leaves the instanced program bound.
+    // Returns the number of draw calls made, 0 or 1.
+    int Draw(FrameState* frameState, const InstancedShader& shader, const glm::mat4& viewMat);
+
+    static bool Test(void);
+};
+
+#endif /* instancing_hpp */
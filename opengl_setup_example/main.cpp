@@ -9,6 +9,8 @@
 #include <vector>
 #include <list>
 #include <memory>
+#include <chrono>
+#include <cstring>
 
 // Define before OpenGL and GLUT includes to avoid deprecation messages
 #define GL_SILENCE_DEPRECATION
@@ -20,40 +22,113 @@
 
 #include "frame_state.h"
 #include "model_object.h"
-#include "shaders.h"
-#include "textures.h"
 #include "proc_textures.h"
-#include "cube.h"
-#include "sphere.h"
-#include "pyramid.h"
-#include "mathutil.h"
-#include "trianglemesh.h"
-
-const char* kVertexShaderPath = "phong_vertex_shader.glsl";
-const char* kFragmentShaderPath = "phong_fragment_shader.glsl";
-
-const RGBColor red = {255, 0, 0};
-const RGBColor blue = {0, 0, 255};
-const RGBColor green = {0, 255, 0};
-const RGBColor white = {255, 255, 255};
-const RGBColor black = { 0, 0, 0};
-const RGBColor orange = {232, 99, 10};
+#include "proc_graph.h"
+#include "noise.h"
+#include "picking.h"
+#include "culling.h"
+#include "occlusion.h"
+#include "thread_pool.h"
+#include "instancing.h"
+#include "geometry_cache.h"
+#include "texture_cache.h"
+#include "virtual_texture.h"
+#include "uniform_buffers.h"
+#include "render_queue.h"
+#include "geometry_arena.h"
+#include "gl_backend.h"
+#include "gl_state.h"
+#include "demo_scene.h"
+#include "bench_harness.h"
+#include "headless.h"
+#include "frame_timer.h"
+#include "profiler.h"
+#include "trace.h"
 
 static bool RunTests(void)
 {
     bool good = true;
+    good = good && TestNoise();
     good = good && TestGenerateCheckers();
+    good = good && TestGenerateParallel();
+    good = good && TestGenerateHeightAndNormalMaps();
+    good = good && TestProcColorBatch();
+    good = good && ProcTexturePlan::Test();
+    good = good && MeshBVH::Test();
+    good = good && Frustum::Test();
+    good = good && ThreadPool::Test();
+    good = good && OcclusionCuller::Test();
+    good = good && InstancedBatch::Test();
+    good = good && GeometryCache::Test();
+    good = good && TextureCache::Test();
+    good = good && VirtualTexture::Test();
+    good = good && UniformBuffers::Test();
+    good = good && RenderQueue::Test();
+    good = good && GeometryArena::Test();
+    good = good && GLStateCache::Test();
+    good = good && GLNullBackend::Test();
+    good = good && FrameTimer::Test();
+    good = good && FrameProfiler::Test();
+    good = good && Tracer::Test();
     return good;
 }
 
 
-static GLint FindUniformLocation(GLint program, const char* name)
+// Returns the integer following flag on the command line, or defaultValue if flag is not there.
+static int IntArg(int argc, const char** argv, const char* flag, int defaultValue)
 {
-    GLint locID = glGetUniformLocation(program, name);
-    if (locID == -1) {
-        std::cerr << "Could not bind " << name << " location" << std::endl;
+    for(int i = 1; i < argc - 1; i++) {
+        if(strcmp(argv[i], flag) == 0) {
+            return atoi(argv[i+1]);
+        }
     }
-    return locID;
+    return defaultValue;
+}
+
+// Returns the string following flag on the command line, or defaultValue if flag is not there.
+static const char* StringArg(int argc, const char** argv, const char* flag, const char* defaultValue)
+{
+    for(int i = 1; i < argc - 1; i++) {
+        if(strcmp(argv[i], flag) == 0) {
+            return argv[i+1];
+        }
+    }
+    return defaultValue;
+}
+
+static bool HasArg(int argc, const char** argv, const char* flag)
+{
+    for(int i = 1; i < argc; i++) {
+        if(strcmp(argv[i], flag) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Writes the trace on the way out of main, whichever way that is.
+struct TraceFileWriter {
+    const char* path;
+
+    explicit TraceFileWriter(const char* tracePath) : path(tracePath) {}
+    ~TraceFileWriter()
+    {
+        if(path) {
+            Tracer::SetEnabled(false);
+            if(Tracer::WriteChromeJSON(path)) {
+                std::cout << "Wrote trace to " << path << std::endl;
+            }
+        }
+    }
+};
+
+// True only on the frame a key goes down.
+static bool KeyPressedOnce(GLFWwindow* window, int key, bool& wasDown)
+{
+    bool down = glfwGetKey(window, key) == GLFW_PRESS;
+    bool pressed = down && !wasDown;
+    wasDown = down;
+    return pressed;
 }
 
 int main(int argc, const char** argv)
@@ -63,9 +138,43 @@ int main(int argc, const char** argv)
         return 1;
     }
     
+    // --trace path records startup and every frame, and writes Chrome trace JSON there on exit.
+    TraceFileWriter traceWriter(StringArg(argc, argv, "--trace", nullptr));
+    if(traceWriter.path) {
+        TRACE_THREAD_NAME("main");
+        Tracer::SetEnabled(true);
+    }
+
     const GLint  kWindowWidth = 1024;
     const GLint kWindowHeight = 768;
 
+    DemoSceneOptions options;
+    // Extra cubes scattered around the scene for testing with many objects, --objects N.
+    options.extraObjectCount = IntArg(argc, argv, "--objects", 0);
+    // --texture-cache DIR keeps the procedural textures there between runs, "" makes them every time.
+    options.textureCacheDirectory = StringArg(argc, argv, "--texture-cache", DemoSceneOptions::kDefaultTextureCacheDirectory);
+    
+    // --bench N runs N frames on the null backend without a window and exits.
+    const int benchFrames = IntArg(argc, argv, "--bench", 0);
+    if(benchFrames > 0) {
+        return RunHeadlessBench(options, benchFrames, HasArg(argc, argv, "--replay")) ? 0 : 1;
+    }
+
+    // --headless N renders N frames offscreen on a real context and prints their timings.
+    const int headlessFrames = IntArg(argc, argv, "--headless", 0);
+    if(headlessFrames > 0) {
+        HeadlessOptions headless;
+        headless.scene = options;
+        headless.scene.width = IntArg(argc, argv, "--width", kWindowWidth);
+        headless.scene.height = IntArg(argc, argv, "--height", kWindowHeight);
+        headless.frames = headlessFrames;
+        headless.contextAPI = StringArg(argc, argv, "--context", "native");
+        headless.timingsPath = StringArg(argc, argv, "--timings", "");
+        headless.pngPath = StringArg(argc, argv, "--png", "");
+        headless.profile = HasArg(argc, argv, "--profile");
+        return RunHeadless(headless) ? 0 : 1;
+    }
+
     std::cout << "GL setup example\n";
 
     if (!glfwInit())
@@ -109,291 +218,26 @@ int main(int argc, const char** argv)
 
     // Ensure we can capture the escape key being pressed below
     glfwSetInputMode(frameState->window, GLFW_STICKY_KEYS, GL_TRUE);
+    glfwSetInputMode(frameState->window, GLFW_STICKY_MOUSE_BUTTONS, GL_TRUE);
 
-    glCullFace( GL_BACK );
-    glFrontFace( GL_CCW );
-    glEnable( GL_CULL_FACE );
-    
-    glEnable(GL_DEPTH_TEST);
-    glDepthFunc(GL_LESS);
-    
-    // glClearColor((GLfloat)0.5f, (GLfloat)0.5f, (GLfloat)0.5f, (GLfloat)1.0f);
-    glClearColor((GLfloat)0.2f, (GLfloat)0.2f, (GLfloat)0.2f, (GLfloat)1.0f);
-
-    GLuint program;
-    if(!InitShader(program, kVertexShaderPath, kFragmentShaderPath)) {
-        std::cerr << "Could not initialize shaders" << std::endl;
+    GLDirectBackend glBackend;
+    std::unique_ptr<DemoScene> scene = std::make_unique<DemoScene>(glBackend, *frameState);
+    options.width = screenWidth;
+    options.height = screenHeight;
+    if(!scene->Init(options)) {
         return 1;
     }
-
-    const float fovyInDegrees = 45.0f;
-    const float aspectRatio = (float) screenWidth / (float)screenHeight;
-    const float znear = 0.001f;
-    const float zfar = 100.0f;
-
-    frameState->projMatrix = glm::perspective(glm::radians(fovyInDegrees), aspectRatio, znear, zfar);
-    
-    frameState->eyePosition = glm::vec3(0.0f, 0.0f, 3.0f);
-    frameState->viewMatrix = glm::lookAt(
-                                         frameState->eyePosition, // position
-                                         glm::vec3(0.0f, 0.0f, 0.0f), // target
-                                         glm::vec3(0.0f, 1.0f, 0.0f) //  up vector
-                                         );
-    
-    frameState->mUniformLocation = FindUniformLocation(program, "modelMatrix");
-    frameState->vUniformLocation = FindUniformLocation(program, "viewMatrix");
-    frameState->normMatUniformLocation = FindUniformLocation(program, "normMatrix");
-    frameState->projUniformLocation = FindUniformLocation(program, "projMatrix");
-    frameState->lightPositionID = FindUniformLocation(program, "lightPosition");
-    
-    
-    frameState->materialAmbientID = FindUniformLocation(program, "materialAmbient");
-    frameState->materialDiffuseID = FindUniformLocation(program, "materialDiffuse");
-    frameState->materialSpecularID = FindUniformLocation(program, "materialSpecular");
-    frameState->materialSpecExpID = FindUniformLocation(program, "materialSpecExp");
-
-    frameState->globalAmbientID = FindUniformLocation(program, "globalAmbient");
-    frameState->lightDiffuseID = FindUniformLocation(program, "lightDiffuse");
-    frameState->lightSpecularID  = FindUniformLocation(program, "lightSpecular");
-    
-    frameState->aPositionLocation = glGetAttribLocation(program, "a_position");
-    if (frameState->aPositionLocation  == -1) {
-        std::cerr << "Could not bind a_position attribute" << std::endl;
-    }
-    
-    glGenVertexArrays(1, &frameState->VertexArrayID);
-    glBindVertexArray(frameState->VertexArrayID);
-
-    
-    //  Textures
-    std::list<std::unique_ptr<RGBImageBuffer>> imageBuffers;
-    std::vector<GLuint> textureIDs;
-    
-    std::cout  << "Generating checkers" << std::endl;
-    RGBImageBuffer* blueGreenCheckersImage = GenerateCheckers(1024, 32, blue, green);
-    
-    assert(blueGreenCheckersImage);
-    GLuint blueGreenCheckersTextureID = CreateTextureFromImage(blueGreenCheckersImage);
-    textureIDs.push_back(blueGreenCheckersTextureID);
-    imageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(blueGreenCheckersImage));
-   
-    
-    RGBImageBuffer* redBlackCheckersImage = GenerateCheckers(1024, 64, red, black);
-    assert(redBlackCheckersImage);
-    GLuint redBlackCheckersTextureID = CreateTextureFromImage(redBlackCheckersImage);
-    textureIDs.push_back(redBlackCheckersTextureID);
-    
-    std::cout  << "Generating marble" << std::endl;
-    RGBImageBuffer* marbleImage = GenerateMarble(512, blue, white);
-    assert(marbleImage);
-    GLuint marbleTextureID = CreateTextureFromImage(marbleImage);
-    textureIDs.push_back(marbleTextureID);
-    
-    std::cout << "Loading image textures" << std::endl;
-    RGBImageBuffer *rockyTextureImage = LoadImageBufferFromPNG("textures/rocky.png");
-    assert(rockyTextureImage);
-    GLuint rockyTextureImageID = CreateTextureFromImage(rockyTextureImage);
-    textureIDs.push_back(rockyTextureImageID);
-    
-    RGBImageBuffer *marsTextureImage = LoadImageBufferFromPNG("textures/mars.png");
-    assert(marsTextureImage);
-    GLuint marsTextureImageID = CreateTextureFromImage(marsTextureImage);
-    textureIDs.push_back(marsTextureImageID);
-    
-    RGBImageBuffer *fuzzyTextureImage = LoadImageBufferFromPNG("textures/fuzzy.png");
-    assert(fuzzyTextureImage);
-    GLuint fuzzyTextureID = CreateTextureFromImage(fuzzyTextureImage);
-    textureIDs.push_back(fuzzyTextureID);
-    
-    std::cout  << "Generating fractal browning motion" << std::endl;
-    RGBImageBuffer* fbmImage = GenerateFractalBrownianMotion(256 /*512*/, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 64, false);
-    assert(fbmImage);
-    GLuint fbmTextureID = CreateTextureFromImage(fbmImage);
-    textureIDs.push_back(fbmTextureID);
-    
-    // Add these all to list of unique ptrs for automatic cleanup.
-    imageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(redBlackCheckersImage));
-    imageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(marbleImage));
-    imageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(rockyTextureImage));
-    imageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(marsTextureImage));
-    imageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(fuzzyTextureImage));
-    imageBuffers.push_back(std::unique_ptr<RGBImageBuffer>(fbmImage));
-    
-    // Lighting
-    frameState->globalAmbient = glm::vec3(1,1,1);
-    frameState->lightDiffuse = glm::vec3(1,1,1);
-    frameState->lightSpecular = glm::vec3(1,1,1);
-    
-    // TODO: setup materials for each shape
-    Material plainWhiteMaterial = Material(glm::vec3(0.1, 0.1, 0.1), glm::vec3(1,1,1), glm::vec3(1,1,1), 15);
-    
-    // Shapes
-    std::list<std::unique_ptr<ModelObject>> objects;
-    
-    // Triangle
-    objects.push_back(std::make_unique<ModelObject>());
-    ModelObject* triObjPtr = objects.back().get();
-    {
-        MakeTriangle(*triObjPtr);
-        BindObjectBuffers(*triObjPtr);
-        
-        triObjPtr->textureID = marbleTextureID;
-        triObjPtr->material = plainWhiteMaterial;
-    }
-    
-    // CUBE
-    objects.push_back(std::make_unique<ModelObject>());
-    ModelObject* cubeObjPtr = objects.back().get();
-    {
-        
-        GenerateCube(cubeObjPtr->vertexData, cubeObjPtr->texCoords);
-        GenerateNormals(cubeObjPtr->vertexData, cubeObjPtr->normals);
-        BindObjectBuffers(*cubeObjPtr);
-        
-        cubeObjPtr->textureID = fbmTextureID;
-        cubeObjPtr->material = plainWhiteMaterial;
-    }
-    
-    // CUBE TWO
-    objects.push_back(std::make_unique<ModelObject>());
-    ModelObject* cubeTwoObjPtr = objects.back().get();
-    {
-        GenerateCube(cubeTwoObjPtr->vertexData, cubeTwoObjPtr->texCoords);
-        GenerateNormals(cubeTwoObjPtr->vertexData, cubeTwoObjPtr->normals);
-        BindObjectBuffers(*cubeTwoObjPtr);
-        
-        cubeTwoObjPtr->textureID = rockyTextureImageID;
-        cubeTwoObjPtr->material = plainWhiteMaterial;
-    }
-        
-    // SPHERE
-    objects.push_back(std::make_unique<ModelObject>());
-    ModelObject* sphereObjPtr = objects.back().get();
-    {
-        GenerateSphere(1.5, 20, 25, sphereObjPtr->vertexData, sphereObjPtr->normals, sphereObjPtr->texCoords, sphereObjPtr->vertexIndexes);
-        BindObjectBuffers(*sphereObjPtr);
-        
-        sphereObjPtr->isIndexed = true;
-        
-        sphereObjPtr->textureID = marsTextureImageID;
-        sphereObjPtr->material = plainWhiteMaterial;
-    }
-    
-    // Pyramid
-    objects.push_back(std::make_unique<ModelObject>());
-    ModelObject* pyramidObjPtr = objects.back().get();
-    {
-        GeneratePyramid(pyramidObjPtr->vertexData, pyramidObjPtr->texCoords);
-        GenerateNormals(pyramidObjPtr->vertexData, pyramidObjPtr->normals);
-        BindObjectBuffers(*pyramidObjPtr);
-        
-        pyramidObjPtr->textureID = blueGreenCheckersTextureID;
-        pyramidObjPtr->material = plainWhiteMaterial;
-    }
-    
-    // Triangle mesh loaded from SMF file.
-    objects.push_back(std::make_unique<ModelObject>());
-    ModelObject* meshObjPtr = objects.back().get();
-    {
-        // TODO: refactor mesh loading into a function.
-        TriangleMesh mesh;
-        const char* meshPath = "mesh/bound-bunny_200.smf";
-        if(!mesh.LoadFromSMF(meshPath)) {
-            std::cerr << "Error loading mesh from " << meshPath << std::endl;
-            
-        } else {
-            
-            mesh.CalcNormals();
-            MakeMeshObject(mesh, *meshObjPtr);
-            BindObjectBuffers(*meshObjPtr);
-            
-            // todo: use a better texture.
-            meshObjPtr->textureID = redBlackCheckersTextureID;
-            meshObjPtr->material = plainWhiteMaterial;
-        }
-    }
-    
-    // Second mesh
-    objects.push_back(std::make_unique<ModelObject>());
-    ModelObject* meshTwoObjPtr = objects.back().get();
-    {
-        TriangleMesh meshTwo;
-        
-        const char* meshTwoPath = "mesh/teddy.smf";
-        if(!meshTwo.LoadFromSMF(meshTwoPath)) {
-            std::cerr << "Error loading mesh from " << meshTwoPath << std::endl;
-            
-        } else {
-            
-            meshTwo.CalcNormals();
-            
-            MakeMeshObject(meshTwo, *meshTwoObjPtr);
-            
-            BindObjectBuffers(*meshTwoObjPtr);
-            
-            // todo: use a better texture.
-            meshTwoObjPtr->textureID = fuzzyTextureID;
-            meshTwoObjPtr->material = plainWhiteMaterial;
-        }
-    }
-    
-    frameState->lightPosition = glm::vec3 {-5, 5, 0};
-
-    // Rotation angles and speeds
-    float triAngle = 0.0f;
-    float cubeAngle = 0.0f;
-    float sphereAngle = 0.0f;
-    float pyramidAngle = 0.0f;
-    float meshAngle = 0.0f;
-    
-    const float kTriRotSpeed = 0.02;
-    const float kCubeRotSpeed = 0.03;
-    const float kSphereRotSpeed = 0.01;
-    const float kPyramidRotSpeed = 0.025;
-    const float kMeshRotSpeed = 0.025;
+    // --profile starts with the per pass profiler on, P toggles it.
+    scene->SetProfiling(HasArg(argc, argv, "--profile"));
     
     std::cout  << "starting main loop" << std::endl;
     
-    bool rotating = true;
-    
-    glUseProgram(program);
- 
-    // setup basic model transforms
-    
-    triObjPtr->PushModelMatrix(glm::scale(triObjPtr->ModelMatrix(), glm::vec3(0.6f, 0.5f, 0.5f)));
-    
-    cubeObjPtr->PushModelMatrix(glm::translate(cubeObjPtr->ModelMatrix(), glm::vec3(-2.5, 0, -4)));
-    cubeObjPtr->PushModelMatrix(glm::scale(cubeObjPtr->ModelMatrix(), glm::vec3(0.6f, 0.5f, 0.5f)));
-    
-    cubeTwoObjPtr->PushModelMatrix( glm::translate(cubeTwoObjPtr->ModelMatrix(), glm::vec3(2.5, 0, -4)) );
-    cubeTwoObjPtr->PushModelMatrix( glm::scale(cubeTwoObjPtr->ModelMatrix(), glm::vec3(0.6f, 0.5f, 0.5f)) );
-    
-    sphereObjPtr->PushModelMatrix( glm::translate(sphereObjPtr->ModelMatrix(), glm::vec3(0, 1.0, -4)) );
-    sphereObjPtr->PushModelMatrix( glm::scale(sphereObjPtr->ModelMatrix(), glm::vec3(0.5f, 0.5f, 0.5f)) );
-    sphereObjPtr->PushModelMatrix( glm::rotate(sphereObjPtr->ModelMatrix(), (float)(PI / 2), glm::vec3(1.0, 0, 0)) );
-    
-    pyramidObjPtr->PushModelMatrix( glm::translate(pyramidObjPtr->ModelMatrix(), glm::vec3(0, -2, -4)) );
-    pyramidObjPtr->PushModelMatrix(  glm::rotate(pyramidObjPtr->ModelMatrix(), (float)(PI / 8.0f), glm::vec3(1, 0, 0)) );
-    
-    meshObjPtr->PushModelMatrix( glm::translate(meshObjPtr->ModelMatrix(), glm::vec3(-2, -2, -5)) );
-    meshObjPtr->PushModelMatrix(  glm::scale(meshObjPtr->ModelMatrix(), glm::vec3(1.5, 1.5, 1.8)) );
-    
-    meshTwoObjPtr->PushModelMatrix( glm::translate(meshTwoObjPtr->ModelMatrix(), glm::vec3(2, -2, -5)) );
-    meshTwoObjPtr->PushModelMatrix(  glm::scale(meshTwoObjPtr->ModelMatrix(), glm::vec3(0.05, 0.05, 0.05)) );
-
-    
-    
-    // TODO: you are here working on model matrix push down stack.
-    for(auto& modelObj : objects) {
-        modelObj->Hide();
-    }
-    triObjPtr->Show();
-    cubeObjPtr->Show();
-    cubeTwoObjPtr->Show();
-    sphereObjPtr->Show();
-    pyramidObjPtr->Show();
-    meshObjPtr->Show();
-    meshTwoObjPtr->Show();
+    bool mouseWasDown = false;
+    bool cullKeyWasDown = false;
+    bool occlusionKeyWasDown = false;
+    bool instancingKeyWasDown = false;
+    bool arenaKeyWasDown = false;
+    bool profileKeyWasDown = false;
     
     while( glfwGetKey(frameState->window, GLFW_KEY_ESCAPE ) != GLFW_PRESS &&
            glfwWindowShouldClose(frameState->window) == 0 ) {
@@ -401,64 +245,66 @@ int main(int argc, const char** argv)
         
         //static void DrawFrame(void)
         {
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-            
-            glEnableVertexAttribArray(frameState->aPositionLocation);
-            
-            glUniformMatrix4fv(frameState->projUniformLocation, 1, GL_FALSE, glm::value_ptr(frameState->projMatrix));
-            glUniformMatrix4fv(frameState->vUniformLocation, 1, GL_FALSE, glm::value_ptr(frameState->viewMatrix));
-            glUniform3f(frameState->lightPositionID,
-                        frameState->lightPosition.x, frameState->lightPosition.y, frameState->lightPosition.z);
-
-
-            glUniform3f(frameState->globalAmbientID,
-                        frameState->globalAmbient.r, frameState->globalAmbient.g, frameState->globalAmbient.b);
-            glUniform3f(frameState->lightDiffuseID,
-                        frameState->lightDiffuse.r, frameState->lightDiffuse.g, frameState->lightDiffuse.b);
-            glUniform3f(frameState->lightSpecularID,
-                        frameState->lightSpecular.r, frameState->lightSpecular.g, frameState->lightSpecular.b);
+            TRACE_ZONE("frame", "frame");
+            scene->rotating = glfwGetKey( frameState->window, GLFW_KEY_SPACE ) != GLFW_PRESS;
+            scene->BeginFrame();
             
-            
-            if (glfwGetKey( frameState->window, GLFW_KEY_SPACE ) == GLFW_PRESS) {
-                rotating = false;
-            } else {
-                rotating = true;
+            // Pick on mouse down while the model matrices for this frame are still pushed.
+            bool mouseDown = glfwGetMouseButton(frameState->window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+            if(mouseDown && !mouseWasDown) {
+                double cursorX, cursorY;
+                int windowWidth, windowHeight;
+                glfwGetCursorPos(frameState->window, &cursorX, &cursorY);
+                glfwGetWindowSize(frameState->window, &windowWidth, &windowHeight);
+                
+                PickResult pick;
+                auto pickStart = std::chrono::high_resolution_clock::now();
+                bool picked = PickObject(frameState.get(), scene->Objects(), cursorX, cursorY, windowWidth, windowHeight, pick);
+                auto pickEnd = std::chrono::high_resolution_clock::now();
+                auto pickMicros = std::chrono::duration<double, std::micro>(pickEnd - pickStart).count();
+                
+                if(picked) {
+                    std::cout << "Picked object " << pick.objectID << " triangle " << pick.triangleID
+                        << " in " << pickMicros << " us" << std::endl;
+                } else {
+                    std::cout << "Picked nothing in " << pickMicros << " us" << std::endl;
+                }
             }
-
-            triObjPtr->PushModelMatrix(glm::rotate(triObjPtr->ModelMatrix(), triAngle, glm::vec3(0, 0.2, 1)));
+            mouseWasDown = mouseDown;
             
-            cubeObjPtr->PushModelMatrix(glm::rotate(cubeObjPtr->ModelMatrix(), cubeAngle, glm::vec3(0.5, 0.0, 0.5)));
-            cubeTwoObjPtr->PushModelMatrix(glm::rotate(cubeTwoObjPtr->ModelMatrix(), cubeAngle, glm::vec3(0.5, 0.0, 0.5)));
+            if(KeyPressedOnce(frameState->window, GLFW_KEY_C, cullKeyWasDown)) {
+                scene->SetCulling(!scene->CullingEnabled());
+                std::cout << "Frustum culling " << (scene->CullingEnabled() ? "on" : "off") << std::endl;
+            }
             
-            sphereObjPtr->PushModelMatrix(glm::rotate(sphereObjPtr->ModelMatrix(), sphereAngle, glm::vec3(0.0, 0.1, 1.0)));
-
-            pyramidObjPtr->PushModelMatrix(glm::rotate(pyramidObjPtr->ModelMatrix(), pyramidAngle, glm::vec3(0, 1, 0)));
+            if(KeyPressedOnce(frameState->window, GLFW_KEY_I, instancingKeyWasDown)) {
+                scene->SetInstancing(!scene->InstancingEnabled());
+                std::cout << "Instancing " << (scene->InstancingEnabled() ? "on" : "off") << std::endl;
+            }
             
-            meshObjPtr->PushModelMatrix(glm::rotate(meshObjPtr->ModelMatrix(), meshAngle, glm::vec3(0, 1, 0)) );
-            meshTwoObjPtr->PushModelMatrix(glm::rotate(meshTwoObjPtr->ModelMatrix(), meshAngle, glm::vec3(1, 0, 0)));
-
-            if(rotating) {
-                triAngle += kTriRotSpeed;
-                cubeAngle += kCubeRotSpeed;
-                sphereAngle += kSphereRotSpeed;
-                pyramidAngle += kPyramidRotSpeed;
-                meshAngle += kMeshRotSpeed;
+            if(KeyPressedOnce(frameState->window, GLFW_KEY_G, arenaKeyWasDown)) {
+                scene->SetArena(!scene->ArenaEnabled());
+                std::cout << "Geometry arena " << (scene->ArenaEnabled() ? "on" : "off") << std::endl;
             }
             
-            for(auto& modelObj : objects) {
-                DrawObject(frameState.get(), *modelObj, frameState->viewMatrix, frameState->mUniformLocation, frameState->normMatUniformLocation);
+            if(KeyPressedOnce(frameState->window, GLFW_KEY_O, occlusionKeyWasDown)) {
+                scene->SetOcclusion(!scene->OcclusionEnabled());
+                std::cout << "Occlusion culling " << (scene->OcclusionEnabled() ? "on" : "off") << std::endl;
             }
-                 
-            for(auto& modelObj : objects) {
-                if(modelObj->modelMatrixStack.size() > 1) {
-                    modelObj->PopModelMatrix() ;
-                }
+            
+            if(KeyPressedOnce(frameState->window, GLFW_KEY_P, profileKeyWasDown)) {
+                scene->SetProfiling(!scene->ProfilingEnabled());
+                std::cout << "Profiler " << (scene->ProfilingEnabled() ? "on" : "off") << std::endl;
             }
-
-            glDisableVertexAttribArray(frameState->aPositionLocation);
             
+            scene->Cull();
+            scene->Submit();
+            scene->EndFrame();
             
-            glfwSwapBuffers(frameState->window);
+            {
+                TRACE_ZONE("frame", "glfwSwapBuffers");
+                glfwSwapBuffers(frameState->window);
+            }
         }
 
         glfwPollEvents();
@@ -468,24 +314,8 @@ int main(int argc, const char** argv)
     std::cout  << "cleaning up" << std::endl;
     
 
-    //  Cleanup GL stuff
-    
-    glDeleteProgram(program);
-    
-    for(auto textureID: textureIDs) {
-        glDeleteTextures(1, &textureID);
-    }
-        
-    glDeleteVertexArrays(1, &frameState->VertexArrayID);
-    
-    for(const auto& modelObj : objects) {
-        glDeleteBuffers(1, &modelObj->vertexBuffer);
-        glDeleteBuffers(1, &modelObj->uvBuffer);
-        glDeleteBuffers(1, &modelObj->normalBuffer);
-        if(modelObj->isIndexed) {
-            glDeleteBuffers(1, &modelObj->indexBuffer);
-        }
-    }
+    //  Cleanup GL stuff, before the context goes.
+    scene.reset();
     
     glfwTerminate();
     std::cout << "GL setup exiting cleanly\n";
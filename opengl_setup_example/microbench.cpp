@@ -0,0 +1,211 @@
+//
+//  microbench.cpp
+//  opengl_setup_example
+//
+
+#include "microbench.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "dbgutils.h"
+
+MicroBench::MicroBench(int warmupReps, int reps, const std::string& filter)
+    : mWarmupReps(warmupReps), mReps(std::max(reps, 1)), mFilter(filter), mLog(&std::cout)
+{
+}
+
+bool MicroBench::Selected(const std::string& name) const
+{
+    return mFilter.empty() || name.find(mFilter) != std::string::npos;
+}
+
+void MicroBench::Run(const std::string& name, int items, const std::function<void()>& fn)
+{
+    if(!Selected(name)) {
+        return;
+    }
+    for(int i = 0; i < mWarmupReps; i++) {
+        fn();
+    }
+    std::vector<double> repNanos(mReps);
+    for(int i = 0; i < mReps; i++) {
+        auto start = std::chrono::high_resolution_clock::now();
+        fn();
+        auto end = std::chrono::high_resolution_clock::now();
+        repNanos[i] = std::chrono::duration<double, std::nano>(end - start).count();
+    }
+    mResults.push_back(Summarize(name, items, repNanos));
+
+    if(!mLog) {
+        return;
+    }
+    const BenchResult& result = mResults.back();
+    char line[256];
+    snprintf(line, sizeof(line), "%-40s %12.1f ns/op median, %12.1f min, +/-%5.1f%%, %d x %d\n",
+             result.name.c_str(), result.medianNanos, result.minNanos, result.spreadPercent, result.reps, result.items);
+    *mLog << line << std::flush;
+}
+
+BenchResult MicroBench::Summarize(const std::string& name, int items, std::vector<double>& repNanos)
+{
+    BenchResult result;
+    result.name = name;
+    result.items = std::max(items, 1);
+    result.reps = (int)repNanos.size();
+    if(repNanos.empty()) {
+        return result;
+    }
+    for(double& nanos : repNanos) {
+        nanos /= result.items;
+    }
+    std::sort(repNanos.begin(), repNanos.end());
+
+    double total = 0;
+    for(double nanos : repNanos) {
+        total += nanos;
+    }
+    result.meanNanos = total / repNanos.size();
+    double variance = 0;
+    for(double nanos : repNanos) {
+        variance += (nanos - result.meanNanos) * (nanos - result.meanNanos);
+    }
+    variance /= repNanos.size();
+
+    size_t mid = repNanos.size() / 2;
+    result.medianNanos = repNanos.size() % 2 == 0 ? (repNanos[mid - 1] + repNanos[mid]) * 0.5 : repNanos[mid];
+    result.minNanos = repNanos.front();
+    result.maxNanos = repNanos.back();
+    result.spreadPercent = result.meanNanos > 0 ? 100.0 * std::sqrt(variance) / result.meanNanos : 0;
+    return result;
+}
+
+void MicroBench::WriteJSON(std::ostream& out) const
+{
+    out << "{\"benchmarks\": [\n";
+    for(size_t i = 0; i < mResults.size(); i++) {
+        const BenchResult& result = mResults[i];
+        out << "  {\"name\": \"" << result.name << "\", \"median_ns\": " << result.medianNanos
+            << ", \"min_ns\": " << result.minNanos << ", \"mean_ns\": " << result.meanNanos
+            << ", \"max_ns\": " << result.maxNanos << ", \"spread_pct\": " << result.spreadPercent
+            << ", \"reps\": " << result.reps << ", \"items\": " << result.items << "}"
+            << (i + 1 < mResults.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+}
+
+bool MicroBench::WriteJSON(const char* path) const
+{
+    std::ofstream out(path);
+    if(!out) {
+        std::cerr << "Unable to open " << path << " for writing" << std::endl;
+        return false;
+    }
+    out.precision(10);
+    WriteJSON(out);
+    return true;
+}
+
+void MicroBench::ParseBaseline(std::istream& in, std::map<std::string, double>& outMedians)
+{
+    // Only the layout WriteJSON makes, one benchmark object per line.
+    const std::string nameKey = "\"name\": \"";
+    const std::string medianKey = "\"median_ns\": ";
+    std::string line;
+    while(std::getline(in, line)) {
+        size_t namePos = line.find(nameKey);
+        size_t medianPos = line.find(medianKey);
+        if(namePos == std::string::npos || medianPos == std::string::npos) {
+            continue;
+        }
+        namePos += nameKey.size();
+        size_t nameEnd = line.find('"', namePos);
+        if(nameEnd == std::string::npos) {
+            continue;
+        }
+        outMedians[line.substr(namePos, nameEnd - namePos)] = strtod(line.c_str() + medianPos + medianKey.size(), nullptr);
+    }
+}
+
+bool MicroBench::ReadBaseline(const char* path, std::map<std::string, double>& outMedians)
+{
+    std::ifstream in(path);
+    if(!in) {
+        std::cerr << "Unable to open baseline " << path << std::endl;
+        return false;
+    }
+    ParseBaseline(in, outMedians);
+    return true;
+}
+
+int MicroBench::CompareToBaseline(const std::map<std::string, double>& baseline, double threshold, std::ostream& out) const
+{
+    int regressions = 0;
+    char line[256];
+    for(const BenchResult& result : mResults) {
+        auto found = baseline.find(result.name);
+        if(found == baseline.end() || found->second <= 0) {
+            snprintf(line, sizeof(line), "%-40s %12.1f ns/op, not in baseline\n", result.name.c_str(), result.medianNanos);
+            out << line;
+            continue;
+        }
+        double change = (result.medianNanos - found->second) / found->second;
+        bool regressed = change > threshold;
+        regressions += regressed ? 1 : 0;
+        snprintf(line, sizeof(line), "%-40s %12.1f ns/op, baseline %12.1f, %+6.1f%%%s\n", result.name.c_str(),
+                 result.medianNanos, found->second, 100.0 * change, regressed ? "  REGRESSION" : "");
+        out << line;
+    }
+    return regressions;
+}
+
+bool MicroBench::Test(void)
+{
+    const std::vector<double> kRepNanos = { 400, 100, 300, 200 };
+    std::vector<double> reps = kRepNanos;
+    BenchResult result = Summarize("sum", 10, reps);
+    DbgAssert(result.reps == 4);
+    DbgAssertAlmostEqual(result.medianNanos, 25.0);
+    DbgAssertAlmostEqual(result.meanNanos, 25.0);
+    DbgAssertAlmostEqual(result.minNanos, 10.0);
+    DbgAssertAlmostEqual(result.maxNanos, 40.0);
+    DbgAssertAlmostEqual(result.spreadPercent, 100.0 * std::sqrt(125.0) / 25.0, 1e-6);
+
+    MicroBench bench(1, 3, "keep");
+    bench.SetLog(nullptr);
+    int calls = 0;
+    bench.Run("keep/a", 1, [&] { calls++; });
+    bench.Run("skip/b", 1, [&] { calls++; });
+    DbgAssert(calls == 4);
+    DbgAssert(bench.Results().size() == 1);
+
+    // Round trip through the JSON, then one result 50% slower than its baseline.
+    reps = kRepNanos;
+    bench.mResults.push_back(Summarize("keep/slow", 1, reps));
+    std::stringstream json;
+    bench.WriteJSON(json);
+    std::map<std::string, double> baseline;
+    ParseBaseline(json, baseline);
+    DbgAssert(baseline.size() == 2);
+    DbgAssertAlmostEqual(baseline["keep/slow"], 250.0);
+
+    std::ostringstream report;
+    DbgAssert(bench.CompareToBaseline(baseline, 0.1, report) == 0);
+    baseline["keep/slow"] = 250.0 / 1.5;
+    baseline.erase("keep/a");
+    std::ostringstream regressionReport;
+    DbgAssert(bench.CompareToBaseline(baseline, 0.1, regressionReport) == 1);
+    DbgAssert(regressionReport.str().find("REGRESSION") != std::string::npos);
+    DbgAssert(regressionReport.str().find("not in baseline") != std::string::npos);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
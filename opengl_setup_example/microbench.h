@@ -0,0 +1,80 @@
+//
+//  microbench.h
+//  opengl_setup_example
+//
+
+#ifndef microbench_hpp
+#define microbench_hpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <ostream>
+
+// Per operation timings for one benchmark, over every timed repetition.
+struct BenchResult {
+    std::string name;
+    // operations each repetition does, the times below are divided by it.
+    int items;
+    int reps;
+    double minNanos;
+    double medianNanos;
+    double meanNanos;
+    double maxNanos;
+    // standard deviation over the mean, in percent.
+    double spreadPercent;
+
+    BenchResult() : items(0), reps(0), minNanos(0), medianNanos(0), meanNanos(0), maxNanos(0), spreadPercent(0) {}
+};
+
+// Keeps the compiler from dropping a computation whose result is never used.
+template <typename T>
+inline void DoNotOptimize(const T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+// Runs each benchmark for some untimed warmup repetitions then times each of the rest
+// separately, so the results carry a spread as well as a median. Results go out as JSON,
+// one benchmark per line, which a later run reads back as its baseline to flag anything
+// that got slower.
+class MicroBench {
+private:
+    int mWarmupReps;
+    int mReps;
+    // only benchmarks whose name contains this run, all of them when empty.
+    std::string mFilter;
+    std::vector<BenchResult> mResults;
+    // each result is printed here as it finishes, unless null.
+    std::ostream* mLog;
+
+public:
+    MicroBench(int warmupReps, int reps, const std::string& filter = "");
+
+    bool Selected(const std::string& name) const;
+    void SetLog(std::ostream* log) { mLog = log; }
+
+    // Times fn, which does items operations per call. Prints and keeps the result.
+    // Does nothing if name is filtered out.
+    void Run(const std::string& name, int items, const std::function<void()>& fn);
+
+    const std::vector<BenchResult>& Results(void) const { return mResults; }
+
+    void WriteJSON(std::ostream& out) const;
+    bool WriteJSON(const char* path) const;
+
+    // Median ns per operation by name, from JSON written by WriteJSON.
+    static bool ReadBaseline(const char* path, std::map<std::string, double>& outMedians);
+    static void ParseBaseline(std::istream& in, std::map<std::string, double>& outMedians);
+
+    // Prints each result against the baseline and returns how many are more than
+    // threshold, 0.1 for 10%, slower than it.
+    int CompareToBaseline(const std::map<std::string, double>& baseline, double threshold, std::ostream& out) const;
+
+    static BenchResult Summarize(const std::string& name, int items, std::vector<double>& repNanos);
+
+    static bool Test(void);
+};
+
+#endif /* microbench_hpp */
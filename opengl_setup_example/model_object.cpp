@@ -8,102 +8,128 @@
 #include "model_object.h"
 #include "textures.h"
 #include "frame_state.h"
+#include "uniform_buffers.h"
+#include "gl_state.h"
+#include "gl_backend.h"
+#include "trace.h"
 
-void DrawObject( FrameState* frameState, ModelObject& obj, glm::mat4 viewMat, GLuint mMatUniformLocation, GLuint normMatUniformLocation)
+int32_t ModelObject::mNextID = 0;
+
+void DrawObject(FrameState* frameState, ModelObject& obj)
 {
-    if(obj.isVisible == false) {
+    if(obj.isVisible == false || obj.isCulled || obj.isInstance || !obj.geometry || obj.transformSlot < 0) {
         return;
     }
-    glm::mat4& modelMat = obj.ModelMatrix();
-    
-    glUniformMatrix4fv(mMatUniformLocation, 1, GL_FALSE, glm::value_ptr(modelMat));
-    
-    auto mv = viewMat * modelMat;
-    glm::mat4 normMat = glm::transpose(glm::inverse(mv));
-    
-    glUniformMatrix4fv(normMatUniformLocation, 1, GL_FALSE, glm::value_ptr(normMat));
-    
-    // Set material properties.
-    glUniform3f(frameState->materialAmbientID,
-                obj.material.ambient.r, obj.material.ambient.g, obj.material.ambient.b);
-    glUniform3f(frameState->materialDiffuseID,
-                obj.material.diffuse.r, obj.material.diffuse.g, obj.material.diffuse.b);
-    glUniform3f(frameState->materialSpecularID,
-                obj.material.specular.r, obj.material.specular.g, obj.material.specular.b);
-    glUniform1f(frameState->materialSpecExpID, obj.material.specExp);
-    
-    
-    glBindBuffer(GL_ARRAY_BUFFER, obj.vertexBuffer);
-    glVertexAttribPointer(
-       0,
-       3,
-       GL_FLOAT,
-       GL_FALSE,
-       0,
-       (void*)0
-    );
+    DrawObjectGeometry(frameState, obj);
+}
 
+void DrawObjectGeometry(FrameState* frameState, const ModelObject& obj)
+{
+    const MeshGeometry& geom = *obj.geometry;
     
-    if(obj.texCoords.empty()) {
-        std::cerr << "Missing object texture coordinates" << std::endl;
-    } else {
-        glBindBuffer(GL_ARRAY_BUFFER, obj.uvBuffer);
-        glVertexAttribPointer( 1, 2, GL_FLOAT, GL_FALSE, 0, NULL);
-        glEnableVertexAttribArray( 1 );
-    }
-    
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, obj.textureID);
-   
-    if(obj.normals.size() > 0 ) {
-        glEnableVertexAttribArray( 2 );
-        glBindBuffer(GL_ARRAY_BUFFER, obj.normalBuffer);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-    }
+    // Transforms and materials were uploaded for the whole frame, only the ranges change per draw.
+    frameState->uniforms->BindObject(obj.transformSlot);
+    frameState->uniforms->BindMaterial(obj.materialSlot);
     
+    frameState->glState->ActiveTexture(GL_TEXTURE0);
+    frameState->glState->BindTexture(GL_TEXTURE_2D, obj.textureID);
     
+    // Buffers and attribute layout were recorded once in BindObjectBuffers.
+    frameState->glState->BindVertexArray(geom.vertexArray);
     
-    if(obj.isIndexed) {
-        if(obj.vertexIndexes.empty()) {
+    DrawGeometryElements(frameState->glState->Backend(), geom);
+}
+
+void DrawGeometryElements(GLBackend& backend, const MeshGeometry& geom)
+{
+    if(geom.isIndexed) {
+        if(geom.drawCount == 0) {
             std::cerr << "Missing object vertex indexes" << std::endl;
             return;
         }
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj.indexBuffer);
-        
-        glDrawElements(GL_TRIANGLES,                    // primitive type
-                       (GLsizei)obj.vertexIndexes.size(),   // # of indices
-                       GL_UNSIGNED_INT,                 // data type
-                       (void*)0);                       // offset to indices
+        backend.DrawElements(GL_TRIANGLES,              // primitive type
+                             geom.drawCount,            // # of indices
+                             GL_UNSIGNED_INT,           // data type
+                             0);                        // offset to indices
 
     } else {
-        glDrawArrays(GL_TRIANGLES, 0, (GLsizei)obj.vertexData.size());
+        backend.DrawArrays(GL_TRIANGLES, 0, geom.drawCount);
     }
-    
 }
 
-void BindObjectBuffers(ModelObject &obj)
+void BindObjectBuffers(GLBackend& backend, MeshGeometry& geom)
 {
-    glGenBuffers(1, &obj.vertexBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, obj.vertexBuffer);
-    glBufferData(GL_ARRAY_BUFFER, obj.vertexData.size() * sizeof(float), obj.vertexData.data(), GL_STATIC_DRAW);
+    TRACE_FUNCTION("gl");
+    geom.Finish();
+    
+    if(!geom.hasTexCoords) {
+        std::cerr << "Missing object texture coordinates" << std::endl;
+    }
+    
+    std::vector<float> interleaved;
+    InterleaveVertexData(geom.vertexData, geom.normals, geom.texCoords, interleaved);
     
-    glGenBuffers(1, &obj.uvBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, obj.uvBuffer);
-    glBufferData(GL_ARRAY_BUFFER, obj.texCoords.size() * sizeof(float), obj.texCoords.data(), GL_STATIC_DRAW);
+    geom.backend = &backend;
+    geom.vertexArray = backend.GenVertexArray();
+    backend.BindVertexArray(geom.vertexArray);
     
-    glGenBuffers(1, &obj.normalBuffer);
-    glBindBuffer(GL_ARRAY_BUFFER, obj.normalBuffer);
-    glBufferData(GL_ARRAY_BUFFER, obj.normals.size() * sizeof(float), obj.normals.data(), GL_STATIC_DRAW);
+    geom.vertexBuffer = backend.GenBuffer();
+    backend.BindBuffer(GL_ARRAY_BUFFER, geom.vertexBuffer);
+    backend.BufferData(GL_ARRAY_BUFFER, interleaved.size() * sizeof(float), interleaved.data(), GL_STATIC_DRAW);
+    geom.gpuBytes = interleaved.size() * sizeof(float);
     
-    if(obj.vertexIndexes.size() > 0) {
-        glGenBuffers(1, &obj.indexBuffer);
+    SetVertexAttributes(backend);
+    
+    if(geom.vertexIndexes.size() > 0) {
+        // The element buffer binding is part of the vertex array state.
+        geom.indexBuffer = backend.GenBuffer();
         assert(sizeof(GLuint) == sizeof(int));
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj.indexBuffer);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, obj.vertexIndexes.size() * sizeof(int), obj.vertexIndexes.data(), GL_STATIC_DRAW);
+        backend.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, geom.indexBuffer);
+        backend.BufferData(GL_ELEMENT_ARRAY_BUFFER, geom.vertexIndexes.size() * sizeof(int), geom.vertexIndexes.data(), GL_STATIC_DRAW);
+        geom.gpuBytes += geom.vertexIndexes.size() * sizeof(int);
+    }
+    
+    backend.BindVertexArray(0);
+    
+    // Nothing reads these on the CPU once they are in buffers.
+    std::vector<float>().swap(geom.texCoords);
+    std::vector<float>().swap(geom.normals);
+}
+
+void SetVertexAttributes(GLBackend& backend)
+{
+    const GLsizei stride = kVertexStride * sizeof(float);
+    backend.EnableVertexAttribArray(0);
+    backend.VertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
+    backend.EnableVertexAttribArray(1);
+    backend.VertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, kVertexUVOffset * sizeof(float));
+    backend.EnableVertexAttribArray(2);
+    backend.VertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, stride, kVertexNormalOffset * sizeof(float));
+}
+
+void InterleaveVertexData(const std::vector<float>& vertices, const std::vector<float>& normals,
+                          const std::vector<float>& texCoords, std::vector<float>& outInterleaved)
+{
+    const size_t vertexCount = vertices.size() / 3;
+    outInterleaved.assign(vertexCount * kVertexStride, 0.0f);
+    for(size_t i = 0; i < vertexCount; i++) {
+        float* dest = &outInterleaved[i * kVertexStride];
+        dest[0] = vertices[i*3];
+        dest[1] = vertices[i*3+1];
+        dest[2] = vertices[i*3+2];
+        if(normals.size() >= (i + 1) * 3) {
+            dest[kVertexNormalOffset] = normals[i*3];
+            dest[kVertexNormalOffset+1] = normals[i*3+1];
+            dest[kVertexNormalOffset+2] = normals[i*3+2];
+        }
+        if(texCoords.size() >= (i + 1) * 2) {
+            dest[kVertexUVOffset] = texCoords[i*2];
+            dest[kVertexUVOffset+1] = texCoords[i*2+1];
+        }
     }
 }
 
-void MakeTriangle(ModelObject& triObj)
+void MakeTriangle(MeshGeometry& triGeom)
 {
     static const float triVertexBufferData[] = {
        -1.0f, -1.0f, 0.0f,
@@ -116,40 +142,40 @@ void MakeTriangle(ModelObject& triObj)
         0.5, 1
     };
 
-    triObj.vertexData.assign(triVertexBufferData, triVertexBufferData + sizeof(triVertexBufferData)/sizeof(float));
+    triGeom.vertexData.assign(triVertexBufferData, triVertexBufferData + sizeof(triVertexBufferData)/sizeof(float));
     
-    GenerateNormals(triObj.vertexData, triObj.normals);
+    GenerateNormals(triGeom.vertexData, triGeom.normals);
     
-    triObj.texCoords.assign(triTexCoords, triTexCoords + sizeof(triTexCoords)/sizeof(float));
+    triGeom.texCoords.assign(triTexCoords, triTexCoords + sizeof(triTexCoords)/sizeof(float));
 }
 
 
-void MakeMeshObject(TriangleMesh& mesh, ModelObject& obj)
+void MakeMeshObject(TriangleMesh& mesh, MeshGeometry& geom)
 {
-    obj.vertexData.clear();
-    obj.normals.clear();
-    obj.vertexIndexes.clear();
+    geom.vertexData.clear();
+    geom.normals.clear();
+    geom.vertexIndexes.clear();
     
     for(auto v : mesh.GetVertices()) {
-        obj.vertexData.push_back(v.x);
-        obj.vertexData.push_back(v.y);
-        obj.vertexData.push_back(v.z);
+        geom.vertexData.push_back(v.x);
+        geom.vertexData.push_back(v.y);
+        geom.vertexData.push_back(v.z);
     }
     
     for(auto n : mesh.GetVertexNormals()) {
-        obj.normals.push_back(n.x);
-        obj.normals.push_back(n.y);
-        obj.normals.push_back(n.z);
+        geom.normals.push_back(n.x);
+        geom.normals.push_back(n.y);
+        geom.normals.push_back(n.z);
     }
     
     for(auto t : mesh.GetTriangles()) {
-        obj.vertexIndexes.push_back(t.vertex[0]);
-        obj.vertexIndexes.push_back(t.vertex[1]);
-        obj.vertexIndexes.push_back(t.vertex[2]);
+        geom.vertexIndexes.push_back(t.vertex[0]);
+        geom.vertexIndexes.push_back(t.vertex[1]);
+        geom.vertexIndexes.push_back(t.vertex[2]);
     }
-    obj.isIndexed = true;
+    geom.isIndexed = true;
     
-    AutoMapUV(mesh, obj.texCoords);
+    AutoMapUV(mesh, geom.texCoords);
 }
 
 
@@ -10,6 +10,7 @@
 
 #include <vector>
 #include <stack>
+#include <memory>
 
 // Define before OpenGL and GLUT includes to avoid deprecation messages
 #define GL_SILENCE_DEPRECATION
@@ -20,6 +21,7 @@
 #include <glm/ext.hpp>
 
 #include "trianglemesh.h"
+#include "geometry_cache.h"
 
 
 struct Material {
@@ -46,25 +48,43 @@ struct Material {
 };
 
 struct FrameState;
+class GLBackend;
 
 class ModelObject {
+private:
+    static int32_t mNextID;
     
 public:
-    std::vector<float> vertexData;
-    std::vector<float> texCoords;
-    std::vector<int> vertexIndexes;
-    std::vector<float> normals;
+    int32_t objectID;
+    // shared with every other object drawing the same mesh.
+    std::shared_ptr<const MeshGeometry> geometry;
     std::stack<glm::mat4> modelMatrixStack;
-    bool isIndexed;
     bool isVisible;
-    GLuint vertexBuffer, uvBuffer, indexBuffer, normalBuffer;
+    // set by the frustum and occlusion cullers each frame.
+    bool isCulled;
+    // drawn into the software depth buffer for occlusion culling.
+    bool isOccluder;
+    // geometry and drawing come from an InstancedBatch, DrawObject skips it.
+    bool isInstance;
+    // drawn after all opaque objects, sorted back to front with blending on.
+    bool isTransparent;
     GLuint textureID;
     Material material;
+    // slot of material in the UniformBuffers material buffer.
+    int materialSlot;
+    // slot of this frame's transforms in the object ring buffer, -1 when not drawn this frame.
+    int transformSlot;
     
     ModelObject() {
-        isIndexed = false;
+        // This is not thread safe, objects are created on the main thread.
+        objectID = ++ mNextID;
+        isCulled = false;
+        isOccluder = false;
+        isInstance = false;
+        isTransparent = false;
         textureID = -1;
-        vertexBuffer = uvBuffer  = indexBuffer = normalBuffer = -1;
+        materialSlot = 0;
+        transformSlot = -1;
         modelMatrixStack.push(glm::identity<glm::mat4>());
     };
     
@@ -84,13 +104,37 @@ public:
 };
 
 
-void DrawObject( FrameState* frameState, ModelObject& obj, glm::mat4 viewMat, GLuint mMatUniformLocation, GLuint normMatUniformLocation);
+void DrawObject(FrameState* frameState, ModelObject& obj);
 
-void BindObjectBuffers(ModelObject &obj);
+// Binds the object's transform and material slots, texture and vertex array and draws it,
+// without checking visibility. The object needs a transform slot for this frame.
+void DrawObjectGeometry(FrameState* frameState, const ModelObject& obj);
 
-void MakeTriangle(ModelObject& triObj);
+// Just the draw call, with the geometry's vertex array already bound.
+void DrawGeometryElements(GLBackend& backend, const MeshGeometry& geom);
 
-void MakeMeshObject(TriangleMesh& mesh, ModelObject& obj);
+// Interleaved vertex layout of uploaded geometry, in floats: position, normal, uv.
+constexpr int kVertexStride = 8;
+constexpr int kVertexNormalOffset = 3;
+constexpr int kVertexUVOffset = 6;
+
+// Uploads the geometry into one interleaved buffer plus an index buffer, and records
+// the attribute layout in a vertex array. Also finishes the geometry.
+// The geometry keeps backend to delete its buffers with.
+void BindObjectBuffers(GLBackend& backend, MeshGeometry& geom);
+
+// Points attributes 0 to 2 (position, uv, normal) at the interleaved buffer bound to
+// GL_ARRAY_BUFFER, recording them in the bound vertex array.
+void SetVertexAttributes(GLBackend& backend);
+
+// Packs separate position, normal and uv arrays into kVertexStride floats per vertex.
+// Missing normals or uvs are left as zero.
+void InterleaveVertexData(const std::vector<float>& vertices, const std::vector<float>& normals,
+                          const std::vector<float>& texCoords, std::vector<float>& outInterleaved);
+
+void MakeTriangle(MeshGeometry& triGeom);
+
+void MakeMeshObject(TriangleMesh& mesh, MeshGeometry& geom);
 
 void GenerateNormals(const std::vector<float>& vertices, std::vector<float>& normals);
 
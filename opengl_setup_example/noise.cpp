@@ -6,8 +6,14 @@
 //
 
 #include <cstdlib>
+#include <cmath>
 #include <ctime>
 #include <cstdio>
+#include <cstdint>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <thread>
 
 #include "dbgutils.h"
 #include "mathutil.h"
@@ -16,23 +22,22 @@ using namespace std;
 
 #include "noise.h"
 
-static bool sNoiseInitialized = false;
-static int sPerm[256];
 
-
-inline double ImpSplineInterp(double u)
+template<typename Real> inline Real ImpSplineInterp(Real u)
 {
     // 6t^5 - 15t^4 + 10t^3 from Perlin 2002
-    double u2 = u*u;
-    double u3 = u2*u;
-    double u4 = u2*u2;
-    double u5 = u2*u3;
+    Real u2 = u*u;
+    Real u3 = u2*u;
+    Real u4 = u2*u2;
+    Real u5 = u2*u3;
     return 6 * u5 - 15 * u4 + 10 * u3;
 }
 
-inline int Perm(int x)
+// The slope of ImpSplineInterp, 30t^4 - 60t^3 + 30t^2.
+template<typename Real> inline Real ImpSplineDeriv(Real u)
 {
-    return sPerm[ x & 0xff ];
+    Real v = u * (u - 1);
+    return 30 * v * v;
 }
 
 static const Vector3 sGradValues[] = {
@@ -57,6 +62,11 @@ static const Vector3 sGradValues[] = {
     { 0,-1, -1}
 };
 
+// sGradValues split by axis for the batch kernels.
+static const int8_t sGradX[] = { 1, -1, 1, -1,   1, -1, 1, -1,   0, 0, 0, 0,    1, 0, -1, 0 };
+static const int8_t sGradY[] = { 1, 1, -1, -1,   0, 0, 0, 0,     1, -1, 1, -1,  1, -1, 1, -1 };
+static const int8_t sGradZ[] = { 0, 0, 0, 0,     1, 1, -1, -1,   1, 1, -1, -1,  0, 1, 0, -1 };
+
 inline double Gradient(int hashVal, Vector3 frac)
 {
     int lo4 = hashVal & 0xF;
@@ -64,38 +74,78 @@ inline double Gradient(int hashVal, Vector3 frac)
     return DotProduct(sGradValues[lo4], frac);
 }
 
-void InitNoise()
+// Gradient in the z = 0 plane.
+template<typename Real> inline Real Gradient2D(int hashVal, Real fx, Real fy)
 {
-    srand ( 11587  ); // larger prime numbers.
+    int lo4 = hashVal & 0xF;
     
+    return sGradX[lo4] * fx + sGradY[lo4] * fy;
+}
+
+// floor(v) as an int64, with the fraction of v above it in frac, without the library call,
+// which would stop the loops over lanes vectorizing. Every value past 2^62 is whole, so v is
+// clamped there first, keeping the cast defined and the fraction 0.
+template<typename Real> inline int64_t LaneFloor(Real v, Real& frac)
+{
+    constexpr Real kLimit = (Real)4611686018427387904.0;
+    Real clamped = std::min(std::max(v, -kLimit), kLimit);
+    int64_t whole = (int64_t)clamped;
+    whole -= clamped < (Real)whole ? 1 : 0;
+    frac = clamped - (Real)whole;
+    return whole;
+}
+
+// The lattice cell of a floored coordinate, the low 8 bits of its magnitude. Casting to
+// int is undefined past int's range, where x86 gave INT_MIN and so cell 0, which stays the
+// cell there so the high octaves of a texture don't change, now on every build.
+template<typename T> inline int LatticeCell(T whole)
+{
+    T magnitude = TAbs(whole);
+    return magnitude < (T)2147483648.0 ? (int)magnitude & 0xff : 0;
+}
+
+// cell wrapped into [0, period).
+inline int WrapCell(int cell, int period)
+{
+    int wrapped = cell % period;
+    return wrapped < 0 ? wrapped + period : wrapped;
+}
+
+NoiseGenerator::NoiseGenerator(uint32_t seed)
+: mSeed(seed)
+{
     for(int i=0; i < 256; i++) {
-        sPerm[i] = i;
+        mPerm[i] = i;
     }
     
-    // Randomly shuffled array, aka permutation
+    // Randomly shuffled array, aka permutation. minstd_rand0 is the generator behind
+    // rand() on macOS, so the default seed gives the table this noise always had.
+    std::minstd_rand0 rng(seed);
     for(int i=0; i < 256; i++) {
-        int selected = rand() % (256 - i);
-        int temp = sPerm[i];
-        sPerm[i] = sPerm[selected];
-        sPerm[selected] = temp;
+        int selected = (int)(rng() % (256 - i));
+        int temp = mPerm[i];
+        mPerm[i] = mPerm[selected];
+        mPerm[selected] = temp;
     }
-    sNoiseInitialized = true;
+}
+
+const NoiseGenerator& NoiseGenerator::Default(void)
+{
+    // built on first use, which C++ makes safe from several threads at once.
+    static const NoiseGenerator sDefault;
+    return sDefault;
 }
 
 // This is Perlin improved noise funcion.
-double ImpPerlinNoise(Vector3 p)
+double NoiseGenerator::ImpPerlinNoise(Vector3 p) const
 {
-    if(!sNoiseInitialized) {
-        InitNoise();
-    }
-    
     // whole and fractional parts of p.
     Vector3 pf = Vector3(floor(p.x), floor(p.y), floor(p.z));
     
     int  xInt, yInt, zInt;
-    xInt = TAbs((int)pf.x) & 0xff;
-    yInt = TAbs((int)pf.y) & 0xff;
-    zInt = TAbs((int)pf.z) & 0xff;
+    xInt = LatticeCell(pf.x);
+    yInt = LatticeCell(pf.y);
+    zInt = LatticeCell(pf.z);
 
     Vector3 frac = p - pf;
     
@@ -107,7 +157,9 @@ double ImpPerlinNoise(Vector3 p)
     
     // Compute hash values for all the corners of the lattice cube.
     
-    int h1[2], h2[4], h3[8];
+    // The last corner reads one past the four h2 hashes, which was h1[0] in the
+    // builds the textures were made with, so that is kept as h2[4].
+    int h1[2], h2[5], h3[8];
     h1[0] = Perm(xInt)   + yInt;
     h1[1] = Perm(xInt+1) + yInt;
     
@@ -116,6 +168,7 @@ double ImpPerlinNoise(Vector3 p)
     
     h2[2] = Perm(h1[1]    ) + zInt;
     h2[3] = Perm(h1[1] + 1) + zInt;
+    h2[4] = h1[0];
     
     Vector3 offset[8];
     
@@ -142,16 +195,16 @@ double ImpPerlinNoise(Vector3 p)
 }
 
 
-double FBM(Vector3 p, double gain, double lacun,
-           double freqMin, double min, double max,
-           int octaves, bool abs)
+double NoiseGenerator::FBM(Vector3 p, double gain, double lacun,
+                           double freqMin, double min, double max,
+                           int octaves, bool abs, NoiseBasis basis) const
 {
     double amp, freq, accum;
     amp = 1;
     freq = freqMin;
     accum = 0;
     for(int i=0; i < octaves; i++) {
-        double n = ImpPerlinNoise(p * freq);
+        double n = basis == kNoiseSimplex ? SimplexNoise(p * freq) : ImpPerlinNoise(p * freq);
         if(abs && n < 0.0)
             n = -n;
         accum += amp * n;
@@ -166,15 +219,1026 @@ double FBM(Vector3 p, double gain, double lacun,
     return fbm;
 }
 
-double Turbulence(Vector3 p, double freqMin, int octaves)
+double NoiseGenerator::Turbulence(Vector3 p, double freqMin, int octaves, NoiseBasis basis) const
+{
+    return FBM(p, 0.5, 2.0, 1, 0, 1, 4, true, basis);
+}
+
+
+template<typename Real> inline Real Lerp(Real a, Real b, Real u)
+{
+    return a + u * (b - a);
+}
+
+// ImpPerlinNoise for kNoiseBatchLanes points. Each stage is a loop over the lanes, kept
+// apart so the arithmetic ones vectorize, only the hashing is a lane at a time.
+template<typename Real>
+void NoiseGenerator::NoiseLanes(const Real* px, const Real* py, const Real* pz, Real* out) const
+{
+    constexpr int kLanes = kNoiseBatchLanes;
+    const Real* p[3] = { px, py, pz };
+    int cell[3][kLanes];
+    Real frac[3][kLanes];
+    Real si[3][kLanes];
+
+    for(int axis = 0; axis < 3; axis++) {
+        for(int i = 0; i < kLanes; i++) {
+            cell[axis][i] = LatticeCell(LaneFloor(p[axis][i], frac[axis][i]));
+            si[axis][i] = ImpSplineInterp(frac[axis][i]);
+        }
+    }
+
+    // Gradients for each corner of each lane's lattice cube, hashed as in ImpPerlinNoise.
+    Real grad[3][8][kLanes];
+    for(int i = 0; i < kLanes; i++) {
+        int h1a = Perm(cell[0][i]) + cell[1][i];
+        int h1b = Perm(cell[0][i] + 1) + cell[1][i];
+        int zInt = cell[2][i];
+        const int h2[5] = {
+            Perm(h1a) + zInt, Perm(h1a + 1) + zInt,
+            Perm(h1b) + zInt, Perm(h1b + 1) + zInt,
+            h1a
+        };
+        for(int corner = 0; corner < 8; corner++) {
+            int lo4 = Perm(h2[corner % 4 + corner / 4]) & 0xF;
+            grad[0][corner][i] = sGradX[lo4];
+            grad[1][corner][i] = sGradY[lo4];
+            grad[2][corner][i] = sGradZ[lo4];
+        }
+    }
+
+    Real dots[8][kLanes];
+    for(int corner = 0; corner < 8; corner++) {
+        const Real offsetX = (corner & 1) == 0 ? 0 : -1;
+        const Real offsetY = ((corner >> 1) & 1) == 0 ? 0 : -1;
+        const Real offsetZ = ((corner >> 2) & 1) == 0 ? 0 : -1;
+        for(int i = 0; i < kLanes; i++) {
+            dots[corner][i] = grad[0][corner][i] * (frac[0][i] + offsetX) +
+                grad[1][corner][i] * (frac[1][i] + offsetY) +
+                grad[2][corner][i] * (frac[2][i] + offsetZ);
+        }
+    }
+
+    for(int i = 0; i < kLanes; i++) {
+        Real temp1 = Lerp(dots[0][i], dots[1][i], si[0][i]);
+        Real temp2 = Lerp(dots[2][i], dots[3][i], si[0][i]);
+        Real temp3 = Lerp(dots[4][i], dots[5][i], si[0][i]);
+        Real temp4 = Lerp(dots[6][i], dots[7][i], si[0][i]);
+        Real tempA = Lerp(temp1, temp2, si[1][i]);
+        Real tempB = Lerp(temp3, temp4, si[1][i]);
+        out[i] = Lerp(tempA, tempB, si[2][i]);
+    }
+}
+
+// Copies up to kNoiseBatchLanes values from src + start, padding past count with zero.
+template<typename Real>
+static void LoadLanes(const Real* src, int start, int count, Real* lanes)
+{
+    for(int i = 0; i < kNoiseBatchLanes; i++) {
+        lanes[i] = start + i < count ? src[start + i] : 0;
+    }
+}
+
+template<typename Real>
+void NoiseGenerator::NoiseBatch(const Real* x, const Real* y, const Real* z, Real* out, int count) const
+{
+    int start = 0;
+    for(; start + kNoiseBatchLanes <= count; start += kNoiseBatchLanes) {
+        NoiseLanes(x + start, y + start, z + start, out + start);
+    }
+    if(start < count) {
+        Real lx[kNoiseBatchLanes], ly[kNoiseBatchLanes], lz[kNoiseBatchLanes], n[kNoiseBatchLanes];
+        LoadLanes(x, start, count, lx);
+        LoadLanes(y, start, count, ly);
+        LoadLanes(z, start, count, lz);
+        NoiseLanes(lx, ly, lz, n);
+        for(int i = 0; start + i < count; i++) {
+            out[start + i] = n[i];
+        }
+    }
+}
+
+// Gradients for 4D simplex noise, the 32 midpoints of a tesseract's edges, by axis.
+static const int8_t sGrad4X[] = { 0, 0, 0, 0, 0, 0, 0, 0,   1, 1, 1, 1, -1, -1, -1, -1,   1, 1, 1, 1, -1, -1, -1, -1,   1, 1, 1, 1, -1, -1, -1, -1 };
+static const int8_t sGrad4Y[] = { 1, 1, 1, 1, -1, -1, -1, -1,   0, 0, 0, 0, 0, 0, 0, 0,   1, 1, -1, -1, 1, 1, -1, -1,   1, 1, -1, -1, 1, 1, -1, -1 };
+static const int8_t sGrad4Z[] = { 1, 1, -1, -1, 1, 1, -1, -1,   1, 1, -1, -1, 1, 1, -1, -1,   0, 0, 0, 0, 0, 0, 0, 0,   1, -1, 1, -1, 1, -1, 1, -1 };
+static const int8_t sGrad4W[] = { 1, -1, 1, -1, 1, -1, 1, -1,   1, -1, 1, -1, 1, -1, 1, -1,   1, -1, 1, -1, 1, -1, 1, -1,   0, 0, 0, 0, 0, 0, 0, 0 };
+
+// Per dimension constants for simplex noise. kSkew takes a point onto the lattice of
+// hypercubes, (sqrt(Dim + 1) - 1) / Dim, and kUnskew back, (1 - 1 / sqrt(Dim + 1)) / Dim.
+// Each corner adds (0.5 - d^2)^4 times its gradient's dot product, and kScale brings
+// the sum out to about [-1, 1]. 2D and 3D use the Perlin gradients, 4D its own.
+template<int Dim> struct SimplexConstants;
+
+template<> struct SimplexConstants<2> {
+    static constexpr double kSkew = 0.36602540378443864676;
+    static constexpr double kUnskew = 0.21132486540518711775;
+    static constexpr double kScale = 70.0;
+    static constexpr int kGradMask = 0xF;
+    static const int8_t* Gradients(int axis) { return axis == 0 ? sGradX : sGradY; }
+};
+
+template<> struct SimplexConstants<3> {
+    static constexpr double kSkew = 1.0 / 3.0;
+    static constexpr double kUnskew = 1.0 / 6.0;
+    static constexpr double kScale = 74.0;
+    static constexpr int kGradMask = 0xF;
+    static const int8_t* Gradients(int axis) { return axis == 0 ? sGradX : axis == 1 ? sGradY : sGradZ; }
+};
+
+template<> struct SimplexConstants<4> {
+    static constexpr double kSkew = 0.30901699437494742410;
+    static constexpr double kUnskew = 0.13819660112501051518;
+    static constexpr double kScale = 60.0;
+    static constexpr int kGradMask = 0x1F;
+    static const int8_t* Gradients(int axis)
+    {
+        const int8_t* grads[] = { sGrad4X, sGrad4Y, sGrad4Z, sGrad4W };
+        return grads[axis];
+    }
+};
+
+// max(v, 0), exactly, written so it doesn't stop a loop vectorizing. The corners are
+// about as often out of reach as in, so a branch here mispredicts half the time.
+template<typename Real> inline Real ClampPositive(Real v)
+{
+    return (v + std::abs(v)) * (Real)0.5;
+}
+
+// The simplex around a point is found by skewing it onto a lattice of hypercubes, then
+// ranking its offsets in that cube. Corner k steps one along each of the k axes with the
+// largest offsets, so every corner comes from compares, without the branches of a lookup.
+template<int Dim, typename Real>
+Real NoiseGenerator::SimplexPoint(const Real* p, Real* gradient) const
+{
+    typedef SimplexConstants<Dim> Constants;
+    Real skew = 0;
+    for(int axis = 0; axis < Dim; axis++) {
+        skew += p[axis];
+    }
+    skew *= (Real)Constants::kSkew;
+
+    int cell[Dim];
+    Real unskew = 0;
+    for(int axis = 0; axis < Dim; axis++) {
+        cell[axis] = (int)floor(p[axis] + skew);
+        unskew += cell[axis];
+    }
+    unskew *= (Real)Constants::kUnskew;
+
+    Real d0[Dim];
+    int rank[Dim] = {};
+    for(int axis = 0; axis < Dim; axis++) {
+        d0[axis] = p[axis] - (cell[axis] - unskew);
+    }
+    for(int a = 0; a < Dim; a++) {
+        for(int b = a + 1; b < Dim; b++) {
+            rank[d0[a] > d0[b] ? a : b]++;
+        }
+    }
+
+    Real sum = 0;
+    Real slope[Dim] = {};
+    for(int corner = 0; corner <= Dim; corner++) {
+        Real d[Dim];
+        Real falloff = 0.5;
+        int hash = 0;
+        for(int axis = Dim - 1; axis >= 0; axis--) {
+            int step = rank[axis] >= Dim - corner ? 1 : 0;
+            d[axis] = d0[axis] - step + corner * (Real)Constants::kUnskew;
+            falloff -= d[axis] * d[axis];
+            hash = Perm(cell[axis] + step + hash);
+        }
+        int lo = hash & Constants::kGradMask;
+        Real dot = 0;
+        for(int axis = 0; axis < Dim; axis++) {
+            dot += Constants::Gradients(axis)[lo] * d[axis];
+        }
+        falloff = ClampPositive(falloff);
+        Real falloff2 = falloff * falloff;
+        Real falloff4 = falloff2 * falloff2;
+        sum += falloff4 * dot;
+        if(gradient) {
+            // the slope of falloff^4 (grad . d) is falloff^4 grad - 8 falloff^3 (grad . d) d.
+            Real dotSlope = 8 * falloff2 * falloff * dot;
+            for(int axis = 0; axis < Dim; axis++) {
+                slope[axis] += falloff4 * Constants::Gradients(axis)[lo] - dotSlope * d[axis];
+            }
+        }
+    }
+    if(gradient) {
+        for(int axis = 0; axis < Dim; axis++) {
+            gradient[axis] = (Real)Constants::kScale * slope[axis];
+        }
+    }
+    return (Real)Constants::kScale * sum;
+}
+
+// SimplexPoint for kNoiseBatchLanes points, staged like NoiseLanes.
+template<int Dim, typename Real>
+void NoiseGenerator::SimplexLanes(const Real* const* p, Real* out) const
+{
+    typedef SimplexConstants<Dim> Constants;
+    constexpr int kLanes = kNoiseBatchLanes;
+    int cell[Dim][kLanes];
+    int rank[Dim][kLanes];
+    Real d0[Dim][kLanes];
+
+    Real skew[kLanes] = {};
+    Real unskew[kLanes] = {};
+    for(int axis = 0; axis < Dim; axis++) {
+        for(int i = 0; i < kLanes; i++) {
+            skew[i] += p[axis][i];
+        }
+    }
+    for(int axis = 0; axis < Dim; axis++) {
+        for(int i = 0; i < kLanes; i++) {
+            // floor without the library call, as LaneFloor does but to int for the cell arithmetic.
+            Real v = p[axis][i] + skew[i] * (Real)Constants::kSkew;
+            int whole = (int)v;
+            whole -= v < (Real)whole ? 1 : 0;
+            cell[axis][i] = whole;
+            unskew[i] += whole;
+            rank[axis][i] = 0;
+        }
+    }
+    for(int axis = 0; axis < Dim; axis++) {
+        for(int i = 0; i < kLanes; i++) {
+            d0[axis][i] = p[axis][i] - (cell[axis][i] - unskew[i] * (Real)Constants::kUnskew);
+        }
+    }
+    for(int a = 0; a < Dim; a++) {
+        for(int b = a + 1; b < Dim; b++) {
+            for(int i = 0; i < kLanes; i++) {
+                int aFirst = d0[a][i] > d0[b][i] ? 1 : 0;
+                rank[a][i] += aFirst;
+                rank[b][i] += 1 - aFirst;
+            }
+        }
+    }
+
+    const int8_t* gradients[Dim];
+    for(int axis = 0; axis < Dim; axis++) {
+        gradients[axis] = Constants::Gradients(axis);
+    }
+
+    Real sum[kLanes] = {};
+    for(int corner = 0; corner <= Dim; corner++) {
+        // offsets from this corner, and its lattice point to hash, last axis first.
+        const Real cornerUnskew = corner * (Real)Constants::kUnskew;
+        Real d[Dim][kLanes];
+        int hash[kLanes] = {};
+        for(int axis = Dim - 1; axis >= 0; axis--) {
+            int lattice[kLanes];
+            for(int i = 0; i < kLanes; i++) {
+                int step = rank[axis][i] >= Dim - corner ? 1 : 0;
+                d[axis][i] = d0[axis][i] - (Real)step + cornerUnskew;
+                lattice[i] = cell[axis][i] + step;
+            }
+            for(int i = 0; i < kLanes; i++) {
+                hash[i] = Perm(lattice[i] + hash[i]);
+            }
+        }
+
+        Real grad[Dim][kLanes];
+        for(int i = 0; i < kLanes; i++) {
+            int lo = hash[i] & Constants::kGradMask;
+            for(int axis = 0; axis < Dim; axis++) {
+                grad[axis][i] = gradients[axis][lo];
+            }
+        }
+
+        Real falloff[kLanes], dot[kLanes];
+        for(int i = 0; i < kLanes; i++) {
+            falloff[i] = 0.5;
+            dot[i] = 0;
+        }
+        for(int axis = Dim - 1; axis >= 0; axis--) {
+            for(int i = 0; i < kLanes; i++) {
+                falloff[i] -= d[axis][i] * d[axis][i];
+                dot[i] += grad[axis][i] * d[axis][i];
+            }
+        }
+        for(int i = 0; i < kLanes; i++) {
+            Real f = ClampPositive(falloff[i]);
+            f *= f;
+            sum[i] += f * f * dot[i];
+        }
+    }
+
+    for(int i = 0; i < kLanes; i++) {
+        out[i] = (Real)Constants::kScale * sum[i];
+    }
+}
+
+template<int Dim, typename Real>
+void NoiseGenerator::SimplexBatch(const Real* const* p, Real* out, int count) const
+{
+    int start = 0;
+    for(; start + kNoiseBatchLanes <= count; start += kNoiseBatchLanes) {
+        const Real* lanes[Dim];
+        for(int axis = 0; axis < Dim; axis++) {
+            lanes[axis] = p[axis] + start;
+        }
+        SimplexLanes<Dim>(lanes, out + start);
+    }
+    if(start < count) {
+        Real padded[Dim][kNoiseBatchLanes], n[kNoiseBatchLanes];
+        const Real* lanes[Dim];
+        for(int axis = 0; axis < Dim; axis++) {
+            LoadLanes(p[axis], start, count, padded[axis]);
+            lanes[axis] = padded[axis];
+        }
+        SimplexLanes<Dim>(lanes, n);
+        for(int i = 0; start + i < count; i++) {
+            out[start + i] = n[i];
+        }
+    }
+}
+
+double NoiseGenerator::SimplexNoise2D(double x, double y) const
+{
+    const double p[] = { x, y };
+    return SimplexPoint<2>(p);
+}
+
+double NoiseGenerator::SimplexNoise(Vector3 p) const
+{
+    const double pt[] = { p.x, p.y, p.z };
+    return SimplexPoint<3>(pt);
+}
+
+double NoiseGenerator::SimplexNoise4D(double x, double y, double z, double w) const
+{
+    const double p[] = { x, y, z, w };
+    return SimplexPoint<4>(p);
+}
+
+void NoiseGenerator::SimplexNoiseBatch2D(const float* x, const float* y, float* out, int count) const
+{
+    const float* p[] = { x, y };
+    SimplexBatch<2>(p, out, count);
+}
+
+void NoiseGenerator::SimplexNoiseBatch2D(const double* x, const double* y, double* out, int count) const
+{
+    const double* p[] = { x, y };
+    SimplexBatch<2>(p, out, count);
+}
+
+void NoiseGenerator::SimplexNoiseBatch(const float* x, const float* y, const float* z, float* out, int count) const
+{
+    const float* p[] = { x, y, z };
+    SimplexBatch<3>(p, out, count);
+}
+
+void NoiseGenerator::SimplexNoiseBatch(const double* x, const double* y, const double* z, double* out, int count) const
+{
+    const double* p[] = { x, y, z };
+    SimplexBatch<3>(p, out, count);
+}
+
+void NoiseGenerator::SimplexNoiseBatch4D(const float* x, const float* y, const float* z, const float* w, float* out, int count) const
+{
+    const float* p[] = { x, y, z, w };
+    SimplexBatch<4>(p, out, count);
+}
+
+void NoiseGenerator::SimplexNoiseBatch4D(const double* x, const double* y, const double* z, const double* w, double* out, int count) const
+{
+    const double* p[] = { x, y, z, w };
+    SimplexBatch<4>(p, out, count);
+}
+
+template<typename Real>
+void NoiseGenerator::FBMBatchT(const Real* x, const Real* y, const Real* z, Real* out, int count,
+                               double gain, double lacun, double freqMin, double min, double max,
+                               int octaves, bool abs, NoiseBasis basis) const
+{
+    constexpr int kLanes = kNoiseBatchLanes;
+    for(int start = 0; start < count; start += kLanes) {
+        Real lx[kLanes], ly[kLanes], lz[kLanes];
+        LoadLanes(x, start, count, lx);
+        LoadLanes(y, start, count, ly);
+        LoadLanes(z, start, count, lz);
+
+        Real accum[kLanes] = {};
+        double amp = 1;
+        double freq = freqMin;
+        for(int octave = 0; octave < octaves; octave++) {
+            Real sx[kLanes], sy[kLanes], sz[kLanes], n[kLanes];
+            for(int i = 0; i < kLanes; i++) {
+                sx[i] = lx[i] * (Real)freq;
+                sy[i] = ly[i] * (Real)freq;
+                sz[i] = lz[i] * (Real)freq;
+            }
+            if(basis == kNoiseSimplex) {
+                const Real* scaled[] = { sx, sy, sz };
+                SimplexLanes<3>(scaled, n);
+            } else {
+                NoiseLanes(sx, sy, sz, n);
+            }
+            for(int i = 0; i < kLanes; i++) {
+                Real v = abs && n[i] < 0 ? -n[i] : n[i];
+                accum[i] += (Real)amp * v;
+            }
+            freq *= lacun;
+            amp *= gain;
+        }
+
+        for(int i = 0; i < kLanes && start + i < count; i++) {
+            Real clipped = TClip(accum[i], (Real)min, (Real)max);
+            out[start + i] = (clipped - (Real)min) / (Real)(max - min);
+        }
+    }
+}
+
+void NoiseGenerator::ImpPerlinNoiseBatch(const float* x, const float* y, const float* z, float* out, int count) const
+{
+    NoiseBatch(x, y, z, out, count);
+}
+
+void NoiseGenerator::ImpPerlinNoiseBatch(const double* x, const double* y, const double* z, double* out, int count) const
+{
+    NoiseBatch(x, y, z, out, count);
+}
+
+void NoiseGenerator::FBMBatch(const float* x, const float* y, const float* z, float* out, int count,
+                              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                              NoiseBasis basis) const
+{
+    FBMBatchT(x, y, z, out, count, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+void NoiseGenerator::FBMBatch(const double* x, const double* y, const double* z, double* out, int count,
+                              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                              NoiseBasis basis) const
+{
+    FBMBatchT(x, y, z, out, count, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+// Same fixed settings as Turbulence.
+void NoiseGenerator::TurbulenceBatch(const float* x, const float* y, const float* z, float* out, int count,
+                                     double freqMin, int octaves, NoiseBasis basis) const
+{
+    FBMBatchT(x, y, z, out, count, 0.5, 2.0, 1, 0, 1, 4, true, basis);
+}
+
+void NoiseGenerator::TurbulenceBatch(const double* x, const double* y, const double* z, double* out, int count,
+                                     double freqMin, int octaves, NoiseBasis basis) const
 {
-    return FBM(p, 0.5, 2.0, 1, 0, 1, 4, true);
+    FBMBatchT(x, y, z, out, count, 0.5, 2.0, 1, 0, 1, 4, true, basis);
+}
+
+
+double NoiseGenerator::ImpPerlinNoise2D(double x, double y) const
+{
+    double xFloor = floor(x);
+    double yFloor = floor(y);
+    int xInt = LatticeCell(xFloor);
+    int yInt = LatticeCell(yFloor);
+    double fx = x - xFloor;
+    double fy = y - yFloor;
+    double sx = ImpSplineInterp(fx);
+    double sy = ImpSplineInterp(fy);
+    
+    // ImpPerlinNoise's hashes for its first four corners, with zInt of 0.
+    int h1a = Perm(xInt) + yInt;
+    int h1b = Perm(xInt + 1) + yInt;
+    double g0 = Gradient2D(Perm(Perm(h1a)), fx, fy);
+    double g1 = Gradient2D(Perm(Perm(h1a + 1)), fx - 1, fy);
+    double g2 = Gradient2D(Perm(Perm(h1b)), fx, fy - 1);
+    double g3 = Gradient2D(Perm(Perm(h1b + 1)), fx - 1, fy - 1);
+    
+    return LinearInterp(LinearInterp(g0, g1, sx), LinearInterp(g2, g3, sx), sy);
+}
+
+double NoiseGenerator::TileableNoise2D(double x, double y, int periodX, int periodY) const
+{
+    double xFloor = floor(x);
+    double yFloor = floor(y);
+    int x0 = WrapCell((int)xFloor, periodX);
+    int x1 = WrapCell((int)xFloor + 1, periodX);
+    int y0 = WrapCell((int)yFloor, periodY);
+    int y1 = WrapCell((int)yFloor + 1, periodY);
+    double fx = x - xFloor;
+    double fy = y - yFloor;
+    double sx = ImpSplineInterp(fx);
+    double sy = ImpSplineInterp(fy);
+    
+    int hx0 = Perm(x0);
+    int hx1 = Perm(x1);
+    double g00 = Gradient2D(Perm(Perm(hx0 + y0)), fx, fy);
+    double g10 = Gradient2D(Perm(Perm(hx1 + y0)), fx - 1, fy);
+    double g01 = Gradient2D(Perm(Perm(hx0 + y1)), fx, fy - 1);
+    double g11 = Gradient2D(Perm(Perm(hx1 + y1)), fx - 1, fy - 1);
+    
+    return LinearInterp(LinearInterp(g00, g10, sx), LinearInterp(g01, g11, sx), sy);
+}
+
+double NoiseGenerator::FBM2D(double x, double y, double gain, double lacun,
+                             double freqMin, double min, double max,
+                             int octaves, bool abs, NoiseBasis basis) const
+{
+    double amp = 1;
+    double freq = freqMin;
+    double accum = 0;
+    for(int i=0; i < octaves; i++) {
+        double n = basis == kNoiseSimplex ? SimplexNoise2D(x * freq, y * freq) : ImpPerlinNoise2D(x * freq, y * freq);
+        if(abs && n < 0.0)
+            n = -n;
+        accum += amp * n;
+        freq *= lacun;
+        amp *= gain;
+    }
+    
+    double clipped = TClip(accum, min, max);
+    return (clipped - min) / (max - min);
+}
+
+// Same fixed settings as Turbulence.
+double NoiseGenerator::Turbulence2D(double x, double y, double freqMin, int octaves, NoiseBasis basis) const
+{
+    return FBM2D(x, y, 0.5, 2.0, 1, 0, 1, 4, true, basis);
+}
+
+double NoiseGenerator::TileableFBM2D(double x, double y, int periodX, int periodY, double gain, int lacun,
+                                     double min, double max, int octaves, bool abs) const
+{
+    double amp = 1;
+    int freq = 1;
+    double accum = 0;
+    for(int i=0; i < octaves; i++) {
+        double n = TileableNoise2D(x * freq, y * freq, periodX * freq, periodY * freq);
+        if(abs && n < 0.0)
+            n = -n;
+        accum += amp * n;
+        freq *= lacun;
+        amp *= gain;
+    }
+    
+    double clipped = TClip(accum, min, max);
+    return (clipped - min) / (max - min);
+}
+
+double NoiseGenerator::TileableTurbulence2D(double x, double y, int periodX, int periodY, int octaves) const
+{
+    return TileableFBM2D(x, y, periodX, periodY, 0.5, 2, 0, 1, octaves, true);
+}
+
+template<typename Real>
+void NoiseGenerator::NoiseLanes2D(const Real* px, const Real* py, Real* out, int periodX, int periodY) const
+{
+    constexpr int kLanes = kNoiseBatchLanes;
+    const Real* p[2] = { px, py };
+    int64_t whole[2][kLanes];
+    Real frac[2][kLanes];
+    Real si[2][kLanes];
+
+    for(int axis = 0; axis < 2; axis++) {
+        for(int i = 0; i < kLanes; i++) {
+            whole[axis][i] = LaneFloor(p[axis][i], frac[axis][i]);
+            si[axis][i] = ImpSplineInterp(frac[axis][i]);
+        }
+    }
+
+    // Hashes of the corners at offsets 00, 10, 01 and 11.
+    int hashes[4][kLanes];
+    if(periodX == 0) {
+        for(int i = 0; i < kLanes; i++) {
+            int xInt = LatticeCell(whole[0][i]);
+            int yInt = LatticeCell(whole[1][i]);
+            int h1a = Perm(xInt) + yInt;
+            int h1b = Perm(xInt + 1) + yInt;
+            hashes[0][i] = Perm(Perm(h1a));
+            hashes[1][i] = Perm(Perm(h1a + 1));
+            hashes[2][i] = Perm(Perm(h1b));
+            hashes[3][i] = Perm(Perm(h1b + 1));
+        }
+    } else {
+        for(int i = 0; i < kLanes; i++) {
+            // a tileable octave's points stay within its period, well inside int.
+            int x = (int)whole[0][i];
+            int y = (int)whole[1][i];
+            int hx0 = Perm(WrapCell(x, periodX));
+            int hx1 = Perm(WrapCell(x + 1, periodX));
+            int y0 = WrapCell(y, periodY);
+            int y1 = WrapCell(y + 1, periodY);
+            hashes[0][i] = Perm(Perm(hx0 + y0));
+            hashes[1][i] = Perm(Perm(hx1 + y0));
+            hashes[2][i] = Perm(Perm(hx0 + y1));
+            hashes[3][i] = Perm(Perm(hx1 + y1));
+        }
+    }
+
+    Real grad[2][4][kLanes];
+    for(int corner = 0; corner < 4; corner++) {
+        for(int i = 0; i < kLanes; i++) {
+            int lo4 = hashes[corner][i] & 0xF;
+            grad[0][corner][i] = sGradX[lo4];
+            grad[1][corner][i] = sGradY[lo4];
+        }
+    }
+
+    Real dots[4][kLanes];
+    for(int corner = 0; corner < 4; corner++) {
+        const Real offsetX = (corner & 1) == 0 ? 0 : -1;
+        const Real offsetY = ((corner >> 1) & 1) == 0 ? 0 : -1;
+        for(int i = 0; i < kLanes; i++) {
+            dots[corner][i] = grad[0][corner][i] * (frac[0][i] + offsetX) +
+                grad[1][corner][i] * (frac[1][i] + offsetY);
+        }
+    }
+
+    for(int i = 0; i < kLanes; i++) {
+        Real temp1 = Lerp(dots[0][i], dots[1][i], si[0][i]);
+        Real temp2 = Lerp(dots[2][i], dots[3][i], si[0][i]);
+        out[i] = Lerp(temp1, temp2, si[1][i]);
+    }
+}
+
+template<typename Real>
+void NoiseGenerator::NoiseBatch2D(const Real* x, const Real* y, Real* out, int count, int periodX, int periodY) const
+{
+    int start = 0;
+    for(; start + kNoiseBatchLanes <= count; start += kNoiseBatchLanes) {
+        NoiseLanes2D(x + start, y + start, out + start, periodX, periodY);
+    }
+    if(start < count) {
+        Real lx[kNoiseBatchLanes], ly[kNoiseBatchLanes], n[kNoiseBatchLanes];
+        LoadLanes(x, start, count, lx);
+        LoadLanes(y, start, count, ly);
+        NoiseLanes2D(lx, ly, n, periodX, periodY);
+        for(int i = 0; start + i < count; i++) {
+            out[start + i] = n[i];
+        }
+    }
+}
+
+// Tiled when periodX isn't 0, each octave's period then grows with its frequency. Only
+// the Perlin basis tiles.
+template<typename Real>
+void NoiseGenerator::FBMBatch2DT(const Real* x, const Real* y, Real* out, int count, int periodX, int periodY,
+                                 double gain, double lacun, double freqMin, double min, double max,
+                                 int octaves, bool abs, NoiseBasis basis) const
+{
+    constexpr int kLanes = kNoiseBatchLanes;
+    for(int start = 0; start < count; start += kLanes) {
+        Real lx[kLanes], ly[kLanes];
+        LoadLanes(x, start, count, lx);
+        LoadLanes(y, start, count, ly);
+
+        Real accum[kLanes] = {};
+        double amp = 1;
+        double freq = freqMin;
+        int octavePeriodX = periodX;
+        int octavePeriodY = periodY;
+        for(int octave = 0; octave < octaves; octave++) {
+            Real sx[kLanes], sy[kLanes], n[kLanes];
+            for(int i = 0; i < kLanes; i++) {
+                sx[i] = lx[i] * (Real)freq;
+                sy[i] = ly[i] * (Real)freq;
+            }
+            if(basis == kNoiseSimplex) {
+                const Real* scaled[] = { sx, sy };
+                SimplexLanes<2>(scaled, n);
+            } else {
+                NoiseLanes2D(sx, sy, n, octavePeriodX, octavePeriodY);
+            }
+            for(int i = 0; i < kLanes; i++) {
+                Real v = abs && n[i] < 0 ? -n[i] : n[i];
+                accum[i] += (Real)amp * v;
+            }
+            freq *= lacun;
+            amp *= gain;
+            octavePeriodX *= (int)lacun;
+            octavePeriodY *= (int)lacun;
+        }
+
+        for(int i = 0; i < kLanes && start + i < count; i++) {
+            Real clipped = TClip(accum[i], (Real)min, (Real)max);
+            out[start + i] = (clipped - (Real)min) / (Real)(max - min);
+        }
+    }
+}
+
+void NoiseGenerator::ImpPerlinNoiseBatch2D(const float* x, const float* y, float* out, int count) const
+{
+    NoiseBatch2D(x, y, out, count, 0, 0);
+}
+
+void NoiseGenerator::ImpPerlinNoiseBatch2D(const double* x, const double* y, double* out, int count) const
+{
+    NoiseBatch2D(x, y, out, count, 0, 0);
+}
+
+void NoiseGenerator::TileableNoiseBatch2D(const float* x, const float* y, float* out, int count, int periodX, int periodY) const
+{
+    NoiseBatch2D(x, y, out, count, periodX, periodY);
+}
+
+void NoiseGenerator::TileableNoiseBatch2D(const double* x, const double* y, double* out, int count, int periodX, int periodY) const
+{
+    NoiseBatch2D(x, y, out, count, periodX, periodY);
+}
+
+void NoiseGenerator::FBMBatch2D(const float* x, const float* y, float* out, int count,
+                                double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                                NoiseBasis basis) const
+{
+    FBMBatch2DT(x, y, out, count, 0, 0, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+void NoiseGenerator::FBMBatch2D(const double* x, const double* y, double* out, int count,
+                                double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                                NoiseBasis basis) const
+{
+    FBMBatch2DT(x, y, out, count, 0, 0, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+void NoiseGenerator::TileableFBMBatch2D(const float* x, const float* y, float* out, int count, int periodX, int periodY,
+                                        double gain, int lacun, double min, double max, int octaves, bool abs) const
+{
+    FBMBatch2DT(x, y, out, count, periodX, periodY, gain, lacun, 1, min, max, octaves, abs, kNoisePerlin);
+}
+
+void NoiseGenerator::TileableFBMBatch2D(const double* x, const double* y, double* out, int count, int periodX, int periodY,
+                                        double gain, int lacun, double min, double max, int octaves, bool abs) const
+{
+    FBMBatch2DT(x, y, out, count, periodX, periodY, gain, lacun, 1, min, max, octaves, abs, kNoisePerlin);
+}
+
+double NoiseGenerator::ImpPerlinNoiseDeriv(Vector3 p, Vector3& gradient) const
+{
+    Vector3 pf = Vector3(floor(p.x), floor(p.y), floor(p.z));
+    int xInt = LatticeCell(pf.x);
+    int yInt = LatticeCell(pf.y);
+    int zInt = LatticeCell(pf.z);
+    Vector3 frac = p - pf;
+    const double si[3] = { ImpSplineInterp(frac.x), ImpSplineInterp(frac.y), ImpSplineInterp(frac.z) };
+    const double dsi[3] = { ImpSplineDeriv(frac.x), ImpSplineDeriv(frac.y), ImpSplineDeriv(frac.z) };
+    
+    // ImpPerlinNoise's hashes.
+    int h1a = Perm(xInt) + yInt;
+    int h1b = Perm(xInt + 1) + yInt;
+    const int h2[5] = {
+        Perm(h1a) + zInt, Perm(h1a + 1) + zInt,
+        Perm(h1b) + zInt, Perm(h1b + 1) + zInt,
+        h1a
+    };
+    
+    // The nested lerps as a sum of corners weighted by their three splines, so each
+    // weight's slope is at hand.
+    double value = 0;
+    gradient = Vector3(0, 0, 0);
+    for(int corner = 0; corner < 8; corner++) {
+        const Vector3& grad = sGradValues[Perm(h2[corner % 4 + corner / 4]) & 0xF];
+        Vector3 offset(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+        double dot = DotProduct(grad, frac - offset);
+        double w[3], dw[3];
+        for(int axis = 0; axis < 3; axis++) {
+            bool far = ((corner >> axis) & 1) != 0;
+            w[axis] = far ? si[axis] : 1 - si[axis];
+            dw[axis] = far ? dsi[axis] : -dsi[axis];
+        }
+        double weight = w[0] * w[1] * w[2];
+        value += weight * dot;
+        gradient += grad * weight + Vector3(dw[0] * w[1] * w[2], w[0] * dw[1] * w[2], w[0] * w[1] * dw[2]) * dot;
+    }
+    return value;
+}
+
+double NoiseGenerator::SimplexNoiseDeriv(Vector3 p, Vector3& gradient) const
+{
+    const double pt[] = { p.x, p.y, p.z };
+    double grad[3];
+    double value = SimplexPoint<3>(pt, grad);
+    gradient = Vector3(grad[0], grad[1], grad[2]);
+    return value;
+}
+
+// Bilinear blend of the gradients at corners 00, 10, 01 and 11 and its partial derivatives.
+static double LatticeNoiseDeriv2D(const int hashes[4], double fx, double fy, double& dx, double& dy)
+{
+    double sx = ImpSplineInterp(fx);
+    double sy = ImpSplineInterp(fy);
+    double gx[4], gy[4], dots[4];
+    for(int corner = 0; corner < 4; corner++) {
+        int lo4 = hashes[corner] & 0xF;
+        gx[corner] = sGradX[lo4];
+        gy[corner] = sGradY[lo4];
+        dots[corner] = gx[corner] * (fx - (corner & 1)) + gy[corner] * (fy - (corner >> 1));
+    }
+    double a = Lerp(dots[0], dots[1], sx);
+    double b = Lerp(dots[2], dots[3], sx);
+    
+    double dsx = ImpSplineDeriv(fx);
+    double dax = Lerp(gx[0], gx[1], sx) + dsx * (dots[1] - dots[0]);
+    double dbx = Lerp(gx[2], gx[3], sx) + dsx * (dots[3] - dots[2]);
+    dx = Lerp(dax, dbx, sy);
+    dy = Lerp(Lerp(gy[0], gy[1], sx), Lerp(gy[2], gy[3], sx), sy) + ImpSplineDeriv(fy) * (b - a);
+    return Lerp(a, b, sy);
+}
+
+double NoiseGenerator::ImpPerlinNoiseDeriv2D(double x, double y, double& dx, double& dy) const
+{
+    double xFloor = floor(x);
+    double yFloor = floor(y);
+    int xInt = LatticeCell(xFloor);
+    int yInt = LatticeCell(yFloor);
+    
+    int h1a = Perm(xInt) + yInt;
+    int h1b = Perm(xInt + 1) + yInt;
+    const int hashes[4] = { Perm(Perm(h1a)), Perm(Perm(h1a + 1)), Perm(Perm(h1b)), Perm(Perm(h1b + 1)) };
+    return LatticeNoiseDeriv2D(hashes, x - xFloor, y - yFloor, dx, dy);
+}
+
+double NoiseGenerator::TileableNoiseDeriv2D(double x, double y, int periodX, int periodY, double& dx, double& dy) const
+{
+    double xFloor = floor(x);
+    double yFloor = floor(y);
+    int hx0 = Perm(WrapCell((int)xFloor, periodX));
+    int hx1 = Perm(WrapCell((int)xFloor + 1, periodX));
+    int y0 = WrapCell((int)yFloor, periodY);
+    int y1 = WrapCell((int)yFloor + 1, periodY);
+    
+    const int hashes[4] = { Perm(Perm(hx0 + y0)), Perm(Perm(hx1 + y0)), Perm(Perm(hx0 + y1)), Perm(Perm(hx1 + y1)) };
+    return LatticeNoiseDeriv2D(hashes, x - xFloor, y - yFloor, dx, dy);
+}
+
+double NoiseGenerator::SimplexNoiseDeriv2D(double x, double y, double& dx, double& dy) const
+{
+    const double p[] = { x, y };
+    double grad[2];
+    double value = SimplexPoint<2>(p, grad);
+    dx = grad[0];
+    dy = grad[1];
+    return value;
+}
+
+// FBM's clip and rescale of the octave sum, whose slope goes to 0 where it clips.
+static double FinishFBMDeriv(double accum, double min, double max, double* gradient, int axes)
+{
+    bool clipped = accum <= min || accum >= max;
+    for(int axis = 0; axis < axes; axis++) {
+        gradient[axis] = clipped ? 0 : gradient[axis] / (max - min);
+    }
+    return (TClip(accum, min, max) - min) / (max - min);
+}
+
+double NoiseGenerator::FBMDeriv(Vector3 p, double gain, double lacun,
+                                double freqMin, double min, double max,
+                                int octaves, bool abs, Vector3& gradient, NoiseBasis basis) const
+{
+    double amp = 1;
+    double freq = freqMin;
+    double accum = 0;
+    double accumGrad[3] = { 0, 0, 0 };
+    for(int i=0; i < octaves; i++) {
+        Vector3 g;
+        double n = basis == kNoiseSimplex ? SimplexNoiseDeriv(p * freq, g) : ImpPerlinNoiseDeriv(p * freq, g);
+        // the octave is noise of p * freq, which makes its slope freq times steeper.
+        double slope = amp * freq;
+        if(abs && n < 0.0) {
+            n = -n;
+            slope = -slope;
+        }
+        accum += amp * n;
+        accumGrad[0] += slope * g.x;
+        accumGrad[1] += slope * g.y;
+        accumGrad[2] += slope * g.z;
+        freq *= lacun;
+        amp *= gain;
+    }
+    
+    double fbm = FinishFBMDeriv(accum, min, max, accumGrad, 3);
+    gradient = Vector3(accumGrad[0], accumGrad[1], accumGrad[2]);
+    return fbm;
+}
+
+double NoiseGenerator::FBMDeriv2D(double x, double y, double gain, double lacun,
+                                  double freqMin, double min, double max,
+                                  int octaves, bool abs, double& dx, double& dy, NoiseBasis basis) const
+{
+    double amp = 1;
+    double freq = freqMin;
+    double accum = 0;
+    double accumGrad[2] = { 0, 0 };
+    for(int i=0; i < octaves; i++) {
+        double nx, ny;
+        double n = basis == kNoiseSimplex ? SimplexNoiseDeriv2D(x * freq, y * freq, nx, ny) :
+            ImpPerlinNoiseDeriv2D(x * freq, y * freq, nx, ny);
+        double slope = amp * freq;
+        if(abs && n < 0.0) {
+            n = -n;
+            slope = -slope;
+        }
+        accum += amp * n;
+        accumGrad[0] += slope * nx;
+        accumGrad[1] += slope * ny;
+        freq *= lacun;
+        amp *= gain;
+    }
+    
+    double fbm = FinishFBMDeriv(accum, min, max, accumGrad, 2);
+    dx = accumGrad[0];
+    dy = accumGrad[1];
+    return fbm;
+}
+
+double NoiseGenerator::TileableFBMDeriv2D(double x, double y, int periodX, int periodY, double gain, int lacun,
+                                          double min, double max, int octaves, bool abs, double& dx, double& dy) const
+{
+    double amp = 1;
+    int freq = 1;
+    double accum = 0;
+    double accumGrad[2] = { 0, 0 };
+    for(int i=0; i < octaves; i++) {
+        double nx, ny;
+        double n = TileableNoiseDeriv2D(x * freq, y * freq, periodX * freq, periodY * freq, nx, ny);
+        double slope = amp * freq;
+        if(abs && n < 0.0) {
+            n = -n;
+            slope = -slope;
+        }
+        accum += amp * n;
+        accumGrad[0] += slope * nx;
+        accumGrad[1] += slope * ny;
+        freq *= lacun;
+        amp *= gain;
+    }
+    
+    double fbm = FinishFBMDeriv(accum, min, max, accumGrad, 2);
+    dx = accumGrad[0];
+    dy = accumGrad[1];
+    return fbm;
+}
+
+double ImpPerlinNoise(Vector3 p)
+{
+    return NoiseGenerator::Default().ImpPerlinNoise(p);
+}
+
+double FBM(Vector3 p, double gain, double lacun,
+           double freqMin, double min, double max,
+           int octaves, bool abs, NoiseBasis basis)
+{
+    return NoiseGenerator::Default().FBM(p, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+double Turbulence(Vector3 p, double freqMin, int octaves, NoiseBasis basis)
+{
+    return NoiseGenerator::Default().Turbulence(p, freqMin, octaves, basis);
+}
+
+double SimplexNoise(Vector3 p)
+{
+    return NoiseGenerator::Default().SimplexNoise(p);
+}
+
+void ImpPerlinNoiseBatch(const float* x, const float* y, const float* z, float* out, int count)
+{
+    NoiseGenerator::Default().ImpPerlinNoiseBatch(x, y, z, out, count);
+}
+
+void ImpPerlinNoiseBatch(const double* x, const double* y, const double* z, double* out, int count)
+{
+    NoiseGenerator::Default().ImpPerlinNoiseBatch(x, y, z, out, count);
+}
+
+void FBMBatch(const float* x, const float* y, const float* z, float* out, int count,
+              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+              NoiseBasis basis)
+{
+    NoiseGenerator::Default().FBMBatch(x, y, z, out, count, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+void FBMBatch(const double* x, const double* y, const double* z, double* out, int count,
+              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+              NoiseBasis basis)
+{
+    NoiseGenerator::Default().FBMBatch(x, y, z, out, count, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+void TurbulenceBatch(const float* x, const float* y, const float* z, float* out, int count, double freqMin, int octaves,
+                     NoiseBasis basis)
+{
+    NoiseGenerator::Default().TurbulenceBatch(x, y, z, out, count, freqMin, octaves, basis);
+}
+
+void TurbulenceBatch(const double* x, const double* y, const double* z, double* out, int count, double freqMin, int octaves,
+                     NoiseBasis basis)
+{
+    NoiseGenerator::Default().TurbulenceBatch(x, y, z, out, count, freqMin, octaves, basis);
 }
 
 
 bool TestNoise()
 {
-    InitNoise();
+    const NoiseGenerator& noise = NoiseGenerator::Default();
+    // the test's own random points, leaving rand() alone.
+    std::mt19937 rng(4321);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
     
     double li = LinearInterp(2, 3, 0.3);
     DbgAssertAlmostEqual(li, 2.3);
@@ -189,7 +1253,7 @@ bool TestNoise()
     for(int i=0; i<256; i++) seen[i] = false;
     
     for(int i=0; i<256; i++) {
-        int p = Perm(i);
+        int p = noise.Perm(i);
         DbgAssert( !seen[p]);
         seen[p] = true;
     }
@@ -202,7 +1266,7 @@ bool TestNoise()
     };
     // smoke test
     for(int i=0; i < 16; i++) {
-        int hval = i | (rand()&0xf << 4);
+        int hval = i | (int)(rng() & 0xf0);
         Vector3 frac = {1,1,1};
         double g = Gradient(hval, frac);
         if(!DbgAssertAlmostEqual(g, kExpectedGradients[i])) {
@@ -239,6 +1303,290 @@ bool TestNoise()
     }
     
     
+    // The batch versions against the scalar ones, at the test cases and at points spread
+    // over many lattice cells and both signs, with a count that leaves a partial last step.
+    std::vector<double> xs, ys, zs;
+    for(int i=0; kNoiseTestCases[i].final == false; i++) {
+        xs.push_back(kNoiseTestCases[i].p.x);
+        ys.push_back(kNoiseTestCases[i].p.y);
+        zs.push_back(kNoiseTestCases[i].p.z);
+    }
+    for(int i = 0; i < 1000; i++) {
+        xs.push_back((unit(rng) - 0.5) * 600.0);
+        ys.push_back((unit(rng) - 0.5) * 600.0);
+        zs.push_back((unit(rng) - 0.5) * 600.0);
+    }
+    const int count = (int)xs.size();
+    std::vector<float> xf(xs.begin(), xs.end()), yf(ys.begin(), ys.end()), zf(zs.begin(), zs.end());
+    std::vector<double> nd(count);
+    std::vector<float> nf(count);
+    
+    ImpPerlinNoiseBatch(xs.data(), ys.data(), zs.data(), nd.data(), count);
+    ImpPerlinNoiseBatch(xf.data(), yf.data(), zf.data(), nf.data(), count);
+    for(int i = 0; i < count; i++) {
+        double expected = ImpPerlinNoise(Vector3(xs[i], ys[i], zs[i]));
+        DbgAssertAlmostEqual(nd[i], expected, 1e-12);
+        // float points can land on the other side of a cell boundary, so those take the float point.
+        double expectedF = ImpPerlinNoise(Vector3(xf[i], yf[i], zf[i]));
+        if(!DbgAssertAlmostEqual(nf[i], expectedF, 1e-4)) {
+            cout << "batch p=" << Vector3(xf[i], yf[i], zf[i]) << " n=" << nf[i] << " expected=" << expectedF << endl;
+        }
+    }
+    
+    FBMBatch(xs.data(), ys.data(), zs.data(), nd.data(), count, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+    FBMBatch(xf.data(), yf.data(), zf.data(), nf.data(), count, 0.5, 2.0, 0.05, 0.2, 0.9, 5, true);
+    for(int i = 0; i < count; i++) {
+        Vector3 pd(xs[i], ys[i], zs[i]);
+        Vector3 pf(xf[i], yf[i], zf[i]);
+        DbgAssertAlmostEqual(nd[i], FBM(pd, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false), 1e-12);
+        DbgAssertAlmostEqual(nf[i], FBM(pf, 0.5, 2.0, 0.05, 0.2, 0.9, 5, true), 1e-4);
+    }
+    
+    // High octaves take points far past int's range, and on past where doubles are all
+    // whole, which the batches have to floor as the scalar noise does. The texels of the
+    // demo's FBM texture, at its 64 octaves, and the points above spread 1000 times wider.
+    std::vector<double> xw(count), yw(count), zw(count), nw(count);
+    for(int i = 0; i < count; i++) {
+        xw[i] = i % 256;
+        yw[i] = (i * 37) % 256;
+        zw[i] = 0;
+    }
+    FBMBatch(xw.data(), yw.data(), zw.data(), nw.data(), count, 0.8, 1.8, 3.0, -0.5, 0.5, 64, false);
+    for(int i = 0; i < count; i++) {
+        DbgAssertAlmostEqual(nw[i], FBM(Vector3(xw[i], yw[i], zw[i]), 0.8, 1.8, 3.0, -0.5, 0.5, 64, false), 1e-12);
+    }
+    for(int i = 0; i < count; i++) {
+        xw[i] = xs[i] * 1000;
+        yw[i] = ys[i] * 1000;
+        zw[i] = zs[i] * 1000;
+    }
+    FBMBatch(xw.data(), yw.data(), zw.data(), nw.data(), count, 0.9, 2.0, 1.0, -1, 1, 48, false);
+    for(int i = 0; i < count; i++) {
+        DbgAssertAlmostEqual(nw[i], FBM(Vector3(xw[i], yw[i], zw[i]), 0.9, 2.0, 1.0, -1, 1, 48, false), 1e-12);
+    }
+    
+    TurbulenceBatch(xs.data(), ys.data(), zs.data(), nd.data(), count, 1.5, 5);
+    for(int i = 0; i < count; i++) {
+        DbgAssertAlmostEqual(nd[i], Turbulence(Vector3(xs[i], ys[i], zs[i]), 1.5, 5), 1e-12);
+    }
+    
+    // 2D noise is the z = 0 slice of the 3D noise, in batches as well.
+    std::vector<double> nd2(count);
+    std::vector<float> nf2(count);
+    noise.ImpPerlinNoiseBatch2D(xs.data(), ys.data(), nd2.data(), count);
+    noise.ImpPerlinNoiseBatch2D(xf.data(), yf.data(), nf2.data(), count);
+    for(int i = 0; i < count; i++) {
+        double expected = ImpPerlinNoise(Vector3(xs[i], ys[i], 0));
+        DbgAssertAlmostEqual(noise.ImpPerlinNoise2D(xs[i], ys[i]), expected, 1e-12);
+        DbgAssertAlmostEqual(nd2[i], expected, 1e-12);
+        DbgAssertAlmostEqual(nf2[i], ImpPerlinNoise(Vector3(xf[i], yf[i], 0)), 1e-4);
+        DbgAssertAlmostEqual(noise.FBM2D(xs[i], ys[i], 0.8, 1.8, 3.0, -0.5, 0.5, 8, false),
+                             FBM(Vector3(xs[i], ys[i], 0), 0.8, 1.8, 3.0, -0.5, 0.5, 8, false), 1e-12);
+        DbgAssertAlmostEqual(noise.Turbulence2D(xs[i], ys[i], 1.5, 5), Turbulence(Vector3(xs[i], ys[i], 0), 1.5, 5), 1e-12);
+    }
+    noise.FBMBatch2D(xs.data(), ys.data(), nd2.data(), count, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false);
+    for(int i = 0; i < count; i++) {
+        DbgAssertAlmostEqual(nd2[i], noise.FBM2D(xs[i], ys[i], 0.8, 1.8, 3.0, -0.5, 0.5, 8, false), 1e-12);
+    }
+    // and far past int's range, as the 3D batches above.
+    noise.FBMBatch2D(xw.data(), yw.data(), nd2.data(), count, 0.8, 1.8, 3.0, -0.5, 0.5, 64, false);
+    for(int i = 0; i < count; i++) {
+        DbgAssertAlmostEqual(nd2[i], noise.FBM2D(xw[i], yw[i], 0.8, 1.8, 3.0, -0.5, 0.5, 64, false), 1e-12);
+    }
+    
+    // Tileable noise repeats with its period and has no seams, on the lattice lines or the wrap.
+    constexpr int kPeriodX = 5, kPeriodY = 7;
+    constexpr double kEpsilon = 1e-7;
+    int tileChecks = 0;
+    for(int i = 0; i < count; i++) {
+        double x = xs[i], y = ys[i];
+        double n = noise.TileableNoise2D(x, y, kPeriodX, kPeriodY);
+        tileChecks += DbgAssertAlmostEqual(noise.TileableNoise2D(x + kPeriodX, y, kPeriodX, kPeriodY), n, 1e-6) ? 1 : 0;
+        tileChecks += DbgAssertAlmostEqual(noise.TileableNoise2D(x, y - 3 * kPeriodY, kPeriodX, kPeriodY), n, 1e-6) ? 1 : 0;
+        
+        double cellX = floor(x);
+        double cellY = floor(y);
+        DbgAssertAlmostEqual(noise.TileableNoise2D(cellX - kEpsilon, y, kPeriodX, kPeriodY),
+                             noise.TileableNoise2D(cellX + kEpsilon, y, kPeriodX, kPeriodY), 1e-5);
+        DbgAssertAlmostEqual(noise.TileableNoise2D(x, cellY - kEpsilon, kPeriodX, kPeriodY),
+                             noise.TileableNoise2D(x, cellY + kEpsilon, kPeriodX, kPeriodY), 1e-5);
+        
+        double fbm = noise.TileableFBM2D(x, y, kPeriodX, kPeriodY, 0.5, 2, -0.5, 0.5, 5, false);
+        DbgAssertAlmostEqual(noise.TileableFBM2D(x - kPeriodX, y + kPeriodY, kPeriodX, kPeriodY, 0.5, 2, -0.5, 0.5, 5, false), fbm, 1e-6);
+        DbgAssertAlmostEqual(noise.TileableTurbulence2D(x, y, kPeriodX, kPeriodY, 5),
+                             noise.TileableFBM2D(x, y, kPeriodX, kPeriodY, 0.5, 2, 0, 1, 5, true), 1e-12);
+    }
+    DbgAssert(tileChecks == 2 * count);
+    noise.TileableNoiseBatch2D(xs.data(), ys.data(), nd2.data(), count, kPeriodX, kPeriodY);
+    for(int i = 0; i < count; i++) {
+        DbgAssertAlmostEqual(nd2[i], noise.TileableNoise2D(xs[i], ys[i], kPeriodX, kPeriodY), 1e-12);
+    }
+    noise.TileableFBMBatch2D(xs.data(), ys.data(), nd2.data(), count, kPeriodX, kPeriodY, 0.5, 2, -0.5, 0.5, 5, false);
+    for(int i = 0; i < count; i++) {
+        DbgAssertAlmostEqual(nd2[i], noise.TileableFBM2D(xs[i], ys[i], kPeriodX, kPeriodY, 0.5, 2, -0.5, 0.5, 5, false), 1e-12);
+    }
+    
+    // Simplex noise stays in range, has no seams anywhere, and its batches match it a point
+    // at a time. Float skews the point onto the simplex lattice in float, so it gets a
+    // looser bound than the Perlin batches.
+    std::vector<double> ws(count), nd3(count), nd4(count);
+    for(int i = 0; i < count; i++) {
+        ws[i] = (unit(rng) - 0.5) * 600.0;
+    }
+    std::vector<float> wf(ws.begin(), ws.end()), nf3(count), nf4(count);
+    noise.SimplexNoiseBatch2D(xs.data(), ys.data(), nd2.data(), count);
+    noise.SimplexNoiseBatch(xs.data(), ys.data(), zs.data(), nd3.data(), count);
+    noise.SimplexNoiseBatch4D(xs.data(), ys.data(), zs.data(), ws.data(), nd4.data(), count);
+    noise.SimplexNoiseBatch2D(xf.data(), yf.data(), nf2.data(), count);
+    noise.SimplexNoiseBatch(xf.data(), yf.data(), zf.data(), nf3.data(), count);
+    noise.SimplexNoiseBatch4D(xf.data(), yf.data(), zf.data(), wf.data(), nf4.data(), count);
+    int sameAsPerlin = 0;
+    for(int i = 0; i < count; i++) {
+        double x = xs[i], y = ys[i], z = zs[i], w = ws[i];
+        double s2 = noise.SimplexNoise2D(x, y);
+        double s3 = noise.SimplexNoise(Vector3(x, y, z));
+        double s4 = noise.SimplexNoise4D(x, y, z, w);
+        DbgAssert(s2 > kNoiseMin && s2 < kNoiseMax);
+        DbgAssert(s3 > kNoiseMin && s3 < kNoiseMax);
+        DbgAssert(s4 > kNoiseMin && s4 < kNoiseMax);
+        sameAsPerlin += s3 == noise.ImpPerlinNoise(Vector3(x, y, z)) ? 1 : 0;
+        
+        DbgAssertAlmostEqual(nd2[i], s2, 1e-12);
+        DbgAssertAlmostEqual(nd3[i], s3, 1e-12);
+        DbgAssertAlmostEqual(nd4[i], s4, 1e-12);
+        DbgAssertAlmostEqual(nf2[i], noise.SimplexNoise2D(xf[i], yf[i]), 1e-3);
+        DbgAssertAlmostEqual(nf3[i], noise.SimplexNoise(Vector3(xf[i], yf[i], zf[i])), 1e-3);
+        DbgAssertAlmostEqual(nf4[i], noise.SimplexNoise4D(xf[i], yf[i], zf[i], wf[i]), 1e-3);
+        
+        DbgAssertAlmostEqual(noise.SimplexNoise2D(x + kEpsilon, y - kEpsilon), s2, 1e-5);
+        DbgAssertAlmostEqual(noise.SimplexNoise(Vector3(x, y + kEpsilon, z - kEpsilon)), s3, 1e-5);
+        DbgAssertAlmostEqual(noise.SimplexNoise4D(x, y, z, w + kEpsilon), s4, 1e-5);
+    }
+    DbgAssert(sameAsPerlin < count / 2);
+    
+    // FBM and Turbulence on the simplex basis, batched against a point at a time.
+    noise.FBMBatch(xs.data(), ys.data(), zs.data(), nd3.data(), count, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false, kNoiseSimplex);
+    noise.TurbulenceBatch(xs.data(), ys.data(), zs.data(), nd4.data(), count, 1.5, 5, kNoiseSimplex);
+    noise.FBMBatch2D(xs.data(), ys.data(), nd2.data(), count, 0.5, 2.0, 0.05, 0.2, 0.9, 5, true, kNoiseSimplex);
+    for(int i = 0; i < count; i++) {
+        Vector3 pd(xs[i], ys[i], zs[i]);
+        DbgAssertAlmostEqual(nd3[i], noise.FBM(pd, 0.8, 1.8, 3.0, -0.5, 0.5, 8, false, kNoiseSimplex), 1e-12);
+        DbgAssertAlmostEqual(nd4[i], noise.Turbulence(pd, 1.5, 5, kNoiseSimplex), 1e-12);
+        DbgAssertAlmostEqual(nd2[i], noise.FBM2D(xs[i], ys[i], 0.5, 2.0, 0.05, 0.2, 0.9, 5, true, kNoiseSimplex), 1e-12);
+    }
+    
+    // The analytic gradients against central differences, and their values against the
+    // plain functions. The 3D Perlin noise has seams on the lattice lines, so its points
+    // keep clear of them at every octave's frequency, up to 8 for the FBM.
+    constexpr double kStep = 1e-5;
+    for(int i = 0; i < count; i++) {
+        double x = xs[i], y = ys[i], z = zs[i];
+        Vector3 pt(x, y, z);
+        Vector3 grad;
+        double dx, dy;
+        
+        bool nearSeam = false;
+        for(double v : { x, y, z }) {
+            double frac = 8 * v - floor(8 * v);
+            nearSeam = nearSeam || frac < 10 * kStep || frac > 1 - 10 * kStep;
+        }
+        if(!nearSeam) {
+            DbgAssertAlmostEqual(noise.ImpPerlinNoiseDeriv(pt, grad), noise.ImpPerlinNoise(pt), 1e-12);
+            DbgAssertAlmostEqual(grad.x, (noise.ImpPerlinNoise(pt + Vector3(kStep, 0, 0)) - noise.ImpPerlinNoise(pt - Vector3(kStep, 0, 0))) / (2 * kStep), 1e-5);
+            DbgAssertAlmostEqual(grad.y, (noise.ImpPerlinNoise(pt + Vector3(0, kStep, 0)) - noise.ImpPerlinNoise(pt - Vector3(0, kStep, 0))) / (2 * kStep), 1e-5);
+            DbgAssertAlmostEqual(grad.z, (noise.ImpPerlinNoise(pt + Vector3(0, 0, kStep)) - noise.ImpPerlinNoise(pt - Vector3(0, 0, kStep))) / (2 * kStep), 1e-5);
+            
+            DbgAssertAlmostEqual(noise.ImpPerlinNoiseDeriv2D(x, y, dx, dy), noise.ImpPerlinNoise2D(x, y), 1e-12);
+            DbgAssertAlmostEqual(dx, (noise.ImpPerlinNoise2D(x + kStep, y) - noise.ImpPerlinNoise2D(x - kStep, y)) / (2 * kStep), 1e-5);
+            DbgAssertAlmostEqual(dy, (noise.ImpPerlinNoise2D(x, y + kStep) - noise.ImpPerlinNoise2D(x, y - kStep)) / (2 * kStep), 1e-5);
+            
+            double fbm = noise.FBMDeriv(pt, 0.5, 2.0, 1.0, -2.0, 2.0, 4, false, grad);
+            DbgAssertAlmostEqual(fbm, noise.FBM(pt, 0.5, 2.0, 1.0, -2.0, 2.0, 4, false), 1e-12);
+            DbgAssertAlmostEqual(grad.x, (noise.FBM(pt + Vector3(kStep, 0, 0), 0.5, 2.0, 1.0, -2.0, 2.0, 4, false) -
+                                          noise.FBM(pt - Vector3(kStep, 0, 0), 0.5, 2.0, 1.0, -2.0, 2.0, 4, false)) / (2 * kStep), 1e-4);
+        }
+        
+        DbgAssertAlmostEqual(noise.TileableNoiseDeriv2D(x, y, kPeriodX, kPeriodY, dx, dy), noise.TileableNoise2D(x, y, kPeriodX, kPeriodY), 1e-12);
+        DbgAssertAlmostEqual(dx, (noise.TileableNoise2D(x + kStep, y, kPeriodX, kPeriodY) - noise.TileableNoise2D(x - kStep, y, kPeriodX, kPeriodY)) / (2 * kStep), 1e-5);
+        DbgAssertAlmostEqual(dy, (noise.TileableNoise2D(x, y + kStep, kPeriodX, kPeriodY) - noise.TileableNoise2D(x, y - kStep, kPeriodX, kPeriodY)) / (2 * kStep), 1e-5);
+        
+        DbgAssertAlmostEqual(noise.SimplexNoiseDeriv(pt, grad), noise.SimplexNoise(pt), 1e-12);
+        DbgAssertAlmostEqual(grad.x, (noise.SimplexNoise(pt + Vector3(kStep, 0, 0)) - noise.SimplexNoise(pt - Vector3(kStep, 0, 0))) / (2 * kStep), 1e-5);
+        DbgAssertAlmostEqual(grad.y, (noise.SimplexNoise(pt + Vector3(0, kStep, 0)) - noise.SimplexNoise(pt - Vector3(0, kStep, 0))) / (2 * kStep), 1e-5);
+        DbgAssertAlmostEqual(grad.z, (noise.SimplexNoise(pt + Vector3(0, 0, kStep)) - noise.SimplexNoise(pt - Vector3(0, 0, kStep))) / (2 * kStep), 1e-5);
+        
+        DbgAssertAlmostEqual(noise.SimplexNoiseDeriv2D(x, y, dx, dy), noise.SimplexNoise2D(x, y), 1e-12);
+        DbgAssertAlmostEqual(dx, (noise.SimplexNoise2D(x + kStep, y) - noise.SimplexNoise2D(x - kStep, y)) / (2 * kStep), 1e-5);
+        DbgAssertAlmostEqual(dy, (noise.SimplexNoise2D(x, y + kStep) - noise.SimplexNoise2D(x, y - kStep)) / (2 * kStep), 1e-5);
+        
+        // ridged, so the abs flips some octaves' slopes, and clipped, where the slope is 0.
+        // The ridges are creases, so the slope only has to match the side without one.
+        double fbm2 = noise.FBMDeriv2D(x, y, 0.5, 2.0, 0.05, 0.2, 0.9, 5, true, dx, dy, kNoiseSimplex);
+        DbgAssertAlmostEqual(fbm2, noise.FBM2D(x, y, 0.5, 2.0, 0.05, 0.2, 0.9, 5, true, kNoiseSimplex), 1e-12);
+        double fbmRight = noise.FBM2D(x + kStep, y, 0.5, 2.0, 0.05, 0.2, 0.9, 5, true, kNoiseSimplex);
+        double fbmLeft = noise.FBM2D(x - kStep, y, 0.5, 2.0, 0.05, 0.2, 0.9, 5, true, kNoiseSimplex);
+        if(fbmRight > 0 && fbmRight < 1 && fbmLeft > 0 && fbmLeft < 1) {
+            double rightSlope = (fbmRight - fbm2) / kStep;
+            double leftSlope = (fbm2 - fbmLeft) / kStep;
+            DbgAssert(std::min(fabs(dx - rightSlope), fabs(dx - leftSlope)) < 1e-3);
+        } else if(fbm2 == 0 || fbm2 == 1) {
+            DbgAssert(dx == 0 && dy == 0);
+        }
+        
+        double tiled = noise.TileableFBMDeriv2D(x, y, kPeriodX, kPeriodY, 0.5, 2, -1.0, 1.0, 5, false, dx, dy);
+        DbgAssertAlmostEqual(tiled, noise.TileableFBM2D(x, y, kPeriodX, kPeriodY, 0.5, 2, -1.0, 1.0, 5, false), 1e-12);
+        DbgAssertAlmostEqual(dy, (noise.TileableFBM2D(x, y + kStep, kPeriodX, kPeriodY, 0.5, 2, -1.0, 1.0, 5, false) -
+                                  noise.TileableFBM2D(x, y - kStep, kPeriodX, kPeriodY, 0.5, 2, -1.0, 1.0, 5, false)) / (2 * kStep), 1e-4);
+    }
+    
+    // Generators with their own seeds. The same seed gives the same noise, a different one
+    // gives another permutation, and none of them touch rand()'s state.
+    srand(42);
+    int expectedRand = rand();
+    srand(42);
+    NoiseGenerator sameSeed(NoiseGenerator::kDefaultSeed);
+    NoiseGenerator otherSeed(1234);
+    DbgAssert(rand() == expectedRand);
+    DbgAssert(otherSeed.Seed() == 1234);
+    
+    for(int i=0; i<256; i++) seen[i] = false;
+    int samePerm = 0;
+    for(int i=0; i<256; i++) {
+        int p = otherSeed.Perm(i);
+        DbgAssert(!seen[p]);
+        seen[p] = true;
+        samePerm += p == noise.Perm(i) ? 1 : 0;
+    }
+    DbgAssert(samePerm < 256);
+    
+    int sameNoise = 0;
+    for(int i = 0; i < count; i++) {
+        Vector3 pt(xs[i], ys[i], zs[i]);
+        DbgAssert(sameSeed.ImpPerlinNoise(pt) == noise.ImpPerlinNoise(pt));
+        sameNoise += otherSeed.ImpPerlinNoise(pt) == noise.ImpPerlinNoise(pt) ? 1 : 0;
+    }
+    DbgAssert(sameNoise < count / 2);
+    
+    // One generator shared by several threads, each doing all the points.
+    constexpr int kThreads = 4;
+    std::vector<double> shared[kThreads];
+    std::vector<std::thread> threads;
+    for(int t = 0; t < kThreads; t++) {
+        shared[t].resize(count);
+        threads.emplace_back([&, t] {
+            otherSeed.FBMBatch(xs.data(), ys.data(), zs.data(), shared[t].data(), count, 0.5, 2.0, 0.05, 0.0, 1.0, 5, true);
+        });
+    }
+    for(std::thread& thread : threads) {
+        thread.join();
+    }
+    for(int i = 0; i < count; i++) {
+        double expected = otherSeed.FBM(Vector3(xs[i], ys[i], zs[i]), 0.5, 2.0, 0.05, 0.0, 1.0, 5, true);
+        for(int t = 0; t < kThreads; t++) {
+            DbgAssertAlmostEqual(shared[t][i], expected, 1e-12);
+        }
+    }
+    
     // print histogram of noise results for inspection.
     
     constexpr int kHistSize = 100;
@@ -247,7 +1595,7 @@ bool TestNoise()
     bool first = true;
     double min = 0, max = 0;
     for(int i = 0; i < 10000; i++) {
-        p = {RandFloat(), RandFloat(), RandFloat()};
+        p = {unit(rng), unit(rng), unit(rng)};
         n = ImpPerlinNoise(p);
         int histIdx = (int)(n * kHistSize);
         // cout << "p=" << p << " n=" << n << " histIdx=" << histIdx << endl;
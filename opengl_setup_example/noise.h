@@ -8,17 +8,187 @@
 #ifndef noise_hpp
 #define noise_hpp
 
+#include <cstdint>
+
 #include "vector3.h"
 
+// Points per step of the batch functions below. Any count works, a partial last step is padded.
+constexpr int kNoiseBatchLanes = 8;
+
+// The noise FBM and Turbulence sum octaves of.
+enum NoiseBasis {
+    // ImpPerlinNoise, interpolated over the 2^N corners of a lattice cube.
+    kNoisePerlin,
+    // SimplexNoise, summed over the N+1 corners of a simplex, so cheaper in more dimensions.
+    kNoiseSimplex
+};
+
+// Perlin improved noise over its own permutation table, shuffled from a seed. Nothing
+// changes after construction, so one generator can be shared by any number of threads.
+class NoiseGenerator {
+public:
+    // the seed the free functions' noise has always come from.
+    static constexpr uint32_t kDefaultSeed = 11587;
+
+private:
+    uint32_t mSeed;
+    int mPerm[256];
+
+    template<typename Real> void NoiseLanes(const Real* px, const Real* py, const Real* pz, Real* out) const;
+    template<typename Real> void NoiseBatch(const Real* x, const Real* y, const Real* z, Real* out, int count) const;
+    template<typename Real> void FBMBatchT(const Real* x, const Real* y, const Real* z, Real* out, int count,
+                                           double gain, double lacun, double freqMin, double min, double max,
+                                           int octaves, bool abs, NoiseBasis basis) const;
+    // periodX of 0 hashes as ImpPerlinNoise2D, otherwise as TileableNoise2D.
+    template<typename Real> void NoiseLanes2D(const Real* px, const Real* py, Real* out, int periodX, int periodY) const;
+    template<typename Real> void NoiseBatch2D(const Real* x, const Real* y, Real* out, int count, int periodX, int periodY) const;
+    template<typename Real> void FBMBatch2DT(const Real* x, const Real* y, Real* out, int count, int periodX, int periodY,
+                                             double gain, double lacun, double freqMin, double min, double max,
+                                             int octaves, bool abs, NoiseBasis basis) const;
+    // Simplex noise in Dim dimensions at one point, and at kNoiseBatchLanes or count points
+    // given as an array per axis.
+    // gradient, when not null, gets the noise's partial derivatives.
+    template<int Dim, typename Real> Real SimplexPoint(const Real* p, Real* gradient = nullptr) const;
+    template<int Dim, typename Real> void SimplexLanes(const Real* const* p, Real* out) const;
+    template<int Dim, typename Real> void SimplexBatch(const Real* const* p, Real* out, int count) const;
+
+public:
+    explicit NoiseGenerator(uint32_t seed = kDefaultSeed);
+
+    uint32_t Seed(void) const { return mSeed; }
+    // entry of the permutation for the low 8 bits of x.
+    int Perm(int x) const { return mPerm[x & 0xff]; }
+
+    // This is Perlin improved noise funcion.
+    double ImpPerlinNoise(Vector3 p) const;
+
+    // Simplex noise, in about the same [-1, 1] range and continuous everywhere, without the
+    // axis aligned look of a cube lattice. At the same frequency its features are about the
+    // size of ImpPerlinNoise's in 2D, and 1.25 times larger in 3D. The 4D one is for
+    // animating 3D textures, with time as w.
+    double SimplexNoise2D(double x, double y) const;
+    double SimplexNoise(Vector3 p) const;
+    double SimplexNoise4D(double x, double y, double z, double w) const;
+
+    double FBM(Vector3 p, double gain, double lacun,
+               double freqMin, double min, double max,
+               int octaves, bool abs, NoiseBasis basis = kNoisePerlin) const;
+
+    double Turbulence(Vector3 p, double freqMin, int octaves, NoiseBasis basis = kNoisePerlin) const;
+
+    // ImpPerlinNoise for count points given as separate x, y and z arrays, the same values
+    // to within rounding, a step of kNoiseBatchLanes points at a time.
+    void ImpPerlinNoiseBatch(const float* x, const float* y, const float* z, float* out, int count) const;
+    void ImpPerlinNoiseBatch(const double* x, const double* y, const double* z, double* out, int count) const;
+
+    // FBM and Turbulence over the same arrays, same arguments as above.
+    void FBMBatch(const float* x, const float* y, const float* z, float* out, int count,
+                  double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                  NoiseBasis basis = kNoisePerlin) const;
+    void FBMBatch(const double* x, const double* y, const double* z, double* out, int count,
+                  double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                  NoiseBasis basis = kNoisePerlin) const;
+
+    void TurbulenceBatch(const float* x, const float* y, const float* z, float* out, int count, double freqMin, int octaves,
+                         NoiseBasis basis = kNoisePerlin) const;
+    void TurbulenceBatch(const double* x, const double* y, const double* z, double* out, int count, double freqMin, int octaves,
+                         NoiseBasis basis = kNoisePerlin) const;
+
+    // The simplex noise for count points, as for ImpPerlinNoiseBatch.
+    void SimplexNoiseBatch2D(const float* x, const float* y, float* out, int count) const;
+    void SimplexNoiseBatch2D(const double* x, const double* y, double* out, int count) const;
+    void SimplexNoiseBatch(const float* x, const float* y, const float* z, float* out, int count) const;
+    void SimplexNoiseBatch(const double* x, const double* y, const double* z, double* out, int count) const;
+    void SimplexNoiseBatch4D(const float* x, const float* y, const float* z, const float* w, float* out, int count) const;
+    void SimplexNoiseBatch4D(const double* x, const double* y, const double* z, const double* w, double* out, int count) const;
+
+    // ImpPerlinNoise in the z = 0 plane, the same values without the work for a third axis.
+    // Like it, the corners at (1, 0) and (0, 1) swap hashes, which leaves seams along the
+    // lattice lines.
+    double ImpPerlinNoise2D(double x, double y) const;
+    // 2D noise that repeats every periodX lattice cells along x and periodY along y.
+    // Each corner is hashed from its own lattice point, so there are no seams, at the
+    // lattice lines or where it wraps.
+    double TileableNoise2D(double x, double y, int periodX, int periodY) const;
+
+    double FBM2D(double x, double y, double gain, double lacun,
+                 double freqMin, double min, double max,
+                 int octaves, bool abs, NoiseBasis basis = kNoisePerlin) const;
+    double Turbulence2D(double x, double y, double freqMin, int octaves, NoiseBasis basis = kNoisePerlin) const;
+    // FBM over TileableNoise2D from a frequency of 1. Each octave multiplies the frequency
+    // and period by lacun, so the sum repeats with the first octave's period.
+    double TileableFBM2D(double x, double y, int periodX, int periodY, double gain, int lacun,
+                         double min, double max, int octaves, bool abs) const;
+    double TileableTurbulence2D(double x, double y, int periodX, int periodY, int octaves) const;
+
+    // Batch versions of the 2D functions above, as for the 3D ones.
+    void ImpPerlinNoiseBatch2D(const float* x, const float* y, float* out, int count) const;
+    void ImpPerlinNoiseBatch2D(const double* x, const double* y, double* out, int count) const;
+    void TileableNoiseBatch2D(const float* x, const float* y, float* out, int count, int periodX, int periodY) const;
+    void TileableNoiseBatch2D(const double* x, const double* y, double* out, int count, int periodX, int periodY) const;
+    void FBMBatch2D(const float* x, const float* y, float* out, int count,
+                    double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                    NoiseBasis basis = kNoisePerlin) const;
+    void FBMBatch2D(const double* x, const double* y, double* out, int count,
+                    double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                    NoiseBasis basis = kNoisePerlin) const;
+    void TileableFBMBatch2D(const float* x, const float* y, float* out, int count, int periodX, int periodY,
+                            double gain, int lacun, double min, double max, int octaves, bool abs) const;
+    void TileableFBMBatch2D(const double* x, const double* y, double* out, int count, int periodX, int periodY,
+                            double gain, int lacun, double min, double max, int octaves, bool abs) const;
+
+    // The functions above together with their gradient, in one evaluation instead of the
+    // extra ones finite differences take. The value is the plain function's to within
+    // rounding, and the gradient is exact, except on ImpPerlinNoise's seams.
+    double ImpPerlinNoiseDeriv(Vector3 p, Vector3& gradient) const;
+    double SimplexNoiseDeriv(Vector3 p, Vector3& gradient) const;
+    double ImpPerlinNoiseDeriv2D(double x, double y, double& dx, double& dy) const;
+    double TileableNoiseDeriv2D(double x, double y, int periodX, int periodY, double& dx, double& dy) const;
+    double SimplexNoiseDeriv2D(double x, double y, double& dx, double& dy) const;
+
+    // The FBM of the functions above with its gradient, summed through the octaves.
+    // Where the sum is clipped to min or max the gradient is 0.
+    double FBMDeriv(Vector3 p, double gain, double lacun,
+                    double freqMin, double min, double max,
+                    int octaves, bool abs, Vector3& gradient, NoiseBasis basis = kNoisePerlin) const;
+    double FBMDeriv2D(double x, double y, double gain, double lacun,
+                      double freqMin, double min, double max,
+                      int octaves, bool abs, double& dx, double& dy, NoiseBasis basis = kNoisePerlin) const;
+    double TileableFBMDeriv2D(double x, double y, int periodX, int periodY, double gain, int lacun,
+                              double min, double max, int octaves, bool abs, double& dx, double& dy) const;
+
+    // The generator behind the free functions below, seeded with kDefaultSeed.
+    static const NoiseGenerator& Default(void);
+};
+
+// The functions below use NoiseGenerator::Default().
+
 // This is Perlin improved noise funcion.
 double ImpPerlinNoise(Vector3 p);
 
 
 double FBM(Vector3 p, double gain, double lacun,
            double freqMin, double min, double max,
-           int octaves, bool abs);
+           int octaves, bool abs, NoiseBasis basis = kNoisePerlin);
+
+double Turbulence(Vector3 p, double freqMin, int octaves, NoiseBasis basis = kNoisePerlin);
+
+double SimplexNoise(Vector3 p);
+
+void ImpPerlinNoiseBatch(const float* x, const float* y, const float* z, float* out, int count);
+void ImpPerlinNoiseBatch(const double* x, const double* y, const double* z, double* out, int count);
+
+void FBMBatch(const float* x, const float* y, const float* z, float* out, int count,
+              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+              NoiseBasis basis = kNoisePerlin);
+void FBMBatch(const double* x, const double* y, const double* z, double* out, int count,
+              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+              NoiseBasis basis = kNoisePerlin);
 
-double Turbulence(Vector3 p, double freqMin, int octaves);
+void TurbulenceBatch(const float* x, const float* y, const float* z, float* out, int count, double freqMin, int octaves,
+                     NoiseBasis basis = kNoisePerlin);
+void TurbulenceBatch(const double* x, const double* y, const double* z, double* out, int count, double freqMin, int octaves,
+                     NoiseBasis basis = kNoisePerlin);
 
 bool TestNoise();
 
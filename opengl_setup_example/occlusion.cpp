@@ -0,0 +1,436 @@
+//
+//  occlusion.cpp
+//  opengl_setup_example
+//
+
+#include "occlusion.h"
+
+#include <cfloat>
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <list>
+#include <memory>
+
+#include <glm/ext.hpp>
+
+#include "model_object.h"
+#include "thread_pool.h"
+#include "simd.h"
+#include "mathutil.h"
+#include "dbgutils.h"
+#include "trace.h"
+
+// Clip space w below this is treated as touching the eye plane.
+constexpr float kMinClipW = 1e-5f;
+
+// objects handed to each worker at a time when testing.
+constexpr int kObjectsPerJob = 32;
+
+typedef std::chrono::high_resolution_clock OcclusionClock;
+
+static double MillisSince(OcclusionClock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(OcclusionClock::now() - start).count();
+}
+
+
+OcclusionCuller::OcclusionCuller(ThreadPool* pool, int width, int height)
+    : mPool(pool), mWidth(width), mHeight(height), mViewProj(1.0f), mSetupMillis(0), mRasterMillis(0)
+{
+    DbgAssert(width % kTileSize == 0 && height % kTileSize == 0);
+    mTilesX = width / kTileSize;
+    mTilesY = height / kTileSize;
+    mTileBins.resize(mTilesX * mTilesY);
+
+    int levelWidth = width, levelHeight = height;
+    for(;;) {
+        DepthLevel level;
+        level.width = levelWidth;
+        level.height = levelHeight;
+        level.depth.assign(levelWidth * levelHeight, 1.0f);
+        mLevels.push_back(std::move(level));
+        if(levelWidth == 1 && levelHeight == 1) {
+            break;
+        }
+        levelWidth = (levelWidth + 1) / 2;
+        levelHeight = (levelHeight + 1) / 2;
+    }
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProj)
+{
+    mViewProj = viewProj;
+    mTris.clear();
+    for(auto& bin : mTileBins) {
+        bin.clear();
+    }
+    mSetupMillis = 0;
+    mRasterMillis = 0;
+}
+
+void OcclusionCuller::AddTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2)
+{
+    // Triangles crossing the near plane are dropped rather than clipped. Losing an
+    // occluder only makes culling less effective, never wrong.
+    const glm::vec4* clip[3] = { &c0, &c1, &c2 };
+    for(int i = 0; i < 3; i++) {
+        if(clip[i]->w < kMinClipW || clip[i]->z < -clip[i]->w) {
+            return;
+        }
+    }
+
+    ScreenTri tri;
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for(int i = 0; i < 3; i++) {
+        float invW = 1.0f / clip[i]->w;
+        tri.v[i].x = (clip[i]->x * invW * 0.5f + 0.5f) * mWidth;
+        tri.v[i].y = (clip[i]->y * invW * 0.5f + 0.5f) * mHeight;
+        tri.v[i].z = clip[i]->z * invW * 0.5f + 0.5f;
+        minX = TMin(minX, tri.v[i].x);
+        minY = TMin(minY, tri.v[i].y);
+        maxX = TMax(maxX, tri.v[i].x);
+        maxY = TMax(maxY, tri.v[i].y);
+    }
+
+    tri.minX = TMax(0, (int)floorf(minX));
+    tri.minY = TMax(0, (int)floorf(minY));
+    tri.maxX = TMin(mWidth - 1, (int)ceilf(maxX));
+    tri.maxY = TMin(mHeight - 1, (int)ceilf(maxY));
+    if(tri.minX > tri.maxX || tri.minY > tri.maxY) {
+        return;
+    }
+
+    // Both faces are rasterized, wind them all counter clockwise so the edge tests agree.
+    glm::vec3 e1 = tri.v[1] - tri.v[0];
+    glm::vec3 e2 = tri.v[2] - tri.v[0];
+    float area = e1.x * e2.y - e1.y * e2.x;
+    if(fabsf(area) < 1e-6f) {
+        return;
+    }
+    if(area < 0) {
+        std::swap(tri.v[1], tri.v[2]);
+    }
+
+    uint32_t triIndex = (uint32_t)mTris.size();
+    mTris.push_back(tri);
+    for(int ty = tri.minY / kTileSize; ty <= tri.maxY / kTileSize; ty++) {
+        for(int tx = tri.minX / kTileSize; tx <= tri.maxX / kTileSize; tx++) {
+            mTileBins[ty * mTilesX + tx].push_back(triIndex);
+        }
+    }
+}
+
+void OcclusionCuller::AddOccluder(const std::vector<float>& vertices, const std::vector<int>& indexes, const glm::mat4& modelMatrix)
+{
+    auto startTime = OcclusionClock::now();
+
+    const glm::mat4 mvp = mViewProj * modelMatrix;
+    const size_t vertexCount = vertices.size() / 3;
+    std::vector<glm::vec4> clipVerts(vertexCount);
+    for(size_t i = 0; i < vertexCount; i++) {
+        clipVerts[i] = mvp * glm::vec4(vertices[i*3], vertices[i*3+1], vertices[i*3+2], 1.0f);
+    }
+
+    if(indexes.empty()) {
+        for(size_t i = 0; i + 2 < vertexCount; i += 3) {
+            AddTriangle(clipVerts[i], clipVerts[i+1], clipVerts[i+2]);
+        }
+    } else {
+        for(size_t i = 0; i + 2 < indexes.size(); i += 3) {
+            AddTriangle(clipVerts[indexes[i]], clipVerts[indexes[i+1]], clipVerts[indexes[i+2]]);
+        }
+    }
+
+    mSetupMillis += MillisSince(startTime);
+}
+
+void OcclusionCuller::AddOccluder(const ModelObject& obj)
+{
+    if(obj.geometry) {
+        AddOccluder(obj.geometry->vertexData, obj.geometry->vertexIndexes, obj.modelMatrixStack.top());
+    }
+}
+
+void OcclusionCuller::RasterizeTile(int tileIndex)
+{
+    const int tileX0 = (tileIndex % mTilesX) * kTileSize;
+    const int tileY0 = (tileIndex / mTilesX) * kTileSize;
+    const int tileX1 = tileX0 + kTileSize - 1;
+    const int tileY1 = tileY0 + kTileSize - 1;
+    float* depth = mLevels[0].depth.data();
+
+    for(int y = tileY0; y <= tileY1; y++) {
+        std::fill(depth + y * mWidth + tileX0, depth + y * mWidth + tileX1 + 1, 1.0f);
+    }
+
+    static const float kLaneOffsets[4] = { 0.5f, 1.5f, 2.5f, 3.5f };
+    const Float4 laneOffsets = Load4(kLaneOffsets);
+    const Float4 zero = Set4(0.0f);
+
+    for(uint32_t triIndex : mTileBins[tileIndex]) {
+        const ScreenTri& tri = mTris[triIndex];
+        const glm::vec3& v0 = tri.v[0];
+        const glm::vec3& v1 = tri.v[1];
+        const glm::vec3& v2 = tri.v[2];
+
+        // Edge functions as A*x + B*y + C, each positive on the inside and zero on the opposite vertex.
+        float a0 = v1.y - v2.y, b0 = v2.x - v1.x, c0 = -(a0 * v1.x + b0 * v1.y);
+        float a1 = v2.y - v0.y, b1 = v0.x - v2.x, c1 = -(a1 * v2.x + b1 * v2.y);
+        float a2 = v0.y - v1.y, b2 = v1.x - v0.x, c2 = -(a2 * v0.x + b2 * v0.y);
+        float invArea = 1.0f / (a0 * v0.x + b0 * v0.y + c0);
+
+        // Window depth is linear in screen space, so it is a plane too.
+        float za = (a0 * v0.z + a1 * v1.z + a2 * v2.z) * invArea;
+        float zb = (b0 * v0.z + b1 * v1.z + b2 * v2.z) * invArea;
+        float zc = (c0 * v0.z + c1 * v1.z + c2 * v2.z) * invArea;
+
+        // x start is aligned down to 4 so every store stays in the tile row.
+        int x0 = TMax(tri.minX, tileX0) & ~3;
+        int x1 = TMin(tri.maxX, tileX1);
+        int y0 = TMax(tri.minY, tileY0);
+        int y1 = TMin(tri.maxY, tileY1);
+
+        Float4 edgeA0 = Set4(a0), edgeA1 = Set4(a1), edgeA2 = Set4(a2), depthA = Set4(za);
+
+        for(int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            Float4 row0 = Set4(b0 * py + c0);
+            Float4 row1 = Set4(b1 * py + c1);
+            Float4 row2 = Set4(b2 * py + c2);
+            Float4 rowZ = Set4(zb * py + zc);
+            float* depthRow = depth + y * mWidth;
+
+            for(int x = x0; x <= x1; x += 4) {
+                Float4 px = Set4((float)x) + laneOffsets;
+                Float4 e0 = edgeA0 * px + row0;
+                Float4 e1 = edgeA1 * px + row1;
+                Float4 e2 = edgeA2 * px + row2;
+                Float4 inside = And4(And4(CmpLe4(zero, e0), CmpLe4(zero, e1)), CmpLe4(zero, e2));
+                if(MoveMask4(inside) == 0) {
+                    continue;
+                }
+                Float4 z = depthA * px + rowZ;
+                Float4 current = Load4(depthRow + x);
+                Store4(depthRow + x, Select4(inside, Min4(z, current), current));
+            }
+        }
+    }
+}
+
+void OcclusionCuller::BuildHiZ(void)
+{
+    for(size_t i = 1; i < mLevels.size(); i++) {
+        const DepthLevel& src = mLevels[i-1];
+        DepthLevel& dst = mLevels[i];
+        for(int y = 0; y < dst.height; y++) {
+            int sy0 = y * 2;
+            int sy1 = TMin(sy0 + 1, src.height - 1);
+            for(int x = 0; x < dst.width; x++) {
+                int sx0 = x * 2;
+                int sx1 = TMin(sx0 + 1, src.width - 1);
+                float z = TMax(TMax(src.depth[sy0 * src.width + sx0], src.depth[sy0 * src.width + sx1]),
+                               TMax(src.depth[sy1 * src.width + sx0], src.depth[sy1 * src.width + sx1]));
+                dst.depth[y * dst.width + x] = z;
+            }
+        }
+    }
+}
+
+void OcclusionCuller::Rasterize(void)
+{
+    TRACE_ZONE("cull", "OcclusionCuller::Rasterize");
+    auto startTime = OcclusionClock::now();
+
+    const int tileCount = mTilesX * mTilesY;
+    if(mPool) {
+        mPool->ParallelFor(tileCount, [this](int tileIndex) { RasterizeTile(tileIndex); });
+    } else {
+        for(int i = 0; i < tileCount; i++) {
+            RasterizeTile(i);
+        }
+    }
+    BuildHiZ();
+
+    mRasterMillis = MillisSince(startTime);
+}
+
+bool OcclusionCuller::IsOccluded(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& modelMatrix) const
+{
+    const glm::mat4 mvp = mViewProj * modelMatrix;
+    float minX = FLT_MAX, minY = FLT_MAX, minZ = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for(int corner = 0; corner < 8; corner++) {
+        glm::vec3 p((corner & 1) ? localMax.x : localMin.x,
+                    (corner & 2) ? localMax.y : localMin.y,
+                    (corner & 4) ? localMax.z : localMin.z);
+        glm::vec4 c = mvp * glm::vec4(p, 1.0f);
+        if(c.w < kMinClipW) {
+            // reaches behind the eye, the screen rect is unbounded.
+            return false;
+        }
+        float invW = 1.0f / c.w;
+        minX = TMin(minX, c.x * invW);
+        maxX = TMax(maxX, c.x * invW);
+        minY = TMin(minY, c.y * invW);
+        maxY = TMax(maxY, c.y * invW);
+        minZ = TMin(minZ, c.z * invW);
+    }
+
+    float nearestDepth = minZ * 0.5f + 0.5f;
+    if(nearestDepth <= 0.0f) {
+        return false;
+    }
+
+    float sx0 = (minX * 0.5f + 0.5f) * mWidth;
+    float sx1 = (maxX * 0.5f + 0.5f) * mWidth;
+    float sy0 = (minY * 0.5f + 0.5f) * mHeight;
+    float sy1 = (maxY * 0.5f + 0.5f) * mHeight;
+    if(sx1 < 0 || sy1 < 0 || sx0 > mWidth || sy0 > mHeight) {
+        // off screen is left to the frustum culler.
+        return false;
+    }
+
+    int ix0 = TClip((int)floorf(sx0), 0, mWidth - 1);
+    int ix1 = TClip((int)ceilf(sx1) - 1, ix0, mWidth - 1);
+    int iy0 = TClip((int)floorf(sy0), 0, mHeight - 1);
+    int iy1 = TClip((int)ceilf(sy1) - 1, iy0, mHeight - 1);
+
+    // Coarsest level where the rect is still about 2 texels across.
+    int level = 0;
+    int span = TMax(ix1 - ix0, iy1 - iy0) + 1;
+    while(span > 2 && level + 1 < (int)mLevels.size()) {
+        span = (span + 1) / 2;
+        level++;
+    }
+
+    const DepthLevel& hiz = mLevels[level];
+    for(int y = iy0 >> level; y <= iy1 >> level; y++) {
+        for(int x = ix0 >> level; x <= ix1 >> level; x++) {
+            if(hiz.depth[y * hiz.width + x] >= nearestDepth) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void OcclusionCuller::CullObjects(const std::vector<ModelObject*>& objects, OcclusionStats& outStats)
+{
+    TRACE_ZONE("cull", "OcclusionCuller::CullObjects");
+    auto startTime = OcclusionClock::now();
+
+    std::atomic<int> tested(0), occluded(0);
+    const int count = (int)objects.size();
+    const int jobCount = (count + kObjectsPerJob - 1) / kObjectsPerJob;
+
+    auto testRange = [&](int job) {
+        int localTested = 0, localOccluded = 0;
+        int end = TMin(count, (job + 1) * kObjectsPerJob);
+        for(int i = job * kObjectsPerJob; i < end; i++) {
+            ModelObject* obj = objects[i];
+            if(!obj->Visible() || obj->isCulled || obj->isOccluder || !obj->geometry) {
+                continue;
+            }
+            localTested++;
+            const LocalBounds& b = obj->geometry->localBounds;
+            if(IsOccluded(b.aabbMin, b.aabbMax, obj->modelMatrixStack.top())) {
+                obj->isCulled = true;
+                localOccluded++;
+            }
+        }
+        tested += localTested;
+        occluded += localOccluded;
+    };
+
+    if(mPool) {
+        mPool->ParallelFor(jobCount, testRange);
+    } else {
+        for(int i = 0; i < jobCount; i++) {
+            testRange(i);
+        }
+    }
+
+    OcclusionStats stats;
+    stats.tested = tested;
+    stats.occluded = occluded;
+    stats.occluderTris = (int)mTris.size();
+    stats.setupMillis = mSetupMillis;
+    stats.rasterMillis = mRasterMillis;
+    stats.testMillis = MillisSince(startTime);
+    outStats = stats;
+}
+
+
+bool OcclusionCuller::Test(void)
+{
+    glm::mat4 proj = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    const glm::mat4 identity = glm::identity<glm::mat4>();
+
+    // A wall 3 units wide at z = -5 facing the camera, wound clockwise to check both faces draw.
+    std::vector<float> wall = { -1.5f, -1.5f, -5,  1.5f, -1.5f, -5,  1.5f, 1.5f, -5,  -1.5f, 1.5f, -5 };
+    std::vector<int> wallIndexes = { 0, 2, 1,  0, 3, 2 };
+    std::vector<float> cube = { -0.5f, -0.5f, -0.5f,  0.5f, 0.5f, 0.5f,  -0.5f, 0.5f, 0.5f };
+
+    ThreadPool pool(2);
+    OcclusionCuller culler(&pool, 128, 96);
+    culler.BeginFrame(proj * view);
+    culler.AddOccluder(wall, wallIndexes, identity);
+    culler.Rasterize();
+
+    // wall covers the middle of the buffer but not the corners.
+    DbgAssert(culler.DepthAt(64, 48) < 1.0f);
+    DbgAssert(culler.DepthAt(1, 1) == 1.0f);
+    glm::vec4 wallClip = proj * view * glm::vec4(0, 0, -5, 1);
+    DbgAssertAlmostEqual(culler.DepthAt(64, 48), wallClip.z / wallClip.w * 0.5 + 0.5, 1e-5);
+
+    auto at = [&](float x, float y, float z) { return glm::translate(identity, glm::vec3(x, y, z)); };
+    glm::vec3 boxMin(-0.5f), boxMax(0.5f);
+    DbgAssert(culler.IsOccluded(boxMin, boxMax, at(0, 0, -10)));
+    DbgAssert(!culler.IsOccluded(boxMin, boxMax, at(0, 0, -2))); // in front of the wall
+    DbgAssert(!culler.IsOccluded(boxMin, boxMax, at(3, 0, -10))); // sticks out the side
+    DbgAssert(!culler.IsOccluded(boxMin, boxMax, at(0, 0, 5))); // behind the eye
+
+    // Objects go through the same test, occluders and hidden objects are left alone.
+    auto cubeGeom = std::make_shared<MeshGeometry>();
+    cubeGeom->vertexData = cube;
+    cubeGeom->Finish();
+    std::list<std::unique_ptr<ModelObject>> owned;
+    std::vector<ModelObject*> objects;
+    const glm::vec3 positions[] = { {0, 0, -10}, {0.5f, 0.5f, -12}, {3, 0, -10}, {0, 0, -2}, {0, 0, -10}, {0, 0, -10} };
+    for(const auto& pos : positions) {
+        owned.push_back(std::make_unique<ModelObject>());
+        ModelObject* obj = owned.back().get();
+        obj->geometry = cubeGeom;
+        obj->Show();
+        obj->PushModelMatrix(at(pos.x, pos.y, pos.z));
+        objects.push_back(obj);
+    }
+    objects[4]->isOccluder = true;
+    objects[5]->Hide();
+
+    OcclusionStats stats;
+    culler.CullObjects(objects, stats);
+    DbgAssert(objects[0]->isCulled);
+    DbgAssert(objects[1]->isCulled);
+    DbgAssert(!objects[2]->isCulled);
+    DbgAssert(!objects[3]->isCulled);
+    DbgAssert(!objects[4]->isCulled);
+    DbgAssert(!objects[5]->isCulled);
+    DbgAssert(stats.tested == 4);
+    DbgAssert(stats.occluded == 2);
+    DbgAssert(stats.occluderTris == 2);
+
+    // Same results with no pool.
+    OcclusionCuller serial(nullptr, 128, 96);
+    serial.BeginFrame(proj * view);
+    serial.AddOccluder(wall, wallIndexes, identity);
+    serial.Rasterize();
+    DbgAssert(serial.IsOccluded(boxMin, boxMax, at(0, 0, -10)));
+    DbgAssert(serial.DepthAt(64, 48) == culler.DepthAt(64, 48));
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
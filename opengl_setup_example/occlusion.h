@@ -0,0 +1,102 @@
+//
+//  occlusion.h
+//  opengl_setup_example
+//
+
+#ifndef occlusion_hpp
+#define occlusion_hpp
+
+#include <vector>
+#include <cstdint>
+
+#include <glm/glm.hpp>
+
+class ModelObject;
+class ThreadPool;
+
+struct OcclusionStats {
+    // objects that reached the occlusion test, after frustum culling.
+    int tested;
+    int occluded;
+    int occluderTris;
+    // transform and binning of occluders, then tile rasterization and hi-z build.
+    double setupMillis;
+    double rasterMillis;
+    double testMillis;
+
+    OcclusionStats() : tested(0), occluded(0), occluderTris(0), setupMillis(0), rasterMillis(0), testMillis(0) {}
+
+    double TotalMillis(void) const { return setupMillis + rasterMillis + testMillis; }
+};
+
+// Software occlusion culling on the CPU.
+// Occluder triangles are rasterized into a small depth buffer split in tiles that are
+// filled in parallel, 4 pixels at a time. A max depth pyramid is built from that and each
+// object's screen space box is tested against the level where it covers about 2x2 texels.
+// Everything runs without a GL context so it can be tested on its own.
+class OcclusionCuller {
+public:
+    static constexpr int kTileSize = 32;
+
+private:
+    struct ScreenTri {
+        // x, y in pixels with y up, z is window depth in [0, 1].
+        glm::vec3 v[3];
+        int minX, minY, maxX, maxY;
+    };
+
+    struct DepthLevel {
+        int width, height;
+        std::vector<float> depth;
+    };
+
+    ThreadPool* mPool;
+    int mWidth, mHeight;
+    int mTilesX, mTilesY;
+    glm::mat4 mViewProj;
+
+    std::vector<ScreenTri> mTris;
+    // indexes into mTris overlapping each tile.
+    std::vector<std::vector<uint32_t>> mTileBins;
+    // level 0 is the full resolution depth buffer, each level after is half the size keeping the farthest depth.
+    std::vector<DepthLevel> mLevels;
+
+    double mSetupMillis;
+    double mRasterMillis;
+
+    void AddTriangle(const glm::vec4& c0, const glm::vec4& c1, const glm::vec4& c2);
+    void RasterizeTile(int tileIndex);
+    void BuildHiZ(void);
+
+public:
+    // width and height must be multiples of kTileSize. pool may be null to run on the caller only.
+    OcclusionCuller(ThreadPool* pool, int width = 256, int height = 192);
+
+    int Width(void) const { return mWidth; }
+    int Height(void) const { return mHeight; }
+
+    // Clears depth and occluders for a new view.
+    void BeginFrame(const glm::mat4& viewProj);
+
+    // vertices are xyz triples, indexes may be empty for unindexed triangles.
+    // Lets callers pass a simplified stand in mesh rather than the drawn one.
+    void AddOccluder(const std::vector<float>& vertices, const std::vector<int>& indexes, const glm::mat4& modelMatrix);
+    void AddOccluder(const ModelObject& obj);
+
+    // Fills the depth buffer from the occluders added this frame and builds the pyramid.
+    void Rasterize(void);
+
+    // Box in object space with its model matrix. Only true when every pixel it could touch
+    // already has something nearer.
+    bool IsOccluded(const glm::vec3& localMin, const glm::vec3& localMax, const glm::mat4& modelMatrix) const;
+
+    // Sets isCulled on occluded objects. Skips hidden, already culled, and occluder objects.
+    void CullObjects(const std::vector<ModelObject*>& objects, OcclusionStats& outStats);
+
+    // depth of the full resolution buffer, x and y in pixels with y up.
+    float DepthAt(int x, int y) const { return mLevels[0].depth[y * mWidth + x]; }
+
+    static bool Test(void);
+};
+
+#endif /* occlusion_hpp */
@@ -0,0 +1,91 @@
+//
+//  offscreen_target.cpp
+//  opengl_setup_example
+//
+
+#include "offscreen_target.h"
+
+#include <iostream>
+
+#include "gl_backend.h"
+
+OffscreenTarget::OffscreenTarget(GLBackend& backend)
+    : mBackend(backend), mFramebuffer(0), mColorBuffer(0), mDepthBuffer(0), mWidth(0), mHeight(0)
+{
+}
+
+OffscreenTarget::~OffscreenTarget()
+{
+    Release();
+}
+
+void OffscreenTarget::Release(void)
+{
+    if(mFramebuffer == 0) {
+        return;
+    }
+    mBackend.DeleteFramebuffer(mFramebuffer);
+    mBackend.DeleteRenderbuffer(mColorBuffer);
+    mBackend.DeleteRenderbuffer(mDepthBuffer);
+    mFramebuffer = mColorBuffer = mDepthBuffer = 0;
+}
+
+bool OffscreenTarget::Init(GLsizei width, GLsizei height)
+{
+    Release();
+    mWidth = width;
+    mHeight = height;
+
+    mColorBuffer = mBackend.GenRenderbuffer();
+    mBackend.BindRenderbuffer(GL_RENDERBUFFER, mColorBuffer);
+    mBackend.RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+    mDepthBuffer = mBackend.GenRenderbuffer();
+    mBackend.BindRenderbuffer(GL_RENDERBUFFER, mDepthBuffer);
+    mBackend.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    mBackend.BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    mFramebuffer = mBackend.GenFramebuffer();
+    mBackend.BindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    mBackend.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, mColorBuffer);
+    mBackend.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, mDepthBuffer);
+
+    GLenum status = mBackend.CheckFramebufferStatus(GL_FRAMEBUFFER);
+    mBackend.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    if(status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer incomplete, status 0x" << std::hex << status << std::dec << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void OffscreenTarget::Bind(void)
+{
+    mBackend.BindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    mBackend.Viewport(0, 0, mWidth, mHeight);
+}
+
+void OffscreenTarget::Unbind(void)
+{
+    mBackend.BindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void OffscreenTarget::ReadPixels(RGBImageBuffer& image)
+{
+    // GL_RGB reads need GL_PACK_ALIGNMENT of 1 for odd widths, RGBA rows are always aligned.
+    RGBImageBuffer rgba(mWidth, mHeight, 4);
+    mBackend.BindFramebuffer(GL_READ_FRAMEBUFFER, mFramebuffer);
+    mBackend.ReadPixels(0, 0, mWidth, mHeight, GL_RGBA, GL_UNSIGNED_BYTE, rgba.Pixels());
+    mBackend.BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    image.SetSize(mWidth, mHeight, 3);
+    for(u_int32_t row = 0; row < image.Height(); row++) {
+        const u_int8_t* src = rgba.Pixels() + row * rgba.RowBytes();
+        u_int8_t* dest = image.Pixels() + row * image.RowBytes();
+        for(u_int32_t col = 0; col < image.Width(); col++) {
+            dest[col * 3 + 0] = src[col * 4 + 0];
+            dest[col * 3 + 1] = src[col * 4 + 1];
+            dest[col * 3 + 2] = src[col * 4 + 2];
+        }
+    }
+}
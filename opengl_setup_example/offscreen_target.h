@@ -0,0 +1,55 @@
+//
+//  offscreen_target.h
+//  opengl_setup_example
+//
+
+#ifndef offscreen_target_hpp
+#define offscreen_target_hpp
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+
+#include "image_buffer.h"
+
+class GLBackend;
+
+// A framebuffer object with RGBA8 color and 24 bit depth renderbuffers, for rendering
+// the demo without drawing to a window.
+class OffscreenTarget {
+private:
+    GLBackend& mBackend;
+    GLuint mFramebuffer;
+    GLuint mColorBuffer;
+    GLuint mDepthBuffer;
+    GLsizei mWidth;
+    GLsizei mHeight;
+
+    void Release(void);
+
+public:
+    explicit OffscreenTarget(GLBackend& backend);
+    // Deletes the framebuffer, the context must still be current.
+    ~OffscreenTarget();
+
+    OffscreenTarget(const OffscreenTarget&) = delete;
+    OffscreenTarget& operator = (const OffscreenTarget&) = delete;
+
+    // Makes the framebuffer and its renderbuffers, false if it is not complete.
+    bool Init(GLsizei width, GLsizei height);
+
+    // Draws go to the target from here on, with the viewport covering it.
+    void Bind(void);
+    // Back to the default framebuffer.
+    void Unbind(void);
+
+    // Waits for the GPU and copies the color buffer into image as RGB.
+    // Rows come out bottom first, the way GL stores them.
+    void ReadPixels(RGBImageBuffer& image);
+
+    GLsizei Width(void) const { return mWidth; }
+    GLsizei Height(void) const { return mHeight; }
+};
+
+#endif /* offscreen_target_hpp */
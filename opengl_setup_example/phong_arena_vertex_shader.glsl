@@ -0,0 +1,49 @@
+#version 330 core
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal;
+
+out vec2 UV;
+
+out vec3 esVertexPosition;
+out vec3 esEyeDirection;
+out vec3 esLightDirection;
+out vec3 esNormal;
+out vec3 halfVector;
+
+layout(std140) uniform FrameData {
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    vec4 lightPosition;
+    vec4 globalAmbient;
+    vec4 lightDiffuse;
+    vec4 lightSpecular;
+};
+
+// Model then normal matrix for every object drawn this frame, 8 texels each.
+uniform samplerBuffer drawData;
+// first object of the current draw, each instance is one object.
+uniform int drawBase;
+
+void main( )
+{
+    int base = (drawBase + gl_InstanceID) * 8;
+    mat4 modelMatrix = mat4(texelFetch(drawData, base), texelFetch(drawData, base + 1),
+                            texelFetch(drawData, base + 2), texelFetch(drawData, base + 3));
+    mat4 normMatrix = mat4(texelFetch(drawData, base + 4), texelFetch(drawData, base + 5),
+                           texelFetch(drawData, base + 6), texelFetch(drawData, base + 7));
+
+    gl_Position = projMatrix * viewMatrix * modelMatrix * vec4(a_position, 1.0);
+    UV = vertexUV;
+    
+    esVertexPosition = (viewMatrix * modelMatrix * vec4(a_position,1)).xyz;
+    
+    esEyeDirection = vec3(0,0,0) - esVertexPosition;
+
+    vec3 esLightPosition = ( viewMatrix * vec4(lightPosition.xyz,1)).xyz;
+    esLightDirection = esLightPosition - esVertexPosition;
+    
+    esNormal = (normMatrix * vec4(vertexNormal,0)).xyz;
+    
+    halfVector = (esLightPosition + (-esVertexPosition)).xyz;
+}
@@ -11,14 +11,21 @@ in vec3 halfVector;
 
 uniform sampler2D myTextureSampler;
 
-uniform vec3 materialAmbient;
-uniform vec3 materialDiffuse;
-uniform vec3 materialSpecular;
-uniform float materialSpecExp;
+layout(std140) uniform FrameData {
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    vec4 lightPosition;
+    vec4 globalAmbient;
+    vec4 lightDiffuse;
+    vec4 lightSpecular;
+};
 
-uniform vec3 globalAmbient;
-uniform vec3 lightDiffuse;
-uniform vec3 lightSpecular;
+layout(std140) uniform MaterialData {
+    vec4 materialAmbient;
+    vec4 materialDiffuse;
+    vec4 materialSpecular;
+    float materialSpecExp;
+};
 
 void main()
 {
@@ -33,7 +40,7 @@ void main()
     vec3 texColor = texture( myTextureSampler, UV ).rgb;
     
     vec3 ambient = (globalAmbient * materialAmbient).xyz;
-    vec3 diffuse = lightDiffuse.xyz * materialDiffuse * max(cosTheta, 0.0);
+    vec3 diffuse = lightDiffuse.xyz * materialDiffuse.xyz * max(cosTheta, 0.0);
     vec3 specular = lightSpecular.xyz * materialSpecular.xyz * pow(max(cosPhi,0.0), materialSpecExp);
     
     color = (ambient + diffuse) * texColor + specular;
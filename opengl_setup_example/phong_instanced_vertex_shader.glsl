@@ -0,0 +1,42 @@
+#version 330 core
+layout(location = 0) in vec3 a_position;
+layout(location = 1) in vec2 vertexUV;
+layout(location = 2) in vec3 vertexNormal;
+
+// per instance, a mat4 takes 4 attribute locations.
+layout(location = 3) in mat4 instanceModelMatrix;
+layout(location = 7) in mat4 instanceNormMatrix;
+
+out vec2 UV;
+
+out vec3 esVertexPosition;
+out vec3 esEyeDirection;
+out vec3 esLightDirection;
+out vec3 esNormal;
+out vec3 halfVector;
+
+layout(std140) uniform FrameData {
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    vec4 lightPosition;
+    vec4 globalAmbient;
+    vec4 lightDiffuse;
+    vec4 lightSpecular;
+};
+
+void main( )
+{
+    gl_Position = projMatrix * viewMatrix * instanceModelMatrix * vec4(a_position, 1.0);
+    UV = vertexUV;
+    
+    esVertexPosition = (viewMatrix * instanceModelMatrix * vec4(a_position,1)).xyz;
+    
+    esEyeDirection = vec3(0,0,0) - esVertexPosition;
+
+    vec3 esLightPosition = ( viewMatrix * vec4(lightPosition.xyz,1)).xyz;
+    esLightDirection = esLightPosition - esVertexPosition;
+    
+    esNormal = (instanceNormMatrix * vec4(vertexNormal,0)).xyz;
+    
+    halfVector = (esLightPosition + (-esVertexPosition)).xyz;
+}
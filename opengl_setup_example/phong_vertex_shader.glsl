@@ -11,12 +11,19 @@ out vec3 esLightDirection;
 out vec3 esNormal;
 out vec3 halfVector;
 
-uniform vec3 lightPosition;
-
-uniform mat4 modelMatrix;
-uniform mat4 viewMatrix;
-uniform mat4 projMatrix;
-uniform mat4 normMatrix;
+layout(std140) uniform FrameData {
+    mat4 viewMatrix;
+    mat4 projMatrix;
+    vec4 lightPosition;
+    vec4 globalAmbient;
+    vec4 lightDiffuse;
+    vec4 lightSpecular;
+};
+
+layout(std140) uniform ObjectData {
+    mat4 modelMatrix;
+    mat4 normMatrix;
+};
 
 void main( )
 {
@@ -27,7 +34,7 @@ void main( )
     
     esEyeDirection = vec3(0,0,0) - esVertexPosition;
 
-    vec3 esLightPosition = ( viewMatrix * vec4(lightPosition,1)).xyz;
+    vec3 esLightPosition = ( viewMatrix * vec4(lightPosition.xyz,1)).xyz;
     esLightDirection = esLightPosition - esVertexPosition;
     
     esNormal = (normMatrix * vec4(vertexNormal,0)).xyz;
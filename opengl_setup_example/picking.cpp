@@ -0,0 +1,402 @@
+//
+//  picking.cpp
+//  opengl_setup_example
+//
+
+#include "picking.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+
+#include <glm/ext.hpp>
+
+#include "model_object.h"
+#include "frame_state.h"
+#include "sphere.h"
+#include "cube.h"
+#include "mathutil.h"
+#include "dbgutils.h"
+
+using namespace std;
+
+// triangles per leaf before we stop splitting.
+constexpr int kMaxLeafTris = 4;
+
+// deepest tree we can traverse with the fixed size stack below.
+constexpr int kMaxStackDepth = 64;
+
+constexpr float kMinHitT = 1e-6f;
+
+
+MeshBVH::MeshBVH(const std::vector<float>& vertices, const std::vector<int>& indexes)
+{
+    Build(vertices, indexes);
+}
+
+void MeshBVH::Build(const std::vector<float>& vertices, const std::vector<int>& indexes)
+{
+    mNodes.clear();
+    mTris.clear();
+    mTriIDs.clear();
+
+    auto vertexAt = [&](int i) {
+        return glm::vec3(vertices[i*3], vertices[i*3+1], vertices[i*3+2]);
+    };
+
+    const int triCount = indexes.empty() ? (int)vertices.size() / 9 : (int)indexes.size() / 3;
+    if(triCount == 0) {
+        return;
+    }
+
+    std::vector<glm::vec3> centroids;
+    mTris.reserve(triCount);
+    centroids.reserve(triCount);
+    for(int i = 0; i < triCount; i++) {
+        glm::vec3 v0, v1, v2;
+        if(indexes.empty()) {
+            v0 = vertexAt(i*3);
+            v1 = vertexAt(i*3+1);
+            v2 = vertexAt(i*3+2);
+        } else {
+            v0 = vertexAt(indexes[i*3]);
+            v1 = vertexAt(indexes[i*3+1]);
+            v2 = vertexAt(indexes[i*3+2]);
+        }
+        mTris.push_back({v0, v1 - v0, v2 - v0});
+        centroids.push_back((v0 + v1 + v2) * (1.0f / 3.0f));
+        mTriIDs.push_back(i);
+    }
+
+    // A binary tree with one triangle per leaf has at most 2n-1 nodes.
+    mNodes.reserve(triCount * 2);
+    mNodes.push_back({glm::vec3(0), glm::vec3(0), 0, triCount});
+    UpdateNodeBounds(0);
+    Subdivide(0, centroids);
+
+    // Put triangles in leaf order so leaves read them contiguously.
+    std::vector<Tri> ordered;
+    ordered.reserve(triCount);
+    for(int id : mTriIDs) {
+        ordered.push_back(mTris[id]);
+    }
+    mTris.swap(ordered);
+}
+
+void MeshBVH::UpdateNodeBounds(int nodeIdx)
+{
+    Node& node = mNodes[nodeIdx];
+    node.boundsMin = glm::vec3(FLT_MAX);
+    node.boundsMax = glm::vec3(-FLT_MAX);
+    for(int i = node.leftFirst; i < node.leftFirst + node.triCount; i++) {
+        const Tri& tri = mTris[mTriIDs[i]];
+        glm::vec3 v1 = tri.v0 + tri.e1;
+        glm::vec3 v2 = tri.v0 + tri.e2;
+        node.boundsMin = glm::min(node.boundsMin, glm::min(tri.v0, glm::min(v1, v2)));
+        node.boundsMax = glm::max(node.boundsMax, glm::max(tri.v0, glm::max(v1, v2)));
+    }
+}
+
+// Median split along the longest axis of the triangle centroids.
+void MeshBVH::Subdivide(int nodeIdx, std::vector<glm::vec3>& centroids)
+{
+    const int first = mNodes[nodeIdx].leftFirst;
+    const int count = mNodes[nodeIdx].triCount;
+    if(count <= kMaxLeafTris) {
+        return;
+    }
+
+    glm::vec3 cMin(FLT_MAX), cMax(-FLT_MAX);
+    for(int i = first; i < first + count; i++) {
+        cMin = glm::min(cMin, centroids[mTriIDs[i]]);
+        cMax = glm::max(cMax, centroids[mTriIDs[i]]);
+    }
+    glm::vec3 extent = cMax - cMin;
+    int axis = 0;
+    if(extent.y > extent.x) axis = 1;
+    if(extent.z > extent[axis]) axis = 2;
+    if(extent[axis] <= 0.0f) {
+        // all centroids coincide, splitting will not help.
+        return;
+    }
+
+    const int mid = first + count / 2;
+    std::nth_element(mTriIDs.begin() + first, mTriIDs.begin() + mid, mTriIDs.begin() + first + count,
+                     [&](int a, int b) { return centroids[a][axis] < centroids[b][axis]; });
+
+    const int leftIdx = (int)mNodes.size();
+    mNodes.push_back({glm::vec3(0), glm::vec3(0), first, mid - first});
+    mNodes.push_back({glm::vec3(0), glm::vec3(0), mid, first + count - mid});
+    mNodes[nodeIdx].leftFirst = leftIdx;
+    mNodes[nodeIdx].triCount = 0;
+
+    UpdateNodeBounds(leftIdx);
+    UpdateNodeBounds(leftIdx + 1);
+    Subdivide(leftIdx, centroids);
+    Subdivide(leftIdx + 1, centroids);
+}
+
+// Slab test, returns entry distance or FLT_MAX on a miss.
+static inline float IntersectAABB(const glm::vec3& origin, const glm::vec3& invDir,
+                                  const glm::vec3& bMin, const glm::vec3& bMax, float tMax)
+{
+    float tx1 = (bMin.x - origin.x) * invDir.x, tx2 = (bMax.x - origin.x) * invDir.x;
+    float tmin = TMin(tx1, tx2), tmax = TMax(tx1, tx2);
+    float ty1 = (bMin.y - origin.y) * invDir.y, ty2 = (bMax.y - origin.y) * invDir.y;
+    tmin = TMax(tmin, TMin(ty1, ty2));
+    tmax = TMin(tmax, TMax(ty1, ty2));
+    float tz1 = (bMin.z - origin.z) * invDir.z, tz2 = (bMax.z - origin.z) * invDir.z;
+    tmin = TMax(tmin, TMin(tz1, tz2));
+    tmax = TMin(tmax, TMax(tz1, tz2));
+    if(tmax >= tmin && tmin < tMax && tmax > 0.0f) {
+        return tmin;
+    }
+    return FLT_MAX;
+}
+
+// Moller-Trumbore ray triangle intersection.
+static inline bool IntersectTri(const glm::vec3& origin, const glm::vec3& dir,
+                                const glm::vec3& v0, const glm::vec3& e1, const glm::vec3& e2, float& outT)
+{
+    glm::vec3 h = glm::cross(dir, e2);
+    float a = glm::dot(e1, h);
+    if(a > -1e-12f && a < 1e-12f) {
+        return false; // parallel to triangle.
+    }
+    float f = 1.0f / a;
+    glm::vec3 s = origin - v0;
+    float u = f * glm::dot(s, h);
+    if(u < 0.0f || u > 1.0f) {
+        return false;
+    }
+    glm::vec3 q = glm::cross(s, e1);
+    float v = f * glm::dot(dir, q);
+    if(v < 0.0f || u + v > 1.0f) {
+        return false;
+    }
+    float t = f * glm::dot(e2, q);
+    if(t < kMinHitT) {
+        return false;
+    }
+    outT = t;
+    return true;
+}
+
+bool MeshBVH::Intersect(const glm::vec3& origin, const glm::vec3& dir, float& outT, int& outTriangle) const
+{
+    if(mNodes.empty()) {
+        return false;
+    }
+
+    const glm::vec3 invDir(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+    float bestT = FLT_MAX;
+    int bestTri = -1;
+
+    int stack[kMaxStackDepth];
+    int stackSize = 0;
+
+    if(IntersectAABB(origin, invDir, mNodes[0].boundsMin, mNodes[0].boundsMax, bestT) == FLT_MAX) {
+        return false;
+    }
+    stack[stackSize++] = 0;
+
+    while(stackSize > 0) {
+        const Node& node = mNodes[stack[--stackSize]];
+
+        if(node.triCount > 0) {
+            for(int i = node.leftFirst; i < node.leftFirst + node.triCount; i++) {
+                const Tri& tri = mTris[i];
+                float t;
+                if(IntersectTri(origin, dir, tri.v0, tri.e1, tri.e2, t) && t < bestT) {
+                    bestT = t;
+                    bestTri = i;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first so the far one is more likely to be rejected.
+        int nearIdx = node.leftFirst, farIdx = node.leftFirst + 1;
+        float nearT = IntersectAABB(origin, invDir, mNodes[nearIdx].boundsMin, mNodes[nearIdx].boundsMax, bestT);
+        float farT = IntersectAABB(origin, invDir, mNodes[farIdx].boundsMin, mNodes[farIdx].boundsMax, bestT);
+        if(farT < nearT) {
+            std::swap(nearIdx, farIdx);
+            std::swap(nearT, farT);
+        }
+        DbgAssert(stackSize + 2 <= kMaxStackDepth);
+        if(farT != FLT_MAX) {
+            stack[stackSize++] = farIdx;
+        }
+        if(nearT != FLT_MAX) {
+            stack[stackSize++] = nearIdx;
+        }
+    }
+
+    if(bestTri == -1) {
+        return false;
+    }
+    outT = bestT;
+    outTriangle = mTriIDs[bestTri];
+    return true;
+}
+
+bool MeshBVH::IntersectBruteForce(const glm::vec3& origin, const glm::vec3& dir, float& outT, int& outTriangle) const
+{
+    float bestT = FLT_MAX;
+    int bestTri = -1;
+    for(int i = 0; i < (int)mTris.size(); i++) {
+        float t;
+        if(IntersectTri(origin, dir, mTris[i].v0, mTris[i].e1, mTris[i].e2, t) && t < bestT) {
+            bestT = t;
+            bestTri = i;
+        }
+    }
+    if(bestTri == -1) {
+        return false;
+    }
+    outT = bestT;
+    outTriangle = mTriIDs[bestTri];
+    return true;
+}
+
+
+void ScreenPointToRay(const FrameState* frameState, double x, double y, int windowWidth, int windowHeight,
+                      glm::vec3& outOrigin, glm::vec3& outDir)
+{
+    // window coordinates have y going down, NDC has y going up.
+    float ndcX = (float)(2.0 * x / windowWidth - 1.0);
+    float ndcY = (float)(1.0 - 2.0 * y / windowHeight);
+
+    glm::mat4 invViewProj = glm::inverse(frameState->projMatrix * frameState->viewMatrix);
+    glm::vec4 nearPt = invViewProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+    glm::vec4 farPt = invViewProj * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+    nearPt /= nearPt.w;
+    farPt /= farPt.w;
+
+    outOrigin = glm::vec3(nearPt);
+    outDir = glm::vec3(farPt) - glm::vec3(nearPt);
+}
+
+bool PickObjectWithRay(const std::list<std::unique_ptr<ModelObject>>& objects,
+                       const glm::vec3& origin, const glm::vec3& dir, PickResult& outResult)
+{
+    bool found = false;
+    float bestT = FLT_MAX;
+
+    for(const auto& obj : objects) {
+        if(!obj->Visible() || !obj->geometry || obj->geometry->bvh.Empty()) {
+            continue;
+        }
+        // Take the ray into object space instead of transforming the mesh.
+        // The direction is not renormalized, so t is the same parameter in both spaces.
+        glm::mat4 invModel = glm::inverse(obj->ModelMatrix());
+        glm::vec3 localOrigin = glm::vec3(invModel * glm::vec4(origin, 1.0f));
+        glm::vec3 localDir = glm::vec3(invModel * glm::vec4(dir, 0.0f));
+
+        float t;
+        int tri;
+        if(obj->geometry->bvh.Intersect(localOrigin, localDir, t, tri) && t < bestT) {
+            bestT = t;
+            found = true;
+            outResult.object = obj.get();
+            outResult.objectID = obj->objectID;
+            outResult.triangleID = tri;
+        }
+    }
+
+    if(found) {
+        outResult.t = bestT;
+        outResult.worldPoint = origin + dir * bestT;
+    }
+    return found;
+}
+
+bool PickObject(const FrameState* frameState, const std::list<std::unique_ptr<ModelObject>>& objects,
+                double x, double y, int windowWidth, int windowHeight, PickResult& outResult)
+{
+    glm::vec3 origin, dir;
+    ScreenPointToRay(frameState, x, y, windowWidth, windowHeight, origin, dir);
+    return PickObjectWithRay(objects, origin, dir, outResult);
+}
+
+
+bool MeshBVH::Test(void)
+{
+    // Sphere is indexed, cube is not, so both paths through Build get used.
+    std::vector<float> sphereVerts, sphereNormals, sphereUVs;
+    std::vector<int> sphereIndexes;
+    GenerateSphere(1.5, 20, 25, sphereVerts, sphereNormals, sphereUVs, sphereIndexes);
+    MeshBVH sphereBVH(sphereVerts, sphereIndexes);
+    DbgAssert(sphereBVH.NumTriangles() == (int)sphereIndexes.size() / 3);
+
+    std::vector<float> cubeVerts, cubeUVs;
+    GenerateCube(cubeVerts, cubeUVs);
+    MeshBVH cubeBVH(cubeVerts, std::vector<int>());
+    DbgAssert(cubeBVH.NumTriangles() == 12);
+
+    // Straight on hit of the sphere along -z from outside.
+    float t = 0;
+    int tri = -1;
+    bool hit = sphereBVH.Intersect({0.01f, 0.02f, 5.0f}, {0, 0, -1}, t, tri);
+    DbgAssert(hit);
+    DbgAssertAlmostEqual(t, 3.5, 0.01);
+
+    // Miss entirely.
+    hit = sphereBVH.Intersect({3.0f, 3.0f, 5.0f}, {0, 0, -1}, t, tri);
+    DbgAssert(!hit);
+
+    // Pointing away.
+    hit = cubeBVH.Intersect({0, 0, 5.0f}, {0, 0, 1}, t, tri);
+    DbgAssert(!hit);
+
+    // Random rays must agree with testing every triangle.
+    for(const MeshBVH* bvh : {&sphereBVH, &cubeBVH}) {
+        for(int i = 0; i < 500; i++) {
+            glm::vec3 origin(RandFloat() * 8 - 4, RandFloat() * 8 - 4, RandFloat() * 8 - 4);
+            glm::vec3 target(RandFloat() * 2 - 1, RandFloat() * 2 - 1, RandFloat() * 2 - 1);
+            glm::vec3 dir = target - origin;
+
+            float bvhT = 0, bruteT = 0;
+            int bvhTri = -1, bruteTri = -1;
+            bool bvhHit = bvh->Intersect(origin, dir, bvhT, bvhTri);
+            bool bruteHit = bvh->IntersectBruteForce(origin, dir, bruteT, bruteTri);
+            DbgAssert(bvhHit == bruteHit);
+            if(bvhHit && bruteHit) {
+                DbgAssertAlmostEqual(bvhT, bruteT, 1e-5);
+            }
+        }
+    }
+
+    // Picking through a transformed object.
+    std::list<std::unique_ptr<ModelObject>> objects;
+    objects.push_back(std::make_unique<ModelObject>());
+    ModelObject* cubeObj = objects.back().get();
+    auto cubeGeom = std::make_shared<MeshGeometry>();
+    cubeGeom->vertexData = cubeVerts;
+    cubeGeom->Finish();
+    cubeObj->geometry = cubeGeom;
+    cubeObj->Show();
+    cubeObj->PushModelMatrix(glm::translate(cubeObj->ModelMatrix(), glm::vec3(10, 0, 0)));
+    cubeObj->PushModelMatrix(glm::scale(cubeObj->ModelMatrix(), glm::vec3(2, 2, 2)));
+
+    PickResult result;
+    hit = PickObjectWithRay(objects, {10, 0, 10}, {0, 0, -1}, result);
+    DbgAssert(hit);
+    if(hit) {
+        DbgAssert(result.object == cubeObj);
+        DbgAssert(result.objectID == cubeObj->objectID);
+        DbgAssertAlmostEqual(result.t, 8.0, 1e-5);
+        DbgAssertAlmostEqual(result.worldPoint.z, 2.0, 1e-5);
+    }
+    hit = PickObjectWithRay(objects, {0, 0, 10}, {0, 0, -1}, result);
+    DbgAssert(!hit);
+
+    cubeObj->Hide();
+    hit = PickObjectWithRay(objects, {10, 0, 10}, {0, 0, -1}, result);
+    DbgAssert(!hit);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
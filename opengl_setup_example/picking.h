@@ -0,0 +1,89 @@
+//
+//  picking.h
+//  opengl_setup_example
+//
+
+#ifndef picking_hpp
+#define picking_hpp
+
+#include <vector>
+#include <list>
+#include <memory>
+
+#include <glm/glm.hpp>
+
+class ModelObject;
+struct FrameState;
+
+// Bounding volume hierarchy over the triangles of one model in object space.
+// Built once from the same float arrays that get uploaded to GL, so ray queries
+// against a ModelObject do not need to touch every triangle.
+class MeshBVH {
+private:
+    struct Node {
+        glm::vec3 boundsMin;
+        glm::vec3 boundsMax;
+        // first child index for interior nodes, first triangle for leaves.
+        int leftFirst;
+        // 0 for interior nodes.
+        int triCount;
+    };
+
+    // Triangle stored as one vertex plus two edges for Moller-Trumbore.
+    struct Tri {
+        glm::vec3 v0, e1, e2;
+    };
+
+    std::vector<Node> mNodes;
+    std::vector<Tri> mTris;
+    // maps BVH triangle order back to the triangle index in the source data.
+    std::vector<int> mTriIDs;
+
+    void Subdivide(int nodeIdx, std::vector<glm::vec3>& centroids);
+    void UpdateNodeBounds(int nodeIdx);
+
+public:
+    MeshBVH() = default;
+
+    // vertices are xyz triples; if indexes is empty every 3 vertices are a triangle.
+    MeshBVH(const std::vector<float>& vertices, const std::vector<int>& indexes);
+
+    void Build(const std::vector<float>& vertices, const std::vector<int>& indexes);
+
+    bool Empty(void) const { return mNodes.empty(); }
+    int NumTriangles(void) const { return (int)mTris.size(); }
+    int NumNodes(void) const { return (int)mNodes.size(); }
+
+    // Find the nearest triangle hit by origin + t * dir with t > 0.
+    // dir does not need to be normalized, t is in units of dir.
+    bool Intersect(const glm::vec3& origin, const glm::vec3& dir, float& outT, int& outTriangle) const;
+
+    // Same as Intersect but tests every triangle, for checking results.
+    bool IntersectBruteForce(const glm::vec3& origin, const glm::vec3& dir, float& outT, int& outTriangle) const;
+
+    static bool Test(void);
+};
+
+
+struct PickResult {
+    ModelObject* object;
+    int objectID;
+    int triangleID;
+    // ray parameter of the hit, world point is rayOrigin + t * rayDir.
+    float t;
+    glm::vec3 worldPoint;
+};
+
+// Build a world space ray through a point in window coordinates(origin top left, like glfwGetCursorPos).
+void ScreenPointToRay(const FrameState* frameState, double x, double y, int windowWidth, int windowHeight,
+                      glm::vec3& outOrigin, glm::vec3& outDir);
+
+// Find the closest visible object under a window point using each object's current ModelMatrix().
+bool PickObject(const FrameState* frameState, const std::list<std::unique_ptr<ModelObject>>& objects,
+                double x, double y, int windowWidth, int windowHeight, PickResult& outResult);
+
+// Same as PickObject but with a world space ray.
+bool PickObjectWithRay(const std::list<std::unique_ptr<ModelObject>>& objects,
+                       const glm::vec3& origin, const glm::vec3& dir, PickResult& outResult);
+
+#endif /* picking_hpp */
@@ -8,6 +8,7 @@
 #include "pngreader.h"
 
 #include "dbgutils.h"
+#include "trace.h"
 
 #include "png.h"
 
@@ -85,6 +86,7 @@ public:
 
 bool ReadPNGImage(const char* path, uint8_t** outPixels, uint32_t* outWidth, uint32_t* outHeight)
 {
+    TRACE_FUNCTION("io");
     DbgAssert(path != nullptr);
     
     
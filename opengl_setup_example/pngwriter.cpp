@@ -0,0 +1,106 @@
+//
+//  pngwriter.cpp
+//  opengl_setup_example
+//
+
+#include "pngwriter.h"
+
+#include "dbgutils.h"
+#include "trace.h"
+
+#include "png.h"
+
+#include <iostream>
+#include <cstdio>
+#include <vector>
+
+// Same error handling as pngreader.cpp, libpng errors throw instead of longjmp.
+
+typedef enum {
+    pw_NoError = 0,
+    pw_FileOpenError,
+    pw_Unknown
+} PNGErrorCode;
+
+typedef struct {
+    PNGErrorCode errorCode;
+
+    FILE* fp;
+} PNGState;
+
+static void LibPNGErrorProc(png_structp png_ptr, png_const_charp ptr)
+{
+    PNGState *statePtr = (PNGState *)png_get_error_ptr(png_ptr);
+    DbgAssert( statePtr );
+    if( statePtr->errorCode == pw_NoError )
+        statePtr->errorCode = pw_Unknown;
+
+    throw( statePtr->errorCode );
+}
+
+static void LibPNGWarningProc(png_structp png_ptr, png_const_charp ptr)
+{
+    // assert so that we can tell when debugging that we had
+    // a warning, but ignore it otherwise.
+    DbgAssert(false);
+}
+
+bool WritePNGImage(const char* path, const uint8_t* pixels, uint32_t width, uint32_t height,
+                   uint32_t rowBytes, uint16_t channels, bool flipRows)
+{
+    TRACE_FUNCTION("io");
+    DbgAssert(path != nullptr);
+    DbgAssert(pixels != nullptr);
+    DbgAssert(channels == 3 || channels == 4);
+    DbgAssert(rowBytes >= width * channels);
+
+    PNGState state;
+    state.errorCode = pw_NoError;
+    state.fp = fopen(path, "wb");
+    if(!state.fp) {
+        std::cerr << "Unable to open PNG file " << path << " for writing\n";
+        return false;
+    }
+
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, (png_voidp)&state,
+                                                  LibPNGErrorProc, LibPNGWarningProc);
+    if(!png_ptr) {
+        std::cerr << "Error allocating memory for PNG write struct\n";
+        fclose(state.fp);
+        return false;
+    }
+
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr) {
+        std::cerr << "Error allocating memory for PNG info\n";
+        png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
+        fclose(state.fp);
+        return false;
+    }
+
+    bool good = true;
+    try {
+        png_init_io(png_ptr, state.fp);
+
+        png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+                     channels == 4 ? PNG_COLOR_TYPE_RGB_ALPHA : PNG_COLOR_TYPE_RGB,
+                     PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+        std::vector<png_bytep> rowPointers(height);
+        for(uint32_t row = 0; row < height; row++) {
+            uint32_t sourceRow = flipRows ? height - 1 - row : row;
+            rowPointers[row] = (png_bytep)(pixels + (size_t)rowBytes * sourceRow);
+        }
+
+        png_write_info(png_ptr, info_ptr);
+        png_write_image(png_ptr, rowPointers.data());
+        png_write_end(png_ptr, info_ptr);
+    } catch(PNGErrorCode code) {
+        std::cerr << "Error " << code << " writing PNG file " << path << std::endl;
+        good = false;
+    }
+
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    fclose(state.fp);
+    return good;
+}
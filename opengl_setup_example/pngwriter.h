@@ -0,0 +1,16 @@
+//
+//  pngwriter.h
+//  opengl_setup_example
+//
+
+#ifndef pngwriter_hpp
+#define pngwriter_hpp
+
+#include <cstdint>
+
+// Writes 8 bit RGB or RGBA pixels, channels is 3 or 4. flipRows writes the last row first,
+// for pixels read back from GL, which start at the bottom.
+bool WritePNGImage(const char* path, const uint8_t* pixels, uint32_t width, uint32_t height,
+                   uint32_t rowBytes, uint16_t channels, bool flipRows);
+
+#endif /* pngwriter_hpp */
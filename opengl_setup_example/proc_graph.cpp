@@ -0,0 +1,484 @@
+//
+//  proc_graph.cpp
+//  opengl_setup_example
+//
+
+#include "proc_graph.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mathutil.h"
+#include "dbgutils.h"
+
+using namespace std;
+
+// Random looking value in [0, 1] that only depends on its arguments, so a pixel gets
+// the same one whichever thread fills it.
+static float PixelRandom(u_int32_t x, u_int32_t y, u_int32_t salt)
+{
+    // murmur3's finalizer over the mixed coordinates.
+    uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ salt * 0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return (h & 0xffffff) / (float)0xffffff;
+}
+
+
+bool ProcTextureGraph::NodeDesc::operator == (const NodeDesc& other) const
+{
+    if(kind != other.kind) {
+        return false;
+    }
+    if(kind == kTexelPoints) {
+        return seed == other.seed && perturb == other.perturb;
+    }
+    return points == other.points && gain == other.gain && lacunarity == other.lacunarity && freqMin == other.freqMin &&
+        min == other.min && max == other.max && octaves == other.octaves && abs == other.abs && basis == other.basis;
+}
+
+ProcTextureGraph::Node ProcTextureGraph::AddNode(const NodeDesc& node)
+{
+    for(size_t i = 0; i < mNodes.size(); i++) {
+        if(mNodes[i] == node) {
+            return (Node)i;
+        }
+    }
+    mNodes.push_back(node);
+    return (Node)mNodes.size() - 1;
+}
+
+ProcTextureGraph::Node ProcTextureGraph::TexelPoints(u_int32_t seed, float perturb)
+{
+    NodeDesc node = {};
+    node.kind = kTexelPoints;
+    node.seed = seed;
+    node.perturb = perturb;
+    return AddNode(node);
+}
+
+ProcTextureGraph::Node ProcTextureGraph::FBM(Node points, double gain, double lacun, double freqMin, double min, double max,
+                                             int octaves, bool abs, NoiseBasis basis)
+{
+    NodeDesc node = {};
+    node.kind = kNoiseSum;
+    node.points = points;
+    node.gain = gain;
+    node.lacunarity = lacun;
+    node.freqMin = freqMin;
+    node.min = min;
+    node.max = max;
+    node.octaves = octaves;
+    node.abs = abs;
+    node.basis = basis;
+    return AddNode(node);
+}
+
+// Same fixed settings as NoiseGenerator::Turbulence.
+ProcTextureGraph::Node ProcTextureGraph::Turbulence(Node points, NoiseBasis basis)
+{
+    return FBM(points, 0.5, 2.0, 1, 0, 1, 4, true, basis);
+}
+
+void ProcTextureGraph::AddMarbleLayer(Node points, Node value, double freq, double amp, ColorF colorA, ColorF colorB)
+{
+    Layer layer = {};
+    layer.kind = kMarbleLayer;
+    layer.points = points;
+    layer.value = value;
+    layer.freq = freq;
+    layer.amp = amp;
+    layer.colorA = colorA;
+    layer.colorB = colorB;
+    mLayers.push_back(layer);
+}
+
+void ProcTextureGraph::AddColorLayer(Node value, ColorF color)
+{
+    Layer layer = {};
+    layer.kind = kColorLayer;
+    layer.points = -1;
+    layer.value = value;
+    layer.colorA = color;
+    mLayers.push_back(layer);
+}
+
+std::shared_ptr<const ProcTexturePlan> ProcTextureGraph::Compile(bool shareNoise, std::string* why) const
+{
+    std::shared_ptr<ProcTexturePlan> plan(new ProcTexturePlan());
+
+    // an octave of noise, told apart by the points, basis and scale it is made from. The scale
+    // is the float FBMBatch multiplies float points by, so sums whose double frequencies
+    // differ only in rounding share the octave and it is still the one each would make.
+    struct Octave {
+        int pointSlot;
+        NoiseBasis basis;
+        float scale;
+        int slot;
+        int uses;
+    };
+    std::vector<Octave> octaves;
+    auto findOctave = [&](int pointSlot, NoiseBasis basis, float scale) -> Octave* {
+        for(Octave& octave : octaves) {
+            if(octave.pointSlot == pointSlot && octave.basis == basis && octave.scale == scale) {
+                return &octave;
+            }
+        }
+        return nullptr;
+    };
+    // frequency stepped in double as FBM does, so the octaves scale the same.
+    auto octaveScale = [](const NodeDesc& node, int octave) {
+        double freq = node.freqMin;
+        for(int i = 0; i < octave; i++) {
+            freq *= node.lacunarity;
+        }
+        return (float)freq;
+    };
+
+    // the points first, since every sum reads them, then how many sums need each octave.
+    std::vector<int> nodeSlots(mNodes.size(), -1);
+    int slotCount = 0;
+    for(size_t n = 0; n < mNodes.size(); n++) {
+        const NodeDesc& node = mNodes[n];
+        if(node.kind == kTexelPoints) {
+            ProcTexturePlan::Step step = {};
+            step.op = ProcTexturePlan::kOpPoints;
+            step.out = slotCount;
+            step.seed = node.seed;
+            step.perturb = node.perturb;
+            slotCount += 3;
+            plan->mSteps.push_back(step);
+            nodeSlots[n] = step.out;
+        } else if(node.octaves > ProcTexturePlan::kMaxOctaves) {
+            if(why) {
+                *why = std::to_string(node.octaves) + " octaves is more than " + std::to_string(ProcTexturePlan::kMaxOctaves);
+            }
+            return nullptr;
+        }
+    }
+    for(const NodeDesc& node : mNodes) {
+        if(node.kind != kNoiseSum) {
+            continue;
+        }
+        for(int octave = 0; octave < node.octaves; octave++) {
+            const float scale = octaveScale(node, octave);
+            if(Octave* made = findOctave(nodeSlots[node.points], node.basis, scale)) {
+                made->uses++;
+            } else {
+                octaves.push_back({ nodeSlots[node.points], node.basis, scale, -1, 1 });
+            }
+        }
+    }
+
+    int octaveCount = 0;
+    for(size_t n = 0; n < mNodes.size(); n++) {
+        const NodeDesc& node = mNodes[n];
+        if(node.kind != kNoiseSum) {
+            continue;
+        }
+        const int pointSlot = nodeSlots[node.points];
+        bool shared = false;
+        for(int octave = 0; octave < node.octaves; octave++) {
+            shared = shared || findOctave(pointSlot, node.basis, octaveScale(node, octave))->uses > 1;
+        }
+
+        ProcTexturePlan::Step sum = {};
+        sum.points = pointSlot;
+        sum.octaveCount = node.octaves;
+        sum.abs = node.abs;
+        sum.min = node.min;
+        sum.max = node.max;
+        sum.basis = node.basis;
+        if(!shareNoise || !shared) {
+            // nothing to share, so the octaves stay in FBMBatch's loop.
+            sum.op = ProcTexturePlan::kOpFBM;
+            sum.gain = node.gain;
+            sum.lacunarity = node.lacunarity;
+            sum.freqMin = node.freqMin;
+            octaveCount += node.octaves;
+        } else {
+            // each octave made once into a value of its own, for every sum that has it.
+            sum.op = ProcTexturePlan::kOpNoiseSum;
+            double amp = 1;
+            for(int octave = 0; octave < node.octaves; octave++) {
+                Octave* made = findOctave(pointSlot, node.basis, octaveScale(node, octave));
+                if(made->slot < 0) {
+                    ProcTexturePlan::Step step = {};
+                    step.op = ProcTexturePlan::kOpOctave;
+                    step.out = slotCount++;
+                    step.points = pointSlot;
+                    step.scale = made->scale;
+                    step.basis = node.basis;
+                    plan->mSteps.push_back(step);
+                    made->slot = step.out;
+                    octaveCount++;
+                }
+                sum.octaveSlots[octave] = made->slot;
+                sum.amps[octave] = (float)amp;
+                amp *= node.gain;
+            }
+        }
+        sum.out = slotCount++;
+        plan->mSteps.push_back(sum);
+        nodeSlots[n] = sum.out;
+    }
+
+    if(slotCount > ProcTexturePlan::kMaxSlots) {
+        if(why) {
+            *why = "needs " + std::to_string(slotCount) + " values, more than " + std::to_string(ProcTexturePlan::kMaxSlots);
+        }
+        return nullptr;
+    }
+
+    for(const Layer& layer : mLayers) {
+        ProcTexturePlan::Step step = {};
+        step.op = layer.kind == kMarbleLayer ? ProcTexturePlan::kOpMarbleLayer : ProcTexturePlan::kOpColorLayer;
+        step.out = -1;
+        step.points = layer.points >= 0 ? nodeSlots[layer.points] : -1;
+        step.value = nodeSlots[layer.value];
+        step.freq = layer.freq;
+        step.amp = layer.amp;
+        step.colorA = layer.colorA;
+        step.colorB = layer.colorB;
+        plan->mSteps.push_back(step);
+    }
+    plan->mSlotCount = slotCount;
+    plan->mOctaveCount = octaveCount;
+    return plan;
+}
+
+
+ProcTexturePlan::ProcTexturePlan()
+: mSlotCount(0), mOctaveCount(0)
+{
+}
+
+void ProcTexturePlan::RunTile(const TileSource& source, int count, const ColorSpan& colors) const
+{
+    float slots[kMaxSlots][kTileTexels];
+    const NoiseGenerator& noise = NoiseGenerator::Default();
+
+    std::fill(colors.r, colors.r + count, 0.0f);
+    std::fill(colors.g, colors.g + count, 0.0f);
+    std::fill(colors.b, colors.b + count, 0.0f);
+
+    for(const Step& step : mSteps) {
+        switch(step.op) {
+            case kOpPoints: {
+                float* x = slots[step.out];
+                float* y = slots[step.out + 1];
+                float* z = slots[step.out + 2];
+                if(source.px) {
+                    for(int i = 0; i < count; i++) {
+                        x[i] = (float)source.px[i];
+                        y[i] = (float)source.py[i];
+                        z[i] = (float)source.pz[i];
+                    }
+                } else {
+                    // Perturbing here breaks up the artifacts along lattice cube boundaries.
+                    const u_int32_t py = source.y << source.level;
+                    for(int i = 0; i < count; i++) {
+                        const u_int32_t px = (source.x + i) << source.level;
+                        x[i] = px + PixelRandom(px, py, step.seed * 3) * step.perturb;
+                        y[i] = py + PixelRandom(px, py, step.seed * 3 + 1) * step.perturb;
+                        z[i] = PixelRandom(px, py, step.seed * 3 + 2) * step.perturb;
+                    }
+                }
+                break;
+            }
+            case kOpOctave: {
+                const float* x = slots[step.points];
+                const float* y = slots[step.points + 1];
+                const float* z = slots[step.points + 2];
+                float sx[kTileTexels], sy[kTileTexels], sz[kTileTexels];
+                for(int i = 0; i < count; i++) {
+                    sx[i] = x[i] * step.scale;
+                    sy[i] = y[i] * step.scale;
+                    sz[i] = z[i] * step.scale;
+                }
+                if(step.basis == kNoiseSimplex) {
+                    noise.SimplexNoiseBatch(sx, sy, sz, slots[step.out], count);
+                } else {
+                    noise.ImpPerlinNoiseBatch(sx, sy, sz, slots[step.out], count);
+                }
+                break;
+            }
+            case kOpFBM: {
+                noise.FBMBatch(slots[step.points], slots[step.points + 1], slots[step.points + 2], slots[step.out], count,
+                               step.gain, step.lacunarity, step.freqMin, step.min, step.max, step.octaveCount, step.abs, step.basis);
+                break;
+            }
+            case kOpNoiseSum: {
+                // summed and scaled as FBM does.
+                float* out = slots[step.out];
+                std::fill(out, out + count, 0.0f);
+                for(int octave = 0; octave < step.octaveCount; octave++) {
+                    const float* n = slots[step.octaveSlots[octave]];
+                    const float amp = step.amps[octave];
+                    for(int i = 0; i < count; i++) {
+                        float v = step.abs && n[i] < 0 ? -n[i] : n[i];
+                        out[i] += amp * v;
+                    }
+                }
+                const float min = (float)step.min;
+                const float max = (float)step.max;
+                const float range = (float)(step.max - step.min);
+                for(int i = 0; i < count; i++) {
+                    float clipped = TClip(out[i], min, max);
+                    out[i] = (clipped - min) / range;
+                }
+                break;
+            }
+            case kOpMarbleLayer: {
+                const float* x = slots[step.points];
+                const float* value = slots[step.value];
+                for(int i = 0; i < count; i++) {
+                    double mval = sin(step.freq * (x[i] + step.amp*value[i]));
+
+                    double cval = TClip(mval, 0.0, 1.0);
+                    colors.r[i] += (float)LinearInterp(step.colorA.r, step.colorB.r, cval);
+                    colors.g[i] += (float)LinearInterp(step.colorA.g, step.colorB.g, cval);
+                    colors.b[i] += (float)LinearInterp(step.colorA.b, step.colorB.b, cval);
+                }
+                break;
+            }
+            case kOpColorLayer: {
+                const float* value = slots[step.value];
+                for(int i = 0; i < count; i++) {
+                    colors.r[i] += step.colorA.r * value[i];
+                    colors.g[i] += step.colorA.g * value[i];
+                    colors.b[i] += step.colorA.b * value[i];
+                }
+                break;
+            }
+        }
+    }
+}
+
+void ProcTexturePlan::ColorsAtPoints(const double* x, const double* y, const double* z, int count,
+                                     const ColorSpan& colors) const
+{
+    for(int start = 0; start < count; start += kTileTexels) {
+        const TileSource source = { 0, 0, 0, x + start, y + start, z + start };
+        RunTile(source, TMin(kTileTexels, count - start), { colors.r + start, colors.g + start, colors.b + start });
+    }
+}
+
+void ProcTexturePlan::ColorsOfTexels(int level, u_int32_t x, u_int32_t y, u_int32_t count, const ColorSpan& colors) const
+{
+    for(u_int32_t start = 0; start < count; start += kTileTexels) {
+        const TileSource source = { level, x + start, y, nullptr, nullptr, nullptr };
+        RunTile(source, (int)TMin<u_int32_t>(kTileTexels, count - start), { colors.r + start, colors.g + start, colors.b + start });
+    }
+}
+
+
+bool ProcTexturePlan::Test(void)
+{
+    // the same node twice is one node.
+    ProcTextureGraph marble;
+    ProcTextureGraph::Node points = marble.TexelPoints(1, 15);
+    DbgAssert(marble.TexelPoints(1, 15) == points);
+    DbgAssert(marble.TexelPoints(2, 15) != points);
+    ProcTextureGraph::Node turbulence = marble.Turbulence(points);
+    DbgAssert(marble.FBM(points, 0.5, 2.0, 1, 0, 1, 4, true) == turbulence);
+    DbgAssert(marble.Turbulence(points, kNoiseSimplex) != turbulence);
+
+    // two sums an octave apart over the same texels share the three octaves they overlap in,
+    // and make what they would on their own. 150 texels, so the last tile is partial.
+    const ColorF red(1.0f, 0.0f, 0.0f);
+    const ColorF green(0.0f, 1.0f, 0.0f);
+    ProcTextureGraph layered;
+    ProcTextureGraph::Node texels = layered.TexelPoints(0, 0.0f);
+    ProcTextureGraph::Node low = layered.FBM(texels, 0.5, 2.0, 0.05, -0.6, 0.6, 4, false);
+    ProcTextureGraph::Node high = layered.FBM(texels, 0.5, 2.0, 0.1, -0.6, 0.6, 4, false);
+    layered.AddColorLayer(low, red);
+    layered.AddColorLayer(high, green);
+    std::shared_ptr<const ProcTexturePlan> shared = layered.Compile();
+    std::shared_ptr<const ProcTexturePlan> separate = layered.Compile(false);
+    DbgAssert(shared && separate);
+    if(!shared || !separate) {
+        return false;
+    }
+    DbgAssert(shared->OctaveCount() == 5);
+    DbgAssert(separate->OctaveCount() == 8);
+
+    const u_int32_t kCount = 150;
+    const u_int32_t kRow = 9;
+    float r[kCount], g[kCount], b[kCount], r2[kCount], g2[kCount], b2[kCount];
+    shared->ColorsOfTexels(1, 3, kRow, kCount, { r, g, b });
+    separate->ColorsOfTexels(1, 3, kRow, kCount, { r2, g2, b2 });
+    float xs[kCount], ys[kCount], zs[kCount], lowFBM[kCount], highFBM[kCount];
+    for(u_int32_t i = 0; i < kCount; i++) {
+        xs[i] = (float)((3 + i) << 1);
+        ys[i] = (float)(kRow << 1);
+        zs[i] = 0.0f;
+    }
+    FBMBatch(xs, ys, zs, lowFBM, kCount, 0.5, 2.0, 0.05, -0.6, 0.6, 4, false);
+    FBMBatch(xs, ys, zs, highFBM, kCount, 0.5, 2.0, 0.1, -0.6, 0.6, 4, false);
+    for(u_int32_t i = 0; i < kCount; i++) {
+        DbgAssert(r[i] == red.r * lowFBM[i] && g[i] == green.g * highFBM[i] && b[i] == 0.0f);
+        DbgAssert(r[i] == r2[i] && g[i] == g2[i] && b[i] == b2[i]);
+    }
+
+    // points passed in are used as they are, here the texels above.
+    double px[kCount], py[kCount], pz[kCount];
+    for(u_int32_t i = 0; i < kCount; i++) {
+        px[i] = xs[i];
+        py[i] = ys[i];
+        pz[i] = 0.0;
+    }
+    shared->ColorsAtPoints(px, py, pz, kCount, { r2, g2, b2 });
+    for(u_int32_t i = 0; i < kCount; i++) {
+        DbgAssert(r[i] == r2[i] && g[i] == g2[i] && b[i] == b2[i]);
+    }
+
+    // A lacunarity of 1.8 steps the frequency in double with rounding that differs between
+    // sums starting a step apart. Octaves are told apart by the float scale the points are
+    // multiplied by, as FBMBatch does, so a shared octave is the one kOpFBM would make and
+    // the sums still come out exactly as on their own.
+    ProcTextureGraph stepped;
+    ProcTextureGraph::Node steppedTexels = stepped.TexelPoints(0, 0.0f);
+    stepped.AddColorLayer(stepped.FBM(steppedTexels, 0.8, 1.8, 0.05, -0.6, 0.6, 12, false), red);
+    stepped.AddColorLayer(stepped.FBM(steppedTexels, 0.8, 1.8, 0.09, -0.6, 0.6, 12, false), green);
+    std::shared_ptr<const ProcTexturePlan> steppedShared = stepped.Compile();
+    std::shared_ptr<const ProcTexturePlan> steppedSeparate = stepped.Compile(false);
+    DbgAssert(steppedShared && steppedSeparate);
+    if(!steppedShared || !steppedSeparate) {
+        return false;
+    }
+    DbgAssert(steppedShared->OctaveCount() == 13);
+    steppedShared->ColorsOfTexels(1, 3, kRow, kCount, { r, g, b });
+    steppedSeparate->ColorsOfTexels(1, 3, kRow, kCount, { r2, g2, b2 });
+    FBMBatch(xs, ys, zs, lowFBM, kCount, 0.8, 1.8, 0.05, -0.6, 0.6, 12, false);
+    FBMBatch(xs, ys, zs, highFBM, kCount, 0.8, 1.8, 0.09, -0.6, 0.6, 12, false);
+    for(u_int32_t i = 0; i < kCount; i++) {
+        DbgAssert(r[i] == red.r * lowFBM[i] && g[i] == green.g * highFBM[i]);
+        DbgAssert(r[i] == r2[i] && g[i] == g2[i] && b[i] == b2[i]);
+    }
+
+    // the marble's two layers share one perturbation and three octaves of turbulence.
+    std::shared_ptr<const ProcTexturePlan> marblePlan =
+        std::dynamic_pointer_cast<const ProcTexturePlan>(MarbleColors({ 0, 0, 255 }, { 255, 255, 255 }));
+    DbgAssert(marblePlan && marblePlan->OctaveCount() == 5);
+
+    // graphs too big for the plan's fixed room don't compile.
+    ProcTextureGraph deep;
+    deep.AddColorLayer(deep.FBM(deep.TexelPoints(0, 0.0f), 0.5, 2.0, 1, -1, 1, kMaxOctaves + 1, false), red);
+    std::string why;
+    DbgAssert(!deep.Compile(true, &why) && !why.empty());
+    ProcTextureGraph wide;
+    for(u_int32_t seed = 0; seed < 11; seed++) {
+        wide.AddMarbleLayer(wide.TexelPoints(seed, 1.0f), wide.Turbulence(wide.TexelPoints(seed, 1.0f)), 0.1, 0.1, red, green);
+    }
+    why.clear();
+    DbgAssert(!wide.Compile(true, &why) && !why.empty());
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,176 @@
+//
+//  proc_graph.h
+//  opengl_setup_example
+//
+
+#ifndef proc_graph_hpp
+#define proc_graph_hpp
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+#include "color.h"
+#include "noise.h"
+#include "proc_textures.h"
+
+class ProcTexturePlan;
+
+// A procedural texture made of layers over shared nodes: the points a layer samples, the
+// noise sums over those points, and the layers adding colors from the sums' values. Adding a
+// node the same as one already there gives back the first, so layers that agree on their
+// inputs share them. Compile turns the graph into a flat plan of steps, see ProcTexturePlan.
+class ProcTextureGraph {
+public:
+    typedef int Node;
+
+private:
+    enum NodeKind {
+        kTexelPoints,
+        kNoiseSum
+    };
+
+    struct NodeDesc {
+        NodeKind kind;
+        // kTexelPoints.
+        u_int32_t seed;
+        float perturb;
+        // kNoiseSum, as the arguments of NoiseGenerator::FBM.
+        Node points;
+        double gain, lacunarity, freqMin, min, max;
+        int octaves;
+        bool abs;
+        NoiseBasis basis;
+
+        bool operator == (const NodeDesc& other) const;
+    };
+
+    enum LayerKind {
+        kMarbleLayer,
+        kColorLayer
+    };
+
+    struct Layer {
+        LayerKind kind;
+        Node points;
+        Node value;
+        // kMarbleLayer.
+        double freq, amp;
+        ColorF colorA, colorB;
+    };
+
+    std::vector<NodeDesc> mNodes;
+    std::vector<Layer> mLayers;
+
+    Node AddNode(const NodeDesc& node);
+
+    friend class ProcTexturePlan;
+
+public:
+    // The level 0 texel at x, y, each of x, y and z moved by perturb times a random amount
+    // in [0, 1] that depends only on the texel and seed, so z is the amount alone. Different
+    // seeds break up the lattice artifacts of the noise differently.
+    Node TexelPoints(u_int32_t seed, float perturb);
+
+    // NoiseGenerator::FBM of points, and Turbulence with the fixed settings it has.
+    Node FBM(Node points, double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+             NoiseBasis basis = kNoisePerlin);
+    Node Turbulence(Node points, NoiseBasis basis = kNoisePerlin);
+
+    // Adds the color between colorA and colorB at sin(freq * (x + amp * value)), clipped to
+    // [0, 1], with x from points.
+    void AddMarbleLayer(Node points, Node value, double freq, double amp, ColorF colorA, ColorF colorB);
+    // Adds color * value.
+    void AddColorLayer(Node value, ColorF color);
+
+    // Null, with the reason in why if it isn't null, if the plan would need more than its
+    // fixed room for values or octaves. shareNoise off gives every noise sum its own octaves,
+    // for comparing.
+    std::shared_ptr<const ProcTexturePlan> Compile(bool shareNoise = true, std::string* why = nullptr) const;
+};
+
+// A compiled ProcTextureGraph: the points, the noise sums and then the layers, as one list of
+// steps run over kTileTexels texels at a time. An octave of the same points, basis and
+// frequency is made once for every sum that has it, so sums with a lacunarity in common and
+// starting frequencies a power of it apart share all the octaves they overlap in. A sum with
+// no octave in common with another is a single FBMBatch step. The values live in fixed
+// arrays on the stack and nothing is allocated while evaluating.
+//
+// The colors come out in float as the ProcColorBatch they replace did, so a plan of the same
+// layers makes the same texels. ColorsAtPoints gives every points node the points it is
+// passed, without perturbing them.
+class ProcTexturePlan : public ProcColorBatch {
+public:
+    static constexpr int kTileTexels = 64;
+    // room for values per tile, a point takes 3.
+    static constexpr int kMaxSlots = 32;
+    static constexpr int kMaxOctaves = 16;
+
+private:
+    enum Op {
+        kOpPoints,
+        kOpOctave,
+        kOpFBM,
+        kOpNoiseSum,
+        kOpMarbleLayer,
+        kOpColorLayer
+    };
+
+    struct Step {
+        Op op;
+        // first slot written, or -1 for the layers which add to the colors.
+        int out;
+        // first slot of the points read, and of the value.
+        int points;
+        int value;
+        // kOpPoints.
+        u_int32_t seed;
+        float perturb;
+        // kOpOctave, and the sums.
+        float scale;
+        NoiseBasis basis;
+        // kOpFBM and kOpNoiseSum, as the arguments of NoiseGenerator::FBM.
+        int octaveCount;
+        bool abs;
+        double min, max;
+        double gain, lacunarity, freqMin;
+        // kOpNoiseSum, amps[i] weighs the octave in slot octaveSlots[i].
+        int octaveSlots[kMaxOctaves];
+        float amps[kMaxOctaves];
+        // layers.
+        double freq, amp;
+        ColorF colorA, colorB;
+    };
+
+    // where a tile's points come from, the texels of a row or points passed in.
+    struct TileSource {
+        int level;
+        u_int32_t x, y;
+        const double* px;
+        const double* py;
+        const double* pz;
+    };
+
+    std::vector<Step> mSteps;
+    int mSlotCount;
+    int mOctaveCount;
+
+    ProcTexturePlan();
+    void RunTile(const TileSource& source, int count, const ColorSpan& colors) const;
+
+    friend class ProcTextureGraph;
+
+public:
+    void ColorsAtPoints(const double* x, const double* y, const double* z, int count, const ColorSpan& colors) const override;
+    void ColorsOfTexels(int level, u_int32_t x, u_int32_t y, u_int32_t count, const ColorSpan& colors) const override;
+
+    int StepCount(void) const { return (int)mSteps.size(); }
+    int SlotCount(void) const { return mSlotCount; }
+    // octaves of noise made per texel.
+    int OctaveCount(void) const { return mOctaveCount; }
+
+    static bool Test(void);
+};
+
+#endif /* proc_graph_hpp */
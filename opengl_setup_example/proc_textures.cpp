@@ -8,39 +8,72 @@
 #include "proc_textures.h"
 #include <cassert>
 #include <iostream>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include <algorithm>
 
 #include "color.h"
 #include "vector3.h"
 #include "noise.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "dbgutils.h"
+#include "simd.h"
+#include "proc_graph.h"
 
 using namespace std;
 
-RGBImageBuffer* GenerateCheckers(u_int32_t textureSize, u_int32_t checkerSize, RGBColor colorA, RGBColor colorB)
+// rows in each band handed to a pool thread, a few so a band is worth the handoff.
+constexpr u_int32_t kRowsPerBand = 8;
+
+// Calls fillRows(yBegin, yEnd) for bands of rows covering [0, height), spread over
+// pool's threads if there is one. Each band must only write its own rows.
+static void ForEachRowBand(ThreadPool* pool, u_int32_t height,
+                           const std::function<void(u_int32_t yBegin, u_int32_t yEnd)>& fillRows)
+{
+    const int bands = (int)((height + kRowsPerBand - 1) / kRowsPerBand);
+    auto fillBand = [&](int band) {
+        u_int32_t yBegin = band * kRowsPerBand;
+        fillRows(yBegin, TMin(yBegin + kRowsPerBand, height));
+    };
+    if(pool) {
+        pool->ParallelFor(bands, fillBand);
+    } else {
+        for(int band = 0; band < bands; band++) {
+            fillBand(band);
+        }
+    }
+}
+
+RGBImageBuffer* GenerateCheckers(u_int32_t textureSize, u_int32_t checkerSize, RGBColor colorA, RGBColor colorB,
+                                 ThreadPool* pool)
 {
+    TRACE_FUNCTION("texture");
     auto buffer = new RGBImageBuffer(textureSize, textureSize);
     
-    uint8_t* pixels = buffer->Pixels();
-    uint8_t* rowPtr = pixels;
-    
-    for(u_int32_t y = 0; y < textureSize; y++) {
-        auto yChk = (y / checkerSize) % 2;
-        uint8_t* pp = rowPtr;
-        for(u_int32_t x = 0; x < textureSize; x++) {
-            auto xChk = (x / checkerSize) % 2;
-            if(xChk == yChk) {
-                // color 1
-                *pp++ = colorA.r;
-                *pp++ = colorA.g;
-                *pp++ = colorA.b;
-            } else {
-                // color 2;
-                *pp++ = colorB.r;
-                *pp++ = colorB.g;
-                *pp++ = colorB.b;
+    ForEachRowBand(pool, textureSize, [&](u_int32_t yBegin, u_int32_t yEnd) {
+        uint8_t* rowPtr = buffer->Pixels() + yBegin * buffer->RowBytes();
+        for(u_int32_t y = yBegin; y < yEnd; y++) {
+            auto yChk = (y / checkerSize) % 2;
+            uint8_t* pp = rowPtr;
+            for(u_int32_t x = 0; x < textureSize; x++) {
+                auto xChk = (x / checkerSize) % 2;
+                if(xChk == yChk) {
+                    // color 1
+                    *pp++ = colorA.r;
+                    *pp++ = colorA.g;
+                    *pp++ = colorA.b;
+                } else {
+                    // color 2;
+                    *pp++ = colorB.r;
+                    *pp++ = colorB.g;
+                    *pp++ = colorB.b;
+                }
             }
+            rowPtr += buffer->RowBytes();
         }
-        rowPtr += buffer->RowBytes();
-    }
+    });
     return buffer;
 }
 
@@ -89,72 +122,42 @@ bool TestGenerateCheckers(void)
 }
 
 
-class Marble {
-private:
-    ColorF mColorA, mColorB;
-    double mFreq, mAmp;
-    float mPertub;
-    
-    
-public:
-    Marble(ColorF colorA, ColorF colorB)
-    : mColorA(colorA), mColorB(colorB), mFreq(4), mAmp(1.0), mPertub(0.05) {
-        
-    }
-    
-    Marble(ColorF colorA, ColorF colorB, double freq, double amp, float perturb)
-    : mColorA(colorA), mColorB(colorB), mFreq(freq), mAmp(amp), mPertub(perturb) {
-       
-    }
-
-    ColorF  MarbleColorAtPoint(Vector3 hp)
-    {
-        // Perturbing here breaks up the artifacts along lattice cube boundaries.
-        Vector3 p = hp + Vector3(RandFloat() * mPertub, RandFloat() * mPertub, RandFloat() * mPertub);
-
-        double t = Turbulence(p, 1.5, 5);
-        double mval = sin(mFreq * (p.x + mAmp*t));
-
-        double cval = TClip(mval, 0.0, 1.0);
-        ColorF clr;
-        clr.r = LinearInterp(mColorA.r, mColorB.r, cval);
-        clr.g = LinearInterp(mColorA.g, mColorB.g, cval);
-        clr.b = LinearInterp(mColorA.b, mColorB.b, cval);
+// Two marbles of different scales added together over one perturbation of the texels. The
+// wider bands take their turbulence an octave lower, so the two sums share three of their
+// four octaves and the plan makes five instead of eight.
+std::shared_ptr<const ProcColorBatch> MarbleColors(RGBColor colorA, RGBColor colorB, NoiseBasis basis)
+{
+    ColorF fcA = From24Color(colorA.r, colorA.g, colorA.b);
+    ColorF fcB = From24Color(colorB.r, colorB.g, colorB.b);
 
-        return clr;
+    ProcTextureGraph graph;
+    ProcTextureGraph::Node points = graph.TexelPoints(1, 15);
+    graph.AddMarbleLayer(points, graph.Turbulence(points, basis), 0.3, 0.25, fcA, fcB);
+    graph.AddMarbleLayer(points, graph.FBM(points, 0.5, 2.0, 0.5, 0, 1, 4, true, basis), 0.11, 0.15, fcA, fcB);
+    std::string why;
+    std::shared_ptr<const ProcTexturePlan> plan = graph.Compile(true, &why);
+    if(!plan) {
+        cerr << "MarbleColors: " << why << endl;
     }
-};
+    return plan;
+}
 
-    
-RGBImageBuffer* GenerateMarble(u_int32_t textureSize, RGBColor colorA, RGBColor colorB)
+ProcRegionFn MarbleRegion(RGBColor colorA, RGBColor colorB, NoiseBasis basis)
 {
-    ColorF fcA = From24Color(colorA.r, colorA.g, colorA.b);
-    ColorF fcB = From24Color(colorB.r, colorB.g, colorB.b);
-    Marble marble(fcA, fcB, 0.3, 0.25, 15);
-    Marble marble2(fcA, fcB, 0.11, 0.15, 10);
+    return RegionFromColors(MarbleColors(colorA, colorB, basis));
+}
+
+RGBImageBuffer* GenerateMarble(u_int32_t textureSize, RGBColor colorA, RGBColor colorB, ThreadPool* pool,
+                               NoiseBasis basis)
+{
+    TRACE_FUNCTION("texture");
+    const ProcRegionFn fill = MarbleRegion(colorA, colorB, basis);
     
     auto buffer = new RGBImageBuffer(textureSize, textureSize);
     
-    uint8_t* pixels = buffer->Pixels();
-    uint8_t* rowPtr = pixels;
-    
-    for(u_int32_t y = 0; y < textureSize; y++) {
-        uint8_t* pp = rowPtr;
-        for(u_int32_t x = 0; x < textureSize; x++) {
-            float z = 0;
-            ColorF fmc = marble.MarbleColorAtPoint(Vector3(x, y, z));
-            ColorF fmc2 = marble2.MarbleColorAtPoint(Vector3(x, y, z));
-            ColorF ftot = fmc + fmc2;
-        
-            RGBColor mc;
-            To24Color(ftot, mc.r, mc.g, mc.b);
-            *pp++ = mc.r;
-            *pp++ = mc.g;
-            *pp++ = mc.b;
-        
-        }
-        rowPtr += buffer->RowBytes();
-    }
+    ForEachRowBand(pool, textureSize, [&](u_int32_t yBegin, u_int32_t yEnd) {
+        fill(0, 0, yBegin, textureSize, yEnd - yBegin, buffer->Pixels() + yBegin * buffer->RowBytes(), buffer->RowBytes());
+    });
     return buffer;
 }
 
@@ -162,7 +165,7 @@ RGBImageBuffer* GenerateMarble(u_int32_t textureSize, RGBColor colorA, RGBColor
 
 
 // This is a 3d procedural texture based on fractional Brownian motion.
-class FractBrownianMotion {
+class FractBrownianMotion : public ProcColorBatch {
 private:
     ColorF mColor;
     double mGain;
@@ -171,66 +174,455 @@ private:
     double mMin, mMax;
     int mOctaves;
     bool mAbs; // use absolute value in numerator (like turbulence).
+    NoiseBasis mBasis;
     
+    // colors from count fbm values.
+    void ScaleColor(const double* fbm, int count, const ColorSpan& colors) const;
+
 public:
     
     FractBrownianMotion(ColorF color);
-    FractBrownianMotion(ColorF color, double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs);
+    FractBrownianMotion(ColorF color, double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                        NoiseBasis basis = kNoisePerlin);
         
-    ColorF ColorAtPoint(const Vector3& hp) const;
+    void ColorsAtPoints(const double* x, const double* y, const double* z, int count, const ColorSpan& colors) const override;
+    // Texels are in the z = 0 plane. In double, since the higher octaves scale the points
+    // past where float keeps the fraction.
+    void ColorsOfTexels(int level, u_int32_t x, u_int32_t y, u_int32_t count, const ColorSpan& colors) const override;
 };
 
 
 
 
 FractBrownianMotion::FractBrownianMotion(ColorF color)
-: mColor(color), mGain(0.5), mLacunarity(2.0), mFreqMin(2), mMin(0.2), mMax(0.9), mOctaves(5), mAbs(true)
+: mColor(color), mGain(0.5), mLacunarity(2.0), mFreqMin(2), mMin(0.2), mMax(0.9), mOctaves(5), mAbs(true), mBasis(kNoisePerlin)
 {
 }
 
 FractBrownianMotion::FractBrownianMotion(ColorF color, double gain, double lacun,
                                          double freqMin, double min, double max,
-                                         int octaves, bool abs)
-: mColor(color), mGain(gain), mLacunarity(lacun), mFreqMin(freqMin), mMin(min), mMax(max), mOctaves(octaves), mAbs(abs)
+                                         int octaves, bool abs, NoiseBasis basis)
+: mColor(color), mGain(gain), mLacunarity(lacun), mFreqMin(freqMin), mMin(min), mMax(max), mOctaves(octaves), mAbs(abs),
+  mBasis(basis)
 {
 }
 
 
-ColorF FractBrownianMotion::ColorAtPoint(const Vector3& hp) const
+void FractBrownianMotion::ScaleColor(const double* fbm, int count, const ColorSpan& colors) const
 {
-    double fbm = FBM(hp, mGain, mLacunarity, mFreqMin, mMin, mMax, mOctaves, mAbs);
-    ColorF clr = mColor * fbm;
-    return clr;
+    for(int i = 0; i < count; i++) {
+        const float f = (float)fbm[i];
+        colors.r[i] = mColor.r * f;
+        colors.g[i] = mColor.g * f;
+        colors.b[i] = mColor.b * f;
+    }
 }
 
+void FractBrownianMotion::ColorsAtPoints(const double* x, const double* y, const double* z, int count,
+                                         const ColorSpan& colors) const
+{
+    std::vector<double> fbm(count);
+    NoiseGenerator::Default().FBMBatch(x, y, z, fbm.data(), count, mGain, mLacunarity, mFreqMin, mMin, mMax, mOctaves, mAbs, mBasis);
+    ScaleColor(fbm.data(), count, colors);
+}
 
-RGBImageBuffer* GenerateFractalBrownianMotion(u_int32_t textureSize, RGBColor color,
-                                              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs)
+void FractBrownianMotion::ColorsOfTexels(int level, u_int32_t xBegin, u_int32_t y, u_int32_t count,
+                                         const ColorSpan& colors) const
+{
+    std::vector<double> xs(count), ys(count, (double)(y << level)), fbm(count);
+    for(u_int32_t x = 0; x < count; x++) {
+        xs[x] = (double)((xBegin + x) << level);
+    }
+    NoiseGenerator::Default().FBMBatch2D(xs.data(), ys.data(), fbm.data(), count, mGain, mLacunarity, mFreqMin, mMin, mMax,
+                                         mOctaves, mAbs, mBasis);
+    ScaleColor(fbm.data(), count, colors);
+}
+
+
+std::shared_ptr<const ProcColorBatch> FractalBrownianMotionColors(RGBColor color,
+                                                                  double gain, double lacun, double freqMin, double min, double max,
+                                                                  int octaves, bool abs, NoiseBasis basis)
 {
     ColorF fc = From24Color(color.r, color.g, color.b);
+    return std::make_shared<FractBrownianMotion>(fc, gain, lacun, freqMin, min, max, octaves, abs, basis);
+}
+
+ProcRegionFn FractalBrownianMotionRegion(RGBColor color,
+                                         double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                                         NoiseBasis basis)
+{
+    return RegionFromColors(FractalBrownianMotionColors(color, gain, lacun, freqMin, min, max, octaves, abs, basis));
+}
+
+
+void PackColors24(const ColorSpan& colors, u_int32_t count, uint8_t* rgb)
+{
+    const Float4 zero = Set4(0.0f);
+    const Float4 one = Set4(1.0f);
+    const Float4 scale = Set4(255.0f);
+    int32_t bytes[3][4];
+    u_int32_t i = 0;
+    for(; i + 4 <= count; i += 4) {
+        StoreTruncated4(bytes[0], Min4(Max4(Load4(colors.r + i), zero), one) * scale);
+        StoreTruncated4(bytes[1], Min4(Max4(Load4(colors.g + i), zero), one) * scale);
+        StoreTruncated4(bytes[2], Min4(Max4(Load4(colors.b + i), zero), one) * scale);
+        for(int lane = 0; lane < 4; lane++) {
+            *rgb++ = (uint8_t)bytes[0][lane];
+            *rgb++ = (uint8_t)bytes[1][lane];
+            *rgb++ = (uint8_t)bytes[2][lane];
+        }
+    }
+    for(; i < count; i++) {
+        *rgb++ = (uint8_t)(TClip(colors.r[i], 0.0f, 1.0f) * 255.0f);
+        *rgb++ = (uint8_t)(TClip(colors.g[i], 0.0f, 1.0f) * 255.0f);
+        *rgb++ = (uint8_t)(TClip(colors.b[i], 0.0f, 1.0f) * 255.0f);
+    }
+}
+
+ProcRegionFn RegionFromColors(std::shared_ptr<const ProcColorBatch> colors)
+{
+    return [colors](int level, u_int32_t xBegin, u_int32_t yBegin, u_int32_t width, u_int32_t height,
+                    uint8_t* pixels, u_int32_t rowBytes) {
+        std::vector<float> r(width), g(width), b(width);
+        const ColorSpan span = { r.data(), g.data(), b.data() };
+
+        uint8_t* rowPtr = pixels;
+        for(u_int32_t y = 0; y < height; y++) {
+            colors->ColorsOfTexels(level, xBegin, yBegin + y, width, span);
+            PackColors24(span, width, rowPtr);
+            rowPtr += rowBytes;
+        }
+    };
+}
+
+RGBImageBuffer* GenerateFractalBrownianMotion(u_int32_t textureSize, RGBColor color,
+                                              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                                              ThreadPool* pool, NoiseBasis basis)
+{
+    TRACE_FUNCTION("texture");
+    const ProcRegionFn fill = FractalBrownianMotionRegion(color, gain, lacun, freqMin, min, max, octaves, abs, basis);
     
-    FractBrownianMotion fbm(fc, gain, lacun, freqMin, min, max, octaves, abs);
+    auto buffer = new RGBImageBuffer(textureSize, textureSize);
+
+    ForEachRowBand(pool, textureSize, [&](u_int32_t yBegin, u_int32_t yEnd) {
+        fill(0, 0, yBegin, textureSize, yEnd - yBegin, buffer->Pixels() + yBegin * buffer->RowBytes(), buffer->RowBytes());
+    });
+    return buffer;
+}
+
+
+RGBImageBuffer* GenerateTileableFractalBrownianMotion(u_int32_t textureSize, RGBColor color, int period,
+                                                      double gain, int lacun, double min, double max, int octaves, bool abs,
+                                                      ThreadPool* pool)
+{
+    TRACE_FUNCTION("texture");
+    const ColorF fc = From24Color(color.r, color.g, color.b);
+    const NoiseGenerator& noise = NoiseGenerator::Default();
     
     auto buffer = new RGBImageBuffer(textureSize, textureSize);
 
-    uint8_t* pixels = buffer->Pixels();
-    uint8_t* rowPtr = pixels;
-
-    for(u_int32_t y = 0; y < textureSize; y++) {
-        uint8_t* pp = rowPtr;
-        for(u_int32_t x = 0; x < textureSize; x++) {
-            ColorF fmc = fbm.ColorAtPoint(Vector3(x, y, 0.0));
-            
-            RGBColor mc;
-            To24Color(fmc, mc.r, mc.g, mc.b);
-            *pp++ = mc.r;
-            *pp++ = mc.g;
-            *pp++ = mc.b;
-        
+    ForEachRowBand(pool, textureSize, [&](u_int32_t yBegin, u_int32_t yEnd) {
+        // the image spans period lattice cells each way, so its last column runs into its first.
+        const int width = (int)textureSize;
+        const double cellsPerPixel = (double)period / textureSize;
+        std::vector<double> xs(width), ys(width), values(width);
+        for(int x = 0; x < width; x++) {
+            xs[x] = x * cellsPerPixel;
         }
-        rowPtr += buffer->RowBytes();
-    }
+
+        uint8_t* rowPtr = buffer->Pixels() + yBegin * buffer->RowBytes();
+        for(u_int32_t y = yBegin; y < yEnd; y++) {
+            std::fill(ys.begin(), ys.end(), y * cellsPerPixel);
+            noise.TileableFBMBatch2D(xs.data(), ys.data(), values.data(), width, period, period,
+                                     gain, lacun, min, max, octaves, abs);
+
+            uint8_t* pp = rowPtr;
+            for(int x = 0; x < width; x++) {
+                RGBColor mc;
+                To24Color(fc * values[x], mc.r, mc.g, mc.b);
+                *pp++ = mc.r;
+                *pp++ = mc.g;
+                *pp++ = mc.b;
+            }
+            rowPtr += buffer->RowBytes();
+        }
+    });
     return buffer;
 }
 
 
+// The surface normal where the height's slope along the columns and rows is dhdu and dhdv.
+static Vector3 BumpNormal(double dhdu, double dhdv)
+{
+    Vector3 n(-dhdu, -dhdv, 1.0);
+    return n / n.Magnitude();
+}
+
+void GenerateTileableHeightAndNormalMaps(u_int32_t textureSize, int period,
+                                         double gain, int lacun, double min, double max, int octaves, bool abs,
+                                         double bumpHeight, RGBImageBuffer*& heightMap, RGBImageBuffer*& normalMap,
+                                         ThreadPool* pool)
+{
+    TRACE_FUNCTION("texture");
+    const NoiseGenerator& noise = NoiseGenerator::Default();
+    
+    heightMap = new RGBImageBuffer(textureSize, textureSize);
+    normalMap = new RGBImageBuffer(textureSize, textureSize);
+
+    ForEachRowBand(pool, textureSize, [&](u_int32_t yBegin, u_int32_t yEnd) {
+        const double cellsPerPixel = (double)period / textureSize;
+        // the noise's gradient is per lattice cell, and the texture is period cells across.
+        const double slopeScale = bumpHeight * period;
+
+        uint8_t* heightRow = heightMap->Pixels() + yBegin * heightMap->RowBytes();
+        uint8_t* normalRow = normalMap->Pixels() + yBegin * normalMap->RowBytes();
+        for(u_int32_t y = yBegin; y < yEnd; y++) {
+            uint8_t* hp = heightRow;
+            uint8_t* np = normalRow;
+            for(u_int32_t x = 0; x < textureSize; x++) {
+                double dx, dy;
+                double h = noise.TileableFBMDeriv2D(x * cellsPerPixel, y * cellsPerPixel, period, period,
+                                                    gain, lacun, min, max, octaves, abs, dx, dy);
+                Vector3 n = BumpNormal(dx * slopeScale, dy * slopeScale);
+                RGBColor mc;
+                To24Color(ColorF(h, h, h), mc.r, mc.g, mc.b);
+                *hp++ = mc.r;
+                *hp++ = mc.g;
+                *hp++ = mc.b;
+                To24Color(ColorF(n.x * 0.5 + 0.5, n.y * 0.5 + 0.5, n.z * 0.5 + 0.5), mc.r, mc.g, mc.b);
+                *np++ = mc.r;
+                *np++ = mc.g;
+                *np++ = mc.b;
+            }
+            heightRow += heightMap->RowBytes();
+            normalRow += normalMap->RowBytes();
+        }
+    });
+}
+
+
+RGBImageBuffer* GenerateProceduralTexture(u_int32_t textureSize, const ProcColorFn& colorFn, ThreadPool* pool)
+{
+    TRACE_FUNCTION("texture");
+    auto buffer = new RGBImageBuffer(textureSize, textureSize);
+
+    ForEachRowBand(pool, textureSize, [&](u_int32_t yBegin, u_int32_t yEnd) {
+        uint8_t* rowPtr = buffer->Pixels() + yBegin * buffer->RowBytes();
+        for(u_int32_t y = yBegin; y < yEnd; y++) {
+            uint8_t* pp = rowPtr;
+            for(u_int32_t x = 0; x < textureSize; x++) {
+                RGBColor mc;
+                To24Color(colorFn(x, y), mc.r, mc.g, mc.b);
+                *pp++ = mc.r;
+                *pp++ = mc.g;
+                *pp++ = mc.b;
+            }
+            rowPtr += buffer->RowBytes();
+        }
+    });
+    return buffer;
+}
+
+
+static bool SameImage(const RGBImageBuffer* a, const RGBImageBuffer* b)
+{
+    if(a->Width() != b->Width() || a->Height() != b->Height()) {
+        return false;
+    }
+    for(u_int32_t y = 0; y < a->Height(); y++) {
+        const uint8_t* rowA = a->Pixels() + y * a->RowBytes();
+        const uint8_t* rowB = b->Pixels() + y * b->RowBytes();
+        if(memcmp(rowA, rowB, a->Width() * a->Channels()) != 0) {
+            cerr << "Parallel texture differs at row " << y << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool TestGenerateParallel(void)
+{
+    // more workers than the test machine may have, and sizes that leave a partial band.
+    ThreadPool pool(3);
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor white = {255, 255, 255};
+    const RGBColor orange = {232, 99, 10};
+
+    for(u_int32_t size : {1u, 37u, 64u}) {
+        std::unique_ptr<RGBImageBuffer> serial(GenerateCheckers(size, 4, blue, white));
+        std::unique_ptr<RGBImageBuffer> parallel(GenerateCheckers(size, 4, blue, white, &pool));
+        DbgAssert(SameImage(serial.get(), parallel.get()));
+
+        serial.reset(GenerateMarble(size, blue, white));
+        parallel.reset(GenerateMarble(size, blue, white, &pool));
+        DbgAssert(SameImage(serial.get(), parallel.get()));
+
+        serial.reset(GenerateFractalBrownianMotion(size, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 4, false));
+        parallel.reset(GenerateFractalBrownianMotion(size, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 4, false, &pool));
+        DbgAssert(SameImage(serial.get(), parallel.get()));
+
+        serial.reset(GenerateMarble(size, blue, white, nullptr, kNoiseSimplex));
+        parallel.reset(GenerateMarble(size, blue, white, &pool, kNoiseSimplex));
+        DbgAssert(SameImage(serial.get(), parallel.get()));
+
+        serial.reset(GenerateFractalBrownianMotion(size, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 4, false, nullptr, kNoiseSimplex));
+        parallel.reset(GenerateFractalBrownianMotion(size, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 4, false, &pool, kNoiseSimplex));
+        DbgAssert(SameImage(serial.get(), parallel.get()));
+
+        serial.reset(GenerateTileableFractalBrownianMotion(size, orange, 4, 0.5, 2, -0.5, 0.5, 4, false));
+        parallel.reset(GenerateTileableFractalBrownianMotion(size, orange, 4, 0.5, 2, -0.5, 0.5, 4, false, &pool));
+        DbgAssert(SameImage(serial.get(), parallel.get()));
+
+        auto gradient = [size](u_int32_t x, u_int32_t y) {
+            return ColorF(x / (float)size, y / (float)size, 0.5f);
+        };
+        serial.reset(GenerateProceduralTexture(size, gradient));
+        parallel.reset(GenerateProceduralTexture(size, gradient, &pool));
+        DbgAssert(SameImage(serial.get(), parallel.get()));
+        const uint8_t* last = parallel->Pixels() + (size - 1) * parallel->RowBytes() + (size - 1) * 3;
+        DbgAssert(last[2] == 127 || last[2] == 128);
+    }
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
+
+
+bool TestGenerateHeightAndNormalMaps(void)
+{
+    ThreadPool pool(3);
+    const RGBColor white = {255, 255, 255};
+    const int kPeriod = 4;
+    const double kBumpHeight = 0.02;
+
+    for(u_int32_t size : {1u, 37u, 64u}) {
+        RGBImageBuffer* height;
+        RGBImageBuffer* normal;
+        GenerateTileableHeightAndNormalMaps(size, kPeriod, 0.5, 2, -1.0, 1.0, 5, false, kBumpHeight, height, normal);
+        std::unique_ptr<RGBImageBuffer> serialHeight(height), serialNormal(normal);
+        GenerateTileableHeightAndNormalMaps(size, kPeriod, 0.5, 2, -1.0, 1.0, 5, false, kBumpHeight, height, normal, &pool);
+        std::unique_ptr<RGBImageBuffer> parallelHeight(height), parallelNormal(normal);
+        DbgAssert(SameImage(serialHeight.get(), parallelHeight.get()));
+        DbgAssert(SameImage(serialNormal.get(), parallelNormal.get()));
+
+        // the heights are the white FBM texture's.
+        std::unique_ptr<RGBImageBuffer> fbm(GenerateTileableFractalBrownianMotion(size, white, kPeriod, 0.5, 2, -1.0, 1.0, 5, false));
+        DbgAssert(SameImage(fbm.get(), serialHeight.get()));
+
+        // the normals are the ones finite differences give, to within the 8 bit packing.
+        const NoiseGenerator& noise = NoiseGenerator::Default();
+        const double cellsPerPixel = (double)kPeriod / size;
+        const double kStep = 1e-5;
+        for(u_int32_t y = 0; y < size; y += 3) {
+            for(u_int32_t x = 0; x < size; x += 3) {
+                double u = x * cellsPerPixel, v = y * cellsPerPixel;
+                double dhdu = (noise.TileableFBM2D(u + kStep, v, kPeriod, kPeriod, 0.5, 2, -1.0, 1.0, 5, false) -
+                               noise.TileableFBM2D(u - kStep, v, kPeriod, kPeriod, 0.5, 2, -1.0, 1.0, 5, false)) / (2 * kStep);
+                double dhdv = (noise.TileableFBM2D(u, v + kStep, kPeriod, kPeriod, 0.5, 2, -1.0, 1.0, 5, false) -
+                               noise.TileableFBM2D(u, v - kStep, kPeriod, kPeriod, 0.5, 2, -1.0, 1.0, 5, false)) / (2 * kStep);
+                Vector3 n = BumpNormal(dhdu * kBumpHeight * kPeriod, dhdv * kBumpHeight * kPeriod);
+                const uint8_t* packed = serialNormal->Pixels() + y * serialNormal->RowBytes() + x * 3;
+                DbgAssert(TAbs(packed[0] - (n.x * 0.5 + 0.5) * 255.0) <= 1.0);
+                DbgAssert(TAbs(packed[1] - (n.y * 0.5 + 0.5) * 255.0) <= 1.0);
+                DbgAssert(TAbs(packed[2] - (n.z * 0.5 + 0.5) * 255.0) <= 1.0);
+            }
+        }
+    }
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
+
+bool TestProcColorBatch(void)
+{
+    // in range channels pack as To24Color does, to within the float scaling, out of range ones
+    // clamp. 11 texels, so both the four wide part and the rest run.
+    const float reds[11] = {0.0f, 1.0f, 0.5f, 1.0f / 255.0f, 0.999f, -0.5f, 1.7f, 2.0f, 0.25f, -3.0f, 0.75f};
+    float r[11], g[11], b[11];
+    for(int i = 0; i < 11; i++) {
+        r[i] = reds[i];
+        g[i] = reds[10 - i];
+        b[i] = reds[i] * 0.5f;
+    }
+    uint8_t packed[33];
+    PackColors24({r, g, b}, 11, packed);
+    for(int i = 0; i < 11; i++) {
+        const float channels[3] = {r[i], g[i], b[i]};
+        for(int c = 0; c < 3; c++) {
+            const float v = channels[c];
+            if(v < 0.0f) {
+                DbgAssert(packed[i * 3 + c] == 0);
+            } else if(v > 1.0f) {
+                DbgAssert(packed[i * 3 + c] == 255);
+            } else {
+                ColorF clr(v, v, v);
+                RGBColor expected;
+                To24Color(clr, expected.r, expected.g, expected.b);
+                DbgAssert(TAbs(packed[i * 3 + c] - expected.r) <= 1);
+            }
+        }
+    }
+
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor white = {255, 255, 255};
+    const RGBColor orange = {232, 99, 10};
+    const u_int32_t kSize = 37;
+    std::vector<float> rs(kSize), gs(kSize), bs(kSize);
+    const ColorSpan span = { rs.data(), gs.data(), bs.data() };
+    std::vector<uint8_t> row(kSize * 3);
+
+    // rows of texels are the generators' rows.
+    std::unique_ptr<RGBImageBuffer> marbleImage(GenerateMarble(kSize, blue, white));
+    std::shared_ptr<const ProcColorBatch> marble = MarbleColors(blue, white);
+    for(u_int32_t y = 0; y < kSize; y += 5) {
+        marble->ColorsOfTexels(0, 0, y, kSize, span);
+        PackColors24(span, kSize, row.data());
+        DbgAssert(memcmp(row.data(), marbleImage->Pixels() + y * marbleImage->RowBytes(), kSize * 3) == 0);
+    }
+
+    // points are taken as they are, so the same points give the same colors wherever they are
+    // in the batch, and a level's texel is level 0's at twice the coordinates.
+    std::vector<double> xs(kSize), ys(kSize), zs(kSize);
+    for(u_int32_t i = 0; i < kSize; i++) {
+        xs[i] = 3.25 * (i % 7);
+        ys[i] = 1.5 * (i % 7);
+        zs[i] = 0.125 * (i % 7);
+    }
+    marble->ColorsAtPoints(xs.data(), ys.data(), zs.data(), kSize, span);
+    for(u_int32_t i = 7; i < kSize; i++) {
+        DbgAssert(rs[i] == rs[i - 7] && gs[i] == gs[i - 7] && bs[i] == bs[i - 7]);
+    }
+
+    std::shared_ptr<const ProcColorBatch> fbm = FractalBrownianMotionColors(orange, 0.8, 1.8, 3.0, -0.5, 0.5, 4, false);
+    std::unique_ptr<RGBImageBuffer> fbmImage(GenerateFractalBrownianMotion(kSize, orange, 0.8, 1.8, 3.0, -0.5, 0.5, 4, false));
+    for(u_int32_t y = 0; y < kSize / 2; y += 3) {
+        fbm->ColorsOfTexels(1, 0, y, kSize / 2, span);
+        PackColors24(span, kSize / 2, row.data());
+        const uint8_t* imageRow = fbmImage->Pixels() + (y * 2) * fbmImage->RowBytes();
+        for(u_int32_t x = 0; x < kSize / 2; x++) {
+            DbgAssert(memcmp(&row[x * 3], imageRow + x * 2 * 3, 3) == 0);
+        }
+    }
+
+    // the FBM's texels are its solid texture at z = 0.
+    std::vector<float> texelR(kSize), texelG(kSize), texelB(kSize);
+    for(u_int32_t i = 0; i < kSize; i++) {
+        xs[i] = i;
+        ys[i] = 11;
+        zs[i] = 0;
+    }
+    fbm->ColorsOfTexels(0, 0, 11, kSize, { texelR.data(), texelG.data(), texelB.data() });
+    fbm->ColorsAtPoints(xs.data(), ys.data(), zs.data(), kSize, span);
+    for(u_int32_t i = 0; i < kSize; i++) {
+        DbgAssert(TAbs(rs[i] - texelR[i]) < 1e-5f && TAbs(gs[i] - texelG[i]) < 1e-5f && TAbs(bs[i] - texelB[i]) < 1e-5f);
+    }
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
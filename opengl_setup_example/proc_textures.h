@@ -8,19 +8,142 @@
 #ifndef proc_textures_hpp
 #define proc_textures_hpp
 
+#include <functional>
+#include <memory>
+#include <string>
+#include <sstream>
+
 #include "image_buffer.h"
 #include "colors.h"
+#include "color.h"
+#include "noise.h"
+
+class ThreadPool;
 
+// The generators fill their image in bands of rows. With a pool the bands are spread
+// over its threads, without one they run on the caller. The pixels come out the same.
+// The noise based ones take the noise to build on, Perlin gives the textures they have
+// always made.
 
-RGBImageBuffer* GenerateCheckers(u_int32_t textureSize, u_int32_t checkerSize, RGBColor colorA, RGBColor colorB);
+RGBImageBuffer* GenerateCheckers(u_int32_t textureSize, u_int32_t checkerSize, RGBColor colorA, RGBColor colorB,
+                                 ThreadPool* pool = nullptr);
 
 bool TestGenerateCheckers(void);
 
 
-RGBImageBuffer* GenerateMarble(u_int32_t textureSize, RGBColor colorA, RGBColor colorB);
+RGBImageBuffer* GenerateMarble(u_int32_t textureSize, RGBColor colorA, RGBColor colorB, ThreadPool* pool = nullptr,
+                               NoiseBasis basis = kNoisePerlin);
 
 
 RGBImageBuffer* GenerateFractalBrownianMotion(u_int32_t textureSize, RGBColor color,
-                                              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs);
+                                              double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                                              ThreadPool* pool = nullptr, NoiseBasis basis = kNoisePerlin);
+
+// Fills a width x height block of a procedural texture from texel x, y of mip level, 3 bytes
+// a texel and rowBytes apart. A texel of level L is the level 0 texel at (x << L, y << L), so
+// each level samples the full size texture more sparsely, with no filtering, which aliases
+// when used as mips. VirtualTexture only asks for level 0 and filters its levels from it.
+// Level 0 of a block is the same as those pixels of the generator above. Called from several
+// threads at once.
+typedef std::function<void(int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                           uint8_t* pixels, u_int32_t rowBytes)> ProcRegionFn;
+
+ProcRegionFn MarbleRegion(RGBColor colorA, RGBColor colorB, NoiseBasis basis = kNoisePerlin);
+
+ProcRegionFn FractalBrownianMotionRegion(RGBColor color,
+                                         double gain, double lacun, double freqMin, double min, double max, int octaves, bool abs,
+                                         NoiseBasis basis = kNoisePerlin);
+
+// Float colors for a batch of points, a channel to an array.
+struct ColorSpan {
+    float* r;
+    float* g;
+    float* b;
+};
+
+// A procedural texture's colors for many points in one call, so the noise runs over a whole
+// row or tile of them at once. The generators bake a row of texels at a time through it and
+// a ray tracer can shade a batch of hits. Called from several threads at once.
+class ProcColorBatch {
+public:
+    virtual ~ProcColorBatch() {}
+
+    // Colors of the solid texture at count points, in level 0 texels, for shading hits.
+    virtual void ColorsAtPoints(const double* x, const double* y, const double* z, int count,
+                                const ColorSpan& colors) const = 0;
+    // Colors of count texels of row y of level from texel x, as the generator makes them.
+    // Levels are as for ProcRegionFn.
+    virtual void ColorsOfTexels(int level, u_int32_t x, u_int32_t y, u_int32_t count, const ColorSpan& colors) const = 0;
+};
+
+// The colors behind GenerateMarble and GenerateFractalBrownianMotion. The marble's points are
+// moved a little at random per texel when baked, ColorsAtPoints takes them as they are.
+std::shared_ptr<const ProcColorBatch> MarbleColors(RGBColor colorA, RGBColor colorB, NoiseBasis basis = kNoisePerlin);
+
+std::shared_ptr<const ProcColorBatch> FractalBrownianMotionColors(RGBColor color,
+                                                                  double gain, double lacun, double freqMin, double min, double max,
+                                                                  int octaves, bool abs, NoiseBasis basis = kNoisePerlin);
+
+// Packs count colors into 3 byte texels at rgb, each channel clamped to [0, 1] and scaled
+// and truncated like To24Color, four texels at a time.
+void PackColors24(const ColorSpan& colors, u_int32_t count, uint8_t* rgb);
+
+// A region fill that bakes colors a row at a time through PackColors24.
+ProcRegionFn RegionFromColors(std::shared_ptr<const ProcColorBatch> colors);
+
+// FBM that wraps at the image edges, so the texture tiles without seams. The image
+// covers period lattice cells of the first octave each way, and each octave after
+// it lacun times as many.
+RGBImageBuffer* GenerateTileableFractalBrownianMotion(u_int32_t textureSize, RGBColor color, int period,
+                                                      double gain, int lacun, double min, double max, int octaves, bool abs,
+                                                      ThreadPool* pool = nullptr);
+
+// The tileable FBM above as a gray height texture, white for the top, and the tangent
+// space normal map for it, both from one pass over the noise and its analytic gradient.
+// The texture spans one unit of surface each way and bumpHeight is the height of white
+// in those units. The normal's x follows the columns and y the rows, packed as n * 0.5 + 0.5.
+void GenerateTileableHeightAndNormalMaps(u_int32_t textureSize, int period,
+                                         double gain, int lacun, double min, double max, int octaves, bool abs,
+                                         double bumpHeight, RGBImageBuffer*& heightMap, RGBImageBuffer*& normalMap,
+                                         ThreadPool* pool = nullptr);
+
+// Bump when any generator's pixels change, so a TextureCache does not hand back the old ones.
+constexpr int kProcTexturesVersion = 4;
+
+template<typename T> void AppendKeyParam(std::ostringstream& key, const T& param)
+{
+    key << '/' << param;
+}
+
+inline void AppendKeyParam(std::ostringstream& key, const RGBColor& color)
+{
+    key << '/' << (int)color.r << ',' << (int)color.g << ',' << (int)color.b;
+}
+
+// Key for a generated texture in a TextureCache: the generator's name and parameters, the
+// default noise seed and kProcTexturesVersion. Doubles go in as hex floats, so the key
+// changes with any bit of them.
+template<typename... Params> std::string ProcTextureKey(const char* generator, const Params&... params)
+{
+    std::ostringstream key;
+    key << generator << std::hexfloat;
+    (AppendKeyParam(key, params), ...);
+    key << "/seed " << NoiseGenerator::kDefaultSeed << "/version " << kProcTexturesVersion;
+    return key.str();
+}
+
+// Color of the pixel at x, y. Called from several threads at once when there is a pool.
+typedef std::function<ColorF(u_int32_t x, u_int32_t y)> ProcColorFn;
+
+RGBImageBuffer* GenerateProceduralTexture(u_int32_t textureSize, const ProcColorFn& colorFn, ThreadPool* pool = nullptr);
+
+// Each generator on a pool against the same one without.
+bool TestGenerateParallel(void);
+
+// The height and normal maps against the plain FBM and its finite differences.
+bool TestGenerateHeightAndNormalMaps(void);
+
+// The batch colors against the baked textures and PackColors24 against To24Color.
+bool TestProcColorBatch(void);
 
 #endif /* proc_textures_hpp */
@@ -0,0 +1,249 @@
+//
+//  profiler.cpp
+//  opengl_setup_example
+//
+
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "gl_backend.h"
+#include "dbgutils.h"
+
+FrameProfiler::FrameProfiler(GLBackend& backend)
+    : mBackend(backend), mFrame(0), mSet(0), mFrameNext(0), mDropped(0)
+{
+    mScopes.reserve(16);
+    mFrameHistory.reserve(kHistoryFrames);
+}
+
+FrameProfiler::~FrameProfiler()
+{
+    for(Scope& scope : mScopes) {
+        if(!scope.gpu) {
+            continue;
+        }
+        for(int set = 0; set < kQuerySets; set++) {
+            mBackend.DeleteQuery(scope.queries[set][0]);
+            mBackend.DeleteQuery(scope.queries[set][1]);
+        }
+    }
+}
+
+int FrameProfiler::AddScope(const char* name, bool gpu)
+{
+    Scope scope;
+    scope.name = name;
+    scope.gpu = gpu;
+    for(int set = 0; set < kQuerySets; set++) {
+        scope.queries[set][0] = gpu ? mBackend.GenQuery() : 0;
+        scope.queries[set][1] = gpu ? mBackend.GenQuery() : 0;
+        scope.queryFrames[set] = -1;
+    }
+    scope.gpuOpen = false;
+    scope.depth = 0;
+    scope.frameCPUMillis = -1;
+    scope.cpuHistory.reserve(kHistoryFrames);
+    scope.gpuHistory.reserve(gpu ? kHistoryFrames : 0);
+    scope.cpuNext = 0;
+    scope.gpuNext = 0;
+    mScopes.push_back(scope);
+    return (int)mScopes.size() - 1;
+}
+
+void FrameProfiler::AddSample(std::vector<float>& history, int& next, float value)
+{
+    if((int)history.size() < kHistoryFrames) {
+        history.push_back(value);
+    } else {
+        history[next] = value;
+    }
+    next = (next + 1) % kHistoryFrames;
+}
+
+void FrameProfiler::Summarize(const std::vector<float>& history, double& avg, double& max)
+{
+    double total = 0;
+    max = 0;
+    for(float value : history) {
+        total += value;
+        max = std::max(max, (double)value);
+    }
+    avg = history.empty() ? 0 : total / history.size();
+}
+
+void FrameProfiler::ReadQueries(int set)
+{
+    for(Scope& scope : mScopes) {
+        if(!scope.gpu || scope.queryFrames[set] < 0) {
+            continue;
+        }
+        scope.queryFrames[set] = -1;
+        // the end timestamp comes after the begin one, so it being ready means both are.
+        if(!mBackend.QueryResultAvailable(scope.queries[set][1])) {
+            mDropped++;
+            continue;
+        }
+        GLuint64 begin = mBackend.QueryResult(scope.queries[set][0]);
+        GLuint64 end = mBackend.QueryResult(scope.queries[set][1]);
+        AddSample(scope.gpuHistory, scope.gpuNext, end > begin ? (end - begin) / 1.0e6f : 0.0f);
+    }
+}
+
+void FrameProfiler::BeginFrame(void)
+{
+    mSet = mFrame % kQuerySets;
+    ReadQueries(mSet);
+    for(Scope& scope : mScopes) {
+        scope.frameCPUMillis = -1;
+    }
+    mFrameStart = Clock::now();
+}
+
+void FrameProfiler::EndFrame(void)
+{
+    auto end = Clock::now();
+    AddSample(mFrameHistory, mFrameNext, std::chrono::duration<float, std::milli>(end - mFrameStart).count());
+    for(Scope& scope : mScopes) {
+        DbgAssert(scope.depth == 0);
+        // scopes not entered this frame keep their history as it was.
+        if(scope.frameCPUMillis >= 0) {
+            AddSample(scope.cpuHistory, scope.cpuNext, (float)scope.frameCPUMillis);
+        }
+    }
+    mFrame++;
+}
+
+void FrameProfiler::BeginScope(int scopeIndex)
+{
+    Scope& scope = mScopes[scopeIndex];
+    if(scope.depth++ > 0) {
+        return;
+    }
+    if(scope.gpu && scope.queryFrames[mSet] != mFrame) {
+        scope.queryFrames[mSet] = mFrame;
+        scope.gpuOpen = true;
+        mBackend.QueryCounter(scope.queries[mSet][0], GL_TIMESTAMP);
+    }
+    scope.start = Clock::now();
+}
+
+void FrameProfiler::EndScope(int scopeIndex)
+{
+    Scope& scope = mScopes[scopeIndex];
+    DbgAssert(scope.depth > 0);
+    if(--scope.depth > 0) {
+        return;
+    }
+    auto end = Clock::now();
+    double millis = std::chrono::duration<double, std::milli>(end - scope.start).count();
+    scope.frameCPUMillis = std::max(scope.frameCPUMillis, 0.0) + millis;
+    // only the first entry of the frame has a begin timestamp, later ones are CPU only.
+    if(scope.gpuOpen) {
+        scope.gpuOpen = false;
+        mBackend.QueryCounter(scope.queries[mSet][1], GL_TIMESTAMP);
+    }
+}
+
+ScopeStats FrameProfiler::Stats(int scopeIndex) const
+{
+    const Scope& scope = mScopes[scopeIndex];
+    ScopeStats stats;
+    Summarize(scope.cpuHistory, stats.cpuAvgMillis, stats.cpuMaxMillis);
+    if(!scope.gpuHistory.empty()) {
+        Summarize(scope.gpuHistory, stats.gpuAvgMillis, stats.gpuMaxMillis);
+    }
+    return stats;
+}
+
+void FrameProfiler::FrameStats(double& avgMillis, double& maxMillis) const
+{
+    Summarize(mFrameHistory, avgMillis, maxMillis);
+}
+
+void FrameProfiler::PrintTable(std::ostream& out) const
+{
+    double frameAvg, frameMax;
+    FrameStats(frameAvg, frameMax);
+
+    char line[160];
+    snprintf(line, sizeof(line), "%-20s %9s %9s %9s %9s %7s\n", "scope", "cpu avg", "cpu max", "gpu avg", "gpu max", "% frame");
+    out << line;
+    for(int i = 0; i < ScopeCount(); i++) {
+        ScopeStats stats = Stats(i);
+        double share = frameAvg > 0 ? 100.0 * stats.cpuAvgMillis / frameAvg : 0.0;
+        if(stats.gpuAvgMillis >= 0) {
+            snprintf(line, sizeof(line), "%-20s %9.3f %9.3f %9.3f %9.3f %7.1f\n", mScopes[i].name.c_str(),
+                     stats.cpuAvgMillis, stats.cpuMaxMillis, stats.gpuAvgMillis, stats.gpuMaxMillis, share);
+        } else {
+            snprintf(line, sizeof(line), "%-20s %9.3f %9.3f %9s %9s %7.1f\n", mScopes[i].name.c_str(),
+                     stats.cpuAvgMillis, stats.cpuMaxMillis, "-", "-", share);
+        }
+        out << line;
+    }
+    snprintf(line, sizeof(line), "%-20s %9.3f %9.3f   (last %zu frames, %d GPU results dropped)\n", "frame",
+             frameAvg, frameMax, mFrameHistory.size(), mDropped);
+    out << line;
+}
+
+bool FrameProfiler::Test(void)
+{
+    GLNullBackend backend;
+    {
+        FrameProfiler profiler(backend);
+        int outer = profiler.AddScope("outer", true);
+        int inner = profiler.AddScope("inner", false);
+        int unused = profiler.AddScope("unused", true);
+        DbgAssert(backend.CountCommands(kCmdGenQuery) == 2 * 2 * kQuerySets);
+
+        const int frames = kQuerySets + 2;
+        for(int i = 0; i < frames; i++) {
+            profiler.BeginFrame();
+            {
+                ProfileScope outerScope(&profiler, outer);
+                // nested and repeated entries, only the outermost first one gets timestamps.
+                ProfileScope again(&profiler, outer);
+                for(int j = 0; j < 3; j++) {
+                    ProfileScope innerScope(&profiler, inner);
+                }
+            }
+            {
+                ProfileScope outerScope(&profiler, outer);
+            }
+            profiler.EndFrame();
+
+            DbgAssert(backend.CountCommands(kCmdQueryCounter) == 2 * (i + 1));
+            // each set is read when the frame kQuerySets later reuses it.
+            int readBack = std::max(0, i + 1 - kQuerySets);
+            DbgAssert(backend.CountCommands(kCmdQueryResult) == 2 * readBack);
+        }
+
+        ScopeStats outerStats = profiler.Stats(outer);
+        DbgAssert(outerStats.cpuAvgMillis >= 0);
+        DbgAssert(outerStats.cpuMaxMillis >= outerStats.cpuAvgMillis);
+        DbgAssert(outerStats.gpuAvgMillis == 0);
+        DbgAssert(profiler.Stats(inner).gpuAvgMillis < 0);
+        DbgAssert(profiler.Stats(unused).cpuAvgMillis == 0);
+        DbgAssert(profiler.Stats(unused).gpuAvgMillis < 0);
+        DbgAssert(profiler.Dropped() == 0);
+
+        // the null backend's results are always ready and 0, so nothing to drop and no time.
+        std::ostringstream table;
+        profiler.PrintTable(table);
+        std::string text = table.str();
+        DbgAssert(text.find("outer") != std::string::npos);
+        DbgAssert(text.find("inner") != std::string::npos);
+        DbgAssert(std::count(text.begin(), text.end(), '\n') == profiler.ScopeCount() + 2);
+
+        // A null profiler is allowed.
+        ProfileScope nothing(nullptr, outer);
+    }
+    DbgAssert(backend.CountCommands(kCmdDeleteQuery) == 2 * 2 * kQuerySets);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
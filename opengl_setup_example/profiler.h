@@ -0,0 +1,142 @@
+//
+//  profiler.h
+//  opengl_setup_example
+//
+
+#ifndef profiler_hpp
+#define profiler_hpp
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <ostream>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+
+class GLBackend;
+
+// Rolling statistics for one scope over the last kHistoryFrames frames it was sampled.
+struct ScopeStats {
+    double cpuAvgMillis;
+    double cpuMaxMillis;
+    // negative when the scope has no GPU timing or none has come back yet.
+    double gpuAvgMillis;
+    double gpuMaxMillis;
+
+    ScopeStats() : cpuAvgMillis(0), cpuMaxMillis(0), gpuAvgMillis(-1), gpuMaxMillis(-1) {}
+};
+
+// Per pass frame profiler. Scopes are added once up front and then timed every frame
+// with BeginScope and EndScope, or a ProfileScope. CPU time is summed over every entry
+// into a scope during the frame, so scopes can nest and repeat.
+//
+// GPU scopes also put a GL_TIMESTAMP query before and after their first entry each frame.
+// The queries cycle through kQuerySets sets and a set is only read when it comes round
+// again, frames later. A result that is still not ready then is dropped rather than
+// waited for, so the profiler never stalls the CPU on the GPU.
+class FrameProfiler {
+public:
+    // Double buffering is the minimum, the third set covers drivers that run two frames behind.
+    static constexpr int kQuerySets = 3;
+    static constexpr int kHistoryFrames = 120;
+
+private:
+    typedef std::chrono::high_resolution_clock Clock;
+
+    struct Scope {
+        std::string name;
+        bool gpu;
+        // begin and end timestamp queries for each set.
+        GLuint queries[kQuerySets][2];
+        // frame each set's queries were issued in, -1 if they were not.
+        int queryFrames[kQuerySets];
+        // between the begin and end timestamps.
+        bool gpuOpen;
+
+        Clock::time_point start;
+        int depth;
+        double frameCPUMillis;
+
+        // rolling history, next is where the next sample goes.
+        std::vector<float> cpuHistory;
+        std::vector<float> gpuHistory;
+        int cpuNext;
+        int gpuNext;
+    };
+
+    GLBackend& mBackend;
+    std::vector<Scope> mScopes;
+    int mFrame;
+    int mSet;
+    Clock::time_point mFrameStart;
+    std::vector<float> mFrameHistory;
+    int mFrameNext;
+    // GPU results that were not ready when their set came round.
+    int mDropped;
+
+    void ReadQueries(int set);
+    static void AddSample(std::vector<float>& history, int& next, float value);
+    static void Summarize(const std::vector<float>& history, double& avg, double& max);
+
+public:
+    explicit FrameProfiler(GLBackend& backend);
+    // Deletes the queries, the context must still be current.
+    ~FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator = (const FrameProfiler&) = delete;
+
+    // Returns the scope's index for BeginScope and EndScope.
+    int AddScope(const char* name, bool gpu);
+
+    // Reads back the oldest query set, which this frame then reuses.
+    void BeginFrame(void);
+    void EndFrame(void);
+
+    void BeginScope(int scope);
+    void EndScope(int scope);
+
+    int ScopeCount(void) const { return (int)mScopes.size(); }
+    const std::string& ScopeName(int scope) const { return mScopes[scope].name; }
+    bool ScopeHasGPU(int scope) const { return mScopes[scope].gpu; }
+    ScopeStats Stats(int scope) const;
+    // average and max whole frame CPU time, BeginFrame to EndFrame.
+    void FrameStats(double& avgMillis, double& maxMillis) const;
+    int Dropped(void) const { return mDropped; }
+
+    // One line per scope with CPU and GPU average and max, and CPU share of the frame.
+    void PrintTable(std::ostream& out) const;
+
+    static bool Test(void);
+};
+
+// Times the enclosing block as scope. A null profiler does nothing, so call sites stay
+// in place with profiling off.
+class ProfileScope {
+private:
+    FrameProfiler* mProfiler;
+    int mScope;
+
+public:
+    ProfileScope(FrameProfiler* profiler, int scope) : mProfiler(profiler), mScope(scope)
+    {
+        if(mProfiler) {
+            mProfiler->BeginScope(mScope);
+        }
+    }
+
+    ~ProfileScope()
+    {
+        if(mProfiler) {
+            mProfiler->EndScope(mScope);
+        }
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator = (const ProfileScope&) = delete;
+};
+
+#endif /* profiler_hpp */
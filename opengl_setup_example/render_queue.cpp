@@ -0,0 +1,228 @@
+//
+//  render_queue.cpp
+//  opengl_setup_example
+//
+
+#include "render_queue.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "model_object.h"
+#include "frame_state.h"
+#include "uniform_buffers.h"
+#include "gl_state.h"
+#include "gl_backend.h"
+#include "mathutil.h"
+#include "dbgutils.h"
+
+// Opaque depth is quantized to kCoarseDepthBits + kFineDepthBits and split between the two fields.
+constexpr int kCoarseDepthBits = 4;
+constexpr int kFineDepthBits = 17;
+constexpr int kTransparentDepthBits = 24;
+
+static uint64_t QuantizeDepth(float depth, float zNear, float zFar, int bits)
+{
+    float t = TClip((depth - zNear) / (zFar - zNear), 0.0f, 1.0f);
+    uint64_t maxValue = (1ull << bits) - 1;
+    return (uint64_t)(t * (double)maxValue);
+}
+
+static uint64_t Field(uint64_t value, int bits, int shift)
+{
+    return (value & ((1ull << bits) - 1)) << shift;
+}
+
+uint64_t RenderQueue::MakeSortKey(const DrawPacket& packet, float zNear, float zFar)
+{
+    uint64_t key = 0;
+    if(!packet.transparent) {
+        uint64_t depth = QuantizeDepth(packet.depth, zNear, zFar, kCoarseDepthBits + kFineDepthBits);
+        key |= Field(depth >> kFineDepthBits, kCoarseDepthBits, 59);
+        key |= Field(packet.program, 8, 51);
+        key |= Field(packet.textureID, 12, 39);
+        key |= Field(packet.vertexArray, 12, 27);
+        key |= Field(packet.materialSlot, 10, 17);
+        key |= Field(depth, kFineDepthBits, 0);
+    } else {
+        uint64_t maxDepth = (1ull << kTransparentDepthBits) - 1;
+        uint64_t depth = QuantizeDepth(packet.depth, zNear, zFar, kTransparentDepthBits);
+        key |= 1ull << 63;
+        key |= Field(maxDepth - depth, kTransparentDepthBits, 39);
+        key |= Field(packet.program, 8, 31);
+        key |= Field(packet.textureID, 12, 19);
+        key |= Field(packet.vertexArray, 12, 7);
+        key |= Field(packet.materialSlot, 7, 0);
+    }
+    return key;
+}
+
+int RenderQueue::CountStateChanges(const std::vector<DrawPacket>& packets)
+{
+    int changes = 0;
+    const DrawPacket* prev = nullptr;
+    for(const DrawPacket& packet : packets) {
+        // The first draw binds everything.
+        changes += (!prev || packet.program != prev->program);
+        changes += (!prev || packet.vertexArray != prev->vertexArray);
+        changes += (!prev || packet.textureID != prev->textureID);
+        changes += (!prev || packet.materialSlot != prev->materialSlot);
+        prev = &packet;
+    }
+    return changes;
+}
+
+void RenderQueue::Clear(void)
+{
+    mPackets.clear();
+    mStats = RenderQueueStats();
+}
+
+void RenderQueue::Add(const ModelObject& obj, GLuint program, const glm::mat4& viewMatrix)
+{
+    const MeshGeometry& geom = *obj.geometry;
+    glm::vec4 center = viewMatrix * obj.modelMatrixStack.top() * glm::vec4(geom.localBounds.sphereCenter, 1.0f);
+
+    DrawPacket packet;
+    packet.object = &obj;
+    packet.program = program;
+    packet.vertexArray = geom.vertexArray;
+    packet.textureID = obj.textureID;
+    packet.materialSlot = obj.materialSlot;
+    // camera looks down -z.
+    packet.depth = -center.z;
+    packet.transparent = obj.isTransparent;
+    AddPacket(packet);
+}
+
+void RenderQueue::AddPacket(const DrawPacket& packet)
+{
+    mPackets.push_back(packet);
+    DrawPacket& added = mPackets.back();
+    added.sortKey = MakeSortKey(added, mNear, mFar);
+    added.sequence = (uint32_t)mPackets.size() - 1;
+}
+
+void RenderQueue::Sort(void)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    mStats.packets = (int)mPackets.size();
+    mStats.stateChangesUnsorted = CountStateChanges(mPackets);
+
+    std::sort(mPackets.begin(), mPackets.end(), [](const DrawPacket& a, const DrawPacket& b) {
+        if(a.sortKey != b.sortKey) {
+            return a.sortKey < b.sortKey;
+        }
+        return a.sequence < b.sequence;
+    });
+
+    mStats.stateChangesSorted = CountStateChanges(mPackets);
+    auto end = std::chrono::high_resolution_clock::now();
+    mStats.sortMillis = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int RenderQueue::Submit(FrameState* frameState)
+{
+    GLStateCache* state = frameState->glState;
+    const DrawPacket* current = nullptr;
+    bool blending = false;
+    int drawCalls = 0;
+
+    for(const DrawPacket& packet : mPackets) {
+        if(packet.transparent && !blending) {
+            state->Enable(GL_BLEND);
+            state->Backend().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            // transparent objects are depth tested against the opaque ones but do not hide each other.
+            state->DepthMask(GL_FALSE);
+            blending = true;
+        }
+
+        if(!current || packet.program != current->program) {
+            state->UseProgram(packet.program);
+            mStats.programBinds++;
+        }
+        if(!current || packet.vertexArray != current->vertexArray) {
+            state->BindVertexArray(packet.vertexArray);
+            mStats.vertexArrayBinds++;
+        }
+        if(!current || packet.textureID != current->textureID) {
+            state->ActiveTexture(GL_TEXTURE0);
+            state->BindTexture(GL_TEXTURE_2D, packet.textureID);
+            mStats.textureBinds++;
+        }
+        if(!current || packet.materialSlot != current->materialSlot) {
+            frameState->uniforms->BindMaterial(packet.materialSlot);
+            mStats.materialBinds++;
+        }
+        frameState->uniforms->BindObject(packet.object->transformSlot);
+
+        DrawGeometryElements(state->Backend(), *packet.object->geometry);
+        drawCalls++;
+        current = &packet;
+    }
+
+    if(blending) {
+        state->DepthMask(GL_TRUE);
+        state->Disable(GL_BLEND);
+    }
+    return drawCalls;
+}
+
+
+bool RenderQueue::Test(void)
+{
+    RenderQueue queue(0.1f, 100.0f);
+
+    // Insertion order alternates textures and programs so it is as bad as it gets.
+    auto packet = [](GLuint program, GLuint vertexArray, GLuint texture, int material, float depth, bool transparent) {
+        DrawPacket p;
+        p.object = nullptr;
+        p.program = program;
+        p.vertexArray = vertexArray;
+        p.textureID = texture;
+        p.materialSlot = material;
+        p.depth = depth;
+        p.transparent = transparent;
+        return p;
+    };
+    queue.AddPacket(packet(1, 5, 10, 0, 4.0f, false));
+    queue.AddPacket(packet(2, 6, 11, 1, 4.5f, false));
+    queue.AddPacket(packet(1, 5, 10, 0, 4.2f, false));
+    queue.AddPacket(packet(2, 6, 11, 1, 4.1f, false));
+    queue.AddPacket(packet(1, 7, 12, 0, 8.0f, true));
+    queue.AddPacket(packet(1, 7, 12, 0, 30.0f, true));
+    // far opaque object in a later depth band.
+    queue.AddPacket(packet(1, 5, 10, 0, 90.0f, false));
+    queue.Sort();
+
+    const std::vector<DrawPacket>& sorted = queue.Packets();
+    DbgAssert(sorted.size() == 7);
+
+    // Opaque first, the near band grouped by state with front to back inside each group.
+    DbgAssert(sorted[0].sequence == 0 && sorted[1].sequence == 2);
+    DbgAssert(sorted[2].sequence == 3 && sorted[3].sequence == 1);
+    DbgAssert(sorted[4].sequence == 6);
+    // then transparent back to front.
+    DbgAssert(sorted[5].transparent && sorted[5].depth == 30.0f);
+    DbgAssert(sorted[6].transparent && sorted[6].depth == 8.0f);
+
+    const RenderQueueStats& stats = queue.Stats();
+    DbgAssert(stats.packets == 7);
+    DbgAssert(stats.stateChangesSorted < stats.stateChangesUnsorted);
+    DbgAssert(stats.stateChangesSorted == CountStateChanges(sorted));
+
+    // Same state in a row costs nothing after the first draw.
+    std::vector<DrawPacket> same(3, packet(1, 2, 3, 4, 1.0f, false));
+    DbgAssert(CountStateChanges(same) == 4);
+
+    // Depth outside the range still orders correctly.
+    DbgAssert(MakeSortKey(packet(1, 1, 1, 0, -5.0f, false), 0.1f, 100.0f) < MakeSortKey(packet(1, 1, 1, 0, 500.0f, false), 0.1f, 100.0f));
+
+    queue.Clear();
+    DbgAssert(queue.Packets().empty() && queue.Stats().packets == 0);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,97 @@
+//
+//  render_queue.h
+//  opengl_setup_example
+//
+
+#ifndef render_queue_hpp
+#define render_queue_hpp
+
+#include <vector>
+#include <cstdint>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class ModelObject;
+struct FrameState;
+
+// Everything needed to order and issue one draw.
+struct DrawPacket {
+    uint64_t sortKey;
+    const ModelObject* object;
+    GLuint program;
+    GLuint vertexArray;
+    GLuint textureID;
+    int materialSlot;
+    // view space distance to the object's bounding sphere center.
+    float depth;
+    bool transparent;
+    // insertion order, breaks ties so sorting is deterministic.
+    uint32_t sequence;
+};
+
+struct RenderQueueStats {
+    int packets;
+    // program, vertex array, texture and material changes if drawn in insertion order.
+    int stateChangesUnsorted;
+    // the same after sorting, which is what Submit actually binds.
+    int stateChangesSorted;
+    int programBinds;
+    int vertexArrayBinds;
+    int textureBinds;
+    int materialBinds;
+    double sortMillis;
+
+    RenderQueueStats() : packets(0), stateChangesUnsorted(0), stateChangesSorted(0), programBinds(0),
+        vertexArrayBinds(0), textureBinds(0), materialBinds(0), sortMillis(0) {}
+};
+
+// Collects the frame's draws, sorts them by a 64 bit key and submits them skipping
+// binds of state that is already current.
+//
+// Opaque key, high to low bits:
+//   1 pass (0) | 4 coarse depth | 8 program | 12 texture | 12 vertex array | 10 material | 17 fine depth
+// so opaque draws go roughly front to back and within each depth band are grouped by state.
+// Transparent key:
+//   1 pass (1) | 24 inverted depth | 8 program | 12 texture | 12 vertex array | 7 material
+// so they come after every opaque draw and go strictly back to front.
+// GL names are masked to their field width, a collision only costs some extra binds.
+class RenderQueue {
+private:
+    std::vector<DrawPacket> mPackets;
+    float mNear;
+    float mFar;
+    RenderQueueStats mStats;
+
+public:
+    // depths between zNear and zFar are spread over the depth bits.
+    RenderQueue(float zNear, float zFar) : mNear(zNear), mFar(zFar) {}
+
+    // Empties the queue and resets the stats for a new frame.
+    void Clear(void);
+
+    // Queues obj drawn with program. obj needs a transform slot for this frame.
+    void Add(const ModelObject& obj, GLuint program, const glm::mat4& viewMatrix);
+    // Queues a packet with its state and depth filled in, the key and sequence are set here.
+    void AddPacket(const DrawPacket& packet);
+
+    static uint64_t MakeSortKey(const DrawPacket& packet, float zNear, float zFar);
+    // Number of state changes needed to draw packets in their current order.
+    static int CountStateChanges(const std::vector<DrawPacket>& packets);
+
+    // Sorts by key and records the state changes before and after.
+    void Sort(void);
+
+    // Issues the queued draws in order. Returns the number of draw calls.
+    int Submit(FrameState* frameState);
+
+    const std::vector<DrawPacket>& Packets(void) const { return mPackets; }
+    const RenderQueueStats& Stats(void) const { return mStats; }
+
+    static bool Test(void);
+};
+
+#endif /* render_queue_hpp */
@@ -6,6 +6,7 @@
 //
 
 #include "shaders.h"
+#include "trace.h"
 
 #include <iostream>
 #include <vector>
@@ -50,6 +51,7 @@ static std::string LoadShaderFile(const char* shaderPath)
 
 bool InitShader(GLuint& outProgram, const char* vertexShaderPath, const char* fragmentShaderPath)
 {
+    TRACE_FUNCTION("gl");
     string vertexShaderSource = LoadShaderFile(vertexShaderPath);
     string fragmentShaderSource = LoadShaderFile(fragmentShaderPath);
     
@@ -0,0 +1,111 @@
+//
+//  simd.h
+//  opengl_setup_example
+//
+
+#ifndef simd_hpp
+#define simd_hpp
+
+// Small 4 wide float vector over SSE on Intel, NEON on Apple Silicon, or plain
+// arrays otherwise. Only the operations the batch kernels need are here.
+
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+struct Float4 {
+#if SIMD_SSE
+    __m128 v;
+#elif SIMD_NEON
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+};
+
+#if SIMD_SSE
+
+inline Float4 Load4(const float* p) { return { _mm_loadu_ps(p) }; }
+inline void Store4(float* p, Float4 a) { _mm_storeu_ps(p, a.v); }
+inline Float4 Set4(float s) { return { _mm_set1_ps(s) }; }
+inline Float4 operator + (Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Float4 operator - (Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Float4 operator * (Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Float4 Min4(Float4 a, Float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Float4 Max4(Float4 a, Float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+// comparisons return all bits set in lanes where true.
+inline Float4 CmpLt4(Float4 a, Float4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline Float4 CmpLe4(Float4 a, Float4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline Float4 Or4(Float4 a, Float4 b) { return { _mm_or_ps(a.v, b.v) }; }
+inline Float4 And4(Float4 a, Float4 b) { return { _mm_and_ps(a.v, b.v) }; }
+// lanes of a where mask is set, b elsewhere.
+inline Float4 Select4(Float4 mask, Float4 a, Float4 b) {
+    return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) };
+}
+// lane i true sets bit i.
+inline int MoveMask4(Float4 a) { return _mm_movemask_ps(a.v); }
+// lanes converted to int toward zero, for lanes in int range.
+inline void StoreTruncated4(int32_t* p, Float4 a) { _mm_storeu_si128((__m128i*)p, _mm_cvttps_epi32(a.v)); }
+
+#elif SIMD_NEON
+
+inline Float4 Load4(const float* p) { return { vld1q_f32(p) }; }
+inline void Store4(float* p, Float4 a) { vst1q_f32(p, a.v); }
+inline Float4 Set4(float s) { return { vdupq_n_f32(s) }; }
+inline Float4 operator + (Float4 a, Float4 b) { return { vaddq_f32(a.v, b.v) }; }
+inline Float4 operator - (Float4 a, Float4 b) { return { vsubq_f32(a.v, b.v) }; }
+inline Float4 operator * (Float4 a, Float4 b) { return { vmulq_f32(a.v, b.v) }; }
+inline Float4 Min4(Float4 a, Float4 b) { return { vminq_f32(a.v, b.v) }; }
+inline Float4 Max4(Float4 a, Float4 b) { return { vmaxq_f32(a.v, b.v) }; }
+inline Float4 CmpLt4(Float4 a, Float4 b) { return { vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)) }; }
+inline Float4 CmpLe4(Float4 a, Float4 b) { return { vreinterpretq_f32_u32(vcleq_f32(a.v, b.v)) }; }
+inline Float4 Or4(Float4 a, Float4 b) {
+    return { vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) };
+}
+inline Float4 And4(Float4 a, Float4 b) {
+    return { vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))) };
+}
+inline Float4 Select4(Float4 mask, Float4 a, Float4 b) {
+    return { vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v) };
+}
+inline int MoveMask4(Float4 a) {
+    static const int32_t kShifts[4] = {0, 1, 2, 3};
+    uint32x4_t bits = vshrq_n_u32(vreinterpretq_u32_f32(a.v), 31);
+    return (int)vaddvq_u32(vshlq_u32(bits, vld1q_s32(kShifts)));
+}
+inline void StoreTruncated4(int32_t* p, Float4 a) { vst1q_s32(p, vcvtq_s32_f32(a.v)); }
+
+#else
+
+inline Float4 Load4(const float* p) { return { {p[0], p[1], p[2], p[3]} }; }
+inline void Store4(float* p, Float4 a) { for(int i = 0; i < 4; i++) p[i] = a.v[i]; }
+inline Float4 Set4(float s) { return { {s, s, s, s} }; }
+#define SIMD_SCALAR_OP(expr) Float4 r; for(int i = 0; i < 4; i++) r.v[i] = (expr); return r;
+inline Float4 operator + (Float4 a, Float4 b) { SIMD_SCALAR_OP(a.v[i] + b.v[i]) }
+inline Float4 operator - (Float4 a, Float4 b) { SIMD_SCALAR_OP(a.v[i] - b.v[i]) }
+inline Float4 operator * (Float4 a, Float4 b) { SIMD_SCALAR_OP(a.v[i] * b.v[i]) }
+inline Float4 Min4(Float4 a, Float4 b) { SIMD_SCALAR_OP(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+inline Float4 Max4(Float4 a, Float4 b) { SIMD_SCALAR_OP(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+// masks are stored as 1.0 or 0.0 in the scalar version.
+inline Float4 CmpLt4(Float4 a, Float4 b) { SIMD_SCALAR_OP(a.v[i] < b.v[i] ? 1.0f : 0.0f) }
+inline Float4 CmpLe4(Float4 a, Float4 b) { SIMD_SCALAR_OP(a.v[i] <= b.v[i] ? 1.0f : 0.0f) }
+inline Float4 Or4(Float4 a, Float4 b) { SIMD_SCALAR_OP((a.v[i] != 0.0f || b.v[i] != 0.0f) ? 1.0f : 0.0f) }
+inline Float4 And4(Float4 a, Float4 b) { SIMD_SCALAR_OP((a.v[i] != 0.0f && b.v[i] != 0.0f) ? 1.0f : 0.0f) }
+inline Float4 Select4(Float4 mask, Float4 a, Float4 b) { SIMD_SCALAR_OP(mask.v[i] != 0.0f ? a.v[i] : b.v[i]) }
+#undef SIMD_SCALAR_OP
+inline int MoveMask4(Float4 a) {
+    int m = 0;
+    for(int i = 0; i < 4; i++) if(a.v[i] != 0.0f) m |= 1 << i;
+    return m;
+}
+inline void StoreTruncated4(int32_t* p, Float4 a) { for(int i = 0; i < 4; i++) p[i] = (int32_t)a.v[i]; }
+
+#endif
+
+#endif /* simd_hpp */
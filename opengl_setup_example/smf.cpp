@@ -1,5 +1,6 @@
 #include "smf.h"
 #include "dbgutils.h"
+#include "trace.h"
 
 #include <iostream>
 #include <sstream>
@@ -24,6 +25,7 @@ static Triangle TriangleFromLineString(const std::string s)
 // Read an SMF file containing triangles.
 bool ReadSMF(std::istream &is, std::vector<Vector3>& out_verts, std::vector<Triangle>& out_triangles)
 {
+    TRACE_FUNCTION("io");
     out_verts.clear();
     out_triangles.clear();
 
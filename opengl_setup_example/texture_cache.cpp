@@ -0,0 +1,379 @@
+//
+//  texture_cache.cpp
+//  opengl_setup_example
+//
+
+#include "texture_cache.h"
+
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mathutil.h"
+#include "dbgutils.h"
+
+// "PTXC" read as a little endian word, a file from a machine of the other order fails it.
+constexpr uint32_t kTextureFileMagic = 0x43585450;
+// the pixels start on a multiple of this after the header and key.
+constexpr size_t kPixelAlignment = 16;
+
+struct TextureFileHeader {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t width, height;
+    uint16_t channels;
+    uint16_t levels;
+    uint32_t keyBytes;
+    // what the texture took to make, so a hit knows what it saved.
+    double generateMillis;
+};
+
+static size_t PixelOffset(size_t keyBytes)
+{
+    return (sizeof(TextureFileHeader) + keyBytes + kPixelAlignment - 1) / kPixelAlignment * kPixelAlignment;
+}
+
+static size_t ChainBytes(u_int32_t width, u_int32_t height, u_int16_t channels, int levelCount)
+{
+    size_t bytes = 0;
+    for(int level = 0; level < levelCount; level++) {
+        bytes += TextureLevels::LevelBytes(width, height, channels);
+        width = TMax(width / 2, 1u);
+        height = TMax(height / 2, 1u);
+    }
+    return bytes;
+}
+
+// 64 bit FNV-1a, enough to spread the keys over file names. The key in the file settles collisions.
+static uint64_t HashKey(const std::string& key)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(char c : key) {
+        hash ^= (uint8_t)c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static double MillisSince(std::chrono::high_resolution_clock::time_point start)
+{
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+
+TextureLevels::TextureLevels()
+    : mMapping(nullptr), mMappingBytes(0), mChannels(0)
+{
+}
+
+TextureLevels::~TextureLevels()
+{
+    if(mMapping) {
+        munmap(mMapping, mMappingBytes);
+    }
+}
+
+size_t TextureLevels::LevelBytes(u_int32_t width, u_int32_t height, u_int16_t channels)
+{
+    size_t rowBytes = ((size_t)width * channels + 3) & ~(size_t)3;
+    return rowBytes * height;
+}
+
+int TextureLevels::FullChainLength(u_int32_t width, u_int32_t height)
+{
+    int levels = 1;
+    while(width > 1 || height > 1) {
+        width = TMax(width / 2, 1u);
+        height = TMax(height / 2, 1u);
+        levels++;
+    }
+    return levels;
+}
+
+void TextureLevels::SetLevels(const uint8_t* pixels, u_int32_t width, u_int32_t height, int levelCount)
+{
+    mLevels.clear();
+    for(int level = 0; level < levelCount; level++) {
+        Level entry;
+        entry.pixels = pixels;
+        entry.width = width;
+        entry.height = height;
+        entry.rowBytes = (u_int32_t)(LevelBytes(width, 1, mChannels));
+        mLevels.push_back(entry);
+
+        pixels += LevelBytes(width, height, mChannels);
+        width = TMax(width / 2, 1u);
+        height = TMax(height / 2, 1u);
+    }
+}
+
+std::unique_ptr<TextureLevels> TextureLevels::FromImage(const RGBImageBuffer& image, bool withMips)
+{
+    std::unique_ptr<TextureLevels> levels(new TextureLevels());
+    const u_int16_t channels = image.Channels();
+    const int levelCount = withMips ? FullChainLength(image.Width(), image.Height()) : 1;
+    levels->mChannels = channels;
+    levels->mOwned.resize(ChainBytes(image.Width(), image.Height(), channels, levelCount));
+    levels->SetLevels(levels->mOwned.data(), image.Width(), image.Height(), levelCount);
+
+    uint8_t* base = levels->mOwned.data();
+    const Level& top = levels->mLevels[0];
+    for(u_int32_t y = 0; y < top.height; y++) {
+        memcpy(base + y * top.rowBytes, image.Pixels() + y * image.RowBytes(), top.width * channels);
+    }
+
+    // each level is a 2x2 box filter of the one above, an odd last row or column is
+    // averaged with itself.
+    for(int level = 1; level < levelCount; level++) {
+        const Level& src = levels->mLevels[level - 1];
+        const Level& dst = levels->mLevels[level];
+        uint8_t* dstPixels = base + (dst.pixels - base);
+        for(u_int32_t y = 0; y < dst.height; y++) {
+            const uint8_t* row0 = src.pixels + TMin(y * 2, src.height - 1) * src.rowBytes;
+            const uint8_t* row1 = src.pixels + TMin(y * 2 + 1, src.height - 1) * src.rowBytes;
+            uint8_t* out = dstPixels + y * dst.rowBytes;
+            for(u_int32_t x = 0; x < dst.width; x++) {
+                u_int32_t x0 = TMin(x * 2, src.width - 1) * channels;
+                u_int32_t x1 = TMin(x * 2 + 1, src.width - 1) * channels;
+                for(u_int16_t c = 0; c < channels; c++) {
+                    *out++ = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+                }
+            }
+        }
+    }
+    return levels;
+}
+
+
+TextureCache::TextureCache(const std::string& directory)
+    : mDirectory(directory), mHits(0), mMisses(0), mHitGenerateMillis(0), mHitLoadMillis(0), mMissMillis(0)
+{
+}
+
+std::string TextureCache::PathForKey(const std::string& key) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.ptex", (unsigned long long)HashKey(key));
+    return mDirectory + "/" + name;
+}
+
+std::unique_ptr<TextureLevels> TextureCache::Load(const std::string& path, const std::string& key, bool withMips,
+                                                  double& generateMillis) const
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return nullptr;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(TextureFileHeader)) {
+        close(fd);
+        return nullptr;
+    }
+    size_t fileBytes = (size_t)info.st_size;
+    void* mapping = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping holds its own reference to the file.
+    close(fd);
+    if(mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    std::unique_ptr<TextureLevels> levels(new TextureLevels());
+    levels->mMapping = mapping;
+    levels->mMappingBytes = fileBytes;
+
+    TextureFileHeader header;
+    memcpy(&header, mapping, sizeof(header));
+    const uint8_t* bytes = (const uint8_t*)mapping;
+    if(header.magic != kTextureFileMagic || header.format != kFormatVersion ||
+       header.width == 0 || header.height == 0 || header.channels == 0 || header.channels > 4 ||
+       header.keyBytes != key.size() || PixelOffset(header.keyBytes) > fileBytes ||
+       memcmp(bytes + sizeof(header), key.data(), key.size()) != 0) {
+        return nullptr;
+    }
+    int expectedLevels = withMips ? TextureLevels::FullChainLength(header.width, header.height) : 1;
+    if(header.levels != expectedLevels ||
+       PixelOffset(header.keyBytes) + ChainBytes(header.width, header.height, header.channels, header.levels) != fileBytes) {
+        return nullptr;
+    }
+
+    levels->mChannels = header.channels;
+    levels->SetLevels(bytes + PixelOffset(header.keyBytes), header.width, header.height, header.levels);
+    generateMillis = header.generateMillis;
+    return levels;
+}
+
+bool TextureCache::Save(const std::string& path, const std::string& key, const TextureLevels& levels,
+                        double generateMillis) const
+{
+    std::error_code error;
+    std::filesystem::create_directories(mDirectory, error);
+    if(error) {
+        std::cerr << "Unable to create texture cache directory " << mDirectory << ": " << error.message() << std::endl;
+        return false;
+    }
+
+    const TextureLevels::Level& top = levels.GetLevel(0);
+    TextureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = kTextureFileMagic;
+    header.format = kFormatVersion;
+    header.width = top.width;
+    header.height = top.height;
+    header.channels = levels.Channels();
+    header.levels = (uint16_t)levels.LevelCount();
+    header.keyBytes = (uint32_t)key.size();
+    header.generateMillis = generateMillis;
+
+    // written beside the real name then renamed over it, so readers see all of a file or none.
+    std::string tempPath = path + "." + std::to_string(getpid()) + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write(key.data(), key.size());
+        const char padding[kPixelAlignment] = {};
+        file.write(padding, PixelOffset(key.size()) - sizeof(header) - key.size());
+        for(int level = 0; level < levels.LevelCount(); level++) {
+            const TextureLevels::Level& entry = levels.GetLevel(level);
+            file.write((const char*)entry.pixels, entry.rowBytes * entry.height);
+        }
+        if(!file) {
+            std::cerr << "Unable to write texture cache file " << tempPath << std::endl;
+            file.close();
+            std::remove(tempPath.c_str());
+            return false;
+        }
+    }
+    if(std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "Unable to rename texture cache file " << tempPath << std::endl;
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<TextureLevels> TextureCache::Get(const std::string& key, bool withMips, const GenerateFunc& generate)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    // with and without mips are separate files, so asking for one never replaces the other.
+    const std::string fileKey = withMips ? key + "/mips" : key;
+    std::string path;
+    if(Enabled()) {
+        path = PathForKey(fileKey);
+        double generateMillis = 0;
+        std::unique_ptr<TextureLevels> levels = Load(path, fileKey, withMips, generateMillis);
+        if(levels) {
+            mHits++;
+            mHitGenerateMillis += generateMillis;
+            mHitLoadMillis += MillisSince(start);
+            return levels;
+        }
+    }
+
+    mMisses++;
+    std::unique_ptr<RGBImageBuffer> image(generate());
+    if(!image) {
+        return nullptr;
+    }
+    std::unique_ptr<TextureLevels> levels = TextureLevels::FromImage(*image, withMips);
+    double generateMillis = MillisSince(start);
+    if(Enabled()) {
+        Save(path, fileKey, *levels, generateMillis);
+    }
+    mMissMillis += MillisSince(start);
+    return levels;
+}
+
+void TextureCache::PrintStats(void) const
+{
+    if(!Enabled()) {
+        std::cout << "Texture cache: off, " << mMisses << " generated in " << mMissMillis << " ms" << std::endl;
+        return;
+    }
+    std::cout << "Texture cache: " << mHits << " hits, " << mMisses << " misses, " << SavedMillis() << " ms saved, "
+        << mMissMillis << " ms generating, in " << mDirectory << std::endl;
+}
+
+
+bool TextureCache::Test(void)
+{
+    namespace fs = std::filesystem;
+    fs::path directory = fs::temp_directory_path() / ("texture_cache_test_" + std::to_string(getpid()));
+    fs::remove_all(directory);
+
+    // odd sizes, so rows are padded and the mips have odd edges.
+    int generated = 0;
+    auto generate = [&generated]() {
+        generated++;
+        RGBImageBuffer* image = new RGBImageBuffer(5, 3);
+        for(u_int32_t y = 0; y < image->Height(); y++) {
+            for(u_int32_t x = 0; x < image->Width() * 3; x++) {
+                image->Pixels()[y * image->RowBytes() + x] = (uint8_t)(y * 40 + x * 7);
+            }
+        }
+        return image;
+    };
+
+    TextureCache cold(directory.string());
+    std::unique_ptr<TextureLevels> made = cold.Get("test/pattern", true, generate);
+    DbgAssert(made && !made->Mapped());
+    DbgAssert(generated == 1 && cold.Misses() == 1 && cold.Hits() == 0);
+    DbgAssert(made->LevelCount() == 3);
+    DbgAssert(made->GetLevel(0).rowBytes == 16);
+    DbgAssert(made->GetLevel(1).width == 2 && made->GetLevel(1).height == 1);
+    DbgAssert(made->GetLevel(2).width == 1 && made->GetLevel(2).height == 1);
+    const TextureLevels::Level& top = made->GetLevel(0);
+    int expected = (top.pixels[0] + top.pixels[3] + top.pixels[top.rowBytes] + top.pixels[top.rowBytes + 3] + 2) / 4;
+    DbgAssert(made->GetLevel(1).pixels[0] == expected);
+
+    // A new cache on the same directory, as on the next run, maps what the first one wrote.
+    TextureCache warm(directory.string());
+    std::unique_ptr<TextureLevels> mapped = warm.Get("test/pattern", true, generate);
+    DbgAssert(mapped && mapped->Mapped());
+    DbgAssert(generated == 1 && warm.Hits() == 1 && warm.Misses() == 0);
+    DbgAssert(mapped->LevelCount() == made->LevelCount());
+    for(int level = 0; level < made->LevelCount(); level++) {
+        const TextureLevels::Level& a = made->GetLevel(level);
+        const TextureLevels::Level& b = mapped->GetLevel(level);
+        DbgAssert(a.width == b.width && a.height == b.height && a.rowBytes == b.rowBytes);
+        DbgAssert(memcmp(a.pixels, b.pixels, a.rowBytes * a.height) == 0);
+    }
+
+    // Without mips and under another key are different files.
+    std::unique_ptr<TextureLevels> single = warm.Get("test/pattern", false, generate);
+    DbgAssert(single && single->LevelCount() == 1 && generated == 2);
+    warm.Get("test/other", true, generate);
+    DbgAssert(generated == 3 && warm.Misses() == 2);
+    DbgAssert(warm.Get("test/pattern", true, generate)->Mapped());
+    DbgAssert(warm.Get("test/pattern", false, generate)->Mapped());
+    DbgAssert(generated == 3 && warm.Hits() == 3);
+
+    // A file cut short is a miss, and gets written again.
+    std::string path = warm.PathForKey("test/pattern/mips");
+    fs::resize_file(path, fs::file_size(path) - 1);
+    DbgAssert(!warm.Get("test/pattern", true, generate)->Mapped());
+    DbgAssert(generated == 4);
+    DbgAssert(warm.Get("test/pattern", true, generate)->Mapped());
+    DbgAssert(generated == 4);
+
+    // Off, it always generates and writes nothing.
+    TextureCache off("");
+    off.Get("test/pattern", true, generate);
+    off.Get("test/pattern", true, generate);
+    DbgAssert(generated == 6 && off.Misses() == 2 && off.Hits() == 0);
+
+    fs::remove_all(directory);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
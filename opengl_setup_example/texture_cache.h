@@ -0,0 +1,114 @@
+//
+//  texture_cache.h
+//  opengl_setup_example
+//
+
+#ifndef texture_cache_hpp
+#define texture_cache_hpp
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "image_buffer.h"
+
+// A texture's pixels and, when asked for, its mip levels down to 1x1. Rows are padded
+// to 4 bytes so every level uploads with GL's default unpack alignment. The pixels are
+// either owned or a read only mapping of a cache file, which lasts as long as this does.
+class TextureLevels {
+public:
+    struct Level {
+        const uint8_t* pixels;
+        u_int32_t width, height;
+        u_int32_t rowBytes;
+    };
+
+private:
+    std::vector<uint8_t> mOwned;
+    void* mMapping;
+    size_t mMappingBytes;
+    std::vector<Level> mLevels;
+    u_int16_t mChannels;
+
+    TextureLevels();
+    // Lays out the levels after the first from offset 0 of pixels.
+    void SetLevels(const uint8_t* pixels, u_int32_t width, u_int32_t height, int levelCount);
+
+    friend class TextureCache;
+
+public:
+    ~TextureLevels();
+
+    TextureLevels(const TextureLevels&) = delete;
+    TextureLevels& operator = (const TextureLevels&) = delete;
+
+    // Copies image, then box filters each level from the one before when withMips is set.
+    static std::unique_ptr<TextureLevels> FromImage(const RGBImageBuffer& image, bool withMips);
+
+    // Bytes of a level of the given size, with its rows padded.
+    static size_t LevelBytes(u_int32_t width, u_int32_t height, u_int16_t channels);
+    // 1 plus the halvings it takes to reach 1x1.
+    static int FullChainLength(u_int32_t width, u_int32_t height);
+
+    int LevelCount(void) const { return (int)mLevels.size(); }
+    const Level& GetLevel(int level) const { return mLevels[level]; }
+    u_int16_t Channels(void) const { return mChannels; }
+    bool Mapped(void) const { return mMapping != nullptr; }
+};
+
+// Generated textures kept on disk between runs. Each file is named for a hash of its key,
+// which should hold everything the pixels depend on, see ProcTextureKey. The file has a
+// small header, the key to check against, and then each level's pixels as they are laid
+// out in memory, so a hit maps the file and uses it as it is.
+//
+// A file that is missing, cut short or for another key is a miss. The texture is made
+// again and the file replaced, written to the side and renamed so a reader never sees
+// half of one.
+class TextureCache {
+public:
+    // makes the texture on a miss, the cache takes ownership.
+    typedef std::function<RGBImageBuffer*(void)> GenerateFunc;
+
+    // in every file's header, bump it when the layout changes.
+    static constexpr uint32_t kFormatVersion = 1;
+
+private:
+    std::string mDirectory;
+    int mHits;
+    int mMisses;
+    // what the hits' textures took to make when they were written, and to load now.
+    double mHitGenerateMillis;
+    double mHitLoadMillis;
+    double mMissMillis;
+
+    std::string PathForKey(const std::string& key) const;
+    std::unique_ptr<TextureLevels> Load(const std::string& path, const std::string& key, bool withMips,
+                                        double& generateMillis) const;
+    bool Save(const std::string& path, const std::string& key, const TextureLevels& levels, double generateMillis) const;
+
+public:
+    // Keeps its files in directory, made on the first miss. An empty directory turns the
+    // cache off, every Get generates and nothing is written.
+    explicit TextureCache(const std::string& directory);
+
+    // The texture for key, mapped from its file or generated and saved. withMips is part
+    // of what is looked up, a file without mips does not satisfy a request for them.
+    // Null if generate returns null.
+    std::unique_ptr<TextureLevels> Get(const std::string& key, bool withMips, const GenerateFunc& generate);
+
+    bool Enabled(void) const { return !mDirectory.empty(); }
+    const std::string& Directory(void) const { return mDirectory; }
+    int Hits(void) const { return mHits; }
+    int Misses(void) const { return mMisses; }
+    // Time the hits would have taken to generate less what loading them took.
+    double SavedMillis(void) const { return mHitGenerateMillis - mHitLoadMillis; }
+    // Time spent generating and saving the misses.
+    double MissMillis(void) const { return mMissMillis; }
+    void PrintStats(void) const;
+
+    static bool Test(void);
+};
+
+#endif /* texture_cache_hpp */
@@ -6,28 +6,88 @@
 //
 
 #include "textures.h"
+#include "gl_backend.h"
+#include "trace.h"
+#include "mathutil.h"
 
+#include <cstring>
 
-GLuint CreateTextureFromImage(RGBImageBuffer* imageBuffer)
+
+GLuint CreateTextureFromImage(GLBackend& backend, RGBImageBuffer* imageBuffer)
 {
-    GLuint textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    TRACE_FUNCTION("gl");
+    GLuint textureID = backend.GenTexture();
+    backend.BindTexture(GL_TEXTURE_2D, textureID);
 
     // Give the image to OpenGL
-    glTexImage2D(GL_TEXTURE_2D, 0,GL_RGB,
-                 imageBuffer->Width(), imageBuffer->Height(),
-                 0,
-                 GL_RGB,
-                 GL_UNSIGNED_BYTE, imageBuffer->Pixels());
+    backend.TexImage2D(GL_TEXTURE_2D, 0, GL_RGB,
+                       imageBuffer->Width(), imageBuffer->Height(),
+                       GL_RGB,
+                       GL_UNSIGNED_BYTE, imageBuffer->Pixels());
+
+    backend.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    backend.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    backend.GenerateMipmap(GL_TEXTURE_2D);
+    
+    return textureID;
+}
+
+GLuint CreateTextureFromLevels(GLBackend& backend, const TextureLevels& levels)
+{
+    TRACE_FUNCTION("gl");
+    GLuint textureID = backend.GenTexture();
+    backend.BindTexture(GL_TEXTURE_2D, textureID);
+
+    const GLenum formats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    const GLenum format = formats[levels.Channels() - 1];
+    for(int level = 0; level < levels.LevelCount(); level++) {
+        const TextureLevels::Level& entry = levels.GetLevel(level);
+        backend.TexImage2D(GL_TEXTURE_2D, level, format, entry.width, entry.height,
+                           format, GL_UNSIGNED_BYTE, entry.pixels);
+    }
 
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
+    backend.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    backend.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    if(levels.LevelCount() == 1) {
+        backend.GenerateMipmap(GL_TEXTURE_2D);
+    }
     
     return textureID;
 }
 
+GLuint CreateTextureFromVirtualRegion(GLBackend& backend, VirtualTexture& virtualTexture, int level,
+                                      u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height)
+{
+    TRACE_FUNCTION("gl");
+    GLuint textureID = backend.GenTexture();
+    backend.BindTexture(GL_TEXTURE_2D, textureID);
+
+    // rows padded to 4 bytes, for GL's default unpack alignment.
+    RGBImageBuffer window(width, height, VirtualTexture::kChannels, true);
+    int mip = 0;
+    for(;;) {
+        // a window running off the end of a small level keeps black past it.
+        memset(window.Pixels(), 0, window.RowBytes() * height);
+        virtualTexture.ReadRegion(level + mip, x, y, width, height, window.Pixels(), window.RowBytes());
+        backend.TexImage2D(GL_TEXTURE_2D, mip, GL_RGB, width, height, GL_RGB, GL_UNSIGNED_BYTE, window.Pixels());
+        if((width == 1 && height == 1) || level + mip + 1 >= virtualTexture.LevelCount()) {
+            break;
+        }
+        x /= 2;
+        y /= 2;
+        width = TMax(width / 2, 1u);
+        height = TMax(height / 2, 1u);
+        window.SetSize(width, height, VirtualTexture::kChannels, true);
+        mip++;
+    }
+
+    backend.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    backend.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    backend.TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mip);
+
+    return textureID;
+}
+
 void AutoMapUV(TriangleMesh &mesh, std::vector<float>& texCoords)
 {
     double minX = mesh.GetVertices().front().x;
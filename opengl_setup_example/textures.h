@@ -12,8 +12,19 @@
 
 #include "image_buffer.h"
 #include "trianglemesh.h"
+#include "texture_cache.h"
+#include "virtual_texture.h"
 
-GLuint CreateTextureFromImage(RGBImageBuffer* imageBuffer);
+class GLBackend;
+
+GLuint CreateTextureFromImage(GLBackend& backend, RGBImageBuffer* imageBuffer);
+// Uploads every level given, and has GL make the rest when there is only the first.
+GLuint CreateTextureFromLevels(GLBackend& backend, const TextureLevels& levels);
+// Uploads a width x height window of virtual's level, from x, y, with the same window of
+// each level after it as its mips, down to where the window is 1x1. Those levels are box
+// filtered from the window's texels, so only the pages under the window are made.
+GLuint CreateTextureFromVirtualRegion(GLBackend& backend, VirtualTexture& virtualTexture, int level,
+                                      u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height);
 
 void AutoMapUV(TriangleMesh &mesh, std::vector<float>& texCoords);
 
@@ -0,0 +1,138 @@
+//
+//  thread_pool.cpp
+//  opengl_setup_example
+//
+
+#include "thread_pool.h"
+
+#include "dbgutils.h"
+#include "trace.h"
+
+ThreadPool::ThreadPool(int numWorkers)
+    : mJob(nullptr), mJobCount(0), mNextIndex(0), mGeneration(0), mActiveWorkers(0), mStopping(false)
+{
+    if(numWorkers <= 0) {
+        int hwThreads = (int)std::thread::hardware_concurrency();
+        numWorkers = hwThreads > 1 ? hwThreads - 1 : 0;
+    }
+    for(int i = 0; i < numWorkers; i++) {
+        mThreads.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mWakeCondition.notify_all();
+    for(auto& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::RunIndices(const std::function<void(int)>& job, int count)
+{
+    TRACE_ZONE("pool", "ThreadPool job");
+    int index;
+    while((index = mNextIndex.fetch_add(1)) < count) {
+        job(index);
+    }
+}
+
+void ThreadPool::WorkerLoop(void)
+{
+    TRACE_THREAD_NAME("pool worker");
+    uint64_t seenGeneration = 0;
+    for(;;) {
+        const std::function<void(int)>* job;
+        int count;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeCondition.wait(lock, [&] { return mStopping || mGeneration != seenGeneration; });
+            if(mStopping) {
+                return;
+            }
+            seenGeneration = mGeneration;
+            job = mJob;
+            count = mJobCount;
+            mActiveWorkers++;
+        }
+
+        RunIndices(*job, count);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mActiveWorkers--;
+        }
+        mDoneCondition.notify_all();
+    }
+}
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& job)
+{
+    if(count <= 0) {
+        return;
+    }
+    TRACE_FUNCTION("pool");
+    if(mThreads.empty() || count == 1) {
+        for(int i = 0; i < count; i++) {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        // A worker that woke late for the previous job may still be finishing up.
+        mDoneCondition.wait(lock, [&] { return mActiveWorkers == 0; });
+        mJob = &job;
+        mJobCount = count;
+        mNextIndex = 0;
+        mGeneration++;
+    }
+    mWakeCondition.notify_all();
+
+    RunIndices(job, count);
+
+    // Every index has been claimed, wait for the workers running the last ones.
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDoneCondition.wait(lock, [&] { return mActiveWorkers == 0; });
+}
+
+
+bool ThreadPool::Test(void)
+{
+    ThreadPool pool(3);
+    DbgAssert(pool.NumThreads() == 4);
+
+    constexpr int kCount = 1000;
+    std::vector<int> hits(kCount, 0);
+    for(int round = 0; round < 50; round++) {
+        pool.ParallelFor(kCount, [&](int i) { hits[i]++; });
+    }
+    bool allHit = true;
+    for(int i = 0; i < kCount; i++) {
+        if(hits[i] != 50) {
+            allHit = false;
+        }
+    }
+    DbgAssert(allHit);
+
+    std::atomic<long> sum(0);
+    pool.ParallelFor(kCount, [&](int i) { sum += i; });
+    DbgAssert(sum == (long)kCount * (kCount - 1) / 2);
+
+    // no workers runs everything on the caller.
+    ThreadPool serial(-1);
+    DbgAssert(serial.NumThreads() >= 1);
+    int serialCount = 0;
+    serial.ParallelFor(10, [&](int) { serialCount++; });
+    DbgAssert(serialCount == 10);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
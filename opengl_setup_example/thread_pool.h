@@ -0,0 +1,53 @@
+//
+//  thread_pool.h
+//  opengl_setup_example
+//
+
+#ifndef thread_pool_hpp
+#define thread_pool_hpp
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+// Fixed set of worker threads for data parallel loops.
+// ParallelFor blocks until every index has run; the calling thread helps out.
+class ThreadPool {
+private:
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mWakeCondition;
+    std::condition_variable mDoneCondition;
+
+    // current job, only valid while a ParallelFor call is running.
+    const std::function<void(int)>* mJob;
+    int mJobCount;
+    std::atomic<int> mNextIndex;
+    uint64_t mGeneration;
+    int mActiveWorkers;
+    bool mStopping;
+
+    void WorkerLoop(void);
+    void RunIndices(const std::function<void(int)>& job, int count);
+
+public:
+    // numWorkers of 0 uses one less than the hardware thread count, leaving a core for the caller.
+    explicit ThreadPool(int numWorkers = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator = (const ThreadPool&) = delete;
+
+    // worker threads plus the calling thread.
+    int NumThreads(void) const { return (int)mThreads.size() + 1; }
+
+    // Run job(i) for i in [0, count). Indices are handed out one at a time so uneven work balances.
+    void ParallelFor(int count, const std::function<void(int)>& job);
+
+    static bool Test(void);
+};
+
+#endif /* thread_pool_hpp */
@@ -0,0 +1,269 @@
+//
+//  trace.cpp
+//  opengl_setup_example
+//
+
+#include "trace.h"
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "dbgutils.h"
+
+std::atomic<bool> Tracer::sEnabled(false);
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    uint64_t startNanos;
+    uint64_t durationNanos;
+};
+
+// One thread's events. Only the owning thread writes events and count, readers take a
+// copy and then check count again to see what was overwritten meanwhile.
+struct TraceBuffer {
+    std::vector<TraceEvent> events;
+    std::atomic<uint64_t> count;
+    // events before this were cleared.
+    std::atomic<uint64_t> start;
+    int threadID;
+    // guarded by the registry mutex.
+    std::string threadName;
+
+    explicit TraceBuffer(int id) : events(Tracer::kEventsPerThread), count(0), start(0), threadID(id) {}
+};
+
+// Buffers live until exit, so a thread that has finished still shows up in the trace.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;
+    std::atomic<uint64_t> epoch;
+
+    TraceRegistry() : epoch(0) {}
+};
+
+static TraceRegistry& Registry(void)
+{
+    static TraceRegistry registry;
+    return registry;
+}
+
+static thread_local TraceBuffer* tBuffer = nullptr;
+
+static TraceBuffer& ThreadBuffer(void)
+{
+    if(!tBuffer) {
+        TraceRegistry& registry = Registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.push_back(std::make_unique<TraceBuffer>((int)registry.buffers.size() + 1));
+        tBuffer = registry.buffers.back().get();
+    }
+    return *tBuffer;
+}
+
+// Events from buffer that are still intact after they were copied.
+static void CopyEvents(const TraceBuffer& buffer, std::vector<TraceEvent>& out)
+{
+    const uint64_t capacity = Tracer::kEventsPerThread;
+    uint64_t count = buffer.count.load(std::memory_order_acquire);
+    uint64_t first = std::max(buffer.start.load(std::memory_order_relaxed), count > capacity ? count - capacity : 0);
+
+    size_t copyStart = out.size();
+    for(uint64_t i = first; i < count; i++) {
+        out.push_back(buffer.events[i % capacity]);
+    }
+
+    // Anything the owner wrote over while copying is gone, and so is the slot it may be
+    // writing now, which count doesn't cover yet. The fence keeps the copy's reads from
+    // moving after the load.
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t countAfter = buffer.count.load(std::memory_order_relaxed);
+    if(countAfter + 1 > capacity && countAfter + 1 - capacity > first) {
+        uint64_t torn = std::min(countAfter + 1 - capacity - first, count - first);
+        out.erase(out.begin() + copyStart, out.begin() + copyStart + torn);
+    }
+}
+
+static void WriteJSONString(std::ostream& out, const char* text)
+{
+    out << '"';
+    for(const char* c = text; *c; c++) {
+        if(*c == '"' || *c == '\\') {
+            out << '\\';
+        }
+        out << *c;
+    }
+    out << '"';
+}
+
+void Tracer::SetEnabled(bool enabled)
+{
+    uint64_t unset = 0;
+    Registry().epoch.compare_exchange_strong(unset, Now());
+    sEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+uint64_t Tracer::Now(void)
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(now).count() + 1;
+}
+
+void Tracer::Record(const char* category, const char* name, uint64_t startNanos, uint64_t endNanos)
+{
+    TraceBuffer& buffer = ThreadBuffer();
+    uint64_t index = buffer.count.load(std::memory_order_relaxed);
+    TraceEvent& event = buffer.events[index % kEventsPerThread];
+    event.category = category;
+    event.name = name;
+    event.startNanos = startNanos;
+    event.durationNanos = endNanos - startNanos;
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::SetThreadName(const char* name)
+{
+    TraceBuffer& buffer = ThreadBuffer();
+    std::lock_guard<std::mutex> lock(Registry().mutex);
+    buffer.threadName = name;
+}
+
+size_t Tracer::EventCount(void)
+{
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    size_t total = 0;
+    for(const auto& buffer : registry.buffers) {
+        uint64_t count = buffer->count.load(std::memory_order_acquire);
+        uint64_t first = std::max(buffer->start.load(std::memory_order_relaxed), count > kEventsPerThread ? count - kEventsPerThread : 0);
+        total += count - first;
+    }
+    return total;
+}
+
+void Tracer::Clear(void)
+{
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for(const auto& buffer : registry.buffers) {
+        buffer->start.store(buffer->count.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+void Tracer::WriteChromeJSON(std::ostream& out)
+{
+    TraceRegistry& registry = Registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const uint64_t epoch = registry.epoch.load();
+    const int pid = 1;
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    std::vector<TraceEvent> events;
+    for(const auto& buffer : registry.buffers) {
+        if(!buffer->threadName.empty()) {
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+                << ",\"tid\":" << buffer->threadID << ",\"args\":{\"name\":";
+            WriteJSONString(out, buffer->threadName.c_str());
+            out << "}}";
+            first = false;
+        }
+
+        events.clear();
+        CopyEvents(*buffer, events);
+        for(const TraceEvent& event : events) {
+            // microseconds from when tracing was first enabled.
+            double ts = event.startNanos > epoch ? (event.startNanos - epoch) / 1000.0 : 0.0;
+            out << (first ? "" : ",\n") << "{\"name\":";
+            WriteJSONString(out, event.name);
+            out << ",\"cat\":";
+            WriteJSONString(out, event.category);
+            out << ",\"ph\":\"X\",\"ts\":" << ts << ",\"dur\":" << event.durationNanos / 1000.0
+                << ",\"pid\":" << pid << ",\"tid\":" << buffer->threadID << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+bool Tracer::WriteChromeJSON(const char* path)
+{
+    std::ofstream out(path);
+    if(!out) {
+        std::cerr << "Unable to open trace file " << path << std::endl;
+        return false;
+    }
+    out.precision(12);
+    WriteChromeJSON(out);
+    return true;
+}
+
+static size_t CountOccurrences(const std::string& text, const std::string& pattern)
+{
+    size_t count = 0;
+    for(size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+bool Tracer::Test(void)
+{
+    bool wasEnabled = Enabled();
+    SetEnabled(false);
+    Clear();
+
+    {
+        TRACE_ZONE("test", "disabled");
+    }
+    DbgAssert(EventCount() == 0);
+
+    SetEnabled(true);
+    {
+        TRACE_ZONE("test", "outer");
+        TRACE_ZONE("test", "inner \"quoted\"");
+    }
+    std::thread worker([] {
+        TRACE_THREAD_NAME("trace test worker");
+        for(int i = 0; i < 3; i++) {
+            TRACE_FUNCTION("test");
+        }
+    });
+    worker.join();
+    DbgAssert(EventCount() == 5);
+
+    std::ostringstream json;
+    WriteChromeJSON(json);
+    std::string text = json.str();
+    DbgAssert(CountOccurrences(text, "\"ph\":\"X\"") == 5);
+    DbgAssert(text.find("\"trace test worker\"") != std::string::npos);
+    DbgAssert(text.find("inner \\\"quoted\\\"") != std::string::npos);
+    DbgAssert(text.front() == '{');
+
+    // A full buffer keeps only the newest events.
+    std::thread flood([] {
+        uint64_t now = Now();
+        for(int i = 0; i < kEventsPerThread + 10; i++) {
+            Record("test", "flood", now, now + 1);
+        }
+    });
+    flood.join();
+    DbgAssert(EventCount() == 5 + (size_t)kEventsPerThread);
+
+    Clear();
+    DbgAssert(EventCount() == 0);
+    SetEnabled(wasEnabled);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
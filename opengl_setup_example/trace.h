@@ -0,0 +1,93 @@
+//
+//  trace.h
+//  opengl_setup_example
+//
+
+#ifndef trace_hpp
+#define trace_hpp
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Define as 0 to compile every TRACE_ macro out.
+#ifndef ENABLE_TRACING
+#define ENABLE_TRACING 1
+#endif
+
+// Timeline tracing for viewing startup and frames in chrome://tracing or ui.perfetto.dev.
+//
+// Each thread writes complete zone events into its own fixed size ring buffer, with no
+// locks on the recording path, and the oldest events are overwritten once it is full.
+// WriteChromeJSON gathers every thread's buffer into Chrome trace event JSON, which
+// Perfetto also opens. Events a thread overwrites while they are being gathered are left out.
+//
+// Recording is off until SetEnabled(true). While off, a zone is one relaxed atomic load.
+class Tracer {
+public:
+    // per thread, 32 bytes each.
+    static constexpr int kEventsPerThread = 1 << 16;
+
+private:
+    static std::atomic<bool> sEnabled;
+
+public:
+    static bool Enabled(void) { return sEnabled.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool enabled);
+
+    // Monotonic nanoseconds, never 0.
+    static uint64_t Now(void);
+
+    // category and name must outlive the tracer, string literals or __func__.
+    static void Record(const char* category, const char* name, uint64_t startNanos, uint64_t endNanos);
+    // Name shown for the calling thread's track, copied.
+    static void SetThreadName(const char* name);
+
+    // Events still in the buffers, across every thread.
+    static size_t EventCount(void);
+    // Drops every recorded event, thread names are kept.
+    static void Clear(void);
+
+    static void WriteChromeJSON(std::ostream& out);
+    static bool WriteChromeJSON(const char* path);
+
+    static bool Test(void);
+};
+
+// Records the enclosing block as one event, if tracing was on when it started.
+class TraceZone {
+private:
+    const char* mCategory;
+    const char* mName;
+    uint64_t mStart;
+
+public:
+    TraceZone(const char* category, const char* name)
+        : mCategory(category), mName(name), mStart(Tracer::Enabled() ? Tracer::Now() : 0) {}
+
+    ~TraceZone()
+    {
+        if(mStart != 0) {
+            Tracer::Record(mCategory, mName, mStart, Tracer::Now());
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    TraceZone& operator = (const TraceZone&) = delete;
+};
+
+#if ENABLE_TRACING
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+// Times the rest of the enclosing block.
+#define TRACE_ZONE(category, name) TraceZone TRACE_CONCAT(traceZone, __LINE__)(category, name)
+// TRACE_ZONE named after the enclosing function.
+#define TRACE_FUNCTION(category) TRACE_ZONE(category, __func__)
+#define TRACE_THREAD_NAME(name) Tracer::SetThreadName(name)
+#else
+#define TRACE_ZONE(category, name)
+#define TRACE_FUNCTION(category)
+#define TRACE_THREAD_NAME(name)
+#endif
+
+#endif /* trace_hpp */
@@ -55,13 +55,14 @@ public:
     const std::vector<Vector3>& GetVertexNormals(void) const { return mVertexNormals; }
     
     static bool Test();
+
+    // Ray against one triangle, with the hit's barycentric beta and gamma. Public for the microbenchmarks.
+	static bool IntersectTriangle(const Ray& r, double& outT, double& outBeta, double& outGamma, const Vector3& v1, const Vector3& v2, const Vector3& v3);
     
 private:
 	Vector3 CalcSmoothNormal(size_t index, double beta, double gamma) const;
 
     static BBox CalcBBox(Vector3 v1, Vector3 v2, Vector3 v3);
-    
-	static bool IntersectTriangle(const Ray& r, double& outT, double& outBeta, double& outGamma, const Vector3& v1, const Vector3& v2, const Vector3& v3);
 };
 
 bool LoadTestMesh(TriangleMesh& mesh);
@@ -0,0 +1,308 @@
+//
+//  uniform_buffers.cpp
+//  opengl_setup_example
+//
+
+#include "uniform_buffers.h"
+
+#include <iostream>
+#include <cstring>
+
+#include <glm/ext.hpp>
+
+#include "model_object.h"
+#include "frame_state.h"
+#include "gl_state.h"
+#include "gl_backend.h"
+#include "dbgutils.h"
+
+// how long to wait on a ring segment the GPU has not finished with, in nanoseconds.
+constexpr GLuint64 kFenceTimeout = 1000000000ull;
+
+static GLsizeiptr AlignUp(GLsizeiptr size, GLsizeiptr alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+static void PackVec4(const glm::vec3& v, float w, float* dest)
+{
+    dest[0] = v.x;
+    dest[1] = v.y;
+    dest[2] = v.z;
+    dest[3] = w;
+}
+
+void PackFrameBlock(const FrameState& frameState, float* dest)
+{
+    memcpy(dest, glm::value_ptr(frameState.viewMatrix), 16 * sizeof(float));
+    memcpy(dest + 16, glm::value_ptr(frameState.projMatrix), 16 * sizeof(float));
+    PackVec4(frameState.lightPosition, 1.0f, dest + 32);
+    PackVec4(frameState.globalAmbient, 0.0f, dest + 36);
+    PackVec4(frameState.lightDiffuse, 0.0f, dest + 40);
+    PackVec4(frameState.lightSpecular, 0.0f, dest + 44);
+}
+
+void PackMaterialBlock(const Material& material, float* dest)
+{
+    PackVec4(material.ambient, 0.0f, dest);
+    PackVec4(material.diffuse, 0.0f, dest + 4);
+    PackVec4(material.specular, 0.0f, dest + 8);
+    dest[12] = material.specExp;
+    dest[13] = dest[14] = dest[15] = 0.0f;
+}
+
+void PackObjectBlock(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, float* dest)
+{
+    glm::mat4 normMat = glm::transpose(glm::inverse(viewMatrix * modelMatrix));
+    memcpy(dest, glm::value_ptr(modelMatrix), 16 * sizeof(float));
+    memcpy(dest + 16, glm::value_ptr(normMat), 16 * sizeof(float));
+}
+
+
+UniformBuffers::UniformBuffers()
+    : mState(nullptr), mFrameBuffer(0), mMaterialBuffer(0), mObjectBuffer(0),
+      mMaterialStride(0), mObjectStride(0), mObjectCapacity(0), mRingSegment(0)
+{
+    for(int i = 0; i < kRingFrames; i++) {
+        mFences[i] = nullptr;
+    }
+}
+
+UniformBuffers::~UniformBuffers()
+{
+    if(!mState) {
+        return;
+    }
+    GLBackend& backend = mState->Backend();
+    for(int i = 0; i < kRingFrames; i++) {
+        if(mFences[i]) {
+            backend.DeleteSync(mFences[i]);
+        }
+    }
+    GLuint buffers[] = { mFrameBuffer, mMaterialBuffer, mObjectBuffer };
+    for(GLuint buffer : buffers) {
+        if(buffer != 0) {
+            backend.DeleteBuffer(buffer);
+        }
+    }
+}
+
+void UniformBuffers::Init(GLStateCache* state)
+{
+    mState = state;
+    GLBackend& backend = mState->Backend();
+    GLint alignment = 256;
+    backend.GetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if(alignment <= 0) {
+        alignment = 256;
+    }
+    mMaterialStride = AlignUp(kMaterialBlockFloats * sizeof(float), alignment);
+    mObjectStride = AlignUp(kObjectBlockFloats * sizeof(float), alignment);
+
+    mFrameBuffer = backend.GenBuffer();
+    mState->BindBuffer(GL_UNIFORM_BUFFER, mFrameBuffer);
+    backend.BufferData(GL_UNIFORM_BUFFER, kFrameBlockFloats * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    mState->BindBufferBase(GL_UNIFORM_BUFFER, kFrameBlockBinding, mFrameBuffer);
+
+    mMaterialBuffer = backend.GenBuffer();
+    mObjectBuffer = backend.GenBuffer();
+}
+
+void UniformBuffers::BindBlocks(GLBackend& backend, GLuint program)
+{
+    const struct { const char* name; GLuint binding; int floats; } blocks[] = {
+        { "FrameData", kFrameBlockBinding, kFrameBlockFloats },
+        { "MaterialData", kMaterialBlockBinding, kMaterialBlockFloats },
+        { "ObjectData", kObjectBlockBinding, kObjectBlockFloats },
+    };
+    for(const auto& block : blocks) {
+        GLuint index = backend.GetUniformBlockIndex(program, block.name);
+        // Not every program uses every block.
+        if(index != GL_INVALID_INDEX) {
+            backend.UniformBlockBinding(program, index, block.binding);
+            // The ranges bound are this size, a smaller range than the shader's block is
+            // an error at draw time. The null backend doesn't know the size and says 0.
+            GLint size = 0;
+            backend.GetActiveUniformBlockiv(program, index, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+            if(size != 0 && size != (GLint)(block.floats * sizeof(float))) {
+                std::cerr << "UniformBuffers: " << block.name << " is " << size << " bytes in the shader, "
+                          << block.floats * sizeof(float) << " packed" << std::endl;
+                DbgAssert(false);
+            }
+        }
+    }
+}
+
+int UniformBuffers::AddMaterial(const Material& material)
+{
+    for(size_t i = 0; i < mMaterials.size(); i++) {
+        const Material& m = mMaterials[i];
+        if(m.ambient == material.ambient && m.diffuse == material.diffuse &&
+           m.specular == material.specular && m.specExp == material.specExp) {
+            return (int)i;
+        }
+    }
+    mMaterials.push_back(material);
+    return (int)mMaterials.size() - 1;
+}
+
+void UniformBuffers::UploadMaterials(void)
+{
+    if(mMaterials.empty()) {
+        return;
+    }
+    const size_t strideFloats = mMaterialStride / sizeof(float);
+    std::vector<float> data(mMaterials.size() * strideFloats, 0.0f);
+    for(size_t i = 0; i < mMaterials.size(); i++) {
+        PackMaterialBlock(mMaterials[i], &data[i * strideFloats]);
+    }
+    mState->BindBuffer(GL_UNIFORM_BUFFER, mMaterialBuffer);
+    mState->Backend().BufferData(GL_UNIFORM_BUFFER, data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+}
+
+void UniformBuffers::UpdateFrame(const FrameState& frameState)
+{
+    mStats = UniformStats();
+
+    float block[kFrameBlockFloats];
+    PackFrameBlock(frameState, block);
+    mState->BindBuffer(GL_UNIFORM_BUFFER, mFrameBuffer);
+    mState->Backend().BufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(block), block);
+    mStats.uploads++;
+}
+
+void UniformBuffers::GrowObjectBuffer(int count)
+{
+    // New storage, nothing the old fences guarded is used any more.
+    GLBackend& backend = mState->Backend();
+    for(int i = 0; i < kRingFrames; i++) {
+        if(mFences[i]) {
+            backend.DeleteSync(mFences[i]);
+            mFences[i] = nullptr;
+        }
+    }
+    mObjectCapacity = count > mObjectCapacity * 2 ? count : mObjectCapacity * 2;
+    mState->BindBuffer(GL_UNIFORM_BUFFER, mObjectBuffer);
+    backend.BufferData(GL_UNIFORM_BUFFER, kRingFrames * mObjectCapacity * mObjectStride, nullptr, GL_STREAM_DRAW);
+}
+
+void UniformBuffers::WriteObjectTransforms(const std::vector<ModelObject*>& objects, const glm::mat4& viewMatrix, bool includeInstances)
+{
+    int count = 0;
+    for(ModelObject* obj : objects) {
+        bool drawn = obj->Visible() && !obj->isCulled && obj->geometry && (includeInstances || !obj->isInstance);
+        obj->transformSlot = drawn ? count++ : -1;
+    }
+    if(count == 0) {
+        return;
+    }
+    if(count > mObjectCapacity) {
+        GrowObjectBuffer(count);
+    }
+
+    GLBackend& backend = mState->Backend();
+    GLsync& fence = mFences[mRingSegment];
+    if(fence) {
+        GLenum result = backend.ClientWaitSync(fence, kFenceTimeout);
+        if(result == GL_WAIT_FAILED || result == GL_TIMEOUT_EXPIRED) {
+            std::cerr << "Timed out waiting for uniform ring segment " << mRingSegment << std::endl;
+        }
+        backend.DeleteSync(fence);
+        fence = nullptr;
+    }
+
+    // The fence means the GPU is done with this segment, so no need for the driver to sync too.
+    mState->BindBuffer(GL_UNIFORM_BUFFER, mObjectBuffer);
+    GLintptr segmentOffset = mRingSegment * mObjectCapacity * mObjectStride;
+    uint8_t* mapped = (uint8_t*)backend.MapBufferRange(GL_UNIFORM_BUFFER, segmentOffset, count * mObjectStride,
+                                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if(!mapped) {
+        std::cerr << "Could not map object uniform buffer" << std::endl;
+        return;
+    }
+    for(ModelObject* obj : objects) {
+        if(obj->transformSlot >= 0) {
+            PackObjectBlock(obj->modelMatrixStack.top(), viewMatrix, (float*)(mapped + obj->transformSlot * mObjectStride));
+        }
+    }
+    backend.UnmapBuffer(GL_UNIFORM_BUFFER);
+    mStats.uploads++;
+}
+
+void UniformBuffers::BindMaterial(int slot)
+{
+    mState->BindBufferRange(GL_UNIFORM_BUFFER, kMaterialBlockBinding, mMaterialBuffer,
+                            slot * mMaterialStride, kMaterialBlockFloats * sizeof(float));
+    mStats.rangeBinds++;
+}
+
+void UniformBuffers::BindObject(int slot)
+{
+    GLintptr segmentOffset = mRingSegment * mObjectCapacity * mObjectStride;
+    mState->BindBufferRange(GL_UNIFORM_BUFFER, kObjectBlockBinding, mObjectBuffer,
+                            segmentOffset + slot * mObjectStride, kObjectBlockFloats * sizeof(float));
+    mStats.rangeBinds++;
+}
+
+void UniformBuffers::EndFrame(void)
+{
+    if(mObjectCapacity > 0) {
+        GLBackend& backend = mState->Backend();
+        if(mFences[mRingSegment]) {
+            backend.DeleteSync(mFences[mRingSegment]);
+        }
+        mFences[mRingSegment] = backend.FenceSync();
+    }
+    mRingSegment = (mRingSegment + 1) % kRingFrames;
+}
+
+
+bool UniformBuffers::Test(void)
+{
+    FrameState frameState;
+    frameState.viewMatrix = glm::lookAt(glm::vec3(0, 0, 3), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
+    frameState.projMatrix = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f);
+    frameState.lightPosition = glm::vec3(-5, 5, 0);
+    frameState.globalAmbient = glm::vec3(0.1f, 0.2f, 0.3f);
+    frameState.lightDiffuse = glm::vec3(1, 1, 1);
+    frameState.lightSpecular = glm::vec3(0.5f, 0.5f, 0.5f);
+
+    // std140 offsets must match the blocks in the shaders.
+    float frameBlock[kFrameBlockFloats];
+    PackFrameBlock(frameState, frameBlock);
+    DbgAssertAlmostEqual(frameBlock[14], frameState.viewMatrix[3][2]);
+    DbgAssertAlmostEqual(frameBlock[16], frameState.projMatrix[0][0]);
+    DbgAssertAlmostEqual(frameBlock[32], -5.0);
+    DbgAssertAlmostEqual(frameBlock[35], 1.0);
+    DbgAssertAlmostEqual(frameBlock[38], 0.3, 1e-6);
+    DbgAssertAlmostEqual(frameBlock[44], 0.5);
+
+    Material material(glm::vec3(0.1f, 0.1f, 0.1f), glm::vec3(1, 0.5f, 0.25f), glm::vec3(1, 1, 1), 15);
+    float materialBlock[kMaterialBlockFloats];
+    PackMaterialBlock(material, materialBlock);
+    DbgAssertAlmostEqual(materialBlock[6], 0.25);
+    DbgAssertAlmostEqual(materialBlock[7], 0.0);
+    DbgAssertAlmostEqual(materialBlock[12], 15.0);
+    // std140 pads the block to a whole vec4.
+    DbgAssert(kMaterialBlockFloats * sizeof(float) % 16 == 0);
+    DbgAssertAlmostEqual(materialBlock[15], 0.0);
+
+    glm::mat4 model = glm::scale(glm::translate(glm::identity<glm::mat4>(), glm::vec3(1, 2, -3)), glm::vec3(2.0f));
+    float objectBlock[kObjectBlockFloats];
+    PackObjectBlock(model, frameState.viewMatrix, objectBlock);
+    DbgAssertAlmostEqual(objectBlock[13], 2.0);
+    // normal matrix undoes the scale.
+    DbgAssertAlmostEqual(objectBlock[16], 0.5, 1e-6);
+
+    // Equal materials share a slot.
+    UniformBuffers buffers;
+    int first = buffers.AddMaterial(material);
+    int same = buffers.AddMaterial(Material(glm::vec3(0.1f, 0.1f, 0.1f), glm::vec3(1, 0.5f, 0.25f), glm::vec3(1, 1, 1), 15));
+    int other = buffers.AddMaterial(Material());
+    DbgAssert(first == 0 && same == 0 && other == 1);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,116 @@
+//
+//  uniform_buffers.h
+//  opengl_setup_example
+//
+
+#ifndef uniform_buffers_hpp
+#define uniform_buffers_hpp
+
+#include <vector>
+
+// Define before OpenGL and GLUT includes to avoid deprecation messages
+#define GL_SILENCE_DEPRECATION
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+struct Material;
+struct FrameState;
+class ModelObject;
+class GLStateCache;
+class GLBackend;
+
+// Binding points of the std140 blocks declared in the phong shaders.
+enum UniformBlockBinding {
+    kFrameBlockBinding = 0,
+    kMaterialBlockBinding = 1,
+    kObjectBlockBinding = 2,
+};
+
+// Block sizes in floats following std140 rules, vec3 members are padded to vec4.
+// FrameData: viewMatrix, projMatrix, lightPosition, globalAmbient, lightDiffuse, lightSpecular.
+constexpr int kFrameBlockFloats = 16 + 16 + 4 * 4;
+// MaterialData: materialAmbient, materialDiffuse, materialSpecular, materialSpecExp, and
+// 3 floats of padding, since std140 rounds a block up to a multiple of vec4.
+constexpr int kMaterialBlockFloats = 4 * 4;
+// ObjectData: modelMatrix, normMatrix.
+constexpr int kObjectBlockFloats = 16 + 16;
+
+void PackFrameBlock(const FrameState& frameState, float* dest);
+void PackMaterialBlock(const Material& material, float* dest);
+void PackObjectBlock(const glm::mat4& modelMatrix, const glm::mat4& viewMatrix, float* dest);
+
+struct UniformStats {
+    // glBufferSubData and map/unmap pairs.
+    int uploads;
+    int rangeBinds;
+
+    UniformStats() : uploads(0), rangeBinds(0) {}
+};
+
+// Owns the uniform buffers behind the phong shader blocks.
+// The frame block is uploaded once per frame. Materials are uploaded once and each
+// draw binds its slot by range. Object transforms go into a buffer split in
+// kRingFrames segments so the CPU writes one segment while the GPU may still read
+// the others, with a fence per segment to make sure.
+class UniformBuffers {
+public:
+    static constexpr int kRingFrames = 3;
+
+private:
+    GLStateCache* mState;
+    GLuint mFrameBuffer;
+    GLuint mMaterialBuffer;
+    GLuint mObjectBuffer;
+
+    // strides rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT for binding by range.
+    GLsizeiptr mMaterialStride;
+    GLsizeiptr mObjectStride;
+
+    std::vector<Material> mMaterials;
+
+    int mObjectCapacity;
+    int mRingSegment;
+    GLsync mFences[kRingFrames];
+
+    UniformStats mStats;
+
+    void GrowObjectBuffer(int count);
+
+public:
+    UniformBuffers();
+    ~UniformBuffers();
+
+    UniformBuffers(const UniformBuffers&) = delete;
+    UniformBuffers& operator = (const UniformBuffers&) = delete;
+
+    // Needs a current GL context. Everything goes through state and its backend.
+    void Init(GLStateCache* state);
+
+    // Points the blocks in program at the binding points above.
+    static void BindBlocks(GLBackend& backend, GLuint program);
+
+    // Returns the material slot for material, adding it if no equal material is there yet.
+    int AddMaterial(const Material& material);
+    // Uploads every material added so far. Call after adding and before drawing.
+    void UploadMaterials(void);
+
+    // Uploads the frame block and resets the stats.
+    void UpdateFrame(const FrameState& frameState);
+
+    // Writes transforms of every visible, unculled object into this frame's segment
+    // and sets transformSlot on them. Instances only get slots if includeInstances is set.
+    void WriteObjectTransforms(const std::vector<ModelObject*>& objects, const glm::mat4& viewMatrix, bool includeInstances);
+
+    void BindMaterial(int slot);
+    void BindObject(int slot);
+
+    // Fences this frame's segment and moves on to the next one.
+    void EndFrame(void);
+
+    const UniformStats& Stats(void) const { return mStats; }
+
+    static bool Test(void);
+};
+
+#endif /* uniform_buffers_hpp */
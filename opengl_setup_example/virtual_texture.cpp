@@ -0,0 +1,388 @@
+//
+//  virtual_texture.cpp
+//  opengl_setup_example
+//
+
+#include "virtual_texture.h"
+
+#include <iostream>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <random>
+
+#include "thread_pool.h"
+#include "texture_cache.h"
+#include "mathutil.h"
+#include "trace.h"
+#include "dbgutils.h"
+
+VirtualTexture::VirtualTexture(u_int32_t size, const ProcRegionFn& fill, size_t budgetBytes, ThreadPool* pool)
+    : mSize(size), mLevelCount(TextureLevels::FullChainLength(size, size)), mFill(fill), mBudgetBytes(budgetBytes),
+      mPool(pool), mResidentBytes(0), mHits(0), mMisses(0), mEvictions(0)
+{
+}
+
+u_int32_t VirtualTexture::LevelSize(int level) const
+{
+    return TMax(mSize >> level, 1u);
+}
+
+uint64_t VirtualTexture::PageKey(int level, u_int32_t pageX, u_int32_t pageY)
+{
+    return ((uint64_t)level << 58) | ((uint64_t)pageY << 29) | pageX;
+}
+
+void VirtualTexture::EvictOverBudget(size_t keepCount)
+{
+    while(mResidentBytes > mBudgetBytes && mLRU.size() > keepCount) {
+        auto found = mPages.find(mLRU.back());
+        mResidentBytes -= found->second.page->pixels.size();
+        mPages.erase(found);
+        mLRU.pop_back();
+        mEvictions++;
+    }
+}
+
+void VirtualTexture::AcquirePages(const std::vector<uint64_t>& keys, ThreadPool* pool,
+                                  std::vector<std::shared_ptr<const Page>>& pages)
+{
+    std::vector<std::shared_ptr<Page>> toMake;
+    pages.clear();
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for(uint64_t key : keys) {
+            auto found = mPages.find(key);
+            if(found != mPages.end()) {
+                mHits++;
+                mLRU.splice(mLRU.begin(), mLRU, found->second.lruPosition);
+                pages.push_back(found->second.page);
+                continue;
+            }
+
+            mMisses++;
+            std::shared_ptr<Page> page = std::make_shared<Page>();
+            page->level = (int)(key >> 58);
+            page->x = (u_int32_t)(key & 0x1fffffff) * kPageSize;
+            page->y = (u_int32_t)((key >> 29) & 0x1fffffff) * kPageSize;
+            u_int32_t levelSize = LevelSize(page->level);
+            page->width = TMin(kPageSize, levelSize - page->x);
+            page->height = TMin(kPageSize, levelSize - page->y);
+            page->rowBytes = (u_int32_t)TextureLevels::LevelBytes(page->width, 1, kChannels);
+            page->pixels.resize((size_t)page->rowBytes * page->height);
+            page->ready = false;
+
+            mLRU.push_front(key);
+            mPages[key] = Entry { page, mLRU.begin() };
+            mResidentBytes += page->pixels.size();
+            toMake.push_back(page);
+            pages.push_back(page);
+        }
+        EvictOverBudget(keys.size());
+    }
+
+    // new pages are only reachable through the table as not ready, so they fill without the lock.
+    if(!toMake.empty()) {
+        TRACE_ZONE("texture", "VirtualTexture fill pages");
+        std::vector<Page*> generated, filtered;
+        for(auto& page : toMake) {
+            (page->level == 0 ? generated : filtered).push_back(page.get());
+        }
+        auto make = [&](int i) {
+            Page& page = *generated[i];
+            mFill(0, page.x, page.y, page.width, page.height, page.pixels.data(), page.rowBytes);
+        };
+        if(pool) {
+            pool->ParallelFor((int)generated.size(), make);
+        } else {
+            for(int i = 0; i < (int)generated.size(); i++) {
+                make(i);
+            }
+        }
+        // on this thread, since reading the level below may need the pool itself.
+        for(Page* page : filtered) {
+            FilterPage(*page, pool);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            for(auto& page : toMake) {
+                page->ready = true;
+            }
+        }
+        mReadyCondition.notify_all();
+    }
+
+    // pages another caller is still making.
+    std::unique_lock<std::mutex> lock(mMutex);
+    mReadyCondition.wait(lock, [&] {
+        for(auto& page : pages) {
+            if(!page->ready) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+
+void VirtualTexture::FilterPage(Page& page, ThreadPool* pool)
+{
+    // the texels under the page, an odd last row or column of the level below is averaged with itself.
+    const u_int32_t belowSize = LevelSize(page.level - 1);
+    const u_int32_t srcWidth = TMin(page.width * 2, belowSize - page.x * 2);
+    const u_int32_t srcHeight = TMin(page.height * 2, belowSize - page.y * 2);
+    const u_int32_t srcRowBytes = srcWidth * kChannels;
+    std::vector<uint8_t> below((size_t)srcRowBytes * srcHeight);
+    ReadRegionOn(pool, page.level - 1, page.x * 2, page.y * 2, srcWidth, srcHeight, below.data(), srcRowBytes);
+
+    for(u_int32_t y = 0; y < page.height; y++) {
+        const uint8_t* row0 = below.data() + TMin(y * 2, srcHeight - 1) * srcRowBytes;
+        const uint8_t* row1 = below.data() + TMin(y * 2 + 1, srcHeight - 1) * srcRowBytes;
+        uint8_t* out = page.pixels.data() + y * page.rowBytes;
+        for(u_int32_t x = 0; x < page.width; x++) {
+            u_int32_t x0 = TMin(x * 2, srcWidth - 1) * kChannels;
+            u_int32_t x1 = TMin(x * 2 + 1, srcWidth - 1) * kChannels;
+            for(u_int16_t c = 0; c < kChannels; c++) {
+                *out++ = (uint8_t)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+            }
+        }
+    }
+}
+
+void VirtualTexture::ForEachPage(int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                                 const PageVisitor& visit)
+{
+    ForEachPageOn(mPool, level, x, y, width, height, visit);
+}
+
+void VirtualTexture::ForEachPageOn(ThreadPool* pool, int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                                   const PageVisitor& visit)
+{
+    if(level < 0 || level >= mLevelCount) {
+        return;
+    }
+    const u_int32_t levelSize = LevelSize(level);
+    if(x >= levelSize || y >= levelSize) {
+        return;
+    }
+    width = TMin(width, levelSize - x);
+    height = TMin(height, levelSize - y);
+    if(width == 0 || height == 0) {
+        return;
+    }
+
+    // as many pages at once as fit in the budget, so a huge region cannot blow through it.
+    const size_t fullPageBytes = TextureLevels::LevelBytes(kPageSize, kPageSize, kChannels);
+    const size_t pagesAtOnce = TMax(mBudgetBytes / fullPageBytes, (size_t)1);
+
+    std::vector<uint64_t> keys;
+    std::vector<std::shared_ptr<const Page>> pages;
+    auto visitPages = [&] {
+        AcquirePages(keys, pool, pages);
+        for(const auto& page : pages) {
+            u_int32_t x0 = TMax(x, page->x);
+            u_int32_t y0 = TMax(y, page->y);
+            u_int32_t x1 = TMin(x + width, page->x + page->width);
+            u_int32_t y1 = TMin(y + height, page->y + page->height);
+            visit(*page, x0, y0, x1 - x0, y1 - y0);
+        }
+        keys.clear();
+        pages.clear();
+    };
+
+    for(u_int32_t pageY = y / kPageSize; pageY <= (y + height - 1) / kPageSize; pageY++) {
+        for(u_int32_t pageX = x / kPageSize; pageX <= (x + width - 1) / kPageSize; pageX++) {
+            keys.push_back(PageKey(level, pageX, pageY));
+            if(keys.size() == pagesAtOnce) {
+                visitPages();
+            }
+        }
+    }
+    if(!keys.empty()) {
+        visitPages();
+    }
+}
+
+void VirtualTexture::ReadRegion(int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                                uint8_t* pixels, u_int32_t rowBytes)
+{
+    TRACE_FUNCTION("texture");
+    ReadRegionOn(mPool, level, x, y, width, height, pixels, rowBytes);
+}
+
+void VirtualTexture::ReadRegionOn(ThreadPool* pool, int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                                  uint8_t* pixels, u_int32_t rowBytes)
+{
+    ForEachPageOn(pool, level, x, y, width, height, [&](const Page& page, u_int32_t px, u_int32_t py, u_int32_t pw, u_int32_t ph) {
+        for(u_int32_t row = 0; row < ph; row++) {
+            const uint8_t* src = page.pixels.data() + (py - page.y + row) * page.rowBytes + (px - page.x) * kChannels;
+            uint8_t* dst = pixels + (size_t)(py - y + row) * rowBytes + (px - x) * kChannels;
+            memcpy(dst, src, pw * kChannels);
+        }
+    });
+}
+
+ColorF VirtualTexture::Sample(double u, double v, int level)
+{
+    level = TClip(level, 0, mLevelCount - 1);
+    const u_int32_t levelSize = LevelSize(level);
+    u_int32_t tx = TMin((u_int32_t)((u - floor(u)) * levelSize), levelSize - 1);
+    u_int32_t ty = TMin((u_int32_t)((v - floor(v)) * levelSize), levelSize - 1);
+
+    const uint64_t key = PageKey(level, tx / kPageSize, ty / kPageSize);
+    // most samples land on a page that is already made, and are read under the lock.
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        auto found = mPages.find(key);
+        if(found != mPages.end() && found->second.page->ready) {
+            mHits++;
+            mLRU.splice(mLRU.begin(), mLRU, found->second.lruPosition);
+            const Page& page = *found->second.page;
+            const uint8_t* texel = page.pixels.data() + (ty - page.y) * page.rowBytes + (tx - page.x) * kChannels;
+            return From24Color(texel[0], texel[1], texel[2]);
+        }
+    }
+
+    std::vector<uint64_t> keys = { key };
+    std::vector<std::shared_ptr<const Page>> pages;
+    AcquirePages(keys, nullptr, pages);
+    const Page& page = *pages[0];
+    const uint8_t* texel = page.pixels.data() + (ty - page.y) * page.rowBytes + (tx - page.x) * kChannels;
+    return From24Color(texel[0], texel[1], texel[2]);
+}
+
+size_t VirtualTexture::ResidentBytes(void)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mResidentBytes;
+}
+
+int VirtualTexture::ResidentPages(void)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return (int)mPages.size();
+}
+
+int VirtualTexture::Hits(void)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mHits;
+}
+
+int VirtualTexture::Misses(void)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMisses;
+}
+
+int VirtualTexture::Evictions(void)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mEvictions;
+}
+
+
+bool VirtualTexture::Test(void)
+{
+    const RGBColor blue = {0, 0, 255};
+    const RGBColor white = {255, 255, 255};
+    // not a multiple of the page size, so the edge pages are partial, and three by three pages
+    // against a budget of four, so reading all of it has to go in pieces.
+    const u_int32_t kSize = 260;
+    const size_t kPageBytes = TextureLevels::LevelBytes(kPageSize, kPageSize, kChannels);
+    const size_t kBudget = 4 * kPageBytes;
+    std::unique_ptr<RGBImageBuffer> reference(GenerateMarble(kSize, blue, white));
+
+    VirtualTexture texture(kSize, MarbleRegion(blue, white), kBudget);
+    DbgAssert(texture.LevelCount() == 9);
+    DbgAssert(texture.LevelSize(1) == 130 && texture.LevelSize(8) == 1);
+
+    // Level 0 is the generator's image.
+    RGBImageBuffer read(kSize, kSize);
+    texture.ReadRegion(0, 0, 0, kSize, kSize, read.Pixels(), read.RowBytes());
+    DbgAssert(memcmp(read.Pixels(), reference->Pixels(), read.RowBytes() * kSize) == 0);
+    DbgAssert(texture.Misses() == 9 && texture.Hits() == 0);
+    DbgAssert(texture.ResidentBytes() <= kBudget);
+    DbgAssert(texture.Evictions() > 0 && texture.Evictions() == texture.Misses() - texture.ResidentPages());
+
+    // The last pages read are still there. Their region comes back without making anything.
+    int missesBefore = texture.Misses();
+    uint8_t corner[4 * 4 * 3];
+    texture.ReadRegion(0, 256, 256, 20, 20, corner, 4 * 3);
+    DbgAssert(texture.Misses() == missesBefore && texture.Hits() == 1);
+    DbgAssert(memcmp(corner + 3 * 12, reference->Pixels() + 259 * reference->RowBytes() + 256 * 3, 12) == 0);
+
+    // Level 1 is level 0 box filtered, as a TextureLevels makes it.
+    std::unique_ptr<TextureLevels> filtered = TextureLevels::FromImage(*reference, true);
+    const TextureLevels::Level& expectedHalf = filtered->GetLevel(1);
+    RGBImageBuffer half(130, 130);
+    texture.ReadRegion(1, 0, 0, 130, 130, half.Pixels(), half.RowBytes());
+    for(u_int32_t y = 0; y < 130; y++) {
+        DbgAssert(memcmp(half.Pixels() + y * half.RowBytes(), expectedHalf.pixels + y * expectedHalf.rowBytes, 130 * 3) == 0);
+    }
+
+    // The same again on a pool, with a budget that holds the whole texture.
+    ThreadPool pool(3);
+    VirtualTexture pooled(kSize, MarbleRegion(blue, white), 20 * kPageBytes, &pool);
+    RGBImageBuffer pooledRead(kSize, kSize);
+    pooled.ReadRegion(0, 0, 0, kSize, kSize, pooledRead.Pixels(), pooledRead.RowBytes());
+    DbgAssert(memcmp(pooledRead.Pixels(), reference->Pixels(), read.RowBytes() * kSize) == 0);
+
+    // Samples from several threads at once, against the reference. They all land on pages
+    // the read above left resident, bench_main has them thrashing a smaller budget.
+    VirtualTexture& sampled = pooled;
+    const int warmMisses = sampled.Misses();
+    std::vector<std::thread> threads;
+    std::vector<int> wrong(4, 0);
+    for(int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t] {
+            std::mt19937 rng(t);
+            std::uniform_real_distribution<double> dist(0.0, 1.0);
+            for(int i = 0; i < 32; i++) {
+                double u = dist(rng), v = dist(rng);
+                ColorF sampledColor = sampled.Sample(u, v, 0);
+                const uint8_t* expected = reference->Pixels() + (u_int32_t)(v * kSize) * reference->RowBytes() + (u_int32_t)(u * kSize) * 3;
+                ColorF exact = From24Color(expected[0], expected[1], expected[2]);
+                if(sampledColor.r != exact.r || sampledColor.g != exact.g || sampledColor.b != exact.b) {
+                    wrong[t]++;
+                }
+            }
+        });
+    }
+    for(auto& thread : threads) {
+        thread.join();
+    }
+    for(int count : wrong) {
+        DbgAssert(count == 0);
+    }
+    DbgAssert(sampled.Misses() == warmMisses && sampled.Evictions() == 0);
+
+    // The last level is the whole texture filtered down, made from the levels below on the pool.
+    const TextureLevels::Level& expectedTop = filtered->GetLevel(8);
+    uint8_t top[3];
+    pooled.ReadRegion(8, 0, 0, 1, 1, top, 3);
+    DbgAssert(memcmp(top, expectedTop.pixels, 3) == 0);
+    // level 1's four pages, then one for each level up from 65 square.
+    DbgAssert(pooled.Misses() == warmMisses + 4 + 7);
+    ColorF topColor = pooled.Sample(0.3, 0.7, 8);
+    DbgAssert(topColor.r == From24Color(top[0], top[1], top[2]).r && topColor.b == From24Color(top[0], top[1], top[2]).b);
+    DbgAssert(texture.ResidentBytes() <= kBudget);
+
+    // A texture of 64k square costs no more than its budget to read from.
+    VirtualTexture huge(1 << 16, MarbleRegion(blue, white), kBudget);
+    uint8_t far[8 * 8 * 3];
+    int visited = 0;
+    huge.ForEachPage(0, (1 << 16) - 100, (1 << 16) - 8, 100, 8, [&](const Page&, u_int32_t, u_int32_t, u_int32_t width, u_int32_t height) {
+        visited += width * height;
+    });
+    DbgAssert(visited == 100 * 8);
+    huge.ReadRegion(0, 40000, 50000, 8, 8, far, 8 * 3);
+    RGBImageBuffer farPage(8, 8);
+    MarbleRegion(blue, white)(0, 40000, 50000, 8, 8, farPage.Pixels(), farPage.RowBytes());
+    DbgAssert(memcmp(far, farPage.Pixels(), sizeof(far)) == 0);
+    DbgAssert(huge.ResidentBytes() <= kBudget);
+
+    if (DbgHasAssertFailed()) {
+        return false;
+    }
+    return true;
+}
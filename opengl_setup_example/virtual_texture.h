@@ -0,0 +1,126 @@
+//
+//  virtual_texture.h
+//  opengl_setup_example
+//
+
+#ifndef virtual_texture_hpp
+#define virtual_texture_hpp
+
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+#include "color.h"
+#include "proc_textures.h"
+
+class ThreadPool;
+
+// A procedural texture too big to make all at once, 16k square and up. Its levels are split
+// into kPageSize square pages, made the first time something asks for them and kept until
+// the least recently used ones have to go to stay under the memory budget. Level 0 pages
+// come from fill. Each level after it is a 2x2 box filter of the one below, as in
+// TextureLevels::FromImage, made from the pages under it, so a coarse page of a big texture
+// costs everything beneath it the first time.
+//
+// Callers ask for a region of a level. The pages it needs are made together, on the pool if
+// there is one, and a region bigger than the budget is handed over a budget's worth of pages
+// at a time, so memory stays at the budget plus the pages callers are holding however big
+// the texture or the request.
+//
+// Sample can be called from any thread. The region calls use the pool, which only runs one
+// job at a time, so with a pool they must come from one thread at a time.
+class VirtualTexture {
+public:
+    static constexpr u_int32_t kPageSize = 128;
+    static constexpr u_int16_t kChannels = 3;
+
+    // One page's texels, smaller than kPageSize on the right and bottom edges of a level.
+    struct Page {
+        int level;
+        // first texel, in the level's texels.
+        u_int32_t x, y;
+        u_int32_t width, height;
+        // padded to 4 bytes, like TextureLevels, for GL's default unpack alignment.
+        u_int32_t rowBytes;
+        std::vector<uint8_t> pixels;
+        // set once fill has run, under the texture's mutex.
+        bool ready;
+    };
+
+    // called with each page of a region in turn, with the part of the region it covers.
+    typedef std::function<void(const Page& page, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height)> PageVisitor;
+
+private:
+    struct Entry {
+        std::shared_ptr<Page> page;
+        std::list<uint64_t>::iterator lruPosition;
+    };
+
+    u_int32_t mSize;
+    int mLevelCount;
+    ProcRegionFn mFill;
+    size_t mBudgetBytes;
+    ThreadPool* mPool;
+
+    std::mutex mMutex;
+    std::condition_variable mReadyCondition;
+    std::unordered_map<uint64_t, Entry> mPages;
+    // most recently used first.
+    std::list<uint64_t> mLRU;
+    size_t mResidentBytes;
+    int mHits;
+    int mMisses;
+    int mEvictions;
+
+    static uint64_t PageKey(int level, u_int32_t pageX, u_int32_t pageY);
+    // Pins keys' pages into pages, making the missing ones on pool. Keys must be of valid pages.
+    void AcquirePages(const std::vector<uint64_t>& keys, ThreadPool* pool, std::vector<std::shared_ptr<const Page>>& pages);
+    // Drops least recently used pages until under budget, sparing the keepCount most recent.
+    // A page being made or held by a caller lives on until they are done with it. Call with mMutex held.
+    void EvictOverBudget(size_t keepCount);
+    // Fills a page of level 1 or up from the level below, read on pool.
+    void FilterPage(Page& page, ThreadPool* pool);
+    // ForEachPage and ReadRegion making missing pages on pool, which Sample calls without.
+    void ForEachPageOn(ThreadPool* pool, int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                       const PageVisitor& visit);
+    void ReadRegionOn(ThreadPool* pool, int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                      uint8_t* pixels, u_int32_t rowBytes);
+
+public:
+    // size is level 0's width and height, each level after it is half the one before down
+    // to 1x1. budgetBytes is what resident pages may use, at least one page is always kept.
+    VirtualTexture(u_int32_t size, const ProcRegionFn& fill, size_t budgetBytes, ThreadPool* pool = nullptr);
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator = (const VirtualTexture&) = delete;
+
+    u_int32_t Size(void) const { return mSize; }
+    int LevelCount(void) const { return mLevelCount; }
+    u_int32_t LevelSize(int level) const;
+
+    // Calls visit for each page overlapping the region of level, in rows of pages, clipped
+    // to the level. The page is only good during the call.
+    void ForEachPage(int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height, const PageVisitor& visit);
+    // Copies the region into pixels, 3 bytes a texel and rowBytes apart. For baking and uploads.
+    void ReadRegion(int level, u_int32_t x, u_int32_t y, u_int32_t width, u_int32_t height,
+                    uint8_t* pixels, u_int32_t rowBytes);
+    // Texel nearest u, v of level, which wrap to [0, 1). For the ray tracer. A missing page,
+    // and for a level past 0 the pages under it, are made on the calling thread.
+    ColorF Sample(double u, double v, int level);
+
+    size_t BudgetBytes(void) const { return mBudgetBytes; }
+    size_t ResidentBytes(void);
+    int ResidentPages(void);
+    int Hits(void);
+    int Misses(void);
+    int Evictions(void);
+
+    static bool Test(void);
+};
+
+#endif /* virtual_texture_hpp */